@@ -0,0 +1,72 @@
+// Copyright (c) 2024 The blazegeek developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "batchverifier.h"
+#include "ctpl.h"
+#include "util.h"
+
+CBatchVerifierBase::CBatchVerifierBase(const std::string& strThreadNameIn, size_t nBatchSizeIn, int64_t nBatchDelayIn) :
+    strThreadName(strThreadNameIn),
+    nBatchSize(nBatchSizeIn),
+    nBatchDelay(nBatchDelayIn),
+    nTimeFirstPending(0)
+{
+}
+
+CBatchVerifierBase::~CBatchVerifierBase()
+{
+}
+
+void CBatchVerifierBase::Start(int nThreads)
+{
+    LOCK(cs);
+    assert(!pool);
+    if (nThreads <= 0) {
+        return;
+    }
+    LogPrint("net", "CBatchVerifier::%s -- Starting %d %s threads\n", __func__, nThreads, strThreadName);
+    pool.reset(new ctpl::thread_pool(nThreads));
+    RenameThreadPool(*pool, strThreadName.c_str());
+}
+
+void CBatchVerifierBase::Stop()
+{
+    std::unique_ptr<ctpl::thread_pool> poolStopped;
+    {
+        LOCK(cs);
+        ReleasePending();
+        poolStopped.swap(pool);
+    }
+    // Batches taken before still get their checks run
+    if (poolStopped) {
+        poolStopped->stop(true);
+    }
+}
+
+bool CBatchVerifierBase::IsRunning()
+{
+    LOCK(cs);
+    return pool != nullptr;
+}
+
+size_t CBatchVerifierBase::Verify(const std::vector<std::function<bool()> >& vecChecks)
+{
+    std::vector<std::future<bool> > vecFutures;
+    {
+        LOCK(cs);
+        if (!pool) {
+            return 0;
+        }
+        for (const auto& check : vecChecks) {
+            vecFutures.emplace_back(pool->push([check](int) {
+                return check();
+            }));
+        }
+    }
+
+    for (auto& f : vecFutures) {
+        f.wait();
+    }
+    return vecFutures.size();
+}
@@ -0,0 +1,164 @@
+// Copyright (c) 2024 The blazegeek developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BATCHVERIFIER_H
+#define BATCHVERIFIER_H
+
+#include "cachemap.h"
+#include "hash.h"
+#include "net.h"
+#include "sync.h"
+#include "utiltime.h"
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ctpl {
+class thread_pool;
+}
+
+/**
+ * Successful signature checks of network messages which are relayed by every
+ * peer and requested again on each sync, so the same signature is usually seen
+ * many times. Entries are keyed by a hash committing to the message, the
+ * signature and the key it was checked against.
+ */
+class CSignatureCache
+{
+private:
+    CCriticalSection cs;
+    CacheMap<uint256, bool> cache;
+
+public:
+    explicit CSignatureCache(size_t nMaxSize) : cache(nMaxSize) {}
+
+    template <typename Key>
+    static uint256 GetEntry(const uint256& nMessageHash, const std::vector<unsigned char>& vchSig, const Key& key, bool fNewSigs)
+    {
+        CHashWriter ss(SER_GETHASH, 0);
+        ss << nMessageHash << vchSig << key << fNewSigs;
+        return ss.GetHash();
+    }
+
+    bool Contains(const uint256& entry)
+    {
+        LOCK(cs);
+        return cache.HasKey(entry);
+    }
+
+    void Add(const uint256& entry)
+    {
+        LOCK(cs);
+        cache.Insert(entry, true);
+    }
+};
+
+/** Threads checking the signatures of a CBatchVerifier, see there */
+class CBatchVerifierBase
+{
+protected:
+    const std::string strThreadName;
+    const size_t nBatchSize;
+    const int64_t nBatchDelay;
+
+    CCriticalSection cs;
+    int64_t nTimeFirstPending;
+    std::unique_ptr<ctpl::thread_pool> pool;
+
+    CBatchVerifierBase(const std::string& strThreadNameIn, size_t nBatchSizeIn, int64_t nBatchDelayIn);
+
+    /// Release the nodes of the messages still queued, cs is held
+    virtual void ReleasePending() = 0;
+
+public:
+    virtual ~CBatchVerifierBase();
+
+    /// Start nThreads verification threads, 0 keeps the messages from being queued
+    void Start(int nThreads);
+    /// Stop the threads and release the nodes of the messages still queued,
+    /// must be called while the connection manager still owns the nodes
+    void Stop();
+    bool IsRunning();
+
+    /// Run the checks on the verification threads and wait for all of them,
+    /// returns how many were run, none once the threads are stopped
+    size_t Verify(const std::vector<std::function<bool()> >& vecChecks);
+};
+
+/**
+ * Queue of messages received from the network whose signatures are checked in
+ * parallel batches before the messages are processed one by one. A batch is due
+ * once nBatchSize messages are pending or the oldest one has been waiting for
+ * nBatchDelay milliseconds. Every queued message holds a reference to the node
+ * it came from, which passes to whoever takes it out of the queue.
+ */
+template <typename T>
+class CBatchVerifier : public CBatchVerifierBase
+{
+public:
+    typedef std::pair<CNode*, T> Item;
+
+private:
+    std::deque<Item> queuePending;
+
+protected:
+    void ReleasePending() override
+    {
+        for (auto& item : queuePending) {
+            item.first->Release();
+        }
+        queuePending.clear();
+    }
+
+public:
+    CBatchVerifier(const std::string& strThreadNameIn, size_t nBatchSizeIn, int64_t nBatchDelayIn) :
+        CBatchVerifierBase(strThreadNameIn, nBatchSizeIn, nBatchDelayIn)
+    {}
+
+    /// Queue a message from pfrom, false if the threads are not running and it has to be processed right away
+    bool Queue(CNode* pfrom, const T& msg)
+    {
+        LOCK(cs);
+        if (!pool) {
+            return false;
+        }
+        if (queuePending.empty()) {
+            nTimeFirstPending = GetTimeMillis();
+        }
+        pfrom->AddRef();
+        queuePending.emplace_back(pfrom, msg);
+        return true;
+    }
+
+    /// Take the oldest batch if it is due (or fForce is set), at most nBatchSize messages.
+    /// The caller has to Release() the nodes once the messages are processed.
+    bool TakeBatch(std::vector<Item>& vecBatch, bool fForce = false)
+    {
+        LOCK(cs);
+        if (queuePending.empty()) {
+            return false;
+        }
+        if (!fForce && queuePending.size() < nBatchSize && GetTimeMillis() - nTimeFirstPending < nBatchDelay) {
+            return false;
+        }
+        // The rest stays due, so it is taken right away on the next call
+        vecBatch.clear();
+        while (!queuePending.empty() && vecBatch.size() < nBatchSize) {
+            vecBatch.push_back(std::move(queuePending.front()));
+            queuePending.pop_front();
+        }
+        return true;
+    }
+
+    size_t GetQueuedCount()
+    {
+        LOCK(cs);
+        return queuePending.size();
+    }
+};
+
+#endif // BATCHVERIFIER_H
@@ -0,0 +1,75 @@
+// Copyright (c) 2024 The blazegeek developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "arith_uint256.h"
+#include "blockencodings.h"
+#include "policy/policy.h"
+#include "txmempool.h"
+
+#include <vector>
+
+static const size_t MEMPOOL_TX_COUNT = 100000;
+static const size_t BLOCK_TX_COUNT = 2500;
+
+static void AddTx(const CTransactionRef& tx, CTxMemPool& pool)
+{
+    int64_t nTime = 0;
+    double dPriority = 10.0;
+    unsigned int nHeight = 1;
+    bool spendsCoinbase = false;
+    unsigned int sigOpCost = 4;
+    LockPoints lp;
+    pool.addUnchecked(tx->GetHash(), CTxMemPoolEntry(
+                                         tx, 1000, nTime, dPriority, nHeight,
+                                         tx->GetValueOut(), spendsCoinbase, sigOpCost, lp));
+}
+
+static CTransactionRef MakeTx(uint32_t n)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = COutPoint(ArithToUint256(arith_uint256(n + 1)), 0);
+    tx.vin[0].scriptSig = CScript() << OP_1;
+    tx.vout.resize(1);
+    tx.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+    tx.vout[0].nValue = COIN;
+    return MakeTransactionRef(tx);
+}
+
+// Reconstruction of a compact block whose transactions are all known,
+// against a mempool of 100k transactions.
+static void CompactBlockReconstruct(benchmark::State& state)
+{
+    CTxMemPool pool(CFeeRate(0));
+    CBlock block;
+    block.nBits = 0x207fffff;
+
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].prevout.SetNull();
+    coinbase.vout.resize(1);
+    block.vtx.push_back(MakeTransactionRef(coinbase));
+
+    for (uint32_t i = 0; i < MEMPOOL_TX_COUNT; i++) {
+        CTransactionRef tx = MakeTx(i);
+        AddTx(tx, pool);
+        if (i % (MEMPOOL_TX_COUNT / BLOCK_TX_COUNT) == 0)
+            block.vtx.push_back(tx);
+    }
+
+    CBlockHeaderAndShortTxIDs cmpctblock(block);
+    std::vector<std::pair<uint256, CTransactionRef>> extra_txn;
+
+    while (state.KeepRunning()) {
+        PartiallyDownloadedBlock partialBlock(&pool);
+        ReadStatus status = partialBlock.InitData(cmpctblock, extra_txn);
+        assert(status == READ_STATUS_OK);
+        for (size_t i = 0; i < block.vtx.size(); i++)
+            assert(partialBlock.IsTxAvailable(i));
+    }
+}
+
+BENCHMARK(CompactBlockReconstruct);
@@ -57,4 +57,30 @@ static void CoinSelection(benchmark::State& state)
     }
 }
 
+// A wallet of 100k coins of different values, where selection used to
+// copy and sort every coin for each attempt
+static void CoinSelection100k(benchmark::State& state)
+{
+    const CWallet wallet;
+    std::vector<COutput> vCoins;
+    LOCK(wallet.cs_wallet);
+
+    for (int i = 0; i < 100000; i++)
+        addCoin((i * 7919 % 100000 + 1) * 1000 + i % 1000, wallet, vCoins);
+
+    CAmount nTarget = 0;
+    while (state.KeepRunning()) {
+        nTarget = nTarget % (100 * COIN) + 7 * COIN + 12345;
+        std::set<std::pair<const CWalletTx*, unsigned int> > setCoinsRet;
+        CAmount nValueRet;
+        bool success = wallet.SelectCoinsMinConf(nTarget, 1, 6, 0, vCoins, setCoinsRet, nValueRet, ALL_COINS, false, 546);
+        assert(success);
+        assert(nValueRet >= nTarget);
+    }
+
+    BOOST_FOREACH (COutput output, vCoins)
+        delete output.tx;
+}
+
 BENCHMARK(CoinSelection);
+BENCHMARK(CoinSelection100k);
@@ -72,6 +72,23 @@ static void HASH_DSHA256_0032b(benchmark::State& state)
     }
 }
 
+// the level above 1024 merkle tree leaves, compare with HASH_DSHA256_0064b_1024
+static void HASH_SHA256D64_1024(benchmark::State& state)
+{
+    std::vector<uint8_t> in(64 * 1024, 0);
+    while (state.KeepRunning())
+        SHA256D64(in.data(), in.data(), 1024);
+}
+
+static void HASH_DSHA256_0064b_1024(benchmark::State& state)
+{
+    std::vector<uint8_t> in(64 * 1024, 0);
+    while (state.KeepRunning()) {
+        for (int i = 0; i < 1024; i++)
+            CHash256().Write(&in[64 * i], 64).Finalize(&in[32 * i]);
+    }
+}
+
 static void HASH_SHA512(benchmark::State& state)
 {
     uint8_t hash[CSHA512::OUTPUT_SIZE];
@@ -80,6 +97,21 @@ static void HASH_SHA512(benchmark::State& state)
         CSHA512().Write(in.data(), in.size()).Finalize(hash);
 }
 
+static void HASH_SHA512_Iterate(benchmark::State& state)
+{
+    uint8_t hash[CSHA512::OUTPUT_SIZE] = {0};
+    while (state.KeepRunning())
+        SHA512Iterate(hash, 1000);
+}
+
+// four chains of 1000 iterations, compare with HASH_SHA512_Iterate
+static void HASH_SHA512_Iterate4(benchmark::State& state)
+{
+    uint8_t hashes[4 * CSHA512::OUTPUT_SIZE] = {0};
+    while (state.KeepRunning())
+        SHA512Iterate4(hashes, 1000);
+}
+
 static void HASH_SipHash_0032b(benchmark::State& state)
 {
     uint256 x;
@@ -192,7 +224,11 @@ BENCHMARK(HASH_RIPEMD160);
 BENCHMARK(HASH_SHA1);
 BENCHMARK(HASH_SHA256);
 BENCHMARK(HASH_DSHA256);
+BENCHMARK(HASH_SHA256D64_1024);
+BENCHMARK(HASH_DSHA256_0064b_1024);
 BENCHMARK(HASH_SHA512);
+BENCHMARK(HASH_SHA512_Iterate);
+BENCHMARK(HASH_SHA512_Iterate4);
 BENCHMARK(HASH_X11);
 
 BENCHMARK(HASH_SHA256_0032b);
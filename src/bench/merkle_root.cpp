@@ -0,0 +1,31 @@
+// Copyright (c) 2024 The blazegeek developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "consensus/merkle.h"
+#include "primitives/block.h"
+
+// About the number of transactions of a full 2MB block
+static void MerkleRoot(benchmark::State& state, int nThreads)
+{
+    CBlock block;
+    block.vtx.resize(9001);
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        CMutableTransaction mtx;
+        mtx.nLockTime = i;
+        block.vtx[i] = MakeTransactionRef(std::move(mtx));
+    }
+    while (state.KeepRunning()) {
+        bool fMutated = false;
+        uint256 root = BlockMerkleRoot(block, &fMutated, nThreads);
+        assert(!fMutated && !root.IsNull());
+    }
+}
+
+static void MerkleRoot1Thread(benchmark::State& state) { MerkleRoot(state, 1); }
+static void MerkleRoot4Threads(benchmark::State& state) { MerkleRoot(state, 4); }
+
+BENCHMARK(MerkleRoot1Thread);
+BENCHMARK(MerkleRoot4Threads);
@@ -0,0 +1,85 @@
+// Copyright (c) 2024 The blazegeek developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "ctpl.h"
+#include "key.h"
+#include "keystore.h"
+#include "primitives/transaction.h"
+#include "privatesend-server.h"
+#include "random.h"
+#include "script/interpreter.h"
+#include "script/sign.h"
+#include "script/standard.h"
+
+#include <future>
+
+// The final transaction of a full session, one client signs its entry of
+// PRIVATESEND_ENTRY_MAX_SIZE inputs in a DSSIGNFINALTX
+static void SetupFinalTransaction(CMutableTransaction& tx, std::vector<CScript>& vScriptPubKeys)
+{
+    CBasicKeyStore keystore;
+    CKey key;
+    key.MakeNewKey(true);
+    keystore.AddKey(key);
+    CScript scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
+
+    for (unsigned int i = 0; i < PRIVATESEND_ENTRY_MAX_SIZE * 3; i++) {
+        tx.vin.push_back(CTxIn(COutPoint(GetRandHash(), 0)));
+        tx.vout.push_back(CTxOut(COIN + 1000, scriptPubKey));
+    }
+    for (unsigned int i = 0; i < PRIVATESEND_ENTRY_MAX_SIZE; i++) {
+        assert(SignSignature(keystore, scriptPubKey, tx, i));
+        vScriptPubKeys.push_back(scriptPubKey);
+    }
+}
+
+// Without the signature cache, so that every round does the actual work
+static bool VerifyInput(const CTransaction& tx, unsigned int nIn, const CScript& scriptPubKey)
+{
+    TransactionSignatureChecker checker(&tx, nIn);
+    return VerifyScript(tx.vin[nIn].scriptSig, scriptPubKey, SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC, checker);
+}
+
+// How long the message handler is busy with one DSSIGNFINALTX without verification threads
+static void PrivateSendVerifySerial(benchmark::State& state)
+{
+    CMutableTransaction txMutable;
+    std::vector<CScript> vScriptPubKeys;
+    SetupFinalTransaction(txMutable, vScriptPubKeys);
+    const CTransaction tx(txMutable);
+
+    while (state.KeepRunning()) {
+        for (unsigned int i = 0; i < vScriptPubKeys.size(); i++) {
+            assert(VerifyInput(tx, i, vScriptPubKeys[i]));
+        }
+    }
+}
+
+// The same on the default number of verification threads
+static void PrivateSendVerifyPool(benchmark::State& state)
+{
+    CMutableTransaction txMutable;
+    std::vector<CScript> vScriptPubKeys;
+    SetupFinalTransaction(txMutable, vScriptPubKeys);
+    const CTransaction tx(txMutable);
+    ctpl::thread_pool pool(DEFAULT_PRIVATESEND_VERIFY_THREADS);
+
+    while (state.KeepRunning()) {
+        std::vector<std::future<bool> > vecFutures;
+        for (unsigned int i = 0; i < vScriptPubKeys.size(); i++) {
+            vecFutures.emplace_back(pool.push([&tx, &vScriptPubKeys, i](int) {
+                return VerifyInput(tx, i, vScriptPubKeys[i]);
+            }));
+        }
+        for (auto& f : vecFutures) {
+            assert(f.get());
+        }
+    }
+    pool.stop(true);
+}
+
+BENCHMARK(PrivateSendVerifySerial);
+BENCHMARK(PrivateSendVerifyPool);
@@ -0,0 +1,76 @@
+// Copyright (c) 2024 The blazegeek developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "chain.h"
+#include "chainparams.h"
+#include "streams.h"
+#include "txmempool.h"
+#include "validation.h"
+
+#include "bench/data/block813851.raw.h"
+
+#include <univalue.h>
+
+extern UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false);
+extern UniValue mempoolToJSON(bool fVerbose = false);
+
+// Measures construction and serialization of the large JSON documents
+// returned by "getblock <hash> 2" and "getrawmempool true".
+
+static void BlockToJsonVerbose(benchmark::State& state)
+{
+    SelectParams(CBaseChainParams::MAIN);
+
+    CDataStream stream((const char*)raw_bench::block813851,
+            (const char*)&raw_bench::block813851[sizeof(raw_bench::block813851)],
+            SER_NETWORK, PROTOCOL_VERSION);
+    char a;
+    stream.write(&a, 1); // Prevent compaction
+
+    CBlock block;
+    stream >> block;
+
+    CBlockIndex blockindex(block);
+    const uint256 blockHash = block.GetHash();
+    blockindex.phashBlock = &blockHash;
+    blockindex.nHeight = 813851;
+
+    while (state.KeepRunning()) {
+        UniValue objBlock = blockToJSON(block, &blockindex, true);
+        std::string strJSON = objBlock.write() + "\n";
+        assert(!strJSON.empty());
+    }
+}
+
+static void MempoolToJsonVerbose(benchmark::State& state)
+{
+    SelectParams(CBaseChainParams::MAIN);
+
+    const int nTxCount = 10000;
+    for (int i = 0; i < nTxCount; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].scriptSig = CScript() << i << OP_1;
+        tx.vout.resize(1);
+        tx.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+        tx.vout[0].nValue = i + 1;
+        CTransactionRef txRef = MakeTransactionRef(tx);
+        LockPoints lp;
+        mempool.addUnchecked(txRef->GetHash(), CTxMemPoolEntry(txRef, 1000, 0, 10.0, 1,
+                                                               txRef->GetValueOut(), false, 4, lp));
+    }
+
+    while (state.KeepRunning()) {
+        UniValue objMempool = mempoolToJSON(true);
+        std::string strJSON = objMempool.write() + "\n";
+        assert(!strJSON.empty());
+    }
+
+    mempool.clear();
+}
+
+BENCHMARK(BlockToJsonVerbose);
+BENCHMARK(MempoolToJsonVerbose);
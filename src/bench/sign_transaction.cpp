@@ -0,0 +1,64 @@
+// Copyright (c) 2024 The blazegeek developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "key.h"
+#include "keystore.h"
+#include "primitives/transaction.h"
+#include "random.h"
+#include "script/sign.h"
+#include "script/standard.h"
+
+// A transaction spending 1000 P2PKH outputs of 100 keys
+static void SetupSignTransaction(CBasicKeyStore& keystore, CMutableTransaction& tx, std::vector<CScript>& vScriptPubKeys)
+{
+    std::vector<CScript> scriptPubKeys;
+    for (int i = 0; i < 100; i++) {
+        CKey key;
+        key.MakeNewKey(true);
+        keystore.AddKey(key);
+        scriptPubKeys.push_back(GetScriptForDestination(key.GetPubKey().GetID()));
+    }
+
+    for (unsigned int i = 0; i < 1000; i++) {
+        tx.vin.push_back(CTxIn(COutPoint(GetRandHash(), i % 4)));
+        vScriptPubKeys.push_back(scriptPubKeys[i % scriptPubKeys.size()]);
+    }
+    tx.vout.resize(2);
+    tx.vout[0].nValue = COIN;
+    tx.vout[1].nValue = 2 * COIN;
+}
+
+static void SignTransaction1000(benchmark::State& state)
+{
+    CBasicKeyStore keystore;
+    CMutableTransaction tx;
+    std::vector<CScript> vScriptPubKeys;
+    SetupSignTransaction(keystore, tx, vScriptPubKeys);
+
+    while (state.KeepRunning()) {
+        CMutableTransaction txSign(tx);
+        assert(SignTransaction(keystore, vScriptPubKeys, txSign));
+    }
+}
+
+// What signing looked like before, one input at a time
+static void SignSignature1000(benchmark::State& state)
+{
+    CBasicKeyStore keystore;
+    CMutableTransaction tx;
+    std::vector<CScript> vScriptPubKeys;
+    SetupSignTransaction(keystore, tx, vScriptPubKeys);
+
+    while (state.KeepRunning()) {
+        CMutableTransaction txSign(tx);
+        for (unsigned int i = 0; i < txSign.vin.size(); i++) {
+            assert(SignSignature(keystore, vScriptPubKeys[i], txSign, i));
+        }
+    }
+}
+
+BENCHMARK(SignTransaction1000);
+BENCHMARK(SignSignature1000);
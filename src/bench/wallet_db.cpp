@@ -0,0 +1,90 @@
+// Copyright (c) 2024 The blazegeek developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "random.h"
+#include "util.h"
+#include "validation.h"
+#include "wallet/db.h"
+#include "wallet/ldb.h"
+#include "wallet/wallet.h"
+
+#include <boost/filesystem.hpp>
+
+// Both backends are kept in memory, so this compares the cost of the
+// database layers rather than the disk they are on.
+static boost::filesystem::path SetupWalletDB(WalletDBBackend backend)
+{
+    boost::filesystem::path pathTemp = boost::filesystem::temp_directory_path() / strprintf("bench_blaze_%lu_%i", (unsigned long)GetTime(), (int)(GetRand(100000)));
+    boost::filesystem::create_directories(pathTemp);
+    ForceSetArg("-datadir", pathTemp.string());
+    ClearDatadirCache();
+
+    if (!bitdb.IsMock())
+        bitdb.MakeMock();
+    if (!walletldb.IsMock())
+        walletldb.MakeMock();
+    nWalletDBBackendNew = backend;
+    return pathTemp;
+}
+
+static void AddTransactions(CWallet& wallet, int nCount)
+{
+    static int nextLockTime = 0;
+    LOCK2(cs_main, wallet.cs_wallet);
+    for (int i = 0; i < nCount; i++) {
+        CMutableTransaction tx;
+        tx.nLockTime = nextLockTime++; // so all transactions get different hashes
+        tx.vout.resize(1);
+        tx.vout[0].nValue = COIN;
+        CWalletTx wtx(&wallet, MakeTransactionRef(std::move(tx)));
+        assert(wallet.AddToWallet(wtx));
+    }
+}
+
+static void WalletAddToWallet(benchmark::State& state, WalletDBBackend backend)
+{
+    boost::filesystem::path pathTemp = SetupWalletDB(backend);
+    std::string strFile = "wallet_add_" + GetWalletDBBackendName(backend) + ".dat";
+    {
+        CWallet wallet(strFile);
+        bool fFirstRun;
+        wallet.LoadWallet(fFirstRun);
+
+        while (state.KeepRunning()) {
+            AddTransactions(wallet, 100);
+        }
+    }
+    boost::filesystem::remove_all(pathTemp);
+}
+
+static void WalletLoad(benchmark::State& state, WalletDBBackend backend)
+{
+    boost::filesystem::path pathTemp = SetupWalletDB(backend);
+    std::string strFile = "wallet_load_" + GetWalletDBBackendName(backend) + ".dat";
+    {
+        CWallet wallet(strFile);
+        bool fFirstRun;
+        wallet.LoadWallet(fFirstRun);
+        AddTransactions(wallet, 1000);
+    }
+
+    while (state.KeepRunning()) {
+        CWallet wallet(strFile);
+        bool fFirstRun;
+        wallet.LoadWallet(fFirstRun);
+        assert(wallet.mapWallet.size() == 1000);
+    }
+    boost::filesystem::remove_all(pathTemp);
+}
+
+static void WalletAddToWalletBDB(benchmark::State& state) { WalletAddToWallet(state, WALLETDB_BDB); }
+static void WalletAddToWalletLevelDB(benchmark::State& state) { WalletAddToWallet(state, WALLETDB_LEVELDB); }
+static void WalletLoadBDB(benchmark::State& state) { WalletLoad(state, WALLETDB_BDB); }
+static void WalletLoadLevelDB(benchmark::State& state) { WalletLoad(state, WALLETDB_LEVELDB); }
+
+BENCHMARK(WalletAddToWalletBDB);
+BENCHMARK(WalletAddToWalletLevelDB);
+BENCHMARK(WalletLoadBDB);
+BENCHMARK(WalletLoadLevelDB);
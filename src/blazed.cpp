@@ -195,6 +195,12 @@ bool AppInit(int argc, char* argv[])
         // threadGroup.join_all(); was left out intentionally here, because we didn't re-test all of
         // the startup-failure cases to make sure they don't result in a hang due to some
         // thread-blocking-waiting-for-another-thread-during-startup case
+
+        // The scheduler thread doesn't wait for other threads, so stopping it
+        // can't hang. It must be gone before Shutdown() delivers the background
+        // notifications still queued on it.
+        scheduler.stop();
+        scheduler.waitForServiceThreads();
     } else {
         WaitForShutdown(&threadGroup);
     }
@@ -0,0 +1,62 @@
+// Copyright (c) 2024 The blazegeek developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_COMPAT_CPUID_H
+#define BITCOIN_COMPAT_CPUID_H
+
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__amd64__) || defined(__i386__)
+#define HAVE_GETCPUID
+
+#include <cpuid.h>
+
+// cpuid.h's __get_cpuid doesn't take a subleaf, which leaf 7 needs.
+static inline void GetCPUID(uint32_t leaf, uint32_t subleaf, uint32_t& a, uint32_t& b, uint32_t& c, uint32_t& d)
+{
+    __cpuid_count(leaf, subleaf, a, b, c, d);
+}
+
+/** Whether the CPU supports AVX2 and the OS saves the AVX registers */
+static inline bool HaveAVX2()
+{
+    uint32_t a, b, c, d;
+    GetCPUID(0, 0, a, b, c, d);
+    if (a < 7)
+        return false;
+    GetCPUID(1, 0, a, b, c, d);
+    bool fXSave = (c >> 27) & 1;
+    bool fAVX = (c >> 28) & 1;
+    if (!fXSave || !fAVX)
+        return false;
+    uint32_t xcr0_lo, xcr0_hi;
+    __asm__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+    if ((xcr0_lo & 6) != 6)
+        return false;
+    GetCPUID(7, 0, a, b, c, d);
+    return (b >> 5) & 1;
+}
+
+/** Whether the CPU supports SSE4.1 */
+static inline bool HaveSSE41()
+{
+    uint32_t a, b, c, d;
+    GetCPUID(1, 0, a, b, c, d);
+    return (c >> 19) & 1;
+}
+
+/** Whether the CPU supports the SHA extensions, they operate on SSE registers */
+static inline bool HaveSHANI()
+{
+    uint32_t a, b, c, d;
+    GetCPUID(0, 0, a, b, c, d);
+    if (a < 7 || !HaveSSE41())
+        return false;
+    GetCPUID(7, 0, a, b, c, d);
+    return (b >> 29) & 1;
+}
+
+#endif // defined(__x86_64__) || defined(__amd64__) || defined(__i386__)
+
+#endif // BITCOIN_COMPAT_CPUID_H
@@ -5,6 +5,12 @@
 #include "merkle.h"
 #include "hash.h"
 #include "utilstrencodings.h"
+#include "crypto/sha256.h"
+
+#include <algorithm>
+#if !defined(BUILD_BITCOIN_INTERNAL)
+#include <thread>
+#endif
 
 /*     WARNING! If you're reading this because you're learning about crypto
        and/or designing a new system that will use merkle trees, keep in mind
@@ -130,10 +136,34 @@ static void MerkleComputation(const std::vector<uint256>& leaves, uint256* proot
     if (proot) *proot = h;
 }
 
-uint256 ComputeMerkleRoot(const std::vector<uint256>& leaves, bool* mutated) {
-    uint256 hash;
-    MerkleComputation(leaves, &hash, mutated, -1, NULL);
-    return hash;
+/*
+ * Replace the count hashes at the start of hashes by the (count + 1) / 2 of the
+ * level above them, duplicating the last one of an odd count. Identical
+ * siblings set mutated.
+ */
+static size_t ComputeMerkleLevel(uint256* hashes, size_t count, bool& mutated) {
+    for (size_t pos = 0; pos + 1 < count; pos += 2) {
+        if (hashes[pos] == hashes[pos + 1]) mutated = true;
+    }
+    // The pairs are hashed in place, result i only overwrites inputs already read.
+    size_t pairs = count / 2;
+    SHA256D64(hashes[0].begin(), hashes[0].begin(), pairs);
+    if (count & 1) {
+        uint256 last = hashes[count - 1];
+        CHash256().Write(last.begin(), 32).Write(last.begin(), 32).Finalize(hashes[pairs].begin());
+    }
+    return (count + 1) / 2;
+}
+
+uint256 ComputeMerkleRoot(std::vector<uint256> hashes, bool* mutated) {
+    bool mutation = false;
+    size_t count = hashes.size();
+    while (count > 1) {
+        count = ComputeMerkleLevel(hashes.data(), count, mutation);
+    }
+    if (mutated) *mutated = mutation;
+    if (hashes.empty()) return uint256();
+    return hashes[0];
 }
 
 std::vector<uint256> ComputeMerkleBranch(const std::vector<uint256>& leaves, uint32_t position) {
@@ -155,14 +185,70 @@ uint256 ComputeMerkleRootFromBranch(const uint256& leaf, const std::vector<uint2
     return hash;
 }
 
-uint256 BlockMerkleRoot(const CBlock& block, bool* mutated)
+uint256 BlockMerkleRoot(const CBlock& block, bool* mutated, int nThreads)
 {
-    std::vector<uint256> leaves;
-    leaves.resize(block.vtx.size());
-    for (size_t s = 0; s < block.vtx.size(); s++) {
-        leaves[s] = block.vtx[s]->GetHash();
+    std::vector<uint256> leaves(block.vtx.size());
+    size_t nChunkSize = leaves.size();
+#if !defined(BUILD_BITCOIN_INTERNAL)
+    if (nThreads > 1 && leaves.size() >= 2 * MIN_MERKLE_LEAVES_PER_THREAD) {
+        // Chunks of a power of two leaves are complete subtrees, only the last
+        // one can have odd levels and it stays last on every level, so the
+        // chunks reduce on their own exactly like the whole tree would.
+        nChunkSize = MIN_MERKLE_LEAVES_PER_THREAD;
+        while (nChunkSize * nThreads < leaves.size()) {
+            nChunkSize *= 2;
+        }
+    }
+#endif
+    size_t nChunks = leaves.empty() ? 0 : (leaves.size() + nChunkSize - 1) / nChunkSize;
+    if (nChunks <= 1) {
+        for (size_t s = 0; s < block.vtx.size(); s++) {
+            leaves[s] = block.vtx[s]->GetHash();
+        }
+        return ComputeMerkleRoot(std::move(leaves), mutated);
+    }
+
+    // Each chunk collects its txids and hashes them up to the root of its subtree.
+    std::vector<char> vMutated(nChunks, false);
+    auto reduce = [&](size_t nChunk) {
+        size_t begin = nChunk * nChunkSize;
+        size_t end = std::min(begin + nChunkSize, leaves.size());
+        for (size_t s = begin; s < end; s++) {
+            leaves[s] = block.vtx[s]->GetHash();
+        }
+        bool fMutated = false;
+        size_t count = end - begin;
+        for (size_t nLevelSize = nChunkSize; nLevelSize > 1; nLevelSize /= 2) {
+            count = ComputeMerkleLevel(&leaves[begin], count, fMutated);
+        }
+        vMutated[nChunk] = fMutated;
+    };
+#if !defined(BUILD_BITCOIN_INTERNAL)
+    std::vector<std::thread> threads;
+    for (size_t nChunk = 1; nChunk < nChunks; nChunk++) {
+        threads.emplace_back(reduce, nChunk);
+    }
+    reduce(0);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+#else
+    for (size_t nChunk = 0; nChunk < nChunks; nChunk++) {
+        reduce(nChunk);
+    }
+#endif
+
+    // The levels above the chunks are few and small.
+    bool mutation = vMutated[0];
+    for (size_t nChunk = 1; nChunk < nChunks; nChunk++) {
+        mutation |= vMutated[nChunk];
+        leaves[nChunk] = leaves[nChunk * nChunkSize];
     }
-    return ComputeMerkleRoot(leaves, mutated);
+    leaves.resize(nChunks);
+    bool fMutatedTop = false;
+    uint256 root = ComputeMerkleRoot(std::move(leaves), &fMutatedTop);
+    if (mutated) *mutated = mutation || fMutatedTop;
+    return root;
 }
 
 std::vector<uint256> BlockMerkleBranch(const CBlock& block, uint32_t position)
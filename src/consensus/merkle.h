@@ -12,15 +12,19 @@
 #include "primitives/block.h"
 #include "uint256.h"
 
-uint256 ComputeMerkleRoot(const std::vector<uint256>& leaves, bool* mutated = NULL);
+//! Leaves a thread gets at least when BlockMerkleRoot splits the tree, a power of two
+static const size_t MIN_MERKLE_LEAVES_PER_THREAD = 1024;
+
+uint256 ComputeMerkleRoot(std::vector<uint256> hashes, bool* mutated = NULL);
 std::vector<uint256> ComputeMerkleBranch(const std::vector<uint256>& leaves, uint32_t position);
 uint256 ComputeMerkleRootFromBranch(const uint256& leaf, const std::vector<uint256>& branch, uint32_t position);
 
 /*
  * Compute the Merkle root of the transactions in a block.
  * *mutated is set to true if a duplicated subtree was found.
+ * Large blocks are split into subtrees hashed on up to nThreads threads.
  */
-uint256 BlockMerkleRoot(const CBlock& block, bool* mutated = NULL);
+uint256 BlockMerkleRoot(const CBlock& block, bool* mutated = NULL, int nThreads = 1);
 
 /*
  * Compute the Merkle branch for the tree of transactions in a block, for a
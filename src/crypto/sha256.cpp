@@ -4,10 +4,40 @@
 
 #include "crypto/sha256.h"
 
+#include "compat/cpuid.h"
 #include "crypto/common.h"
 
+#include <assert.h>
 #include <string.h>
 
+#if !defined(BUILD_BITCOIN_INTERNAL)
+#if defined(ENABLE_SHANI)
+namespace sha256_shani
+{
+/** SHA-256 with the SHA extensions, in sha256_shani.cpp */
+void Transform(uint32_t* s, const unsigned char* chunk, size_t blocks);
+}
+namespace sha256d64_shani
+{
+void Transform_2way(unsigned char* out, const unsigned char* in);
+}
+#endif
+#if defined(ENABLE_SSE41)
+namespace sha256d64_sse41
+{
+/** Four double SHA-256 in the 32-bit lanes of SSE registers, in sha256_sse41.cpp */
+void Transform_4way(unsigned char* out, const unsigned char* in);
+}
+#endif
+#if defined(ENABLE_AVX2)
+namespace sha256d64_avx2
+{
+/** Eight double SHA-256 in the 32-bit lanes of AVX2 registers, in sha256_avx2.cpp */
+void Transform_8way(unsigned char* out, const unsigned char* in);
+}
+#endif
+#endif // !defined(BUILD_BITCOIN_INTERNAL)
+
 // Internal implementation code.
 namespace
 {
@@ -43,91 +73,241 @@ void inline Initialize(uint32_t* s)
     s[7] = 0x5be0cd19ul;
 }
 
-/** Perform one SHA-256 transformation, processing a 64-byte chunk. */
-void Transform(uint32_t* s, const unsigned char* chunk)
-{
-    uint32_t a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
-    uint32_t w0, w1, w2, w3, w4, w5, w6, w7, w8, w9, w10, w11, w12, w13, w14, w15;
-
-    Round(a, b, c, d, e, f, g, h, 0x428a2f98, w0 = ReadBE32(chunk + 0));
-    Round(h, a, b, c, d, e, f, g, 0x71374491, w1 = ReadBE32(chunk + 4));
-    Round(g, h, a, b, c, d, e, f, 0xb5c0fbcf, w2 = ReadBE32(chunk + 8));
-    Round(f, g, h, a, b, c, d, e, 0xe9b5dba5, w3 = ReadBE32(chunk + 12));
-    Round(e, f, g, h, a, b, c, d, 0x3956c25b, w4 = ReadBE32(chunk + 16));
-    Round(d, e, f, g, h, a, b, c, 0x59f111f1, w5 = ReadBE32(chunk + 20));
-    Round(c, d, e, f, g, h, a, b, 0x923f82a4, w6 = ReadBE32(chunk + 24));
-    Round(b, c, d, e, f, g, h, a, 0xab1c5ed5, w7 = ReadBE32(chunk + 28));
-    Round(a, b, c, d, e, f, g, h, 0xd807aa98, w8 = ReadBE32(chunk + 32));
-    Round(h, a, b, c, d, e, f, g, 0x12835b01, w9 = ReadBE32(chunk + 36));
-    Round(g, h, a, b, c, d, e, f, 0x243185be, w10 = ReadBE32(chunk + 40));
-    Round(f, g, h, a, b, c, d, e, 0x550c7dc3, w11 = ReadBE32(chunk + 44));
-    Round(e, f, g, h, a, b, c, d, 0x72be5d74, w12 = ReadBE32(chunk + 48));
-    Round(d, e, f, g, h, a, b, c, 0x80deb1fe, w13 = ReadBE32(chunk + 52));
-    Round(c, d, e, f, g, h, a, b, 0x9bdc06a7, w14 = ReadBE32(chunk + 56));
-    Round(b, c, d, e, f, g, h, a, 0xc19bf174, w15 = ReadBE32(chunk + 60));
-
-    Round(a, b, c, d, e, f, g, h, 0xe49b69c1, w0 += sigma1(w14) + w9 + sigma0(w1));
-    Round(h, a, b, c, d, e, f, g, 0xefbe4786, w1 += sigma1(w15) + w10 + sigma0(w2));
-    Round(g, h, a, b, c, d, e, f, 0x0fc19dc6, w2 += sigma1(w0) + w11 + sigma0(w3));
-    Round(f, g, h, a, b, c, d, e, 0x240ca1cc, w3 += sigma1(w1) + w12 + sigma0(w4));
-    Round(e, f, g, h, a, b, c, d, 0x2de92c6f, w4 += sigma1(w2) + w13 + sigma0(w5));
-    Round(d, e, f, g, h, a, b, c, 0x4a7484aa, w5 += sigma1(w3) + w14 + sigma0(w6));
-    Round(c, d, e, f, g, h, a, b, 0x5cb0a9dc, w6 += sigma1(w4) + w15 + sigma0(w7));
-    Round(b, c, d, e, f, g, h, a, 0x76f988da, w7 += sigma1(w5) + w0 + sigma0(w8));
-    Round(a, b, c, d, e, f, g, h, 0x983e5152, w8 += sigma1(w6) + w1 + sigma0(w9));
-    Round(h, a, b, c, d, e, f, g, 0xa831c66d, w9 += sigma1(w7) + w2 + sigma0(w10));
-    Round(g, h, a, b, c, d, e, f, 0xb00327c8, w10 += sigma1(w8) + w3 + sigma0(w11));
-    Round(f, g, h, a, b, c, d, e, 0xbf597fc7, w11 += sigma1(w9) + w4 + sigma0(w12));
-    Round(e, f, g, h, a, b, c, d, 0xc6e00bf3, w12 += sigma1(w10) + w5 + sigma0(w13));
-    Round(d, e, f, g, h, a, b, c, 0xd5a79147, w13 += sigma1(w11) + w6 + sigma0(w14));
-    Round(c, d, e, f, g, h, a, b, 0x06ca6351, w14 += sigma1(w12) + w7 + sigma0(w15));
-    Round(b, c, d, e, f, g, h, a, 0x14292967, w15 += sigma1(w13) + w8 + sigma0(w0));
-
-    Round(a, b, c, d, e, f, g, h, 0x27b70a85, w0 += sigma1(w14) + w9 + sigma0(w1));
-    Round(h, a, b, c, d, e, f, g, 0x2e1b2138, w1 += sigma1(w15) + w10 + sigma0(w2));
-    Round(g, h, a, b, c, d, e, f, 0x4d2c6dfc, w2 += sigma1(w0) + w11 + sigma0(w3));
-    Round(f, g, h, a, b, c, d, e, 0x53380d13, w3 += sigma1(w1) + w12 + sigma0(w4));
-    Round(e, f, g, h, a, b, c, d, 0x650a7354, w4 += sigma1(w2) + w13 + sigma0(w5));
-    Round(d, e, f, g, h, a, b, c, 0x766a0abb, w5 += sigma1(w3) + w14 + sigma0(w6));
-    Round(c, d, e, f, g, h, a, b, 0x81c2c92e, w6 += sigma1(w4) + w15 + sigma0(w7));
-    Round(b, c, d, e, f, g, h, a, 0x92722c85, w7 += sigma1(w5) + w0 + sigma0(w8));
-    Round(a, b, c, d, e, f, g, h, 0xa2bfe8a1, w8 += sigma1(w6) + w1 + sigma0(w9));
-    Round(h, a, b, c, d, e, f, g, 0xa81a664b, w9 += sigma1(w7) + w2 + sigma0(w10));
-    Round(g, h, a, b, c, d, e, f, 0xc24b8b70, w10 += sigma1(w8) + w3 + sigma0(w11));
-    Round(f, g, h, a, b, c, d, e, 0xc76c51a3, w11 += sigma1(w9) + w4 + sigma0(w12));
-    Round(e, f, g, h, a, b, c, d, 0xd192e819, w12 += sigma1(w10) + w5 + sigma0(w13));
-    Round(d, e, f, g, h, a, b, c, 0xd6990624, w13 += sigma1(w11) + w6 + sigma0(w14));
-    Round(c, d, e, f, g, h, a, b, 0xf40e3585, w14 += sigma1(w12) + w7 + sigma0(w15));
-    Round(b, c, d, e, f, g, h, a, 0x106aa070, w15 += sigma1(w13) + w8 + sigma0(w0));
-
-    Round(a, b, c, d, e, f, g, h, 0x19a4c116, w0 += sigma1(w14) + w9 + sigma0(w1));
-    Round(h, a, b, c, d, e, f, g, 0x1e376c08, w1 += sigma1(w15) + w10 + sigma0(w2));
-    Round(g, h, a, b, c, d, e, f, 0x2748774c, w2 += sigma1(w0) + w11 + sigma0(w3));
-    Round(f, g, h, a, b, c, d, e, 0x34b0bcb5, w3 += sigma1(w1) + w12 + sigma0(w4));
-    Round(e, f, g, h, a, b, c, d, 0x391c0cb3, w4 += sigma1(w2) + w13 + sigma0(w5));
-    Round(d, e, f, g, h, a, b, c, 0x4ed8aa4a, w5 += sigma1(w3) + w14 + sigma0(w6));
-    Round(c, d, e, f, g, h, a, b, 0x5b9cca4f, w6 += sigma1(w4) + w15 + sigma0(w7));
-    Round(b, c, d, e, f, g, h, a, 0x682e6ff3, w7 += sigma1(w5) + w0 + sigma0(w8));
-    Round(a, b, c, d, e, f, g, h, 0x748f82ee, w8 += sigma1(w6) + w1 + sigma0(w9));
-    Round(h, a, b, c, d, e, f, g, 0x78a5636f, w9 += sigma1(w7) + w2 + sigma0(w10));
-    Round(g, h, a, b, c, d, e, f, 0x84c87814, w10 += sigma1(w8) + w3 + sigma0(w11));
-    Round(f, g, h, a, b, c, d, e, 0x8cc70208, w11 += sigma1(w9) + w4 + sigma0(w12));
-    Round(e, f, g, h, a, b, c, d, 0x90befffa, w12 += sigma1(w10) + w5 + sigma0(w13));
-    Round(d, e, f, g, h, a, b, c, 0xa4506ceb, w13 += sigma1(w11) + w6 + sigma0(w14));
-    Round(c, d, e, f, g, h, a, b, 0xbef9a3f7, w14 + sigma1(w12) + w7 + sigma0(w15));
-    Round(b, c, d, e, f, g, h, a, 0xc67178f2, w15 + sigma1(w13) + w8 + sigma0(w0));
-
-    s[0] += a;
-    s[1] += b;
-    s[2] += c;
-    s[3] += d;
-    s[4] += e;
-    s[5] += f;
-    s[6] += g;
-    s[7] += h;
+/** Perform a number of SHA-256 transformations, processing 64-byte chunks. */
+void Transform(uint32_t* s, const unsigned char* chunk, size_t blocks)
+{
+    while (blocks--) {
+        uint32_t a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+        uint32_t w0, w1, w2, w3, w4, w5, w6, w7, w8, w9, w10, w11, w12, w13, w14, w15;
+
+        Round(a, b, c, d, e, f, g, h, 0x428a2f98, w0 = ReadBE32(chunk + 0));
+        Round(h, a, b, c, d, e, f, g, 0x71374491, w1 = ReadBE32(chunk + 4));
+        Round(g, h, a, b, c, d, e, f, 0xb5c0fbcf, w2 = ReadBE32(chunk + 8));
+        Round(f, g, h, a, b, c, d, e, 0xe9b5dba5, w3 = ReadBE32(chunk + 12));
+        Round(e, f, g, h, a, b, c, d, 0x3956c25b, w4 = ReadBE32(chunk + 16));
+        Round(d, e, f, g, h, a, b, c, 0x59f111f1, w5 = ReadBE32(chunk + 20));
+        Round(c, d, e, f, g, h, a, b, 0x923f82a4, w6 = ReadBE32(chunk + 24));
+        Round(b, c, d, e, f, g, h, a, 0xab1c5ed5, w7 = ReadBE32(chunk + 28));
+        Round(a, b, c, d, e, f, g, h, 0xd807aa98, w8 = ReadBE32(chunk + 32));
+        Round(h, a, b, c, d, e, f, g, 0x12835b01, w9 = ReadBE32(chunk + 36));
+        Round(g, h, a, b, c, d, e, f, 0x243185be, w10 = ReadBE32(chunk + 40));
+        Round(f, g, h, a, b, c, d, e, 0x550c7dc3, w11 = ReadBE32(chunk + 44));
+        Round(e, f, g, h, a, b, c, d, 0x72be5d74, w12 = ReadBE32(chunk + 48));
+        Round(d, e, f, g, h, a, b, c, 0x80deb1fe, w13 = ReadBE32(chunk + 52));
+        Round(c, d, e, f, g, h, a, b, 0x9bdc06a7, w14 = ReadBE32(chunk + 56));
+        Round(b, c, d, e, f, g, h, a, 0xc19bf174, w15 = ReadBE32(chunk + 60));
+
+        Round(a, b, c, d, e, f, g, h, 0xe49b69c1, w0 += sigma1(w14) + w9 + sigma0(w1));
+        Round(h, a, b, c, d, e, f, g, 0xefbe4786, w1 += sigma1(w15) + w10 + sigma0(w2));
+        Round(g, h, a, b, c, d, e, f, 0x0fc19dc6, w2 += sigma1(w0) + w11 + sigma0(w3));
+        Round(f, g, h, a, b, c, d, e, 0x240ca1cc, w3 += sigma1(w1) + w12 + sigma0(w4));
+        Round(e, f, g, h, a, b, c, d, 0x2de92c6f, w4 += sigma1(w2) + w13 + sigma0(w5));
+        Round(d, e, f, g, h, a, b, c, 0x4a7484aa, w5 += sigma1(w3) + w14 + sigma0(w6));
+        Round(c, d, e, f, g, h, a, b, 0x5cb0a9dc, w6 += sigma1(w4) + w15 + sigma0(w7));
+        Round(b, c, d, e, f, g, h, a, 0x76f988da, w7 += sigma1(w5) + w0 + sigma0(w8));
+        Round(a, b, c, d, e, f, g, h, 0x983e5152, w8 += sigma1(w6) + w1 + sigma0(w9));
+        Round(h, a, b, c, d, e, f, g, 0xa831c66d, w9 += sigma1(w7) + w2 + sigma0(w10));
+        Round(g, h, a, b, c, d, e, f, 0xb00327c8, w10 += sigma1(w8) + w3 + sigma0(w11));
+        Round(f, g, h, a, b, c, d, e, 0xbf597fc7, w11 += sigma1(w9) + w4 + sigma0(w12));
+        Round(e, f, g, h, a, b, c, d, 0xc6e00bf3, w12 += sigma1(w10) + w5 + sigma0(w13));
+        Round(d, e, f, g, h, a, b, c, 0xd5a79147, w13 += sigma1(w11) + w6 + sigma0(w14));
+        Round(c, d, e, f, g, h, a, b, 0x06ca6351, w14 += sigma1(w12) + w7 + sigma0(w15));
+        Round(b, c, d, e, f, g, h, a, 0x14292967, w15 += sigma1(w13) + w8 + sigma0(w0));
+
+        Round(a, b, c, d, e, f, g, h, 0x27b70a85, w0 += sigma1(w14) + w9 + sigma0(w1));
+        Round(h, a, b, c, d, e, f, g, 0x2e1b2138, w1 += sigma1(w15) + w10 + sigma0(w2));
+        Round(g, h, a, b, c, d, e, f, 0x4d2c6dfc, w2 += sigma1(w0) + w11 + sigma0(w3));
+        Round(f, g, h, a, b, c, d, e, 0x53380d13, w3 += sigma1(w1) + w12 + sigma0(w4));
+        Round(e, f, g, h, a, b, c, d, 0x650a7354, w4 += sigma1(w2) + w13 + sigma0(w5));
+        Round(d, e, f, g, h, a, b, c, 0x766a0abb, w5 += sigma1(w3) + w14 + sigma0(w6));
+        Round(c, d, e, f, g, h, a, b, 0x81c2c92e, w6 += sigma1(w4) + w15 + sigma0(w7));
+        Round(b, c, d, e, f, g, h, a, 0x92722c85, w7 += sigma1(w5) + w0 + sigma0(w8));
+        Round(a, b, c, d, e, f, g, h, 0xa2bfe8a1, w8 += sigma1(w6) + w1 + sigma0(w9));
+        Round(h, a, b, c, d, e, f, g, 0xa81a664b, w9 += sigma1(w7) + w2 + sigma0(w10));
+        Round(g, h, a, b, c, d, e, f, 0xc24b8b70, w10 += sigma1(w8) + w3 + sigma0(w11));
+        Round(f, g, h, a, b, c, d, e, 0xc76c51a3, w11 += sigma1(w9) + w4 + sigma0(w12));
+        Round(e, f, g, h, a, b, c, d, 0xd192e819, w12 += sigma1(w10) + w5 + sigma0(w13));
+        Round(d, e, f, g, h, a, b, c, 0xd6990624, w13 += sigma1(w11) + w6 + sigma0(w14));
+        Round(c, d, e, f, g, h, a, b, 0xf40e3585, w14 += sigma1(w12) + w7 + sigma0(w15));
+        Round(b, c, d, e, f, g, h, a, 0x106aa070, w15 += sigma1(w13) + w8 + sigma0(w0));
+
+        Round(a, b, c, d, e, f, g, h, 0x19a4c116, w0 += sigma1(w14) + w9 + sigma0(w1));
+        Round(h, a, b, c, d, e, f, g, 0x1e376c08, w1 += sigma1(w15) + w10 + sigma0(w2));
+        Round(g, h, a, b, c, d, e, f, 0x2748774c, w2 += sigma1(w0) + w11 + sigma0(w3));
+        Round(f, g, h, a, b, c, d, e, 0x34b0bcb5, w3 += sigma1(w1) + w12 + sigma0(w4));
+        Round(e, f, g, h, a, b, c, d, 0x391c0cb3, w4 += sigma1(w2) + w13 + sigma0(w5));
+        Round(d, e, f, g, h, a, b, c, 0x4ed8aa4a, w5 += sigma1(w3) + w14 + sigma0(w6));
+        Round(c, d, e, f, g, h, a, b, 0x5b9cca4f, w6 += sigma1(w4) + w15 + sigma0(w7));
+        Round(b, c, d, e, f, g, h, a, 0x682e6ff3, w7 += sigma1(w5) + w0 + sigma0(w8));
+        Round(a, b, c, d, e, f, g, h, 0x748f82ee, w8 += sigma1(w6) + w1 + sigma0(w9));
+        Round(h, a, b, c, d, e, f, g, 0x78a5636f, w9 += sigma1(w7) + w2 + sigma0(w10));
+        Round(g, h, a, b, c, d, e, f, 0x84c87814, w10 += sigma1(w8) + w3 + sigma0(w11));
+        Round(f, g, h, a, b, c, d, e, 0x8cc70208, w11 += sigma1(w9) + w4 + sigma0(w12));
+        Round(e, f, g, h, a, b, c, d, 0x90befffa, w12 += sigma1(w10) + w5 + sigma0(w13));
+        Round(d, e, f, g, h, a, b, c, 0xa4506ceb, w13 += sigma1(w11) + w6 + sigma0(w14));
+        Round(c, d, e, f, g, h, a, b, 0xbef9a3f7, w14 + sigma1(w12) + w7 + sigma0(w15));
+        Round(b, c, d, e, f, g, h, a, 0xc67178f2, w15 + sigma1(w13) + w8 + sigma0(w0));
+
+        s[0] += a;
+        s[1] += b;
+        s[2] += c;
+        s[3] += d;
+        s[4] += e;
+        s[5] += f;
+        s[6] += g;
+        s[7] += h;
+        chunk += 64;
+    }
+}
+
+typedef void (*TransformFn)(uint32_t*, const unsigned char*, size_t);
+typedef void (*TransformD64Fn)(unsigned char*, const unsigned char*);
+
+/** Double SHA-256 of one 64-byte input with a single stream transform. */
+template <TransformFn tr>
+void TransformD64(unsigned char* out, const unsigned char* in)
+{
+    // Padding of a 64-byte message, the 0x80 end marker and the length of 512 bits.
+    static const unsigned char pad64[64] = {0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x02, 0};
+    uint32_t s[8];
+    unsigned char buf[64] = {0};
+    Initialize(s);
+    tr(s, in, 1);
+    tr(s, pad64, 1);
+    for (int i = 0; i < 8; i++)
+        WriteBE32(buf + 4 * i, s[i]);
+    // The second hash is of the 32-byte result, 256 bits.
+    buf[32] = 0x80;
+    buf[62] = 0x01;
+    Initialize(s);
+    tr(s, buf, 1);
+    for (int i = 0; i < 8; i++)
+        WriteBE32(out + 4 * i, s[i]);
 }
 
 } // namespace sha256
+
+/** The 512 bytes the self-test hashes, from a linear congruential generator. */
+void SelfTestInput(unsigned char* in)
+{
+    uint32_t x = 1;
+    for (int i = 0; i < 512; i++) {
+        x = x * 1103515245 + 12345;
+        in[i] = x >> 24;
+    }
+}
+
+/** SHA-256 of the first 119 bytes of the self-test input, two blocks once padded. */
+const unsigned char SELFTEST_HASH[32] = {
+    0x78, 0x95, 0x31, 0xf3, 0x08, 0x8a, 0x2d, 0xc1, 0x36, 0x0e, 0x60, 0x22, 0x6a, 0x30, 0x2f, 0xda,
+    0x53, 0x38, 0x74, 0xd2, 0xcd, 0x01, 0x46, 0xa3, 0xb0, 0xfc, 0xea, 0x22, 0xe8, 0xf9, 0xc3, 0xfb};
+
+/** Double SHA-256 of each of the eight 64-byte blocks of the self-test input. */
+const unsigned char SELFTEST_D64[256] = {
+    0x24, 0x3f, 0x12, 0xbd, 0x66, 0x1b, 0xcd, 0xa0, 0x71, 0x81, 0xff, 0xec, 0x0a, 0xcc, 0x6c, 0x0d,
+    0x7a, 0x6a, 0x9d, 0x0a, 0xae, 0xaa, 0xe3, 0xa9, 0xb4, 0x2f, 0x71, 0x26, 0x41, 0x77, 0xa8, 0x6b,
+    0x6b, 0x75, 0x57, 0xbc, 0xb5, 0xaf, 0x2a, 0xb8, 0x9c, 0xf8, 0xa0, 0xbf, 0x14, 0x5b, 0xf7, 0xc8,
+    0x62, 0x18, 0x43, 0xd0, 0x7c, 0x38, 0xc2, 0x04, 0x40, 0xc8, 0x4d, 0xad, 0x4c, 0xd7, 0xdf, 0xde,
+    0xcd, 0xe0, 0x5a, 0x0f, 0xfe, 0xd4, 0xfc, 0x1d, 0x00, 0x0d, 0x9c, 0x83, 0x84, 0x6d, 0xb8, 0x06,
+    0x44, 0x39, 0xe0, 0x38, 0x8b, 0x7d, 0x74, 0x4b, 0x39, 0x25, 0x7d, 0x19, 0x87, 0x44, 0x45, 0xfc,
+    0x50, 0xbd, 0x1e, 0xf8, 0x12, 0x97, 0x47, 0xe5, 0x41, 0xc4, 0x70, 0xc1, 0x7f, 0x6d, 0x38, 0x3e,
+    0xa4, 0x4b, 0xfc, 0xfe, 0x73, 0xd0, 0x09, 0xa2, 0x96, 0xf4, 0x60, 0x22, 0xed, 0x77, 0xbe, 0x5b,
+    0x9b, 0xfd, 0x7a, 0x81, 0xd4, 0xb7, 0xbd, 0x0d, 0x39, 0xdf, 0xfa, 0x61, 0xdc, 0x0f, 0x68, 0x08,
+    0x04, 0xa8, 0x2e, 0x72, 0x6d, 0xec, 0x72, 0xf5, 0x9b, 0x03, 0x6b, 0xeb, 0x6d, 0x77, 0xd8, 0xb8,
+    0xd4, 0x93, 0xcc, 0x50, 0xef, 0xb6, 0xe1, 0x67, 0x34, 0xb2, 0xfb, 0x32, 0xd3, 0xc8, 0x33, 0x40,
+    0x99, 0x80, 0x28, 0x64, 0xfb, 0x68, 0xdc, 0x0a, 0x2b, 0x47, 0xc3, 0xa2, 0xa0, 0x84, 0xa0, 0xbf,
+    0x4e, 0x4f, 0x79, 0x40, 0x21, 0x20, 0x4b, 0xb0, 0x86, 0x8f, 0x97, 0xa4, 0xe8, 0x9c, 0x34, 0x9b,
+    0xda, 0x0c, 0x2d, 0xfe, 0xcd, 0x49, 0xa4, 0xe3, 0xba, 0xc3, 0x29, 0x40, 0x30, 0xf3, 0x82, 0xf6,
+    0xc0, 0x24, 0x48, 0x79, 0x35, 0xea, 0x14, 0x2d, 0x8c, 0xfe, 0x9e, 0xd5, 0xe6, 0x88, 0xff, 0x66,
+    0x9e, 0x91, 0x75, 0x1c, 0x1b, 0xa2, 0xdf, 0xf3, 0x5e, 0x9f, 0xac, 0xf4, 0x2b, 0x13, 0x5f, 0x74};
+
+bool SelfTestTransform(sha256::TransformFn tr)
+{
+    unsigned char in[512];
+    SelfTestInput(in);
+    // The 0x80 end marker and the length of 952 bits after the 119 bytes.
+    in[119] = 0x80;
+    memset(in + 120, 0, 6);
+    in[126] = 0x03;
+    in[127] = 0xb8;
+    uint32_t s[8];
+    unsigned char out[32];
+    sha256::Initialize(s);
+    tr(s, in, 2);
+    for (int i = 0; i < 8; i++)
+        WriteBE32(out + 4 * i, s[i]);
+    return memcmp(out, SELFTEST_HASH, 32) == 0;
+}
+
+/** Check a transform of ways 64-byte inputs at a time on all eight self-test blocks. */
+bool SelfTestD64(sha256::TransformD64Fn tr, int ways)
+{
+    unsigned char in[512];
+    unsigned char out[256];
+    SelfTestInput(in);
+    for (int i = 0; i < 8; i += ways)
+        tr(out + 32 * i, in + 64 * i);
+    return memcmp(out, SELFTEST_D64, 256) == 0;
+}
+
+/** The transforms in use, the multi-way ones are NULL where the CPU lacks them. */
+struct SHA256Transforms
+{
+    sha256::TransformFn transform;
+    sha256::TransformD64Fn transformD64;
+    sha256::TransformD64Fn transformD64_2way;
+    sha256::TransformD64Fn transformD64_4way;
+    sha256::TransformD64Fn transformD64_8way;
+    const char* name;
+};
+
+/**
+ * Every implementation the CPU supports is checked against the self-test
+ * vectors first, one that gets them wrong (a compiler or CPU bug) is left out
+ * and the next one down is used instead.
+ */
+SHA256Transforms SelectTransforms()
+{
+    SHA256Transforms ret = {sha256::Transform, sha256::TransformD64<sha256::Transform>, NULL, NULL, NULL, "standard"};
+    // There is nothing to fall back to from the portable implementation.
+    assert(SelfTestTransform(ret.transform) && SelfTestD64(ret.transformD64, 1));
+#if !defined(BUILD_BITCOIN_INTERNAL) && defined(HAVE_GETCPUID)
+#if defined(ENABLE_SHANI)
+    if (HaveSHANI() && SelfTestTransform(sha256_shani::Transform) &&
+        SelfTestD64(sha256::TransformD64<sha256_shani::Transform>, 1) && SelfTestD64(sha256d64_shani::Transform_2way, 2)) {
+        // The SHA extensions outrun the SIMD lanes, there's no point in mixing them.
+        ret.transform = sha256_shani::Transform;
+        ret.transformD64 = sha256::TransformD64<sha256_shani::Transform>;
+        ret.transformD64_2way = sha256d64_shani::Transform_2way;
+        ret.name = "shani(1way,2way)";
+        return ret;
+    }
+#endif
+#if defined(ENABLE_SSE41)
+    if (HaveSSE41() && SelfTestD64(sha256d64_sse41::Transform_4way, 4)) {
+        ret.transformD64_4way = sha256d64_sse41::Transform_4way;
+        ret.name = "standard(1way),sse41(4way)";
+    }
+#endif
+#if defined(ENABLE_AVX2)
+    if (HaveAVX2() && SelfTestD64(sha256d64_avx2::Transform_8way, 8)) {
+        ret.transformD64_8way = sha256d64_avx2::Transform_8way;
+        ret.name = ret.transformD64_4way ? "standard(1way),sse41(4way),avx2(8way)" : "standard(1way),avx2(8way)";
+    }
+#endif
+#endif
+    return ret;
+}
+
+const SHA256Transforms& GetTransforms()
+{
+    static const SHA256Transforms transforms = SelectTransforms();
+    return transforms;
+}
+
 } // namespace
 
 
@@ -147,14 +327,15 @@ CSHA256& CSHA256::Write(const unsigned char* data, size_t len)
         memcpy(buf + bufsize, data, 64 - bufsize);
         bytes += 64 - bufsize;
         data += 64 - bufsize;
-        sha256::Transform(s, buf);
+        GetTransforms().transform(s, buf, 1);
         bufsize = 0;
     }
-    while (end >= data + 64) {
+    if (end - data >= 64) {
         // Process full chunks directly from the source.
-        sha256::Transform(s, data);
-        bytes += 64;
-        data += 64;
+        size_t blocks = (end - data) / 64;
+        GetTransforms().transform(s, data, blocks);
+        data += 64 * blocks;
+        bytes += 64 * blocks;
     }
     if (end > data) {
         // Fill the buffer with what remains.
@@ -187,3 +368,75 @@ CSHA256& CSHA256::Reset()
     sha256::Initialize(s);
     return *this;
 }
+
+const char* SHA256Implementation()
+{
+    return GetTransforms().name;
+}
+
+bool SHA256SelfTestAll(std::string& strTested)
+{
+    strTested = "standard";
+    if (!SelfTestTransform(sha256::Transform) || !SelfTestD64(sha256::TransformD64<sha256::Transform>, 1))
+        return false;
+#if !defined(BUILD_BITCOIN_INTERNAL) && defined(HAVE_GETCPUID)
+#if defined(ENABLE_SHANI)
+    if (HaveSHANI()) {
+        strTested += ",shani";
+        if (!SelfTestTransform(sha256_shani::Transform) ||
+            !SelfTestD64(sha256::TransformD64<sha256_shani::Transform>, 1) || !SelfTestD64(sha256d64_shani::Transform_2way, 2))
+            return false;
+    }
+#endif
+#if defined(ENABLE_SSE41)
+    if (HaveSSE41()) {
+        strTested += ",sse41";
+        if (!SelfTestD64(sha256d64_sse41::Transform_4way, 4))
+            return false;
+    }
+#endif
+#if defined(ENABLE_AVX2)
+    if (HaveAVX2()) {
+        strTested += ",avx2";
+        if (!SelfTestD64(sha256d64_avx2::Transform_8way, 8))
+            return false;
+    }
+#endif
+#endif
+    return true;
+}
+
+void SHA256D64(unsigned char* out, const unsigned char* in, size_t blocks)
+{
+    const SHA256Transforms& transforms = GetTransforms();
+    if (transforms.transformD64_8way) {
+        while (blocks >= 8) {
+            transforms.transformD64_8way(out, in);
+            out += 256;
+            in += 512;
+            blocks -= 8;
+        }
+    }
+    if (transforms.transformD64_4way) {
+        while (blocks >= 4) {
+            transforms.transformD64_4way(out, in);
+            out += 128;
+            in += 256;
+            blocks -= 4;
+        }
+    }
+    if (transforms.transformD64_2way) {
+        while (blocks >= 2) {
+            transforms.transformD64_2way(out, in);
+            out += 64;
+            in += 128;
+            blocks -= 2;
+        }
+    }
+    while (blocks) {
+        transforms.transformD64(out, in);
+        out += 32;
+        in += 64;
+        --blocks;
+    }
+}
@@ -7,6 +7,7 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string>
 
 /** A hasher class for SHA-256. */
 class CSHA256
@@ -25,4 +26,22 @@ public:
     CSHA256& Reset();
 };
 
+/** Name of the SHA-256 implementations selected for this CPU, for the log. */
+const char* SHA256Implementation();
+
+/**
+ * Check every SHA-256 implementation compiled in and supported by this CPU
+ * against the self-test vectors, also those not selected. The names of the
+ * ones tested go to strTested, the last one is the culprit if it fails.
+ * For the unit tests.
+ */
+bool SHA256SelfTestAll(std::string& strTested);
+
+/**
+ * Double SHA-256 of blocks independent 64-byte inputs, each result is 32 bytes of output.
+ * Several inputs are hashed at once in the lanes of SIMD registers where the CPU
+ * supports it, this is what the levels of a merkle tree consist of.
+ */
+void SHA256D64(unsigned char* output, const unsigned char* input, size_t blocks);
+
 #endif // BITCOIN_CRYPTO_SHA256_H
@@ -0,0 +1,187 @@
+// Copyright (c) 2024 The blazegeek developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// This file is compiled with the SHA extensions enabled, it is only called
+// after checking that the CPU supports them.
+
+#ifdef ENABLE_SHANI
+
+#include <stdint.h>
+#include <string.h>
+#include <immintrin.h>
+
+namespace {
+
+alignas(16) const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+alignas(16) const uint32_t INIT[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+/** Byte order of the big endian words of a 16-byte load */
+alignas(16) const uint8_t MASK[16] = {0x03, 0x02, 0x01, 0x00, 0x07, 0x06, 0x05, 0x04, 0x0b, 0x0a, 0x09, 0x08, 0x0f, 0x0e, 0x0d, 0x0c};
+
+/** Padding of a 64-byte message, the 0x80 end marker and the length of 512 bits */
+alignas(16) const unsigned char PAD64[64] = {0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                             0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                             0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                             0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x02, 0};
+
+/** Four rounds, quad is the index of the first round divided by four. */
+void inline __attribute__((always_inline)) QuadRound(__m128i& s0, __m128i& s1, __m128i m, int quad)
+{
+    const __m128i msg = _mm_add_epi32(m, _mm_load_si128((const __m128i*)(K + 4 * quad)));
+    s1 = _mm_sha256rnds2_epu32(s1, s0, msg);
+    s0 = _mm_sha256rnds2_epu32(s0, s1, _mm_shuffle_epi32(msg, 0x0e));
+}
+
+/** The next four words of the message schedule: m0 are the oldest, m2 receives the new ones. */
+void inline __attribute__((always_inline)) ShiftMessageA(__m128i& m0, __m128i m1)
+{
+    m0 = _mm_sha256msg1_epu32(m0, m1);
+}
+
+void inline __attribute__((always_inline)) ShiftMessageC(__m128i& m0, __m128i m1, __m128i& m2)
+{
+    m2 = _mm_sha256msg2_epu32(_mm_add_epi32(m2, _mm_alignr_epi8(m1, m0, 4)), m1);
+}
+
+void inline __attribute__((always_inline)) ShiftMessageB(__m128i& m0, __m128i m1, __m128i& m2)
+{
+    ShiftMessageC(m0, m1, m2);
+    ShiftMessageA(m0, m1);
+}
+
+/** Reorder the state words a-h into the ABEF and CDGH halves the SHA instructions work on. */
+void inline __attribute__((always_inline)) Shuffle(__m128i& s0, __m128i& s1)
+{
+    const __m128i t1 = _mm_shuffle_epi32(s0, 0xB1);
+    const __m128i t2 = _mm_shuffle_epi32(s1, 0x1B);
+    s0 = _mm_alignr_epi8(t1, t2, 0x08);
+    s1 = _mm_blend_epi16(t2, t1, 0xF0);
+}
+
+void inline __attribute__((always_inline)) Unshuffle(__m128i& s0, __m128i& s1)
+{
+    const __m128i t1 = _mm_shuffle_epi32(s0, 0x1B);
+    const __m128i t2 = _mm_shuffle_epi32(s1, 0xB1);
+    s0 = _mm_blend_epi16(t1, t2, 0xF0);
+    s1 = _mm_alignr_epi8(t2, t1, 0x08);
+}
+
+__m128i inline __attribute__((always_inline)) Load(const unsigned char* in)
+{
+    return _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)in), _mm_load_si128((const __m128i*)MASK));
+}
+
+void inline __attribute__((always_inline)) Save(unsigned char* out, __m128i s)
+{
+    _mm_storeu_si128((__m128i*)out, _mm_shuffle_epi8(s, _mm_load_si128((const __m128i*)MASK)));
+}
+
+/**
+ * Transform of LANES shuffled states by one block each. The steps of the
+ * independent lanes are interleaved so their instructions overlap.
+ */
+template <int LANES>
+void inline __attribute__((always_inline)) TransformLanes(__m128i* s0, __m128i* s1, const unsigned char* const* chunk)
+{
+    __m128i m0[LANES], m1[LANES], m2[LANES], m3[LANES], so0[LANES], so1[LANES];
+    for (int l = 0; l < LANES; l++) {
+        so0[l] = s0[l];
+        so1[l] = s1[l];
+        m0[l] = Load(chunk[l]);
+        m1[l] = Load(chunk[l] + 16);
+        m2[l] = Load(chunk[l] + 32);
+        m3[l] = Load(chunk[l] + 48);
+    }
+    for (int l = 0; l < LANES; l++) QuadRound(s0[l], s1[l], m0[l], 0);
+    for (int l = 0; l < LANES; l++) { QuadRound(s0[l], s1[l], m1[l], 1); ShiftMessageA(m0[l], m1[l]); }
+    for (int l = 0; l < LANES; l++) { QuadRound(s0[l], s1[l], m2[l], 2); ShiftMessageA(m1[l], m2[l]); }
+    for (int l = 0; l < LANES; l++) { QuadRound(s0[l], s1[l], m3[l], 3); ShiftMessageB(m2[l], m3[l], m0[l]); }
+    for (int l = 0; l < LANES; l++) { QuadRound(s0[l], s1[l], m0[l], 4); ShiftMessageB(m3[l], m0[l], m1[l]); }
+    for (int l = 0; l < LANES; l++) { QuadRound(s0[l], s1[l], m1[l], 5); ShiftMessageB(m0[l], m1[l], m2[l]); }
+    for (int l = 0; l < LANES; l++) { QuadRound(s0[l], s1[l], m2[l], 6); ShiftMessageB(m1[l], m2[l], m3[l]); }
+    for (int l = 0; l < LANES; l++) { QuadRound(s0[l], s1[l], m3[l], 7); ShiftMessageB(m2[l], m3[l], m0[l]); }
+    for (int l = 0; l < LANES; l++) { QuadRound(s0[l], s1[l], m0[l], 8); ShiftMessageB(m3[l], m0[l], m1[l]); }
+    for (int l = 0; l < LANES; l++) { QuadRound(s0[l], s1[l], m1[l], 9); ShiftMessageB(m0[l], m1[l], m2[l]); }
+    for (int l = 0; l < LANES; l++) { QuadRound(s0[l], s1[l], m2[l], 10); ShiftMessageB(m1[l], m2[l], m3[l]); }
+    for (int l = 0; l < LANES; l++) { QuadRound(s0[l], s1[l], m3[l], 11); ShiftMessageB(m2[l], m3[l], m0[l]); }
+    for (int l = 0; l < LANES; l++) { QuadRound(s0[l], s1[l], m0[l], 12); ShiftMessageB(m3[l], m0[l], m1[l]); }
+    for (int l = 0; l < LANES; l++) { QuadRound(s0[l], s1[l], m1[l], 13); ShiftMessageC(m0[l], m1[l], m2[l]); }
+    for (int l = 0; l < LANES; l++) { QuadRound(s0[l], s1[l], m2[l], 14); ShiftMessageC(m1[l], m2[l], m3[l]); }
+    for (int l = 0; l < LANES; l++) QuadRound(s0[l], s1[l], m3[l], 15);
+    for (int l = 0; l < LANES; l++) {
+        s0[l] = _mm_add_epi32(s0[l], so0[l]);
+        s1[l] = _mm_add_epi32(s1[l], so1[l]);
+    }
+}
+
+} // namespace
+
+namespace sha256_shani {
+
+void Transform(uint32_t* s, const unsigned char* chunk, size_t blocks)
+{
+    __m128i s0 = _mm_loadu_si128((const __m128i*)s);
+    __m128i s1 = _mm_loadu_si128((const __m128i*)(s + 4));
+    Shuffle(s0, s1);
+    while (blocks--) {
+        TransformLanes<1>(&s0, &s1, &chunk);
+        chunk += 64;
+    }
+    Unshuffle(s0, s1);
+    _mm_storeu_si128((__m128i*)s, s0);
+    _mm_storeu_si128((__m128i*)(s + 4), s1);
+}
+
+} // namespace sha256_shani
+
+namespace sha256d64_shani {
+
+void Transform_2way(unsigned char* out, const unsigned char* in)
+{
+    __m128i s0[2], s1[2];
+    for (int l = 0; l < 2; l++) {
+        s0[l] = _mm_load_si128((const __m128i*)INIT);
+        s1[l] = _mm_load_si128((const __m128i*)(INIT + 4));
+        Shuffle(s0[l], s1[l]);
+    }
+    const unsigned char* chunk[2] = {in, in + 64};
+    TransformLanes<2>(s0, s1, chunk);
+    const unsigned char* pad[2] = {PAD64, PAD64};
+    TransformLanes<2>(s0, s1, pad);
+
+    // The 32-byte hashes of the first round, padded to a single block.
+    alignas(16) unsigned char buf[2][64];
+    for (int l = 0; l < 2; l++) {
+        Unshuffle(s0[l], s1[l]);
+        Save(buf[l], s0[l]);
+        Save(buf[l] + 16, s1[l]);
+        memset(buf[l] + 32, 0, 32);
+        buf[l][32] = 0x80;
+        buf[l][62] = 0x01;
+        s0[l] = _mm_load_si128((const __m128i*)INIT);
+        s1[l] = _mm_load_si128((const __m128i*)(INIT + 4));
+        Shuffle(s0[l], s1[l]);
+        chunk[l] = buf[l];
+    }
+    TransformLanes<2>(s0, s1, chunk);
+
+    for (int l = 0; l < 2; l++) {
+        Unshuffle(s0[l], s1[l]);
+        Save(out + 32 * l, s0[l]);
+        Save(out + 32 * l + 16, s1[l]);
+    }
+}
+
+} // namespace sha256d64_shani
+
+#endif // ENABLE_SHANI
@@ -5,9 +5,18 @@
 #include "crypto/sha512.h"
 
 #include "crypto/common.h"
+#include "compat/cpuid.h"
 
 #include <string.h>
 
+#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+namespace sha512_avx2
+{
+/** Four chains in the 64-bit lanes of AVX2 registers, in sha512_avx2.cpp */
+void Iterate4(unsigned char* hashes, uint64_t nCount);
+}
+#endif
+
 // Internal implementation code.
 namespace
 {
@@ -144,8 +153,35 @@ void Transform(uint64_t* s, const unsigned char* chunk)
     s[7] += h;
 }
 
+/** Hash 64 bytes stored as the first half of chunk, whose second half holds their padding, and store the result there. */
+void inline TransformPadded64(unsigned char* chunk)
+{
+    uint64_t s[8];
+    Initialize(s);
+    Transform(s, chunk);
+    for (int i = 0; i < 8; i++)
+        WriteBE64(chunk + 8 * i, s[i]);
+}
+
+void Iterate4(unsigned char* hashes, uint64_t nCount)
+{
+    for (int i = 0; i < 4; i++)
+        SHA512Iterate(hashes + i * CSHA512::OUTPUT_SIZE, nCount);
+}
+
 } // namespace sha512
 
+typedef void (*Iterate4Fn)(unsigned char* hashes, uint64_t nCount);
+
+Iterate4Fn SelectIterate4()
+{
+#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL) && defined(HAVE_GETCPUID)
+    if (HaveAVX2())
+        return sha512_avx2::Iterate4;
+#endif
+    return sha512::Iterate4;
+}
+
 } // namespace
 
 
@@ -205,3 +241,22 @@ CSHA512& CSHA512::Reset()
     sha512::Initialize(s);
     return *this;
 }
+
+void SHA512Iterate(unsigned char hash[CSHA512::OUTPUT_SIZE], uint64_t nCount)
+{
+    // A 64-byte message is a single chunk with constant padding, so the
+    // buffering of CSHA512 can be skipped.
+    unsigned char chunk[128] = {0};
+    memcpy(chunk, hash, CSHA512::OUTPUT_SIZE);
+    chunk[64] = 0x80;
+    WriteBE64(chunk + 120, CSHA512::OUTPUT_SIZE << 3);
+    for (uint64_t i = 0; i < nCount; i++)
+        sha512::TransformPadded64(chunk);
+    memcpy(hash, chunk, CSHA512::OUTPUT_SIZE);
+}
+
+void SHA512Iterate4(unsigned char hashes[4 * CSHA512::OUTPUT_SIZE], uint64_t nCount)
+{
+    static const Iterate4Fn iterate4 = SelectIterate4();
+    iterate4(hashes, nCount);
+}
@@ -25,4 +25,13 @@ public:
     CSHA512& Reset();
 };
 
+/** Replace hash by its own SHA-512 nCount times, the chain used for passphrase key derivation. */
+void SHA512Iterate(unsigned char hash[CSHA512::OUTPUT_SIZE], uint64_t nCount);
+
+/**
+ * SHA512Iterate of four independent 64-byte values stored one after another.
+ * The chains are computed together, with AVX2 where the CPU supports it.
+ */
+void SHA512Iterate4(unsigned char hashes[4 * CSHA512::OUTPUT_SIZE], uint64_t nCount);
+
 #endif // BITCOIN_CRYPTO_SHA512_H
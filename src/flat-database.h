@@ -46,6 +46,8 @@ private:
         int64_t nStart = GetTimeMillis();
 
         // serialize, checksum data up to that point, then append checksum
+        // (the object is only locked while serializing into memory, not
+        // while hashing and writing)
         CDataStream ssObj(SER_DISK, CLIENT_VERSION);
         ssObj << strMagicMessage; // specific magic message for this type of object
         ssObj << FLATDATA(Params().MessageStart()); // network specific magic number
@@ -53,11 +55,16 @@ private:
         uint256 hash = Hash(ssObj.begin(), ssObj.end());
         ssObj << hash;
 
+        // write to a temporary file first, so that an interrupted dump
+        // never leaves a truncated file behind
+        boost::filesystem::path pathTmp = pathDB;
+        pathTmp += ".new";
+
         // open output file, and associate with CAutoFile
-        FILE *file = fopen(pathDB.string().c_str(), "wb");
+        FILE *file = fopen(pathTmp.string().c_str(), "wb");
         CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
         if (fileout.IsNull())
-            return error("%s: Failed to open file %s", __func__, pathDB.string());
+            return error("%s: Failed to open file %s", __func__, pathTmp.string());
 
         // Write and commit header, data
         try {
@@ -66,15 +73,19 @@ private:
         catch (std::exception &e) {
             return error("%s: Serialize or I/O error - %s", __func__, e.what());
         }
+        FileCommit(fileout.Get());
         fileout.fclose();
 
+        if (!RenameOver(pathTmp, pathDB))
+            return error("%s: Rename-into-place failed", __func__);
+
         LogPrintf("Written info to %s  %dms\n", strFilename, GetTimeMillis() - nStart);
         LogPrintf("     %s\n", objToSave.ToString());
 
         return true;
     }
 
-    ReadResult Read(T& objToLoad, bool fDryRun = false)
+    ReadResult Read(T& objToLoad, bool fHeaderOnly = false)
     {
         //LOCK(objToLoad.cs);
 
@@ -88,43 +99,23 @@ private:
             return FileError;
         }
 
-        // use file size to size memory buffer
-        int fileSize = boost::filesystem::file_size(pathDB);
-        int dataSize = fileSize - sizeof(uint256);
-        // Don't try to resize to a negative number if file is small
+        // everything but the trailing checksum is covered by it
+        int64_t dataSize = (int64_t)boost::filesystem::file_size(pathDB) - (int64_t)sizeof(uint256);
         if (dataSize < 0)
-            dataSize = 0;
-        std::vector<unsigned char> vchData;
-        vchData.resize(dataSize);
-        uint256 hashIn;
-
-        // read data and checksum from file
-        try {
-            filein.read((char *)&vchData[0], dataSize);
-            filein >> hashIn;
-        }
-        catch (std::exception &e) {
-            error("%s: Deserialize or I/O error - %s", __func__, e.what());
-            return HashReadError;
-        }
-        filein.fclose();
-
-        CDataStream ssObj(vchData, SER_DISK, CLIENT_VERSION);
-
-        // verify stored checksum matches input data
-        uint256 hashTmp = Hash(ssObj.begin(), ssObj.end());
-        if (hashIn != hashTmp)
         {
-            error("%s: Checksum mismatch, data corrupted", __func__);
-            return IncorrectHash;
+            error("%s: File too small", __func__);
+            return HashReadError;
         }
 
+        // Deserialize straight from the file while hashing what is read,
+        // instead of loading the whole file into memory first.
+        CHashVerifier<CAutoFile> verifier(&filein);
 
         unsigned char pchMsgTmp[4];
         std::string strMagicMessageTmp;
         try {
             // de-serialize file header (file specific magic message) and ..
-            ssObj >> strMagicMessageTmp;
+            verifier >> strMagicMessageTmp;
 
             // ... verify the message matches predefined one
             if (strMagicMessage != strMagicMessageTmp)
@@ -135,7 +126,7 @@ private:
 
 
             // de-serialize file header (network specific magic number) and ..
-            ssObj >> FLATDATA(pchMsgTmp);
+            verifier >> FLATDATA(pchMsgTmp);
 
             // ... verify the network matches ours
             if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp)))
@@ -144,8 +135,11 @@ private:
                 return IncorrectMagicNumber;
             }
 
+            if (fHeaderOnly)
+                return Ok;
+
             // de-serialize data into T object
-            ssObj >> objToLoad;
+            verifier >> objToLoad;
         }
         catch (std::exception &e) {
             objToLoad.Clear();
@@ -153,13 +147,37 @@ private:
             return IncorrectFormat;
         }
 
+        // read data and checksum from file
+        uint256 hashIn;
+        try {
+            // objects bail out early on a serialization version mismatch,
+            // hash whatever they did not consume
+            int64_t nPos = ftell(filein.Get());
+            if (nPos < 0 || nPos > dataSize)
+                throw std::ios_base::failure("unexpected file position");
+            verifier.ignore(dataSize - nPos);
+            filein >> hashIn;
+        }
+        catch (std::exception &e) {
+            objToLoad.Clear();
+            error("%s: Deserialize or I/O error - %s", __func__, e.what());
+            return HashReadError;
+        }
+        filein.fclose();
+
+        // verify stored checksum matches input data
+        if (hashIn != verifier.GetHash())
+        {
+            objToLoad.Clear();
+            error("%s: Checksum mismatch, data corrupted", __func__);
+            return IncorrectHash;
+        }
+
         LogPrintf("Loaded info from %s  %dms\n", strFilename, GetTimeMillis() - nStart);
         LogPrintf("     %s\n", objToLoad.ToString());
-        if(!fDryRun) {
-            LogPrintf("%s: Cleaning....\n", __func__);
-            objToLoad.CheckAndRemove();
-            LogPrintf("     %s\n", objToLoad.ToString());
-        }
+        LogPrintf("%s: Cleaning....\n", __func__);
+        objToLoad.CheckAndRemove();
+        LogPrintf("     %s\n", objToLoad.ToString());
 
         return Ok;
     }
@@ -199,6 +217,8 @@ public:
     {
         int64_t nStart = GetTimeMillis();
 
+        // only the header is checked, so that we don't overwrite a file
+        // that belongs to something else, without loading the whole thing
         LogPrintf("Verifying %s format...\n", strFilename);
         T tmpObjToLoad;
         ReadResult readResult = Read(tmpObjToLoad, true);
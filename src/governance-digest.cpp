@@ -0,0 +1,50 @@
+// Copyright (c) 2024 The blazegeek developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "governance-digest.h"
+
+/** Average number of hashes per bucket the digest is sized for */
+static const size_t GOVERNANCE_DIGEST_BUCKET_ELEMENTS = 4;
+
+CGovernanceSetDigest::CGovernanceSetDigest() :
+    nParentHash(),
+    vBuckets(1, 0)
+{
+}
+
+CGovernanceSetDigest::CGovernanceSetDigest(const uint256& nParentHashIn, size_t nElements) :
+    nParentHash(nParentHashIn)
+{
+    size_t nBuckets = 1;
+    while (nBuckets < MAX_GOVERNANCE_DIGEST_BUCKETS && nBuckets * GOVERNANCE_DIGEST_BUCKET_ELEMENTS < nElements) {
+        nBuckets <<= 1;
+    }
+    vBuckets.assign(nBuckets, 0);
+}
+
+CGovernanceSetDigest CGovernanceSetDigest::WithLayoutOf(const CGovernanceSetDigest& other)
+{
+    CGovernanceSetDigest digest;
+    digest.nParentHash = other.nParentHash;
+    digest.vBuckets.assign(other.vBuckets.size(), 0);
+    return digest;
+}
+
+bool CGovernanceSetDigest::IsValid() const
+{
+    size_t nBuckets = vBuckets.size();
+    return nBuckets != 0 && nBuckets <= MAX_GOVERNANCE_DIGEST_BUCKETS && (nBuckets & (nBuckets - 1)) == 0;
+}
+
+void CGovernanceSetDigest::Insert(const uint256& hash)
+{
+    // the bucket is selected by the low bits, mix in an independent part of the hash
+    vBuckets[GetBucket(hash)] ^= hash.GetUint64(1);
+}
+
+bool CGovernanceSetDigest::Differs(const CGovernanceSetDigest& other, const uint256& hash) const
+{
+    size_t nBucket = GetBucket(hash);
+    return vBuckets[nBucket] != other.vBuckets[nBucket];
+}
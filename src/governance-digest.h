@@ -0,0 +1,66 @@
+// Copyright (c) 2024 The blazegeek developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef GOVERNANCE_DIGEST_H
+#define GOVERNANCE_DIGEST_H
+
+#include <vector>
+
+#include "serialize.h"
+#include "uint256.h"
+
+/** Maximum number of buckets a digest may have, 128kB on the wire */
+static const size_t MAX_GOVERNANCE_DIGEST_BUCKETS = 16384;
+/** Maximum number of digests a peer may send in a single message */
+static const size_t MAX_GOVERNANCE_DIGESTS_PER_MESSAGE = 100;
+
+/**
+ * Compact summary of a set of governance hashes: either all objects a node
+ * knows (null nParentHash) or the votes of a single object.
+ *
+ * Hashes are spread over a power of two number of buckets by their low bits
+ * and every bucket stores the xor of its members. A peer builds a digest of
+ * its own set with the same number of buckets and only has to announce the
+ * hashes which fall into buckets whose values differ, so the data sent is
+ * proportional to the difference between the two sets rather than to their
+ * size, without the false positives of a bloom filter.
+ */
+class CGovernanceSetDigest
+{
+private:
+    uint256 nParentHash;
+    std::vector<uint64_t> vBuckets;
+
+public:
+    CGovernanceSetDigest();
+    /** Create an empty digest sized for about nElements hashes */
+    CGovernanceSetDigest(const uint256& nParentHashIn, size_t nElements);
+    /** Create an empty digest with the same layout as other */
+    static CGovernanceSetDigest WithLayoutOf(const CGovernanceSetDigest& other);
+
+    const uint256& GetParentHash() const { return nParentHash; }
+    size_t GetBucketCount() const { return vBuckets.size(); }
+
+    /** Check that the bucket count is a power of two within limits */
+    bool IsValid() const;
+
+    void Insert(const uint256& hash);
+
+    /** True if hash falls into a bucket in which this and other (same layout) differ */
+    bool Differs(const CGovernanceSetDigest& other, const uint256& hash) const;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(nParentHash);
+        READWRITE(vBuckets);
+    }
+
+private:
+    size_t GetBucket(const uint256& hash) const { return hash.GetCheapHash() & (vBuckets.size() - 1); }
+};
+
+#endif
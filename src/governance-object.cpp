@@ -40,6 +40,7 @@ CGovernanceObject::CGovernanceObject() :
     fExpired(false),
     fUnparsable(false),
     mapCurrentMNVotes(),
+    nVoteTally(),
     cmmapOrphanVotes(),
     fileVotes()
 {
@@ -68,6 +69,7 @@ CGovernanceObject::CGovernanceObject(const uint256& nHashParentIn, int nRevision
     fExpired(false),
     fUnparsable(false),
     mapCurrentMNVotes(),
+    nVoteTally(),
     cmmapOrphanVotes(),
     fileVotes()
 {
@@ -99,6 +101,7 @@ CGovernanceObject::CGovernanceObject(const CGovernanceObject& other) :
     cmmapOrphanVotes(other.cmmapOrphanVotes),
     fileVotes(other.fileVotes)
 {
+    memcpy(nVoteTally, other.nVoteTally, sizeof(nVoteTally));
 }
 
 bool CGovernanceObject::ProcessVote(CNode* pfrom,
@@ -204,7 +207,9 @@ bool CGovernanceObject::ProcessVote(CNode* pfrom,
         return false;
     }
 
+    UpdateVoteTally(eSignal, voteInstanceRef.eOutcome, -1);
     voteInstanceRef = vote_instance_t(vote.GetOutcome(), nVoteTimeUpdate, vote.GetTimestamp());
+    UpdateVoteTally(eSignal, voteInstanceRef.eOutcome, 1);
     fileVotes.AddVote(vote);
     fDirtyCache = true;
     return true;
@@ -218,6 +223,9 @@ void CGovernanceObject::ClearMasternodeVotes()
     while (it != mapCurrentMNVotes.end()) {
         if (!mnodeman.Has(it->first)) {
             fileVotes.RemoveVotesFromMasternode(it->first);
+            for (const auto& instancePair : it->second.mapInstances) {
+                UpdateVoteTally(instancePair.first, instancePair.second.eOutcome, -1);
+            }
             mapCurrentMNVotes.erase(it++);
         } else {
             ++it;
@@ -249,6 +257,7 @@ std::set<uint256> CGovernanceObject::RemoveInvalidProposalVotes(const COutPoint&
         CGovernanceVote tmpVote(mnOutpoint, nParentHash, (vote_signal_enum_t)jt->first, jt->second.eOutcome);
         tmpVote.SetTime(jt->second.nCreationTime);
         if (removedVotes.count(tmpVote.GetHash())) {
+            UpdateVoteTally(jt->first, jt->second.eOutcome, -1);
             jt = it->second.mapInstances.erase(jt);
         } else {
             ++jt;
@@ -713,15 +722,35 @@ int CGovernanceObject::CountMatchingVotes(vote_signal_enum_t eVoteSignalIn, vote
 {
     LOCK(cs);
 
-    int nCount = 0;
+    if (eVoteSignalIn < 0 || eVoteSignalIn > MAX_SUPPORTED_VOTE_SIGNAL ||
+        eVoteOutcomeIn < 0 || eVoteOutcomeIn > VOTE_OUTCOME_ABSTAIN) {
+        return 0;
+    }
+    return nVoteTally[eVoteSignalIn][eVoteOutcomeIn];
+}
+
+void CGovernanceObject::UpdateVoteTally(int nSignal, vote_outcome_enum_t eOutcome, int nDelta)
+{
+    AssertLockHeld(cs);
+
+    // VOTE_OUTCOME_NONE is what a rejected vote leaves behind, it is never counted
+    if (nSignal < 0 || nSignal > MAX_SUPPORTED_VOTE_SIGNAL ||
+        eOutcome <= VOTE_OUTCOME_NONE || eOutcome > VOTE_OUTCOME_ABSTAIN) {
+        return;
+    }
+    nVoteTally[nSignal][eOutcome] += nDelta;
+}
+
+void CGovernanceObject::RebuildVoteTally()
+{
+    LOCK(cs);
+
+    memset(nVoteTally, 0, sizeof(nVoteTally));
     for (const auto& votepair : mapCurrentMNVotes) {
-        const vote_rec_t& recVote = votepair.second;
-        vote_instance_m_cit it2 = recVote.mapInstances.find(eVoteSignalIn);
-        if (it2 != recVote.mapInstances.end() && it2->second.eOutcome == eVoteOutcomeIn) {
-            ++nCount;
+        for (const auto& instancePair : votepair.second.mapInstances) {
+            UpdateVoteTally(instancePair.first, instancePair.second.eOutcome, 1);
         }
     }
-    return nCount;
 }
 
 /**
@@ -864,6 +893,7 @@ std::vector<uint256> CGovernanceObject::RemoveOldVotes(unsigned int nMinTime)
         auto itVotePair = miRef.begin();
         while (itVotePair != miRef.end()) {
             if (itVotePair->second.nCreationTime < nMinTime) {
+                UpdateVoteTally(itVotePair->first, itVotePair->second.eOutcome, -1);
                 miRef.erase(itVotePair++);
             } else {
                 ++itVotePair;
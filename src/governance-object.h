@@ -29,6 +29,7 @@ class CGovernanceVote;
 
 static const int MIN_GOVERNANCE_PEER_PROTO_VERSION = 70210;
 static const int GOVERNANCE_FILTER_PROTO_VERSION = 70206;
+static const int GOVERNANCE_DIGEST_PROTO_VERSION = 70214;
 
 static const double GOVERNANCE_FILTER_FP_RATE = 0.001;
 
@@ -184,6 +185,9 @@ private:
 
     vote_m_t mapCurrentMNVotes;
 
+    /// Number of current votes per signal and outcome, kept in sync with mapCurrentMNVotes
+    int nVoteTally[MAX_SUPPORTED_VOTE_SIGNAL + 1][VOTE_OUTCOME_ABSTAIN + 1];
+
     /// Limited map of votes orphaned by MN
     vote_cmm_t cmmapOrphanVotes;
 
@@ -332,13 +336,16 @@ public:
             READWRITE(fExpired);
             READWRITE(mapCurrentMNVotes);
             READWRITE(fileVotes);
+            if (ser_action.ForRead()) {
+                RebuildVoteTally();
+            }
             LogPrint("gobject", "CGovernanceObject::SerializationOp hash = %s, vote count = %d\n", GetHash().ToString(), fileVotes.GetVoteCount());
         }
 
         // AFTER DESERIALIZATION OCCURS, CACHED VARIABLES MUST BE CALCULATED MANUALLY
     }
 
-private:
+protected:
     // FUNCTIONS FOR DEALING WITH DATA STRING
     void LoadData();
     void GetData(UniValue& objResult);
@@ -351,6 +358,10 @@ private:
     /// Called when MN's which have voted on this object have been removed
     void ClearMasternodeVotes();
 
+    /// Adjust nVoteTally for a vote instance entering (nDelta = 1) or leaving (nDelta = -1) mapCurrentMNVotes
+    void UpdateVoteTally(int nSignal, vote_outcome_enum_t eOutcome, int nDelta);
+    void RebuildVoteTally();
+
     // Revalidate all votes from this MN and delete them if validation fails
     // This is the case for DIP3 MNs that change voting keys. Returns deleted vote hashes
     std::set<uint256> RemoveInvalidProposalVotes(const COutPoint& mnOutpoint);
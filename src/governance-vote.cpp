@@ -5,12 +5,17 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "governance-vote.h"
+#include "batchverifier.h"
 #include "governance-object.h"
 #include "masternode-sync.h"
 #include "masternodeman.h"
 #include "messagesigner.h"
 #include "util.h"
 
+/** Votes are relayed by every peer and are requested again on each governance sync */
+static const unsigned int MAX_VOTE_SIGNATURE_CACHE_SIZE = 100000;
+static CSignatureCache voteSigCache(MAX_VOTE_SIGNATURE_CACHE_SIZE);
+
 std::string CGovernanceVoting::ConvertOutcomeToString(vote_outcome_enum_t nOutcome)
 {
     static const std::map<vote_outcome_enum_t, std::string> mapOutcomeString = {
@@ -184,8 +189,14 @@ bool CGovernanceVote::Sign(const CKey& key, const CKeyID& keyID)
 bool CGovernanceVote::CheckSignature(const CKeyID& keyID) const
 {
     std::string strError;
+    bool fNewSigs = sporkManager.IsSporkActive(SPORK_6_NEW_SIGS);
 
-    if (sporkManager.IsSporkActive(SPORK_6_NEW_SIGS)) {
+    uint256 cacheEntry = CSignatureCache::GetEntry(GetHash(), vchSig, keyID, fNewSigs);
+    if (voteSigCache.Contains(cacheEntry)) {
+        return true;
+    }
+
+    if (fNewSigs) {
         uint256 hash = GetSignatureHash();
 
         if (!CHashSigner::VerifyHash(hash, keyID, vchSig, strError)) {
@@ -213,6 +224,7 @@ bool CGovernanceVote::CheckSignature(const CKeyID& keyID) const
         }
     }
 
+    voteSigCache.Add(cacheEntry);
     return true;
 }
 
@@ -229,6 +241,11 @@ bool CGovernanceVote::Sign(const CBLSSecretKey& key)
 
 bool CGovernanceVote::CheckSignature(const CBLSPublicKey& pubKey) const
 {
+    uint256 cacheEntry = CSignatureCache::GetEntry(GetHash(), vchSig, pubKey, true);
+    if (voteSigCache.Contains(cacheEntry)) {
+        return true;
+    }
+
     uint256 hash = GetSignatureHash();
     CBLSSignature sig;
     sig.SetBuf(vchSig);
@@ -236,6 +253,7 @@ bool CGovernanceVote::CheckSignature(const CBLSPublicKey& pubKey) const
         LogPrintf("CGovernanceVote::CheckSignature -- VerifyInsecure() failed\n");
         return false;
     }
+    voteSigCache.Add(cacheEntry);
     return true;
 }
 
@@ -9,14 +9,16 @@
 CGovernanceObjectVoteFile::CGovernanceObjectVoteFile() :
     nMemoryVotes(0),
     listVotes(),
-    mapVoteIndex()
+    mapVoteIndex(),
+    mapMasternodeIndex()
 {
 }
 
 CGovernanceObjectVoteFile::CGovernanceObjectVoteFile(const CGovernanceObjectVoteFile& other) :
     nMemoryVotes(other.nMemoryVotes),
     listVotes(other.listVotes),
-    mapVoteIndex()
+    mapVoteIndex(),
+    mapMasternodeIndex()
 {
     RebuildIndex();
 }
@@ -29,6 +31,7 @@ void CGovernanceObjectVoteFile::AddVote(const CGovernanceVote& vote)
         return;
     listVotes.push_front(vote);
     mapVoteIndex.emplace(nHash, listVotes.begin());
+    mapMasternodeIndex.emplace(vote.GetMasternodeOutpoint(), listVotes.begin());
     ++nMemoryVotes;
 }
 
@@ -58,34 +61,31 @@ std::vector<CGovernanceVote> CGovernanceObjectVoteFile::GetVotes() const
 
 void CGovernanceObjectVoteFile::RemoveVotesFromMasternode(const COutPoint& outpointMasternode)
 {
-    vote_l_it it = listVotes.begin();
-    while (it != listVotes.end()) {
-        if (it->GetMasternodeOutpoint() == outpointMasternode) {
-            --nMemoryVotes;
-            mapVoteIndex.erase(it->GetHash());
-            listVotes.erase(it++);
-        } else {
-            ++it;
-        }
+    auto range = mapMasternodeIndex.equal_range(outpointMasternode);
+    for (vote_mn_mm_it it = range.first; it != range.second; ++it) {
+        --nMemoryVotes;
+        mapVoteIndex.erase(it->second->GetHash());
+        listVotes.erase(it->second);
     }
+    mapMasternodeIndex.erase(range.first, range.second);
 }
 
 std::set<uint256> CGovernanceObjectVoteFile::RemoveInvalidProposalVotes(const COutPoint& outpointMasternode)
 {
     std::set<uint256> removedVotes;
 
-    vote_l_it it = listVotes.begin();
-    while (it != listVotes.end()) {
-        if (it->GetSignal() == VOTE_SIGNAL_FUNDING && it->GetMasternodeOutpoint() == outpointMasternode) {
-            if (!it->IsValid(true)) {
-                removedVotes.emplace(it->GetHash());
-                --nMemoryVotes;
-                mapVoteIndex.erase(it->GetHash());
-                listVotes.erase(it++);
-                continue;
-            }
+    // collect first, EraseVote modifies mapMasternodeIndex
+    std::vector<vote_l_it> vecInvalid;
+    auto range = mapMasternodeIndex.equal_range(outpointMasternode);
+    for (vote_mn_mm_it it = range.first; it != range.second; ++it) {
+        if (it->second->GetSignal() == VOTE_SIGNAL_FUNDING && !it->second->IsValid(true)) {
+            vecInvalid.push_back(it->second);
         }
-        ++it;
+    }
+
+    for (vote_l_it it : vecInvalid) {
+        removedVotes.emplace(it->GetHash());
+        EraseVote(it);
     }
 
     return removedVotes;
@@ -97,10 +97,8 @@ std::vector<uint256> CGovernanceObjectVoteFile::RemoveOldVotes(unsigned int nMin
     vote_l_it it = listVotes.begin();
     while (it != listVotes.end()) {
         if (it->GetTimestamp() < nMinTime) {
-            --nMemoryVotes;
             removed.emplace_back(it->GetHash());
-            mapVoteIndex.erase(it->GetHash());
-            listVotes.erase(it++);
+            it = EraseVote(it);
         } else {
             ++it;
         }
@@ -111,6 +109,7 @@ std::vector<uint256> CGovernanceObjectVoteFile::RemoveOldVotes(unsigned int nMin
 void CGovernanceObjectVoteFile::RebuildIndex()
 {
     mapVoteIndex.clear();
+    mapMasternodeIndex.clear();
     nMemoryVotes = 0;
     vote_l_it it = listVotes.begin();
     while (it != listVotes.end()) {
@@ -118,6 +117,7 @@ void CGovernanceObjectVoteFile::RebuildIndex()
         uint256 nHash = vote.GetHash();
         if (mapVoteIndex.find(nHash) == mapVoteIndex.end()) {
             mapVoteIndex[nHash] = it;
+            mapMasternodeIndex.emplace(vote.GetMasternodeOutpoint(), it);
             ++nMemoryVotes;
             ++it;
         } else {
@@ -125,3 +125,17 @@ void CGovernanceObjectVoteFile::RebuildIndex()
         }
     }
 }
+
+CGovernanceObjectVoteFile::vote_l_it CGovernanceObjectVoteFile::EraseVote(vote_l_it it)
+{
+    auto range = mapMasternodeIndex.equal_range(it->GetMasternodeOutpoint());
+    for (vote_mn_mm_it mnit = range.first; mnit != range.second; ++mnit) {
+        if (mnit->second == it) {
+            mapMasternodeIndex.erase(mnit);
+            break;
+        }
+    }
+    mapVoteIndex.erase(it->GetHash());
+    --nMemoryVotes;
+    return listVotes.erase(it);
+}
@@ -38,6 +38,10 @@ public: // Types
 
     typedef vote_m_t::const_iterator vote_m_cit;
 
+    typedef std::multimap<COutPoint, vote_l_it> vote_mn_mm_t;
+
+    typedef vote_mn_mm_t::iterator vote_mn_mm_it;
+
 private:
     static const int MAX_MEMORY_VOTES = -1;
 
@@ -47,6 +51,9 @@ private:
 
     vote_m_t mapVoteIndex;
 
+    /// Votes by masternode outpoint, so a masternode's votes can be removed without a full scan
+    vote_mn_mm_t mapMasternodeIndex;
+
 public:
     CGovernanceObjectVoteFile();
 
@@ -94,6 +101,9 @@ public:
 
 private:
     void RebuildIndex();
+
+    /// Remove a vote from the list and both indexes, returns the next list position
+    vote_l_it EraseVote(vote_l_it it);
 };
 
 #endif
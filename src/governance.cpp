@@ -41,10 +41,15 @@ CGovernanceManager::CGovernanceManager() :
     mapLastMasternodeObject(),
     setRequestedObjects(),
     fRateChecksEnabled(true),
+    voteVerifier("blaze-gov-verify", GOVERNANCE_VOTE_BATCH_SIZE, GOVERNANCE_VOTE_BATCH_DELAY),
     cs()
 {
 }
 
+CGovernanceManager::~CGovernanceManager()
+{
+}
+
 // Accessors for thread-safe access to maps
 bool CGovernanceManager::HaveObjectForHash(const uint256& nHash) const
 {
@@ -126,6 +131,61 @@ void CGovernanceManager::ProcessMessage(CNode* pfrom, const std::string& strComm
         LogPrint("gobject", "MNGOVERNANCESYNC -- syncing governance objects to our peer at %s\n", pfrom->addr.ToString());
     }
 
+    // A PEER WANTS THE OBJECTS/VOTES WHICH ARE NOT COVERED BY ITS SET DIGESTS
+    else if (strCommand == NetMsgType::MNGOVERNANCEDIGEST) {
+        if (pfrom->nVersion < MIN_GOVERNANCE_PEER_PROTO_VERSION) {
+            LogPrint("gobject", "MNGOVERNANCEDIGEST -- peer=%d using obsolete version %i\n", pfrom->id, pfrom->nVersion);
+            connman.PushMessage(pfrom, CNetMsgMaker(pfrom->GetSendVersion()).Make(NetMsgType::REJECT, strCommand, REJECT_OBSOLETE, strprintf("Version must be %d or greater", MIN_GOVERNANCE_PEER_PROTO_VERSION)));
+            return;
+        }
+
+        // Same as for MNGOVERNANCESYNC, ignore these until we are fully synced,
+        // a digest can ask for every object and vote we have.
+        if (!masternodeSync.IsSynced()) {
+            LogPrint("gobject", "MNGOVERNANCEDIGEST -- not synced yet, ignoring digests from peer=%d\n", pfrom->id);
+            return;
+        }
+
+        std::vector<CGovernanceSetDigest> vecDigests;
+        vRecv >> vecDigests;
+
+        if (vecDigests.size() > MAX_GOVERNANCE_DIGESTS_PER_MESSAGE) {
+            LogPrint("gobject", "MNGOVERNANCEDIGEST -- too many digests (%d), peer=%d\n", vecDigests.size(), pfrom->id);
+            LOCK(cs_main);
+            Misbehaving(pfrom->GetId(), 20);
+            return;
+        }
+        for (const auto& digest : vecDigests) {
+            if (!digest.IsValid()) {
+                LogPrint("gobject", "MNGOVERNANCEDIGEST -- invalid digest with %d buckets, peer=%d\n", digest.GetBucketCount(), pfrom->id);
+                LOCK(cs_main);
+                Misbehaving(pfrom->GetId(), 20);
+                return;
+            }
+        }
+
+        int nSkipped = 0;
+        for (const auto& digest : vecDigests) {
+            if (digest.GetParentHash().IsNull()) {
+                SyncAll(pfrom, connman, &digest);
+                continue;
+            }
+            // Serve every object and its votes at most once per peer until the
+            // fulfilled request expires, like SyncAll does for the full sync.
+            std::string strRequest = strprintf("%s-%s", NetMsgType::MNGOVERNANCEDIGEST, digest.GetParentHash().ToString());
+            if (netfulfilledman.HasFulfilledRequest(pfrom->addr, strRequest)) {
+                nSkipped++;
+                continue;
+            }
+            netfulfilledman.AddFulfilledRequest(pfrom->addr, strRequest);
+            SyncSingleObjAndItsVotes(pfrom, digest, connman);
+        }
+        if (nSkipped > 0) {
+            LogPrint("gobject", "MNGOVERNANCEDIGEST -- skipped %d already served objects, peer=%d\n", nSkipped, pfrom->id);
+        }
+        LogPrint("gobject", "MNGOVERNANCEDIGEST -- reconciled %d digests with peer=%d\n", vecDigests.size(), pfrom->id);
+    }
+
     // A NEW GOVERNANCE OBJECT HAS ARRIVED
     else if (strCommand == NetMsgType::MNGOVERNANCEOBJECT) {
         // MAKE SURE WE HAVE A VALID REFERENCE TO THE TIP BEFORE CONTINUING
@@ -258,21 +318,82 @@ void CGovernanceManager::ProcessMessage(CNode* pfrom, const std::string& strComm
             return;
         }
 
-        CGovernanceException exception;
-        if (ProcessVote(pfrom, vote, exception, connman)) {
-            LogPrint("gobject", "MNGOVERNANCEOBJECTVOTE -- %s new\n", strHash);
-            masternodeSync.BumpAssetLastTime("MNGOVERNANCEOBJECTVOTE");
-            vote.Relay(connman);
-        } else {
-            LogPrint("gobject", "MNGOVERNANCEOBJECTVOTE -- Rejected vote, error = %s\n", exception.what());
-            if ((exception.GetNodePenalty() != 0) && masternodeSync.IsSynced()) {
-                LOCK(cs_main);
-                Misbehaving(pfrom->GetId(), exception.GetNodePenalty());
-            }
+        if (voteVerifier.Queue(pfrom, vote)) {
+            ProcessPendingVotes(connman);
             return;
         }
-        // SEND NOTIFICATION TO SCRIPT/ZMQ
-        GetMainSignals().NotifyGovernanceVote(vote);
+
+        ProcessNetworkVote(pfrom, vote, connman);
+    }
+}
+
+void CGovernanceManager::ProcessNetworkVote(CNode* pfrom, const CGovernanceVote& vote, CConnman& connman)
+{
+    CGovernanceException exception;
+    if (ProcessVote(pfrom, vote, exception, connman)) {
+        LogPrint("gobject", "MNGOVERNANCEOBJECTVOTE -- %s new\n", vote.GetHash().ToString());
+        masternodeSync.BumpAssetLastTime("MNGOVERNANCEOBJECTVOTE");
+        vote.Relay(connman);
+    } else {
+        LogPrint("gobject", "MNGOVERNANCEOBJECTVOTE -- Rejected vote, error = %s\n", exception.what());
+        if ((exception.GetNodePenalty() != 0) && masternodeSync.IsSynced()) {
+            LOCK(cs_main);
+            Misbehaving(pfrom->GetId(), exception.GetNodePenalty());
+        }
+        return;
+    }
+    // SEND NOTIFICATION TO SCRIPT/ZMQ
+    GetMainSignals().NotifyGovernanceVote(vote);
+}
+
+void CGovernanceManager::StartVoteVerification(int nThreads)
+{
+    voteVerifier.Start(nThreads);
+}
+
+void CGovernanceManager::StopVoteVerification()
+{
+    voteVerifier.Stop();
+}
+
+void CGovernanceManager::ProcessPendingVotes(CConnman& connman, bool fForce)
+{
+    std::vector<CBatchVerifier<CGovernanceVote>::Item> vecVotes;
+    if (!voteVerifier.TakeBatch(vecVotes, fForce)) {
+        return;
+    }
+
+    // Verify the signatures of all distinct, not yet known votes in parallel.
+    // Results end up in the vote signature cache, so that ProcessVote below
+    // only has to run the cheap checks.
+    std::vector<std::function<bool()> > vecChecks;
+    {
+        LOCK(cs);
+        std::set<uint256> setQueued;
+        for (const auto& pair : vecVotes) {
+            const CGovernanceVote& vote = pair.second;
+            uint256 nHash = vote.GetHash();
+            if (!setQueued.insert(nHash).second || cmapVoteToObject.HasKey(nHash) || cmapInvalidVotes.HasKey(nHash)) {
+                continue;
+            }
+            object_m_cit it = mapObjects.find(vote.GetParentHash());
+            if (it == mapObjects.end()) {
+                continue;
+            }
+            bool useVotingKey = it->second.GetObjectType() == GOVERNANCE_OBJECT_PROPOSAL && vote.GetSignal() == VOTE_SIGNAL_FUNDING;
+            vecChecks.emplace_back([vote, useVotingKey]() {
+                return vote.IsValid(useVotingKey);
+            });
+        }
+    }
+
+    size_t nVerified = voteVerifier.Verify(vecChecks);
+
+    LogPrint("gobject", "CGovernanceManager::%s -- processing %d votes, %d verified in parallel\n", __func__, vecVotes.size(), nVerified);
+
+    for (auto& pair : vecVotes) {
+        ProcessNetworkVote(pair.first, pair.second, connman);
+        pair.first->Release();
     }
 }
 
@@ -517,26 +638,27 @@ std::vector<CGovernanceVote> CGovernanceManager::GetCurrentVotes(const uint256&
     if (it == mapObjects.end()) return vecResult;
     const CGovernanceObject& govobj = it->second;
 
-    CMasternode mn;
-    std::map<COutPoint, CMasternode> mapMasternodes;
-    if (mnCollateralOutpointFilter.IsNull()) {
-        mapMasternodes = mnodeman.GetFullMasternodeMap();
-    } else if (mnodeman.Get(mnCollateralOutpointFilter, mn)) {
-        mapMasternodes[mnCollateralOutpointFilter] = mn;
+    // Walk the object's own vote records instead of the whole masternode list,
+    // only votes of masternodes we still know about are reported
+    LOCK(govobj.cs);
+    CGovernanceObject::vote_m_cit itBegin = govobj.mapCurrentMNVotes.begin();
+    CGovernanceObject::vote_m_cit itEnd = govobj.mapCurrentMNVotes.end();
+    if (!mnCollateralOutpointFilter.IsNull()) {
+        itBegin = govobj.mapCurrentMNVotes.find(mnCollateralOutpointFilter);
+        if (itBegin != itEnd) {
+            itEnd = std::next(itBegin);
+        }
     }
 
-    // Loop thru each MN collateral outpoint and get the votes for the `nParentHash` governance object
-    for (const auto& mnpair : mapMasternodes) {
-        // get a vote_rec_t from the govobj
-        vote_rec_t voteRecord;
-        if (!govobj.GetCurrentMNVotes(mnpair.first, voteRecord)) continue;
+    for (CGovernanceObject::vote_m_cit itVote = itBegin; itVote != itEnd; ++itVote) {
+        if (!mnodeman.Has(itVote->first)) continue;
 
-        for (const auto& voteInstancePair : voteRecord.mapInstances) {
+        for (const auto& voteInstancePair : itVote->second.mapInstances) {
             int signal = voteInstancePair.first;
             int outcome = voteInstancePair.second.eOutcome;
             int64_t nCreationTime = voteInstancePair.second.nCreationTime;
 
-            CGovernanceVote vote = CGovernanceVote(mnpair.first, nParentHash, (vote_signal_enum_t)signal, (vote_outcome_enum_t)outcome);
+            CGovernanceVote vote = CGovernanceVote(itVote->first, nParentHash, (vote_signal_enum_t)signal, (vote_outcome_enum_t)outcome);
             vote.SetTime(nCreationTime);
 
             vecResult.push_back(vote);
@@ -651,6 +773,16 @@ bool CGovernanceManager::ConfirmInventoryRequest(const CInv& inv)
 }
 
 void CGovernanceManager::SyncSingleObjAndItsVotes(CNode* pnode, const uint256& nProp, const CBloomFilter& filter, CConnman& connman)
+{
+    SyncSingleObjAndItsVotes(pnode, nProp, &filter, nullptr, connman);
+}
+
+void CGovernanceManager::SyncSingleObjAndItsVotes(CNode* pnode, const CGovernanceSetDigest& digest, CConnman& connman)
+{
+    SyncSingleObjAndItsVotes(pnode, digest.GetParentHash(), nullptr, &digest, connman);
+}
+
+void CGovernanceManager::SyncSingleObjAndItsVotes(CNode* pnode, const uint256& nProp, const CBloomFilter* pfilter, const CGovernanceSetDigest* pdigest, CConnman& connman)
 {
     // do not provide any data until our node is synced
     if (!masternodeSync.IsSynced()) return;
@@ -684,14 +816,30 @@ void CGovernanceManager::SyncSingleObjAndItsVotes(CNode* pnode, const uint256& n
     LogPrint("gobject", "CGovernanceManager::%s -- syncing govobj: %s, peer=%d\n", __func__, strHash, pnode->id);
     pnode->PushInventory(CInv(MSG_GOVERNANCE_OBJECT, it->first));
 
-    auto fileVotes = govobj.GetVoteFile();
+    std::vector<CGovernanceVote> vecVotes = govobj.GetVoteFile().GetVotes();
+
+    // our votes laid out like the peer's digest, votes in matching buckets are known to the peer
+    CGovernanceSetDigest digestOurs;
+    if (pdigest) {
+        digestOurs = CGovernanceSetDigest::WithLayoutOf(*pdigest);
+        for (const auto& vote : vecVotes) {
+            digestOurs.Insert(vote.GetHash());
+        }
+    }
 
-    for (const auto& vote : fileVotes.GetVotes()) {
+    for (const auto& vote : vecVotes) {
         uint256 nVoteHash = vote.GetHash();
 
+        if (pfilter && pfilter->contains(nVoteHash)) {
+            continue;
+        }
+        if (pdigest && !digestOurs.Differs(*pdigest, nVoteHash)) {
+            continue;
+        }
+
         bool onlyVotingKeyAllowed = govobj.GetObjectType() == GOVERNANCE_OBJECT_PROPOSAL && vote.GetSignal() == VOTE_SIGNAL_FUNDING;
 
-        if (filter.contains(nVoteHash) || !vote.IsValid(onlyVotingKeyAllowed)) {
+        if (!vote.IsValid(onlyVotingKeyAllowed)) {
             continue;
         }
         pnode->PushInventory(CInv(MSG_GOVERNANCE_OBJECT_VOTE, nVoteHash));
@@ -704,7 +852,7 @@ void CGovernanceManager::SyncSingleObjAndItsVotes(CNode* pnode, const uint256& n
     LogPrintf("CGovernanceManager::%s -- sent 1 object and %d votes to peer=%d\n", __func__, nVoteCount, pnode->id);
 }
 
-void CGovernanceManager::SyncAll(CNode* pnode, CConnman& connman) const
+void CGovernanceManager::SyncAll(CNode* pnode, CConnman& connman, const CGovernanceSetDigest* pdigest) const
 {
     // do not provide any data until our node is synced
     if (!masternodeSync.IsSynced()) return;
@@ -727,12 +875,25 @@ void CGovernanceManager::SyncAll(CNode* pnode, CConnman& connman) const
 
     LOCK2(cs_main, cs);
 
+    // our objects laid out like the peer's digest, objects in matching buckets are known to the peer
+    CGovernanceSetDigest digestOurs;
+    if (pdigest) {
+        digestOurs = CGovernanceSetDigest::WithLayoutOf(*pdigest);
+        for (const auto& objPair : mapObjects) {
+            digestOurs.Insert(objPair.first);
+        }
+    }
+
     // all valid objects, no votes
     for (const auto& objPair : mapObjects) {
         uint256 nHash = objPair.first;
         const CGovernanceObject& govobj = objPair.second;
         std::string strHash = nHash.ToString();
 
+        if (pdigest && !digestOurs.Differs(*pdigest, nHash)) {
+            continue;
+        }
+
         LogPrint("gobject", "CGovernanceManager::%s -- attempting to sync govobj: %s, peer=%d\n", __func__, strHash, pnode->id);
 
         if (govobj.IsSetCachedDelete() || govobj.IsSetExpired()) {
@@ -895,6 +1056,9 @@ bool CGovernanceManager::ProcessVote(CNode* pfrom, const CGovernanceVote& vote,
     }
 
     bool fOk = govobj.ProcessVote(pfrom, vote, exception, connman) && cmapVoteToObject.Insert(nHashVote, &govobj);
+    if (fOk) {
+        mapMasternodeVotedObjects[vote.GetMasternodeOutpoint()].insert(nHashGovobj);
+    }
     LEAVE_CRITICAL_SECTION(cs);
     return fOk;
 }
@@ -1020,6 +1184,16 @@ void CGovernanceManager::RequestGovernanceObject(CNode* pfrom, const uint256& nH
 
     CNetMsgMaker msgMaker(pfrom->GetSendVersion());
 
+    if (pfrom->nVersion >= GOVERNANCE_DIGEST_PROTO_VERSION) {
+        if (fUseFilter) {
+            RequestGovernanceDigests(pfrom, std::vector<uint256>(1, nHash), connman);
+        } else {
+            // an empty digest, the peer sends the object and all its votes
+            connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::MNGOVERNANCEDIGEST, std::vector<CGovernanceSetDigest>(1, CGovernanceSetDigest(nHash, 0))));
+        }
+        return;
+    }
+
     if (pfrom->nVersion < GOVERNANCE_FILTER_PROTO_VERSION) {
         connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::MNGOVERNANCESYNC, nHash));
         return;
@@ -1047,6 +1221,48 @@ void CGovernanceManager::RequestGovernanceObject(CNode* pfrom, const uint256& nH
     connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::MNGOVERNANCESYNC, nHash, filter));
 }
 
+void CGovernanceManager::RequestGovernanceDigests(CNode* pnode, const std::vector<uint256>& vecHashes, CConnman& connman)
+{
+    std::vector<CGovernanceSetDigest> vecDigests;
+    {
+        LOCK(cs);
+        for (const auto& nHash : vecHashes) {
+            if (nHash.IsNull()) {
+                CGovernanceSetDigest digest(nHash, mapObjects.size() + mapPostponedObjects.size());
+                for (const auto& objPair : mapObjects) {
+                    digest.Insert(objPair.first);
+                }
+                for (const auto& objPair : mapPostponedObjects) {
+                    digest.Insert(objPair.first);
+                }
+                vecDigests.push_back(digest);
+                continue;
+            }
+
+            CGovernanceObject* pObj = FindGovernanceObject(nHash);
+            if (!pObj) {
+                vecDigests.emplace_back(nHash, 0);
+                continue;
+            }
+            std::vector<CGovernanceVote> vecVotes = pObj->GetVoteFile().GetVotes();
+            CGovernanceSetDigest digest(nHash, vecVotes.size());
+            for (const auto& vote : vecVotes) {
+                digest.Insert(vote.GetHash());
+            }
+            vecDigests.push_back(digest);
+        }
+    }
+
+    LogPrint("gobject", "CGovernanceManager::%s -- requesting %d digests from peer=%d\n", __func__, vecDigests.size(), pnode->id);
+
+    CNetMsgMaker msgMaker(pnode->GetSendVersion());
+    for (size_t i = 0; i < vecDigests.size(); i += MAX_GOVERNANCE_DIGESTS_PER_MESSAGE) {
+        size_t nEnd = std::min(vecDigests.size(), i + MAX_GOVERNANCE_DIGESTS_PER_MESSAGE);
+        std::vector<CGovernanceSetDigest> vecChunk(vecDigests.begin() + i, vecDigests.begin() + nEnd);
+        connman.PushMessage(pnode, msgMaker.Make(NetMsgType::MNGOVERNANCEDIGEST, vecChunk));
+    }
+}
+
 int CGovernanceManager::RequestGovernanceObjectVotes(CNode* pnode, CConnman& connman)
 {
     if (pnode->nVersion < MIN_GOVERNANCE_PEER_PROTO_VERSION) return -3;
@@ -1113,6 +1329,9 @@ int CGovernanceManager::RequestGovernanceObjectVotes(const std::vector<CNode*>&
     std::random_shuffle(vTriggerObjHashes.begin(), vTriggerObjHashes.end(), insecure_rand);
     std::random_shuffle(vOtherObjHashes.begin(), vOtherObjHashes.end(), insecure_rand);
 
+    // peers supporting set digests get a single request for all objects picked for them
+    std::map<CNode*, std::vector<uint256> > mapDigestRequests;
+
     for (int i = 0; i < nMaxObjRequestsPerNode; ++i) {
         uint256 nHashGovobj;
 
@@ -1141,7 +1360,11 @@ int CGovernanceManager::RequestGovernanceObjectVotes(const std::vector<CNode*>&
                 if (mapAskedRecently[nHashGovobj].count(pnode->addr)) continue;
             }
 
-            RequestGovernanceObject(pnode, nHashGovobj, connman, true);
+            if (pnode->nVersion >= GOVERNANCE_DIGEST_PROTO_VERSION) {
+                mapDigestRequests[pnode].push_back(nHashGovobj);
+            } else {
+                RequestGovernanceObject(pnode, nHashGovobj, connman, true);
+            }
             mapAskedRecently[nHashGovobj][pnode->addr] = nNow + nTimeout;
             fAsked = true;
             // stop loop if max number of peers per obj was asked
@@ -1155,6 +1378,9 @@ int CGovernanceManager::RequestGovernanceObjectVotes(const std::vector<CNode*>&
         }
         if (!fAsked) i--;
     }
+    for (const auto& pair : mapDigestRequests) {
+        RequestGovernanceDigests(pair.first, pair.second, connman);
+    }
     LogPrint("gobject", "CGovernanceManager::RequestGovernanceObjectVotes -- end: vTriggerObjHashes %d vOtherObjHashes %d mapAskedRecently %d\n",
         vTriggerObjHashes.size(), vOtherObjHashes.size(), mapAskedRecently.size());
 
@@ -1190,12 +1416,17 @@ void CGovernanceManager::RebuildIndexes()
     LOCK(cs);
 
     cmapVoteToObject.Clear();
+    mapMasternodeVotedObjects.clear();
     for (auto& objPair : mapObjects) {
         CGovernanceObject& govobj = objPair.second;
         std::vector<CGovernanceVote> vecVotes = govobj.GetVoteFile().GetVotes();
         for (size_t i = 0; i < vecVotes.size(); ++i) {
             cmapVoteToObject.Insert(vecVotes[i].GetHash(), &govobj);
         }
+        LOCK(govobj.cs);
+        for (const auto& votepair : govobj.mapCurrentMNVotes) {
+            mapMasternodeVotedObjects[votepair.first].insert(objPair.first);
+        }
     }
 }
 
@@ -1381,17 +1612,33 @@ void CGovernanceManager::RemoveInvalidProposalVotes()
     }
 
     for (const auto& outpoint : changedKeyMNs) {
-        for (auto& p : mapObjects) {
-            auto removed = p.second.RemoveInvalidProposalVotes(outpoint);
-            if (removed.empty()) {
+        auto itVoted = mapMasternodeVotedObjects.find(outpoint);
+        if (itVoted == mapMasternodeVotedObjects.end()) {
+            continue;
+        }
+        hash_s_t& setObjects = itVoted->second;
+        for (auto itHash = setObjects.begin(); itHash != setObjects.end(); ) {
+            object_m_it itObj = mapObjects.find(*itHash);
+            if (itObj == mapObjects.end()) {
+                setObjects.erase(itHash++);
                 continue;
             }
+            auto removed = itObj->second.RemoveInvalidProposalVotes(outpoint);
             for (auto& voteHash : removed) {
                 cmapVoteToObject.Erase(voteHash);
                 cmapInvalidVotes.Erase(voteHash);
                 cmmapOrphanVotes.Erase(voteHash);
                 setRequestedVotes.erase(voteHash);
             }
+            vote_rec_t voteRecord;
+            if (!itObj->second.GetCurrentMNVotes(outpoint, voteRecord)) {
+                setObjects.erase(itHash++);
+            } else {
+                ++itHash;
+            }
+        }
+        if (setObjects.empty()) {
+            mapMasternodeVotedObjects.erase(itVoted);
         }
     }
 
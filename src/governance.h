@@ -9,10 +9,12 @@
 
 //#define ENABLE_BLAZE_DEBUG
 
+#include "batchverifier.h"
 #include "bloom.h"
 #include "cachemap.h"
 #include "cachemultimap.h"
 #include "chain.h"
+#include "governance-digest.h"
 #include "governance-exceptions.h"
 #include "governance-object.h"
 #include "governance-vote.h"
@@ -32,6 +34,12 @@ class CGovernanceVote;
 
 extern CGovernanceManager governance;
 
+static const int DEFAULT_GOVERNANCE_VERIFY_THREADS = 2;
+/** Verify queued network votes once this many are pending... */
+static const size_t GOVERNANCE_VOTE_BATCH_SIZE = 256;
+/** ...or once the oldest one has been waiting this long (in milliseconds) */
+static const int64_t GOVERNANCE_VOTE_BATCH_DELAY = 100;
+
 struct ExpirationInfo {
     ExpirationInfo(int64_t _nExpirationTime, int _idFrom) :
         nExpirationTime(_nExpirationTime), idFrom(_idFrom) {}
@@ -253,6 +261,9 @@ private:
 
     object_ref_cm_t cmapVoteToObject;
 
+    // objects each masternode has (or had) current votes on, may contain stale entries
+    std::map<COutPoint, hash_s_t> mapMasternodeVotedObjects;
+
     vote_cm_t cmapInvalidVotes;
 
     vote_cmm_t cmmapOrphanVotes;
@@ -268,6 +279,9 @@ private:
     // used to check for changed voting keys
     CDeterministicMNList lastMNListForVotingKeys;
 
+    // votes received from the network, waiting to be verified as a batch
+    CBatchVerifier<CGovernanceVote> voteVerifier;
+
     class ScopedLockBool
     {
         bool& ref;
@@ -294,7 +308,7 @@ public:
 
     CGovernanceManager();
 
-    virtual ~CGovernanceManager() {}
+    virtual ~CGovernanceManager();
 
     /**
      * This is called by AlreadyHave in net_processing.cpp as part of the inventory
@@ -304,12 +318,23 @@ public:
     bool ConfirmInventoryRequest(const CInv& inv);
 
     void SyncSingleObjAndItsVotes(CNode* pnode, const uint256& nProp, const CBloomFilter& filter, CConnman& connman);
-    void SyncAll(CNode* pnode, CConnman& connman) const;
+    void SyncSingleObjAndItsVotes(CNode* pnode, const CGovernanceSetDigest& digest, CConnman& connman);
+    void SyncAll(CNode* pnode, CConnman& connman, const CGovernanceSetDigest* pdigest = nullptr) const;
+
+    /// Ask pnode for the objects (null hash) or object votes it has and we are missing, using set digests
+    void RequestGovernanceDigests(CNode* pnode, const std::vector<uint256>& vecHashes, CConnman& connman);
 
     void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman);
 
     void DoMaintenance(CConnman& connman);
 
+    /// Start the threads verifying batches of network votes, 0 processes every vote on arrival
+    void StartVoteVerification(int nThreads);
+    /// Stop the verification threads and release the nodes of the votes still queued
+    void StopVoteVerification();
+    /// Verify and process the queued network votes if the batch is full or old enough
+    void ProcessPendingVotes(CConnman& connman, bool fForce = false);
+
     CGovernanceObject* FindGovernanceObject(const uint256& nHash);
 
     // These commands are only used in RPC
@@ -331,6 +356,7 @@ public:
         mapObjects.clear();
         mapErasedGovernanceObjects.clear();
         cmapVoteToObject.Clear();
+        mapMasternodeVotedObjects.clear();
         cmapInvalidVotes.Clear();
         cmmapOrphanVotes.Clear();
         mapLastMasternodeObject.clear();
@@ -427,6 +453,8 @@ public:
 private:
     void RequestGovernanceObject(CNode* pfrom, const uint256& nHash, CConnman& connman, bool fUseFilter = false);
 
+    void SyncSingleObjAndItsVotes(CNode* pnode, const uint256& nProp, const CBloomFilter* pfilter, const CGovernanceSetDigest* pdigest, CConnman& connman);
+
     void AddInvalidVote(const CGovernanceVote& vote)
     {
         cmapInvalidVotes.Insert(vote.GetHash(), vote);
@@ -439,6 +467,9 @@ private:
 
     bool ProcessVote(CNode* pfrom, const CGovernanceVote& vote, CGovernanceException& exception, CConnman& connman);
 
+    /// Process a vote received from pfrom, relay it and penalize the peer if it was invalid
+    void ProcessNetworkVote(CNode* pfrom, const CGovernanceVote& vote, CConnman& connman);
+
     /// Called to indicate a requested object has been received
     bool AcceptObjectMessage(const uint256& nHash);
 
@@ -113,6 +113,8 @@ public:
 
     uint256 GetSeedHash();
     void DeriveChildExtKey(uint32_t nAccountIndex, bool fInternal, uint32_t nChildIndex, CExtKey& extKeyRet);
+    /// Derive the parent of all keys of the external or internal chain of an account
+    void DeriveChainExtKey(uint32_t nAccountIndex, bool fInternal, CExtKey& extKeyRet);
 
     void AddAccount();
     bool GetAccount(uint32_t nAccountIndex, CHDAccount& hdAccountRet);
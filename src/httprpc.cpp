@@ -18,12 +18,32 @@
 #include <stdio.h>
 #include "utilstrencodings.h"
 
+#include <set>
+
 #include <boost/algorithm/string.hpp> // boost::trim
 #include <boost/foreach.hpp> //BOOST_FOREACH
 
 /** WWW-Authenticate to present with 401 Unauthorized response */
 static const char* WWW_AUTH_HEADER_DATA = "Basic realm=\"jsonrpc\"";
 
+/** Number of bytes at the start of a request body searched for the method name */
+static const size_t RPC_CLASSIFY_PEEK_SIZE = 512;
+
+/** Cheap RPC calls that are served by their own work queue, so that health
+ * checks keep being answered while expensive calls occupy the other workers.
+ */
+static const std::set<std::string> setLightRPCMethods = {
+    "getbestblockhash",
+    "getblockcount",
+    "getblockhash",
+    "getconnectioncount",
+    "getdifficulty",
+    "getmempoolinfo",
+    "getnetworkinfo",
+    "getrpcinfo",
+    "ping",
+};
+
 /** Simple one-shot callback timer to be used by the RPC mechanism to e.g.
  * re-lock the wallet.
  */
@@ -202,7 +222,7 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
             throw JSONRPCError(RPC_PARSE_ERROR, "Top-level object parse error");
 
         req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strReply);
+        req->WriteReply(HTTP_OK, std::move(strReply));
     } catch (const UniValue& objError) {
         JSONErrorReply(req, objError, jreq.id);
         return false;
@@ -213,6 +233,115 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
     return true;
 }
 
+static const char* JSON_WHITESPACE = " \t\r\n";
+
+/** Skip the JSON string starting at pos, returns the position after it or npos if it doesn't end */
+static size_t SkipJSONString(const std::string& str, size_t pos, bool& fEscapedRet)
+{
+    fEscapedRet = false;
+    for (size_t i = pos + 1; i < str.size(); i++) {
+        if (str[i] == '\\') {
+            fEscapedRet = true;
+            i++;
+        } else if (str[i] == '"') {
+            return i + 1;
+        }
+    }
+    return std::string::npos;
+}
+
+/** Skip the JSON value starting at pos, returns the position after it or npos if it doesn't end.
+ * Only strings and nesting are tracked, the worker still rejects anything malformed.
+ */
+static size_t SkipJSONValue(const std::string& str, size_t pos)
+{
+    bool fEscaped;
+    int nDepth = 0;
+    for (size_t i = pos; i < str.size(); i++) {
+        char c = str[i];
+        if (c == '"') {
+            i = SkipJSONString(str, i, fEscaped);
+            if (i == std::string::npos || nDepth == 0)
+                return i;
+            i--;
+        } else if (c == '{' || c == '[') {
+            nDepth++;
+        } else if (c == '}' || c == ']') {
+            if (nDepth == 0)
+                return i; // end of the object holding a number or literal
+            if (--nDepth == 0)
+                return i + 1;
+        } else if (nDepth == 0 && (c == ',' || c == ' ' || c == '\t' || c == '\r' || c == '\n')) {
+            return i;
+        }
+    }
+    return std::string::npos;
+}
+
+/** Find the method name of a single JSON-RPC request without parsing it into a UniValue.
+ * This runs on the HTTP event loop thread and is only used to pick a work queue,
+ * the request is fully parsed (and authorized) by the worker. Only the top-level
+ * "method" key counts, so that names within the params can't pass for it. Requests
+ * which don't fit into strBody, or which the parser could read differently (escapes,
+ * duplicate keys), are not classified.
+ */
+static bool PeekJSONRPCMethod(const std::string& strBody, std::string& strMethod)
+{
+    size_t pos = strBody.find_first_not_of(JSON_WHITESPACE);
+    if (pos == std::string::npos || strBody[pos] != '{')
+        return false; // batches and malformed requests
+    bool fFound = false;
+    bool fEscaped;
+    pos = strBody.find_first_not_of(JSON_WHITESPACE, pos + 1);
+    while (pos != std::string::npos && strBody[pos] == '"') {
+        size_t end = SkipJSONString(strBody, pos, fEscaped);
+        if (end == std::string::npos || fEscaped)
+            return false;
+        bool fMethod = strBody.compare(pos + 1, end - pos - 2, "method") == 0;
+        pos = strBody.find_first_not_of(JSON_WHITESPACE, end);
+        if (pos == std::string::npos || strBody[pos] != ':')
+            return false;
+        pos = strBody.find_first_not_of(JSON_WHITESPACE, pos + 1);
+        if (pos == std::string::npos)
+            return false;
+        if (fMethod) {
+            if (fFound || strBody[pos] != '"')
+                return false;
+            end = SkipJSONString(strBody, pos, fEscaped);
+            if (end == std::string::npos || fEscaped)
+                return false;
+            strMethod = strBody.substr(pos + 1, end - pos - 2);
+            fFound = true;
+        } else {
+            end = SkipJSONValue(strBody, pos);
+            if (end == std::string::npos)
+                return false;
+        }
+        pos = strBody.find_first_not_of(JSON_WHITESPACE, end);
+        if (pos == std::string::npos)
+            return false;
+        if (strBody[pos] == '}')
+            return fFound;
+        if (strBody[pos] != ',')
+            return false;
+        pos = strBody.find_first_not_of(JSON_WHITESPACE, pos + 1);
+    }
+    return false;
+}
+
+HTTPWorkClass ClassifyJSONRPCRequest(const std::string& strBody)
+{
+    std::string strMethod;
+    if (PeekJSONRPCMethod(strBody, strMethod) && setLightRPCMethods.count(strMethod))
+        return HTTP_WORK_RPC_LIGHT;
+    return HTTP_WORK_RPC_HEAVY;
+}
+
+static HTTPWorkClass HTTPReq_JSONRPC_Classify(HTTPRequest* req, const std::string &)
+{
+    return ClassifyJSONRPCRequest(req->PeekBody(RPC_CLASSIFY_PEEK_SIZE));
+}
+
 static bool InitRPCAuthentication()
 {
     if (GetArg("-rpcpassword", "") == "")
@@ -237,7 +366,7 @@ bool StartHTTPRPC()
     if (!InitRPCAuthentication())
         return false;
 
-    RegisterHTTPHandler("/", true, HTTPReq_JSONRPC);
+    RegisterHTTPHandler("/", true, HTTPReq_JSONRPC, HTTPReq_JSONRPC_Classify);
 
     assert(EventBase());
     httpRPCTimerInterface = new HTTPRPCTimerInterface(EventBase());
@@ -5,6 +5,8 @@
 #ifndef BITCOIN_HTTPRPC_H
 #define BITCOIN_HTTPRPC_H
 
+#include "httpserver.h"
+
 #include <string>
 #include <map>
 
@@ -22,6 +24,12 @@ void InterruptHTTPRPC();
  */
 void StopHTTPRPC();
 
+/** Work class of a JSON-RPC request body. Only single requests for a cheap
+ * method go to the light queue, anything that can't be classified from the
+ * start of the body is heavy.
+ */
+HTTPWorkClass ClassifyJSONRPCRequest(const std::string& strBody);
+
 /** Start HTTP REST subsystem.
  * Precondition; HTTP and RPC has been started.
  */
@@ -19,6 +19,8 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <signal.h>
+#include <algorithm>
+#include <deque>
 #include <future>
 
 #include <event2/event.h>
@@ -58,6 +60,9 @@ private:
     HTTPRequestHandler func;
 };
 
+/** Number of latency samples kept per work queue for the percentile statistics */
+static const size_t HTTP_LATENCY_SAMPLES = 1024;
+
 /** Simple work queue for distributing work over multiple threads.
  * Work items are simply callable objects.
  */
@@ -68,10 +73,17 @@ private:
     /** Mutex protects entire object */
     std::mutex cs;
     std::condition_variable cond;
-    std::deque<std::unique_ptr<WorkItem>> queue;
+    /** Queued work items together with the time (in microseconds) they were enqueued */
+    std::deque<std::pair<std::unique_ptr<WorkItem>, int64_t>> queue;
     bool running;
     size_t maxDepth;
     int numThreads;
+    /** Statistics */
+    uint64_t nProcessed;
+    uint64_t nRejected;
+    /** Ring buffer of the latest enqueue-to-completion latencies, in microseconds */
+    std::vector<int64_t> vLatency;
+    size_t nLatencyPos;
 
     /** RAII object to keep track of number of running worker threads */
     class ThreadCounter
@@ -94,7 +106,10 @@ private:
 public:
     WorkQueue(size_t _maxDepth) : running(true),
                                  maxDepth(_maxDepth),
-                                 numThreads(0)
+                                 numThreads(0),
+                                 nProcessed(0),
+                                 nRejected(0),
+                                 nLatencyPos(0)
     {
     }
     /** Precondition: worker threads have all stopped
@@ -108,9 +123,10 @@ public:
     {
         std::unique_lock<std::mutex> lock(cs);
         if (queue.size() >= maxDepth) {
+            nRejected++;
             return false;
         }
-        queue.emplace_back(std::unique_ptr<WorkItem>(item));
+        queue.emplace_back(std::unique_ptr<WorkItem>(item), GetTimeMicros());
         cond.notify_one();
         return true;
     }
@@ -120,16 +136,29 @@ public:
         ThreadCounter count(*this);
         while (true) {
             std::unique_ptr<WorkItem> i;
+            int64_t nTimeEnqueued;
             {
                 std::unique_lock<std::mutex> lock(cs);
                 while (running && queue.empty())
                     cond.wait(lock);
                 if (!running)
                     break;
-                i = std::move(queue.front());
+                i = std::move(queue.front().first);
+                nTimeEnqueued = queue.front().second;
                 queue.pop_front();
             }
             (*i)();
+            int64_t nLatency = GetTimeMicros() - nTimeEnqueued;
+            {
+                std::unique_lock<std::mutex> lock(cs);
+                nProcessed++;
+                if (vLatency.size() < HTTP_LATENCY_SAMPLES) {
+                    vLatency.push_back(nLatency);
+                } else {
+                    vLatency[nLatencyPos] = nLatency;
+                    nLatencyPos = (nLatencyPos + 1) % HTTP_LATENCY_SAMPLES;
+                }
+            }
         }
     }
     /** Interrupt and exit loops */
@@ -154,18 +183,44 @@ public:
         std::unique_lock<std::mutex> lock(cs);
         return queue.size();
     }
+
+    /** Fill in depth, counters and latency percentiles of this queue */
+    void GetStats(HTTPWorkQueueStats& stats)
+    {
+        std::vector<int64_t> vSorted;
+        {
+            std::unique_lock<std::mutex> lock(cs);
+            stats.nThreads = numThreads;
+            stats.nDepth = queue.size();
+            stats.nMaxDepth = maxDepth;
+            stats.nProcessed = nProcessed;
+            stats.nRejected = nRejected;
+            vSorted = vLatency;
+        }
+        std::sort(vSorted.begin(), vSorted.end());
+        auto percentile = [&vSorted](size_t p) -> int64_t {
+            if (vSorted.empty())
+                return 0;
+            return vSorted[std::min(vSorted.size() - 1, vSorted.size() * p / 100)];
+        };
+        stats.nLatencyP50 = percentile(50);
+        stats.nLatencyP90 = percentile(90);
+        stats.nLatencyP99 = percentile(99);
+        stats.nLatencyMax = vSorted.empty() ? 0 : vSorted.back();
+    }
 };
 
 struct HTTPPathHandler
 {
     HTTPPathHandler() {}
-    HTTPPathHandler(std::string _prefix, bool _exactMatch, HTTPRequestHandler _handler):
-        prefix(_prefix), exactMatch(_exactMatch), handler(_handler)
+    HTTPPathHandler(std::string _prefix, bool _exactMatch, HTTPRequestHandler _handler, HTTPWorkClassifier _classifier):
+        prefix(_prefix), exactMatch(_exactMatch), handler(_handler), classifier(_classifier)
     {
     }
     std::string prefix;
     bool exactMatch;
     HTTPRequestHandler handler;
+    HTTPWorkClassifier classifier;
 };
 
 /** HTTP module state */
@@ -176,8 +231,8 @@ static struct event_base* eventBase = 0;
 struct evhttp* eventHTTP = 0;
 //! List of subnets to allow RPC connections from
 static std::vector<CSubNet> rpc_allow_subnets;
-//! Work queue for handling longer requests off the event loop thread
-static WorkQueue<HTTPClosure>* workQueue = 0;
+//! Work queues for handling longer requests off the event loop thread, one per HTTPWorkClass
+static WorkQueue<HTTPClosure>* workQueues[HTTP_WORK_CLASS_MAX] = {};
 //! Handlers for (sub)paths
 std::vector<HTTPPathHandler> pathHandlers;
 //! Bound listening sockets
@@ -283,14 +338,16 @@ static void http_request_cb(struct evhttp_request* req, void* arg)
         }
     }
 
-    // Dispatch to worker thread
+    // Dispatch to the worker threads of the request's work class
     if (i != iend) {
+        HTTPWorkClass workClass = i->classifier ? i->classifier(hreq.get(), path) : HTTP_WORK_RPC_HEAVY;
+        WorkQueue<HTTPClosure>* workQueue = workQueues[workClass];
         std::unique_ptr<HTTPWorkItem> item(new HTTPWorkItem(std::move(hreq), path, i->handler));
         assert(workQueue);
         if (workQueue->Enqueue(item.get()))
             item.release(); /* if true, queue took ownership */
         else {
-            LogPrintf("WARNING: request rejected because http work queue depth exceeded, it can be increased with the -rpcworkqueue= setting\n");
+            LogPrintf("WARNING: request rejected because http %s work queue depth exceeded, it can be increased with the -rpcworkqueue= setting\n", HTTPWorkClassName(workClass));
             item->req->WriteReply(HTTP_INTERNAL, "Work queue depth exceeded");
         }
     } else {
@@ -356,12 +413,39 @@ static bool HTTPBindAddresses(struct evhttp* http)
 }
 
 /** Simple wrapper to set thread name and run work queue */
-static void HTTPWorkQueueRun(WorkQueue<HTTPClosure>* queue)
+static void HTTPWorkQueueRun(WorkQueue<HTTPClosure>* queue, HTTPWorkClass workClass)
 {
-    RenameThread("blaze-httpworker");
+    RenameThread(strprintf("blaze-http-%s", HTTPWorkClassName(workClass)).c_str());
     queue->Run();
 }
 
+const char* HTTPWorkClassName(HTTPWorkClass workClass)
+{
+    switch (workClass) {
+    case HTTP_WORK_REST:
+        return "rest";
+    case HTTP_WORK_RPC_LIGHT:
+        return "rpclight";
+    case HTTP_WORK_RPC_HEAVY:
+        return "rpc";
+    default:
+        return "unknown";
+    }
+}
+
+/** Number of worker threads configured for a work class */
+static int HTTPWorkClassThreads(HTTPWorkClass workClass)
+{
+    switch (workClass) {
+    case HTTP_WORK_REST:
+        return std::max((long)GetArg("-restthreads", DEFAULT_HTTP_REST_THREADS), 1L);
+    case HTTP_WORK_RPC_LIGHT:
+        return std::max((long)GetArg("-rpclightthreads", DEFAULT_HTTP_LIGHT_THREADS), 1L);
+    default:
+        return std::max((long)GetArg("-rpcthreads", DEFAULT_HTTP_THREADS), 1L);
+    }
+}
+
 /** libevent event log callback */
 static void libevent_log_cb(int severity, const char *msg)
 {
@@ -434,9 +518,10 @@ bool InitHTTPServer()
 
     LogPrint("http", "Initialized HTTP server\n");
     int workQueueDepth = std::max((long)GetArg("-rpcworkqueue", DEFAULT_HTTP_WORKQUEUE), 1L);
-    LogPrintf("HTTP: creating work queue of depth %d\n", workQueueDepth);
+    LogPrintf("HTTP: creating work queues of depth %d\n", workQueueDepth);
 
-    workQueue = new WorkQueue<HTTPClosure>(workQueueDepth);
+    for (int i = 0; i < HTTP_WORK_CLASS_MAX; i++)
+        workQueues[i] = new WorkQueue<HTTPClosure>(workQueueDepth);
     eventBase = base;
     eventHTTP = http;
     return true;
@@ -448,15 +533,18 @@ std::future<bool> threadResult;
 bool StartHTTPServer()
 {
     LogPrint("http", "Starting HTTP server\n");
-    int rpcThreads = std::max((long)GetArg("-rpcthreads", DEFAULT_HTTP_THREADS), 1L);
-    LogPrintf("HTTP: starting %d worker threads\n", rpcThreads);
     std::packaged_task<bool(event_base*, evhttp*)> task(ThreadHTTP);
     threadResult = task.get_future();
     threadHTTP = std::thread(std::move(task), eventBase, eventHTTP);
 
-    for (int i = 0; i < rpcThreads; i++) {
-        std::thread rpc_worker(HTTPWorkQueueRun, workQueue);
-        rpc_worker.detach();
+    for (int i = 0; i < HTTP_WORK_CLASS_MAX; i++) {
+        HTTPWorkClass workClass = (HTTPWorkClass)i;
+        int nThreads = HTTPWorkClassThreads(workClass);
+        LogPrintf("HTTP: starting %d %s worker threads\n", nThreads, HTTPWorkClassName(workClass));
+        for (int j = 0; j < nThreads; j++) {
+            std::thread rpc_worker(HTTPWorkQueueRun, workQueues[i], workClass);
+            rpc_worker.detach();
+        }
     }
     return true;
 }
@@ -472,22 +560,27 @@ void InterruptHTTPServer()
         // Reject requests on current connections
         evhttp_set_gencb(eventHTTP, http_reject_request_cb, NULL);
     }
-    if (workQueue)
-        workQueue->Interrupt();
+    for (WorkQueue<HTTPClosure>* workQueue : workQueues) {
+        if (workQueue)
+            workQueue->Interrupt();
+    }
 }
 
 void StopHTTPServer()
 {
     LogPrint("http", "Stopping HTTP server\n");
-    if (workQueue) {
+    for (WorkQueue<HTTPClosure>*& workQueue : workQueues) {
+        if (!workQueue)
+            continue;
         LogPrint("http", "Waiting for HTTP worker threads to exit\n");
 #ifndef WIN32
         // ToDo: Disabling WaitExit() for Windows platforms is an ugly workaround for the wallet not
         // closing during a repair-restart. It doesn't hurt, though, because threadHTTP.timed_join
         // below takes care of this and sends a loopbreak.
         workQueue->WaitExit();
-#endif        
+#endif
         delete workQueue;
+        workQueue = 0;
     }
     if (eventBase) {
         LogPrint("http", "Waiting for HTTP event thread to exit\n");
@@ -519,6 +612,20 @@ struct event_base* EventBase()
     return eventBase;
 }
 
+std::vector<HTTPWorkQueueStats> GetHTTPWorkQueueStats()
+{
+    std::vector<HTTPWorkQueueStats> vStats;
+    for (int i = 0; i < HTTP_WORK_CLASS_MAX; i++) {
+        if (!workQueues[i])
+            continue;
+        HTTPWorkQueueStats stats;
+        stats.workClass = (HTTPWorkClass)i;
+        workQueues[i]->GetStats(stats);
+        vStats.push_back(stats);
+    }
+    return vStats;
+}
+
 static void httpevent_callback_fn(evutil_socket_t, short, void* data)
 {
     // Static handler: simply call inner handler
@@ -570,6 +677,18 @@ std::pair<bool, std::string> HTTPRequest::GetHeader(const std::string& hdr)
         return std::make_pair(false, "");
 }
 
+std::string HTTPRequest::PeekBody(size_t nMaxSize)
+{
+    struct evbuffer* buf = evhttp_request_get_input_buffer(req);
+    if (!buf)
+        return "";
+    size_t size = std::min(evbuffer_get_length(buf), nMaxSize);
+    std::string rv(size, '\0');
+    ev_ssize_t nCopied = evbuffer_copyout(buf, &rv[0], size);
+    rv.resize(nCopied < 0 ? 0 : nCopied);
+    return rv;
+}
+
 std::string HTTPRequest::ReadBody()
 {
     struct evbuffer* buf = evhttp_request_get_input_buffer(req);
@@ -609,6 +728,32 @@ void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
     struct evbuffer* evb = evhttp_request_get_output_buffer(req);
     assert(evb);
     evbuffer_add(evb, strReply.data(), strReply.size());
+    SendReply(nStatus);
+}
+
+static void http_reply_cleanup_cb(const void*, size_t, void* arg)
+{
+    delete static_cast<std::string*>(arg);
+}
+
+void HTTPRequest::WriteReply(int nStatus, std::string&& strReply)
+{
+    assert(!replySent && req);
+    struct evbuffer* evb = evhttp_request_get_output_buffer(req);
+    assert(evb);
+    if (!strReply.empty()) {
+        // libevent frees the body through the cleanup callback once it has been sent
+        std::string* body = new std::string(std::move(strReply));
+        if (evbuffer_add_reference(evb, body->data(), body->size(), http_reply_cleanup_cb, body) != 0) {
+            evbuffer_add(evb, body->data(), body->size());
+            delete body;
+        }
+    }
+    SendReply(nStatus);
+}
+
+void HTTPRequest::SendReply(int nStatus)
+{
     HTTPEvent* ev = new HTTPEvent(eventBase, true,
         std::bind(evhttp_send_reply, req, nStatus, (const char*)NULL, (struct evbuffer *)NULL));
     ev->trigger(0);
@@ -656,10 +801,10 @@ HTTPRequest::RequestMethod HTTPRequest::GetRequestMethod()
     }
 }
 
-void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler)
+void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler, const HTTPWorkClassifier &classifier)
 {
     LogPrint("http", "Registering HTTP handler for %s (exactmatch %d)\n", prefix, exactMatch);
-    pathHandlers.push_back(HTTPPathHandler(prefix, exactMatch, handler));
+    pathHandlers.push_back(HTTPPathHandler(prefix, exactMatch, handler, classifier));
 }
 
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch)
@@ -8,8 +8,11 @@
 #include <string>
 #include <stdint.h>
 #include <functional>
+#include <vector>
 
 static const int DEFAULT_HTTP_THREADS=4;
+static const int DEFAULT_HTTP_LIGHT_THREADS=2;
+static const int DEFAULT_HTTP_REST_THREADS=2;
 static const int DEFAULT_HTTP_WORKQUEUE=16;
 static const int DEFAULT_HTTP_SERVER_TIMEOUT=30;
 
@@ -32,13 +35,50 @@ void InterruptHTTPServer();
 /** Stop HTTP server */
 void StopHTTPServer();
 
+/** Work classes of HTTP requests.
+ * Every class is served by its own work queue and worker threads, so that
+ * slow requests of one class cannot starve the others.
+ */
+enum HTTPWorkClass {
+    HTTP_WORK_REST,
+    HTTP_WORK_RPC_LIGHT,
+    HTTP_WORK_RPC_HEAVY,
+    HTTP_WORK_CLASS_MAX
+};
+
+/** Work class name, used for thread names, logging and getrpcinfo */
+const char* HTTPWorkClassName(HTTPWorkClass workClass);
+
+/** Statistics of one work queue */
+struct HTTPWorkQueueStats
+{
+    HTTPWorkClass workClass;
+    int nThreads;
+    size_t nDepth;
+    size_t nMaxDepth;
+    uint64_t nProcessed;
+    uint64_t nRejected;
+    /** Enqueue-to-completion latencies of recent requests, in microseconds */
+    int64_t nLatencyP50;
+    int64_t nLatencyP90;
+    int64_t nLatencyP99;
+    int64_t nLatencyMax;
+};
+
+/** Return statistics of all work queues */
+std::vector<HTTPWorkQueueStats> GetHTTPWorkQueueStats();
+
 /** Handler for requests to a certain HTTP path */
 typedef std::function<bool(HTTPRequest* req, const std::string &)> HTTPRequestHandler;
+/** Picks the work class of a request. Runs on the event loop thread, so it
+ * must be cheap and must not consume the request body.
+ */
+typedef std::function<HTTPWorkClass(HTTPRequest* req, const std::string &)> HTTPWorkClassifier;
 /** Register handler for prefix.
  * If multiple handlers match a prefix, the first-registered one will
- * be invoked.
+ * be invoked. Requests without a classifier go to HTTP_WORK_RPC_HEAVY.
  */
-void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler);
+void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler, const HTTPWorkClassifier &classifier = HTTPWorkClassifier());
 /** Unregister handler for prefix */
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch);
 
@@ -94,6 +134,12 @@ public:
      */
     std::string ReadBody();
 
+    /**
+     * Return up to nMaxSize bytes from the start of the request body without
+     * consuming it.
+     */
+    std::string PeekBody(size_t nMaxSize);
+
     /**
      * Write output header.
      *
@@ -110,6 +156,15 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     void WriteReply(int nStatus, const std::string& strReply = "");
+    /**
+     * Write HTTP reply, handing the body over to the output evbuffer without
+     * copying it. Preferred for large replies.
+     */
+    void WriteReply(int nStatus, std::string&& strReply);
+
+private:
+    /** Queue sending of the reply that was written to the output buffer */
+    void SendReply(int nStatus);
 };
 
 /** Event handler closure.
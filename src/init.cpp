@@ -20,6 +20,7 @@
 #include "checkpoints.h"
 #include "compat/sanity.h"
 #include "consensus/validation.h"
+#include "crypto/sha256.h"
 #include "httpserver.h"
 #include "httprpc.h"
 #include "key.h"
@@ -95,6 +96,8 @@
 
 #if ENABLE_ZMQ
 #include "zmq/zmqnotificationinterface.h"
+#include "zmq/zmqpublishnotifier.h"
+#include "zmq/zmqrpc.h"
 #endif
 
 extern void ThreadSendAlert(CConnman& connman);
@@ -104,6 +107,7 @@ static const bool DEFAULT_PROXYRANDOMIZE = true;
 static const bool DEFAULT_REST_ENABLE = false;
 static const bool DEFAULT_DISABLE_SAFEMODE = false;
 static const bool DEFAULT_STOPAFTERBLOCKIMPORT = false;
+static const int64_t DEFAULT_CACHE_CHECKPOINT_INTERVAL = 0;
 
 
 std::unique_ptr<CConnman> g_connman;
@@ -221,6 +225,44 @@ void Interrupt(boost::thread_group& threadGroup)
     threadGroup.interrupt_all();
 }
 
+/** Store data caches into serialized dat files */
+static void DumpCaches()
+{
+    // a checkpoint may still be writing when the caches are dumped at shutdown
+    static CCriticalSection cs_dumpCaches;
+    LOCK(cs_dumpCaches);
+
+    CFlatDB<CMasternodeMan> flatdb1("mncache.dat", "magicMasternodeCache");
+    flatdb1.Dump(mnodeman);
+    CFlatDB<CMasternodePayments> flatdb2("mnpayments.dat", "magicMasternodePaymentsCache");
+    flatdb2.Dump(mnpayments);
+    CFlatDB<CGovernanceManager> flatdb3("governance.dat", "magicGovernanceCache");
+    flatdb3.Dump(governance);
+    CFlatDB<CNetFulfilledRequestManager> flatdb4("netfulfilled.dat", "magicFulfilledCache");
+    flatdb4.Dump(netfulfilledman);
+    if(fEnableInstantSend)
+    {
+        CFlatDB<CInstantSend> flatdb5("instantsend.dat", "magicInstantSendCache");
+        flatdb5.Dump(instantsend);
+    }
+    CFlatDB<CSporkManager> flatdb6("sporks.dat", "magicSporkCache");
+    flatdb6.Dump(sporkManager);
+}
+
+/**
+ * Write the caches every nIntervalMinutes. Serializing the managers takes
+ * a while, this thread keeps it from delaying the maintenance tasks of the
+ * scheduler thread.
+ */
+static void ThreadCacheCheckpoint(int64_t nIntervalMinutes)
+{
+    RenameThread("blaze-cachechk");
+    while (true) {
+        MilliSleep(nIntervalMinutes * 60 * 1000);
+        DumpCaches();
+    }
+}
+
 /** Preparing steps before shutting down or restarting the wallet */
 void PrepareShutdown()
 {
@@ -255,28 +297,24 @@ void PrepareShutdown()
     if (pwalletMain)
         pwalletMain->Flush(false);
 #endif
+    // Votes and messages still queued need their nodes, finish or release them
+    // while the connection manager is alive
+    instantsend.StopVoteProcessing();
+    governance.StopVoteVerification();
+    mnodeman.StopVerification();
     MapPort(false);
     UnregisterValidationInterface(peerLogic.get());
     peerLogic.reset();
     g_connman.reset();
 
+    privateSendServer.Stop();
+
+    // The scheduler thread is gone by now, deliver whatever is still queued
+    // for background listeners before they are torn down
+    GetMainSignals().FlushBackgroundCallbacks();
+
     if (!fLiteMode && !fRPCInWarmup) {
-        // STORE DATA CACHES INTO SERIALIZED DAT FILES
-        CFlatDB<CMasternodeMan> flatdb1("mncache.dat", "magicMasternodeCache");
-        flatdb1.Dump(mnodeman);
-        CFlatDB<CMasternodePayments> flatdb2("mnpayments.dat", "magicMasternodePaymentsCache");
-        flatdb2.Dump(mnpayments);
-        CFlatDB<CGovernanceManager> flatdb3("governance.dat", "magicGovernanceCache");
-        flatdb3.Dump(governance);
-        CFlatDB<CNetFulfilledRequestManager> flatdb4("netfulfilled.dat", "magicFulfilledCache");
-        flatdb4.Dump(netfulfilledman);
-        if(fEnableInstantSend)
-        {
-            CFlatDB<CInstantSend> flatdb5("instantsend.dat", "magicInstantSendCache");
-            flatdb5.Dump(instantsend);
-        }
-        CFlatDB<CSporkManager> flatdb6("sporks.dat", "magicSporkCache");
-        flatdb6.Dump(sporkManager);
+        DumpCaches();
     }
 
     UnregisterNodeSignals(GetNodeSignals());
@@ -347,6 +385,7 @@ void PrepareShutdown()
     }
 #endif
     UnregisterAllValidationInterfaces();
+    GetMainSignals().UnregisterBackgroundSignalScheduler();
 }
 
 /**
@@ -530,6 +569,11 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-zmqpubrawtx=<address>", _("Enable publish raw transaction in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawtxlock=<address>", _("Enable publish raw transaction (locked via InstantSend) in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawinstantsenddoublespend=<address>", _("Enable publish raw transactions of attempted InstantSend double spend in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubhwm=<n>", strprintf(_("Set the outbound message high water mark of the publish sockets (default: %d)"), DEFAULT_ZMQ_SNDHWM));
+    if (showDebug) {
+        strUsage += HelpMessageOpt("-zmqpubqueuesize=<n>", strprintf("Maximum number of messages waiting for the zmq publisher thread before new ones are dropped (default: %d)", DEFAULT_ZMQ_PUBLISH_QUEUE_SIZE));
+        strUsage += HelpMessageOpt("-zmqpubqueuemaxmem=<n>", strprintf("Maximum size in megabytes of the messages waiting for the zmq publisher thread (default: %d)", DEFAULT_ZMQ_PUBLISH_QUEUE_MAXMEM));
+    }
 #endif
 
     strUsage += HelpMessageGroup(_("Debugging/Testing options:"));
@@ -586,6 +630,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-shrinkdebugfile", _("Shrink debug.log file on client startup (default: 1 when no -debug)"));
     AppendParamsHelpMessages(strUsage, showDebug);
     strUsage += HelpMessageOpt("-litemode=<n>", strprintf(_("Disable all Blaze specific functionality (Masternodes, PrivateSend, InstantSend, Governance) (0-1, default: %u)"), 0));
+    strUsage += HelpMessageOpt("-cachecheckpointinterval=<n>", strprintf(_("Write masternode, governance and other caches to disk every <n> minutes, not only at shutdown (0 to disable, default: %u)"), DEFAULT_CACHE_CHECKPOINT_INTERVAL));
     strUsage += HelpMessageOpt("-sporkaddr=<hex>", strprintf(_("Override spork address. Only useful for regtest and devnet. Using this on mainnet or testnet will ban you.")));
     strUsage += HelpMessageOpt("-minsporkkeys=<n>", strprintf(_("Overrides minimum spork signers to change spork value. Only useful for regtest and devnet. Using this on mainnet or testnet will ban you.")));
 
@@ -595,6 +640,9 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-mnconflock=<n>", strprintf(_("Lock masternodes from masternode configuration file (default: %u)"), 1));
     strUsage += HelpMessageOpt("-masternodeprivkey=<n>", _("Set the masternode private key"));
     strUsage += HelpMessageOpt("-masternodeblsprivkey=<hex>", _("Set the masternode BLS private key"));
+    strUsage += HelpMessageOpt("-govverifythreads=<n>", strprintf(_("Set the number of threads verifying batches of governance vote signatures, 0 = verify each vote on arrival (default: %d)"), DEFAULT_GOVERNANCE_VERIFY_THREADS));
+    strUsage += HelpMessageOpt("-mnverifythreads=<n>", strprintf(_("Set the number of threads verifying batches of masternode announcement and ping signatures, 0 = verify each message on arrival (default: %d)"), DEFAULT_MASTERNODE_VERIFY_THREADS));
+    strUsage += HelpMessageOpt("-privatesendverifythreads=<n>", strprintf(_("Set the number of threads verifying signatures of PrivateSend transactions mixed by this masternode, 0 = verify them in the message handler (default: %d)"), DEFAULT_PRIVATESEND_VERIFY_THREADS));
 
 #ifdef ENABLE_WALLET
     strUsage += HelpMessageGroup(_("PrivateSend options:"));
@@ -610,6 +658,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageGroup(_("InstantSend options:"));
     strUsage += HelpMessageOpt("-enableinstantsend=<n>", strprintf(_("Enable InstantSend, show confirmations for locked transactions (0-1, default: %u)"), 1));
     strUsage += HelpMessageOpt("-instantsendnotify=<cmd>", _("Execute command when a wallet InstantSend transaction is successfully locked (%s in cmd is replaced by TxID)"));
+    strUsage += HelpMessageOpt("-instantsendthreads=<n>", strprintf(_("Set the number of threads validating InstantSend lock votes, 0 = validate them in the message handler (default: %d)"), DEFAULT_INSTANTSEND_VOTE_THREADS));
 
 
     strUsage += HelpMessageGroup(_("Node relay options:"));
@@ -640,8 +689,11 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-rpcport=<port>", strprintf(_("Listen for JSON-RPC connections on <port> (default: %u or testnet: %u)"), BaseParams(CBaseChainParams::MAIN).RPCPort(), BaseParams(CBaseChainParams::TESTNET).RPCPort()));
     strUsage += HelpMessageOpt("-rpcallowip=<ip>", _("Allow JSON-RPC connections from specified source. Valid for <ip> are a single IP (e.g. 1.2.3.4), a network/netmask (e.g. 1.2.3.4/255.255.255.0) or a network/CIDR (e.g. 1.2.3.4/24). This option can be specified multiple times"));
     strUsage += HelpMessageOpt("-rpcthreads=<n>", strprintf(_("Set the number of threads to service RPC calls (default: %d)"), DEFAULT_HTTP_THREADS));
+    strUsage += HelpMessageOpt("-rpclightthreads=<n>", strprintf(_("Set the number of threads to service lightweight RPC calls such as getblockcount (default: %d)"), DEFAULT_HTTP_LIGHT_THREADS));
+    strUsage += HelpMessageOpt("-restthreads=<n>", strprintf(_("Set the number of threads to service REST requests (default: %d)"), DEFAULT_HTTP_REST_THREADS));
+    strUsage += HelpMessageOpt("-rpcbatchthreads=<n>", strprintf(_("Set the number of threads executing the entries of batched JSON-RPC requests concurrently, only use this if the entries of your batches do not depend on each other, 0 = execute them in order (default: %d)"), DEFAULT_RPC_BATCH_THREADS));
     if (showDebug) {
-        strUsage += HelpMessageOpt("-rpcworkqueue=<n>", strprintf("Set the depth of the work queue to service RPC calls (default: %d)", DEFAULT_HTTP_WORKQUEUE));
+        strUsage += HelpMessageOpt("-rpcworkqueue=<n>", strprintf("Set the depth of each work queue (REST, light RPC, RPC) to service RPC calls (default: %d)", DEFAULT_HTTP_WORKQUEUE));
         strUsage += HelpMessageOpt("-rpcservertimeout=<n>", strprintf("Timeout during HTTP requests (default: %d)", DEFAULT_HTTP_SERVER_TIMEOUT));
     }
 
@@ -1223,6 +1275,9 @@ bool AppInitParameterInteraction()
 #ifdef ENABLE_WALLET
     RegisterWalletRPCCommands(tableRPC);
 #endif
+#if ENABLE_ZMQ
+    RegisterZMQRPCCommands(tableRPC);
+#endif
 
     nConnectTimeout = GetArg("-timeout", DEFAULT_CONNECT_TIMEOUT);
     if (nConnectTimeout <= 0)
@@ -1389,6 +1444,8 @@ bool AppInitSanityChecks()
 {
     // ********************************************************* Step 4: sanity checks
 
+    LogPrintf("Using the '%s' SHA256 implementation\n", SHA256Implementation());
+
     // Initialize elliptic curve code
     ECC_Start();
     globalVerifyHandle.reset(new ECCVerifyHandle());
@@ -1467,6 +1524,8 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
     CScheduler::Function serviceLoop = boost::bind(&CScheduler::serviceQueue, &scheduler);
     threadGroup.create_thread(boost::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
 
+    GetMainSignals().RegisterBackgroundSignalScheduler(scheduler);
+
     /* Start the RPC server already.  It will be started in "warmup" mode
      * and not really process calls already (but it will signify connections
      * that the server is there and will be ready later).  Warmup mode will
@@ -1641,7 +1700,8 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
     pzmqNotificationInterface = CZMQNotificationInterface::Create();
 
     if (pzmqNotificationInterface) {
-        RegisterValidationInterface(pzmqNotificationInterface);
+        // ZMQ only publishes, so it does not need to run under cs_main
+        RegisterValidationInterface(pzmqNotificationInterface, true);
     }
 #endif
 
@@ -1873,6 +1933,10 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
     fFeeEstimatesInitialized = true;
 
     // ********************************************************* Step 8: load wallet
+
+    // the wallet buckets its outputs by denomination while loading
+    CPrivateSend::InitStandardDenominations();
+
 #ifdef ENABLE_WALLET
     if (!CWallet::InitLoadWallet())
         return false;
@@ -2022,8 +2086,6 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
     LogPrintf("PrivateSend amount: %d\n", privateSendClient.nPrivateSendAmount);
 #endif // ENABLE_WALLET
 
-    CPrivateSend::InitStandardDenominations();
-
     // ********************************************************* Step 11c: setup InstantSend
 
     fEnableInstantSend = GetBoolArg("-enableinstantsend", 1);
@@ -2086,15 +2148,25 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
         scheduler.scheduleEvery(boost::bind(&CNetFulfilledRequestManager::DoMaintenance, boost::ref(netfulfilledman)), 60);
         scheduler.scheduleEvery(boost::bind(&CMasternodeSync::DoMaintenance, boost::ref(masternodeSync), boost::ref(*g_connman)), 1);
         scheduler.scheduleEvery(boost::bind(&CMasternodeMan::DoMaintenance, boost::ref(mnodeman), boost::ref(*g_connman)), 1);
+        mnodeman.StartVerification(GetArg("-mnverifythreads", DEFAULT_MASTERNODE_VERIFY_THREADS));
         scheduler.scheduleEvery(boost::bind(&CActiveLegacyMasternodeManager::DoMaintenance, boost::ref(legacyActiveMasternodeManager), boost::ref(*g_connman)), MASTERNODE_MIN_MNP_SECONDS);
 
         scheduler.scheduleEvery(boost::bind(&CMasternodePayments::DoMaintenance, boost::ref(mnpayments)), 60);
         scheduler.scheduleEvery(boost::bind(&CGovernanceManager::DoMaintenance, boost::ref(governance), boost::ref(*g_connman)), 60 * 5);
+        governance.StartVoteVerification(GetArg("-govverifythreads", DEFAULT_GOVERNANCE_VERIFY_THREADS));
 
         scheduler.scheduleEvery(boost::bind(&CInstantSend::DoMaintenance, boost::ref(instantsend)), 60);
+        instantsend.StartVoteProcessing(GetArg("-instantsendthreads", DEFAULT_INSTANTSEND_VOTE_THREADS));
+
+        int64_t nCacheCheckpointInterval = GetArg("-cachecheckpointinterval", DEFAULT_CACHE_CHECKPOINT_INTERVAL);
+        if (nCacheCheckpointInterval > 0)
+            threadGroup.create_thread(boost::bind(&ThreadCacheCheckpoint, nCacheCheckpointInterval));
 
-        if (fMasternodeMode)
-            scheduler.scheduleEvery(boost::bind(&CPrivateSendServer::DoMaintenance, boost::ref(privateSendServer), boost::ref(*g_connman)), 1);
+        if (fMasternodeMode) {
+            // sessions move on their own timers, maintenance only expires old queues
+            privateSendServer.Start(scheduler, GetArg("-privatesendverifythreads", DEFAULT_PRIVATESEND_VERIFY_THREADS));
+            scheduler.scheduleEvery(boost::bind(&CPrivateSendServer::DoMaintenance, boost::ref(privateSendServer), boost::ref(*g_connman)), PRIVATESEND_QUEUE_TIMEOUT);
+        }
 #ifdef ENABLE_WALLET
         else
             scheduler.scheduleEvery(boost::bind(&CPrivateSendClientManager::DoMaintenance, boost::ref(privateSendClient), boost::ref(*g_connman)), 1);
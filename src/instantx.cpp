@@ -5,6 +5,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "activemasternode.h"
+#include "ctpl.h"
 #include "init.h"
 #include "instantx.h"
 #include "key.h"
@@ -44,6 +45,8 @@ const double CInstantSend::AUTO_IX_MEMPOOL_THRESHOLD = 0.1;
 CInstantSend instantsend;
 const std::string CInstantSend::SERIALIZATION_VERSION_STRING = "CInstantSend-Version-1";
 
+const std::vector<int64_t> CInstantSendLatencyStats::vecBucketBounds = {100, 250, 500, 1000, 2000, 5000, 10000, 15000};
+
 // Transaction Locks
 //
 // step 1) Some node announces intention to lock transaction inputs via "txlockrequest" message (ix)
@@ -51,10 +54,79 @@ const std::string CInstantSend::SERIALIZATION_VERSION_STRING = "CInstantSend-Ver
 // step 3) Once there are COutPointLock::SIGNATURES_REQUIRED valid "txlockvote" messages (txlvote) per each spent outpoint
 //         for a corresponding "txlockrequest" message (ix), all outpoints from that tx are treated as locked
 
+//
+// CInstantSendLatencyStats
+//
+
+void CInstantSendLatencyStats::Add(int64_t nMillis)
+{
+    size_t nBucket = std::lower_bound(vecBucketBounds.begin(), vecBucketBounds.end(), nMillis) - vecBucketBounds.begin();
+    vecCounts[nBucket]++;
+    nCount++;
+    nTotalMillis += nMillis;
+    nMaxMillis = std::max(nMaxMillis, nMillis);
+}
+
 //
 // CInstantSend
 //
 
+CInstantSend::CInstantSend() :
+    nCachedBlockHeight(0),
+    nVotesQueued(0),
+    nMaxVotesQueued(0)
+{
+}
+
+CInstantSend::~CInstantSend()
+{
+}
+
+void CInstantSend::StartVoteProcessing(int nThreads, size_t nMaxQueued)
+{
+    LOCK(cs_votePool);
+    assert(!votePool);
+    if (nThreads <= 0) {
+        return;
+    }
+    LogPrint("instantsend", "CInstantSend::%s -- Starting %d vote processing threads\n", __func__, nThreads);
+    nMaxVotesQueued = nMaxQueued;
+    votePool.reset(new ctpl::thread_pool(nThreads));
+    RenameThreadPool(*votePool, "blaze-isvote");
+}
+
+void CInstantSend::StopVoteProcessing()
+{
+    std::unique_ptr<ctpl::thread_pool> pool;
+    {
+        // new votes are processed by the message handler from now on
+        LOCK(cs_votePool);
+        pool.swap(votePool);
+    }
+    if (pool) {
+        pool->stop(true);
+    }
+}
+
+bool CInstantSend::QueueTxLockVote(CNode* pfrom, const CTxLockVote& vote, CConnman& connman)
+{
+    LOCK(cs_votePool);
+    if (!votePool) {
+        return false;
+    }
+    if (nVotesQueued >= nMaxVotesQueued) {
+        return false;
+    }
+    nVotesQueued++;
+    pfrom->AddRef();
+    votePool->push([this, pfrom, vote, &connman](int) {
+        ProcessNewTxLockVote(pfrom, vote, connman);
+        pfrom->Release();
+        nVotesQueued--;
+    });
+    return true;
+}
+
 void CInstantSend::ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman)
 {
     if (fLiteMode) return; // disable all Blaze specific functionality
@@ -90,7 +162,22 @@ void CInstantSend::ProcessMessage(CNode* pfrom, const std::string& strCommand, C
             if (!ret.second) return;
         }
 
-        ProcessNewTxLockVote(pfrom, vote, connman);
+        // Rank lookups and signature checks dominate vote processing, let the worker
+        // threads handle them concurrently instead of stalling the message handler
+        bool fThreaded;
+        {
+            LOCK(cs_votePool);
+            fThreaded = votePool != nullptr;
+        }
+        if (!fThreaded) {
+            ProcessNewTxLockVote(pfrom, vote, connman);
+        } else if (!QueueTxLockVote(pfrom, vote, connman)) {
+            // The workers are too far behind, drop the vote and forget we saw
+            // it so the copy another peer relays is processed instead
+            LogPrint("instantsend", "TXLOCKVOTE -- vote queue is full, dropping vote %s from peer=%d\n", nVoteHash.ToString(), pfrom->id);
+            LOCK(cs_instantsend);
+            mapTxLockVotes.erase(nVoteHash);
+        }
 
         return;
     }
@@ -167,6 +254,7 @@ bool CInstantSend::CreateTxLockCandidate(const CTxLockRequest& txLockRequest)
         LogPrintf("CInstantSend::CreateTxLockCandidate -- new, txid=%s\n", txHash.ToString());
 
         CTxLockCandidate txLockCandidate(txLockRequest);
+        txLockCandidate.nTimeRequestReceived = GetTimeMillis();
         // all inputs should already be checked by txLockRequest.IsValid() above, just use them now
         for (const auto& txin : txLockRequest.tx->vin) {
             txLockCandidate.AddOutPointLock(txin.prevout);
@@ -175,6 +263,7 @@ bool CInstantSend::CreateTxLockCandidate(const CTxLockRequest& txLockRequest)
     } else if (!itLockCandidate->second.txLockRequest) {
         // i.e. empty Transaction Lock Candidate was created earlier, let's update it with actual data
         itLockCandidate->second.txLockRequest = txLockRequest;
+        itLockCandidate->second.nTimeRequestReceived = GetTimeMillis();
         if (itLockCandidate->second.IsTimedOut()) {
             LogPrintf("CInstantSend::CreateTxLockCandidate -- timed out, txid=%s\n", txHash.ToString());
             return false;
@@ -513,6 +602,9 @@ void CInstantSend::TryToFinalizeLockCandidate(const CTxLockCandidate& txLockCand
         LogPrint("instantsend", "CInstantSend::TryToFinalizeLockCandidate -- Transaction Lock is ready to complete, txid=%s\n", txHash.ToString());
         if (ResolveConflicts(txLockCandidate)) {
             LockTransactionInputs(txLockCandidate);
+            if (txLockCandidate.nTimeRequestReceived > 0 && IsLockedInstantSendTransaction(txHash)) {
+                lockLatencyStats.Add(GetTimeMillis() - txLockCandidate.nTimeRequestReceived);
+            }
             UpdateLockedTransaction(txLockCandidate);
         }
     }
@@ -929,6 +1021,12 @@ std::string CInstantSend::ToString() const
     return strprintf("Lock Candidates: %llu, Votes %llu", mapTxLockCandidates.size(), mapTxLockVotes.size());
 }
 
+CInstantSendLatencyStats CInstantSend::GetLockLatencyStats() const
+{
+    LOCK(cs_instantsend);
+    return lockLatencyStats;
+}
+
 void CInstantSend::DoMaintenance()
 {
     if (ShutdownRequested()) return;
@@ -18,6 +18,10 @@ class CTxLockRequest;
 class CTxLockCandidate;
 class CInstantSend;
 
+namespace ctpl {
+class thread_pool;
+}
+
 extern CInstantSend instantsend;
 
 /*
@@ -39,9 +43,38 @@ static const int INSTANTSEND_LOCK_TIMEOUT_SECONDS   = 15;
 /// must be greater than INSTANTSEND_LOCK_TIMEOUT_SECONDS
 static const int INSTANTSEND_FAILED_TIMEOUT_SECONDS = 60;
 
+static const int DEFAULT_INSTANTSEND_VOTE_THREADS    = 2;
+/// Votes waiting for the vote processing threads, newer ones are dropped beyond that
+static const size_t MAX_INSTANTSEND_VOTE_QUEUE      = 10000;
+
 extern bool fEnableInstantSend;
 extern int nCompleteTXLocks;
 
+/**
+ * Distribution of the time between receiving a transaction lock request
+ * and completing the lock of all its inputs.
+ */
+class CInstantSendLatencyStats
+{
+public:
+    /// Upper bounds of the histogram buckets in milliseconds, the last bucket is unbounded
+    static const std::vector<int64_t> vecBucketBounds;
+
+    std::vector<uint64_t> vecCounts;
+    uint64_t nCount;
+    int64_t nTotalMillis;
+    int64_t nMaxMillis;
+
+    CInstantSendLatencyStats() :
+        vecCounts(vecBucketBounds.size() + 1, 0),
+        nCount(0),
+        nTotalMillis(0),
+        nMaxMillis(0)
+        {}
+
+    void Add(int64_t nMillis);
+};
+
 /**
  * Manages InstantSend. Processes lock requests, candidates, and votes.
  */
@@ -70,6 +103,15 @@ private:
     /// Track masternodes who voted with no txlockrequest (for DOS protection)
     std::map<COutPoint, int64_t> mapMasternodeOrphanVotes; ///< MN outpoint - Time
 
+    CInstantSendLatencyStats lockLatencyStats;
+
+    /// Worker threads validating and processing votes received from the network
+    CCriticalSection cs_votePool;
+    std::unique_ptr<ctpl::thread_pool> votePool;
+    /// Votes handed to votePool which aren't processed yet, each holds a reference to its node
+    std::atomic<size_t> nVotesQueued;
+    size_t nMaxVotesQueued;
+
     bool CreateTxLockCandidate(const CTxLockRequest& txLockRequest);
     void CreateEmptyTxLockCandidate(const uint256& txHash);
     void Vote(CTxLockCandidate& txLockCandidate, CConnman& connman);
@@ -95,6 +137,8 @@ public:
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action) {
+        LOCK(cs_instantsend);
+
         std::string strVersion;
         if(ser_action.ForRead()) {
             READWRITE(strVersion);
@@ -119,8 +163,19 @@ public:
         }
     }
 
+    CInstantSend();
+    ~CInstantSend();
+
     void Clear();
 
+    /// Start the threads processing network votes, 0 processes them in the message handler
+    void StartVoteProcessing(int nThreads, size_t nMaxQueued = MAX_INSTANTSEND_VOTE_QUEUE);
+    /// Wait for the queued votes and stop the threads, must be called before nodes are deleted
+    void StopVoteProcessing();
+    /// Hand a vote to the processing threads, false if there are none or their queue is full
+    bool QueueTxLockVote(CNode* pfrom, const CTxLockVote& vote, CConnman& connman);
+    size_t GetQueuedVoteCount() const { return nVotesQueued; }
+
     void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman);
 
     bool ProcessTxLockRequest(const CTxLockRequest& txLockRequest, CConnman& connman);
@@ -154,6 +209,8 @@ public:
 
     std::string ToString() const;
 
+    CInstantSendLatencyStats GetLockLatencyStats() const;
+
     void DoMaintenance();
 
     /// checks if we can automatically lock "simple" transactions
@@ -358,18 +415,22 @@ private:
 public:
     CTxLockCandidate() :
         nConfirmedHeight(-1),
-        nTimeCreated(GetTime())
+        nTimeCreated(GetTime()),
+        nTimeRequestReceived(0)
     {}
 
     CTxLockCandidate(const CTxLockRequest& txLockRequestIn) :
         nConfirmedHeight(-1),
         nTimeCreated(GetTime()),
         txLockRequest(txLockRequestIn),
-        mapOutPointLocks()
+        mapOutPointLocks(),
+        nTimeRequestReceived(0)
         {}
 
     CTxLockRequest txLockRequest;
     std::map<COutPoint, COutPointLock> mapOutPointLocks;
+    /// Memory only, when the lock request was received (in milliseconds), 0 if unknown
+    int64_t nTimeRequestReceived;
 
     ADD_SERIALIZE_METHODS;
 
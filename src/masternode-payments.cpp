@@ -28,6 +28,8 @@ CCriticalSection cs_vecPayees;
 CCriticalSection cs_mapMasternodeBlocks;
 CCriticalSection cs_mapMasternodePaymentVotes;
 
+const std::string CMasternodePayments::SERIALIZATION_VERSION_STRING = "CMasternodePayments-Version-1";
+
 bool IsOldBudgetBlockValueValid(const CBlock& block, int nBlockHeight, CAmount blockReward, std::string& strErrorRet) {
     const Consensus::Params& consensusParams = Params().GetConsensus();
     bool isBlockRewardValueMet = (block.vtx[0]->GetValueOut() <= blockReward);
@@ -330,11 +332,122 @@ std::map<int, std::string> GetRequiredPaymentsStrings(int nStartHeight, int nEnd
     return mapPayments;
 }
 
+CMasternodePayments::CMasternodePayments() :
+    nStorageCoeff(1.25),
+    nMinBlocksToStore(6000),
+    nCachedBlockHeight(0),
+    vecBlockPayees(nMinBlocksToStore + MNPAYMENTS_FUTURE_BLOCKS + 1),
+    mapPaymentVoteIndex(),
+    nBlockCount(0)
+{
+}
+
 void CMasternodePayments::Clear()
 {
-    LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePaymentVotes);
-    mapMasternodeBlocks.clear();
-    mapMasternodePaymentVotes.clear();
+    LOCK(cs_mapMasternodeBlocks);
+    ClearPaymentVotes();
+}
+
+void CMasternodePayments::ClearPaymentVotes()
+{
+    AssertLockHeld(cs_mapMasternodeBlocks);
+    for (auto& blockPayees : vecBlockPayees) {
+        blockPayees.Reset(-1);
+    }
+    mapPaymentVoteIndex.clear();
+    nBlockCount = 0;
+}
+
+const CMasternodeBlockPayees* CMasternodePayments::GetBlockPayees(int nBlockHeight) const
+{
+    AssertLockHeld(cs_mapMasternodeBlocks);
+    if (nBlockHeight < 0) return nullptr;
+    const CMasternodeBlockPayees& blockPayees = vecBlockPayees[nBlockHeight % vecBlockPayees.size()];
+    return blockPayees.nBlockHeight == nBlockHeight ? &blockPayees : nullptr;
+}
+
+CMasternodeBlockPayees* CMasternodePayments::GetBlockPayees(int nBlockHeight)
+{
+    return const_cast<CMasternodeBlockPayees*>(static_cast<const CMasternodePayments*>(this)->GetBlockPayees(nBlockHeight));
+}
+
+CMasternodeBlockPayees* CMasternodePayments::GetOrCreateBlockPayees(int nBlockHeight)
+{
+    AssertLockHeld(cs_mapMasternodeBlocks);
+    if (nBlockHeight < 0) return nullptr;
+    CMasternodeBlockPayees& blockPayees = vecBlockPayees[nBlockHeight % vecBlockPayees.size()];
+    if (blockPayees.nBlockHeight == nBlockHeight) return &blockPayees;
+    // The slot is taken by a newer block, this one must be out of the storage window already
+    if (blockPayees.nBlockHeight > nBlockHeight) return nullptr;
+    ResetBlockPayees(blockPayees, nBlockHeight);
+    return &blockPayees;
+}
+
+void CMasternodePayments::ResetBlockPayees(CMasternodeBlockPayees& blockPayees, int nBlockHeight)
+{
+    AssertLockHeld(cs_mapMasternodeBlocks);
+    for (const auto& pair : blockPayees.vecVotes) {
+        mapPaymentVoteIndex.erase(pair.first);
+    }
+    if (blockPayees.HasPayees()) {
+        nBlockCount--;
+    }
+    blockPayees.Reset(nBlockHeight);
+}
+
+void CMasternodePayments::ResizeBlockPayees(int nStorageLimit)
+{
+    AssertLockHeld(cs_mapMasternodeBlocks);
+    // Every height from the oldest one stored up to the furthest future block gets its own slot
+    size_t nSize = nStorageLimit + MNPAYMENTS_FUTURE_BLOCKS + 1;
+    if (nSize <= vecBlockPayees.size()) return;
+
+    LogPrint("mnpayments", "CMasternodePayments::%s -- %d -> %d blocks\n", __func__, vecBlockPayees.size(), nSize);
+
+    std::vector<CMasternodeBlockPayees> vecBlockPayeesNew(nSize);
+    for (auto& blockPayees : vecBlockPayees) {
+        if (blockPayees.nBlockHeight < 0) continue;
+        CMasternodeBlockPayees& blockPayeesNew = vecBlockPayeesNew[blockPayees.nBlockHeight % nSize];
+        // Only stale blocks can collide here, keep the newest one
+        if (blockPayeesNew.nBlockHeight > blockPayees.nBlockHeight) {
+            ResetBlockPayees(blockPayees, -1);
+            continue;
+        }
+        ResetBlockPayees(blockPayeesNew, -1);
+        blockPayeesNew = std::move(blockPayees);
+    }
+    vecBlockPayees.swap(vecBlockPayeesNew);
+}
+
+bool CMasternodePayments::AddPaymentVote(const CMasternodePaymentVote& vote)
+{
+    AssertLockHeld(cs_mapMasternodeBlocks);
+
+    uint256 nVoteHash = vote.GetHash();
+    CMasternodeBlockPayees* pblockPayees;
+    size_t nPos;
+
+    const auto it = mapPaymentVoteIndex.find(nVoteHash);
+    if (it != mapPaymentVoteIndex.end()) {
+        pblockPayees = GetBlockPayees(it->second.first);
+        assert(pblockPayees);
+        nPos = it->second.second;
+        if (pblockPayees->vecVotes[nPos].second.IsVerified()) return false;
+    } else {
+        pblockPayees = GetOrCreateBlockPayees(vote.nBlockHeight);
+        if (!pblockPayees) return false;
+        nPos = pblockPayees->AddVote(nVoteHash, vote);
+        mapPaymentVoteIndex.emplace(nVoteHash, std::make_pair(vote.nBlockHeight, nPos));
+    }
+
+    if (vote.IsVerified()) {
+        if (!pblockPayees->HasPayees()) {
+            nBlockCount++;
+        }
+        pblockPayees->AddPayee(nPos, vote);
+    }
+
+    return true;
 }
 
 bool CMasternodePayments::UpdateLastVote(const CMasternodePaymentVote& vote)
@@ -462,27 +575,28 @@ void CMasternodePayments::ProcessMessage(CNode* pfrom, const std::string& strCom
         // Ignore any payments messages until masternode list is synced
         if(!masternodeSync.IsMasternodeListSynced()) return;
 
-        {
-            LOCK(cs_mapMasternodePaymentVotes);
+        // Check the range first, votes are only stored for blocks within the storage window
+        int nFirstBlock = nCachedBlockHeight - GetStorageLimit();
+        if(vote.nBlockHeight < nFirstBlock || vote.nBlockHeight > nCachedBlockHeight + MNPAYMENTS_FUTURE_BLOCKS) {
+            LogPrint("mnpayments", "MASTERNODEPAYMENTVOTE -- vote out of range: nFirstBlock=%d, nBlockHeight=%d, nHeight=%d\n", nFirstBlock, vote.nBlockHeight, nCachedBlockHeight);
+            return;
+        }
 
-            auto res = mapMasternodePaymentVotes.emplace(nHash, vote);
+        {
+            LOCK(cs_mapMasternodeBlocks);
 
             // Avoid processing same vote multiple times if it was already verified earlier
-            if(!res.second && res.first->second.IsVerified()) {
+            if(HasVerifiedPaymentVote(nHash)) {
                 LogPrint("mnpayments", "MASTERNODEPAYMENTVOTE -- hash=%s, nBlockHeight=%d/%d seen\n",
                             nHash.ToString(), vote.nBlockHeight, nCachedBlockHeight);
                 return;
             }
 
-            // Mark vote as non-verified when it's seen for the first time,
+            // Store vote as non-verified when it's seen for the first time,
             // AddOrUpdatePaymentVote() below should take care of it if vote is actually ok
-            res.first->second.MarkAsNotVerified();
-        }
-
-        int nFirstBlock = nCachedBlockHeight - GetStorageLimit();
-        if(vote.nBlockHeight < nFirstBlock || vote.nBlockHeight > nCachedBlockHeight+20) {
-            LogPrint("mnpayments", "MASTERNODEPAYMENTVOTE -- vote out of range: nFirstBlock=%d, nBlockHeight=%d, nHeight=%d\n", nFirstBlock, vote.nBlockHeight, nCachedBlockHeight);
-            return;
+            CMasternodePaymentVote voteSeen(vote);
+            voteSeen.MarkAsNotVerified();
+            AddPaymentVote(voteSeen);
         }
 
         std::string strError = "";
@@ -631,9 +745,9 @@ bool CMasternodePayments::GetBlockTxOuts(int nBlockHeight, CAmount blockReward,
         return true;
     } else {
         LOCK(cs_mapMasternodeBlocks);
-        auto it = mapMasternodeBlocks.find(nBlockHeight);
+        const CMasternodeBlockPayees* pblockPayees = GetBlockPayees(nBlockHeight);
         CScript payee;
-        if (it == mapMasternodeBlocks.end() || !it->second.GetBestPayee(payee)) {
+        if (!pblockPayees || !pblockPayees->GetBestPayee(payee)) {
             return false;
         }
         voutMasternodePaymentsRet.emplace_back(masternodeReward, payee);
@@ -681,63 +795,117 @@ bool CMasternodePayments::AddOrUpdatePaymentVote(const CMasternodePaymentVote& v
     uint256 blockHash = uint256();
     if(!GetBlockHash(blockHash, vote.nBlockHeight - 101)) return false;
 
-    uint256 nVoteHash = vote.GetHash();
+    if (!vote.IsVerified()) return false;
 
-    if(HasVerifiedPaymentVote(nVoteHash)) return false;
+    LOCK(cs_mapMasternodeBlocks);
 
-    LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePaymentVotes);
+    if (!AddPaymentVote(vote)) return false;
 
-    mapMasternodePaymentVotes[nVoteHash] = vote;
+    LogPrint("mnpayments", "CMasternodePayments::%s -- added, hash=%s\n", __func__, vote.GetHash().ToString());
 
-    auto it = mapMasternodeBlocks.emplace(vote.nBlockHeight, CMasternodeBlockPayees(vote.nBlockHeight)).first;
-    it->second.AddPayee(vote);
+    return true;
+}
 
-    LogPrint("mnpayments", "CMasternodePayments::%s -- added, hash=%s\n", __func__, nVoteHash.ToString());
+bool CMasternodePayments::HasVerifiedPaymentVote(const uint256& hashIn) const
+{
+    CMasternodePaymentVote vote;
+    return GetPaymentVote(hashIn, vote) && vote.IsVerified();
+}
+
+bool CMasternodePayments::HasPaymentVote(const uint256& hashIn) const
+{
+    LOCK(cs_mapMasternodeBlocks);
+    return mapPaymentVoteIndex.count(hashIn);
+}
 
+bool CMasternodePayments::GetPaymentVote(const uint256& hashIn, CMasternodePaymentVote& voteRet) const
+{
+    LOCK(cs_mapMasternodeBlocks);
+    const auto it = mapPaymentVoteIndex.find(hashIn);
+    if (it == mapPaymentVoteIndex.end()) return false;
+    const CMasternodeBlockPayees* pblockPayees = GetBlockPayees(it->second.first);
+    assert(pblockPayees);
+    voteRet = pblockPayees->vecVotes[it->second.second].second;
     return true;
 }
 
-bool CMasternodePayments::HasVerifiedPaymentVote(const uint256& hashIn) const
+bool CMasternodePayments::HasPaymentBlock(int nBlockHeight) const
 {
-    LOCK(cs_mapMasternodePaymentVotes);
-    const auto it = mapMasternodePaymentVotes.find(hashIn);
-    return it != mapMasternodePaymentVotes.end() && it->second.IsVerified();
+    LOCK(cs_mapMasternodeBlocks);
+    const CMasternodeBlockPayees* pblockPayees = GetBlockPayees(nBlockHeight);
+    return pblockPayees && pblockPayees->HasPayees();
+}
+
+bool CMasternodePayments::GetPaymentBlockVotes(int nBlockHeight, std::vector<CMasternodePaymentVote>& vecVotesRet) const
+{
+    LOCK(cs_mapMasternodeBlocks);
+    const CMasternodeBlockPayees* pblockPayees = GetBlockPayees(nBlockHeight);
+    if (!pblockPayees || !pblockPayees->HasPayees()) return false;
+    for (const auto& pair : pblockPayees->vecVotes) {
+        if (pair.second.IsVerified()) {
+            vecVotesRet.push_back(pair.second);
+        }
+    }
+    return true;
+}
+
+bool CMasternodePayments::HasPayeeWithVotes(int nBlockHeight, const CScript& payeeIn, int nVotesReq) const
+{
+    LOCK(cs_mapMasternodeBlocks);
+    const CMasternodeBlockPayees* pblockPayees = GetBlockPayees(nBlockHeight);
+    return pblockPayees && pblockPayees->HasPayeeWithVotes(payeeIn, nVotesReq);
 }
 
-void CMasternodeBlockPayees::AddPayee(const CMasternodePaymentVote& vote)
+void CMasternodeBlockPayees::Reset(int nBlockHeightIn)
 {
     LOCK(cs_vecPayees);
+    nBlockHeight = nBlockHeightIn;
+    vecPayees.clear();
+    vecVotes.clear();
+    nBestPayee = -1;
+}
 
-    uint256 nVoteHash = vote.GetHash();
+size_t CMasternodeBlockPayees::AddVote(const uint256& nVoteHash, const CMasternodePaymentVote& vote)
+{
+    LOCK(cs_vecPayees);
+    vecVotes.emplace_back(nVoteHash, vote);
+    return vecVotes.size() - 1;
+}
 
-    for (auto& payee : vecPayees) {
-        if (payee.GetPayee() == vote.payee) {
-            payee.AddVoteHash(nVoteHash);
-            return;
-        }
+void CMasternodeBlockPayees::AddPayee(size_t nPos, const CMasternodePaymentVote& vote)
+{
+    LOCK(cs_vecPayees);
+
+    vecVotes[nPos].second = vote;
+
+    int nPayee = 0;
+    while (nPayee < (int)vecPayees.size() && vecPayees[nPayee].GetPayee() != vote.payee) {
+        nPayee++;
+    }
+    if (nPayee == (int)vecPayees.size()) {
+        vecPayees.emplace_back(vote.payee);
+    }
+    vecPayees[nPayee].AddVote();
+
+    // Keep the first payee with the most votes
+    if (nBestPayee < 0 ||
+        vecPayees[nPayee].GetVoteCount() > vecPayees[nBestPayee].GetVoteCount() ||
+        (vecPayees[nPayee].GetVoteCount() == vecPayees[nBestPayee].GetVoteCount() && nPayee < nBestPayee)) {
+        nBestPayee = nPayee;
     }
-    CMasternodePayee payeeNew(vote.payee, nVoteHash);
-    vecPayees.push_back(payeeNew);
 }
 
 bool CMasternodeBlockPayees::GetBestPayee(CScript& payeeRet) const
 {
     LOCK(cs_vecPayees);
 
-    if(vecPayees.empty()) {
+    if(nBestPayee < 0) {
         LogPrint("mnpayments", "CMasternodeBlockPayees::%s -- ERROR: couldn't find any payee\n", __func__);
         return false;
     }
 
-    int nVotes = -1;
-    for (const auto& payee : vecPayees) {
-        if (payee.GetVoteCount() > nVotes) {
-            payeeRet = payee.GetPayee();
-            nVotes = payee.GetVoteCount();
-        }
-    }
-
-    return (nVotes > -1);
+    payeeRet = vecPayees[nBestPayee].GetPayee();
+    return true;
 }
 
 bool CMasternodeBlockPayees::HasPayeeWithVotes(const CScript& payeeIn, int nVotesReq) const
@@ -758,19 +926,13 @@ bool CMasternodeBlockPayees::IsTransactionValid(const CTransaction& txNew) const
 {
     LOCK(cs_vecPayees);
 
-    int nMaxSignatures = 0;
+    int nMaxSignatures = nBestPayee < 0 ? 0 : vecPayees[nBestPayee].GetVoteCount();
     std::string strPayeesPossible = "";
 
     CAmount nMasternodePayment = GetMasternodePayment(nBlockHeight, txNew.GetValueOut());
 
     //require at least MNPAYMENTS_SIGNATURES_REQUIRED signatures
 
-    for (const auto& payee : vecPayees) {
-        if (payee.GetVoteCount() >= nMaxSignatures) {
-            nMaxSignatures = payee.GetVoteCount();
-        }
-    }
-
     // if we don't have at least MNPAYMENTS_SIGNATURES_REQUIRED signatures on a payee, approve whichever is the longest chain
     if(nMaxSignatures < MNPAYMENTS_SIGNATURES_REQUIRED) return true;
 
@@ -826,8 +988,8 @@ std::string CMasternodeBlockPayees::GetRequiredPaymentsString() const
 std::string CMasternodePayments::GetRequiredPaymentsString(int nBlockHeight) const
 {
     LOCK(cs_mapMasternodeBlocks);
-    const auto it = mapMasternodeBlocks.find(nBlockHeight);
-    return it == mapMasternodeBlocks.end() ? "Unknown" : it->second.GetRequiredPaymentsString();
+    const CMasternodeBlockPayees* pblockPayees = GetBlockPayees(nBlockHeight);
+    return pblockPayees ? pblockPayees->GetRequiredPaymentsString() : "Unknown";
 }
 
 bool CMasternodePayments::IsTransactionValid(const CTransaction& txNew, int nBlockHeight, CAmount blockReward) const
@@ -858,8 +1020,8 @@ bool CMasternodePayments::IsTransactionValid(const CTransaction& txNew, int nBlo
         return true;
     } else {
         LOCK(cs_mapMasternodeBlocks);
-        const auto it = mapMasternodeBlocks.find(nBlockHeight);
-        return it == mapMasternodeBlocks.end() ? true : it->second.IsTransactionValid(txNew);
+        const CMasternodeBlockPayees* pblockPayees = GetBlockPayees(nBlockHeight);
+        return pblockPayees ? pblockPayees->IsTransactionValid(txNew) : true;
     }
 }
 
@@ -871,20 +1033,17 @@ void CMasternodePayments::CheckAndRemove()
 
     if(!masternodeSync.IsBlockchainSynced()) return;
 
-    LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePaymentVotes);
-
     int nLimit = GetStorageLimit();
 
-    std::map<uint256, CMasternodePaymentVote>::iterator it = mapMasternodePaymentVotes.begin();
-    while(it != mapMasternodePaymentVotes.end()) {
-        CMasternodePaymentVote vote = (*it).second;
+    LOCK(cs_mapMasternodeBlocks);
 
-        if(nCachedBlockHeight - vote.nBlockHeight > nLimit) {
-            LogPrint("mnpayments", "CMasternodePayments::%s -- Removing old Masternode payment: nBlockHeight=%d\n", __func__, vote.nBlockHeight);
-            mapMasternodePaymentVotes.erase(it++);
-            mapMasternodeBlocks.erase(vote.nBlockHeight);
-        } else {
-            ++it;
+    // Most old blocks are dropped when their slot is reused, this only catches the ones
+    // which are not overwritten yet, e.g. after a reorg or when the window shrinks
+    for (auto& blockPayees : vecBlockPayees) {
+        if(blockPayees.nBlockHeight >= 0 && nCachedBlockHeight - blockPayees.nBlockHeight > nLimit) {
+            LogPrint("mnpayments", "CMasternodePayments::%s -- Removing old Masternode payments: nBlockHeight=%d, votes=%d\n", __func__,
+                        blockPayees.nBlockHeight, blockPayees.vecVotes.size());
+            ResetBlockPayees(blockPayees, -1);
         }
     }
     LogPrintf("CMasternodePayments::%s -- %s\n", __func__, ToString());
@@ -1033,26 +1192,19 @@ void CMasternodePayments::CheckBlockVotes(int nBlockHeight)
 
     LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePaymentVotes);
 
+    const CMasternodeBlockPayees* pblockPayees = GetBlockPayees(nBlockHeight);
+
     int i{0};
     for (const auto& mn : mns) {
         CScript payee;
         bool found = false;
 
-        const auto it = mapMasternodeBlocks.find(nBlockHeight);
-        if (it != mapMasternodeBlocks.end()) {
-            for (const auto& p : it->second.vecPayees) {
-                for (const auto& voteHash : p.GetVoteHashes()) {
-                    const auto itVote = mapMasternodePaymentVotes.find(voteHash);
-                    if (itVote == mapMasternodePaymentVotes.end()) {
-                        debugStr += strprintf("    - could not find vote %s\n",
-                                              voteHash.ToString());
-                        continue;
-                    }
-                    if (itVote->second.masternodeOutpoint == mn.second.outpoint) {
-                        payee = itVote->second.payee;
-                        found = true;
-                        break;
-                    }
+        if (pblockPayees) {
+            for (const auto& pair : pblockPayees->vecVotes) {
+                if (pair.second.IsVerified() && pair.second.masternodeOutpoint == mn.second.outpoint) {
+                    payee = pair.second.payee;
+                    found = true;
+                    break;
                 }
             }
         }
@@ -1170,16 +1322,13 @@ void CMasternodePayments::Sync(CNode* pnode, CConnman& connman) const
 
     int nInvCount = 0;
 
-    for(int h = nCachedBlockHeight; h < nCachedBlockHeight + 20; h++) {
-        const auto it = mapMasternodeBlocks.find(h);
-        if(it != mapMasternodeBlocks.end()) {
-            for (const auto& payee : it->second.vecPayees) {
-                std::vector<uint256> vecVoteHashes = payee.GetVoteHashes();
-                for (const auto& hash : vecVoteHashes) {
-                    if(!HasVerifiedPaymentVote(hash)) continue;
-                    pnode->PushInventory(CInv(MSG_MASTERNODE_PAYMENT_VOTE, hash));
-                    nInvCount++;
-                }
+    for(int h = nCachedBlockHeight; h < nCachedBlockHeight + MNPAYMENTS_FUTURE_BLOCKS; h++) {
+        const CMasternodeBlockPayees* pblockPayees = GetBlockPayees(h);
+        if(pblockPayees) {
+            for (const auto& pair : pblockPayees->vecVotes) {
+                if(!pair.second.IsVerified()) continue;
+                pnode->PushInventory(CInv(MSG_MASTERNODE_PAYMENT_VOTE, pair.first));
+                nInvCount++;
             }
         }
     }
@@ -1203,8 +1352,8 @@ void CMasternodePayments::RequestLowDataPaymentBlocks(CNode* pnode, CConnman& co
     const CBlockIndex *pindex = chainActive.Tip();
 
     while(nCachedBlockHeight - pindex->nHeight < nLimit) {
-        const auto it = mapMasternodeBlocks.find(pindex->nHeight);
-        if(it == mapMasternodeBlocks.end()) {
+        const CMasternodeBlockPayees* pblockPayees = GetBlockPayees(pindex->nHeight);
+        if(!pblockPayees || !pblockPayees->HasPayees()) {
             // We have no idea about this block height, let's ask
             vToFetch.push_back(CInv(MSG_MASTERNODE_PAYMENT_BLOCK, pindex->GetBlockHash()));
             // We should not violate GETDATA rules
@@ -1219,11 +1368,12 @@ void CMasternodePayments::RequestLowDataPaymentBlocks(CNode* pnode, CConnman& co
         pindex = pindex->pprev;
     }
 
-    for (auto& mnBlockPayees : mapMasternodeBlocks) {
-        int nBlockHeight = mnBlockPayees.first;
+    for (const auto& mnBlockPayees : vecBlockPayees) {
+        if (!mnBlockPayees.HasPayees()) continue;
+        int nBlockHeight = mnBlockPayees.nBlockHeight;
         int nTotalVotes = 0;
         bool fFound = false;
-        for (const auto& payee : mnBlockPayees.second.vecPayees) {
+        for (const auto& payee : mnBlockPayees.vecPayees) {
             if(payee.GetVoteCount() >= MNPAYMENTS_SIGNATURES_REQUIRED) {
                 fFound = true;
                 break;
@@ -1239,7 +1389,7 @@ void CMasternodePayments::RequestLowDataPaymentBlocks(CNode* pnode, CConnman& co
         // DEBUG
         DBG (
             // Let's see why this failed
-            for (const auto& payee : mnBlockPayees.second.vecPayees) {
+            for (const auto& payee : mnBlockPayees.vecPayees) {
                 CTxDestination address1;
                 ExtractDestination(payee.GetPayee(), address1);
                 CBitcoinAddress address2(address1);
@@ -1272,8 +1422,8 @@ std::string CMasternodePayments::ToString() const
 {
     std::ostringstream info;
 
-    info << "Votes: " << (int)mapMasternodePaymentVotes.size() <<
-            ", Blocks: " << (int)mapMasternodeBlocks.size();
+    info << "Votes: " << GetVoteCount() <<
+            ", Blocks: " << GetBlockCount();
 
     return info.str();
 }
@@ -1290,6 +1440,15 @@ int CMasternodePayments::GetStorageLimit() const
     return std::max(int(mnodeman.size() * nStorageCoeff), nMinBlocksToStore);
 }
 
+void CMasternodePayments::UpdateStorageLimit()
+{
+    // mnodeman.cs is taken before cs_mapMasternodeBlocks
+    int nLimit = GetStorageLimit();
+
+    LOCK(cs_mapMasternodeBlocks);
+    ResizeBlockPayees(nLimit);
+}
+
 void CMasternodePayments::UpdatedBlockTip(const CBlockIndex *pindex, CConnman& connman)
 {
     if(!pindex) return;
@@ -1301,6 +1460,9 @@ void CMasternodePayments::UpdatedBlockTip(const CBlockIndex *pindex, CConnman& c
     nCachedBlockHeight = pindex->nHeight;
     LogPrint("mnpayments", "CMasternodePayments::%s -- nCachedBlockHeight=%d\n", __func__, nCachedBlockHeight);
 
+    // Also covers a list loaded from the cache without any payments to load
+    UpdateStorageLimit();
+
     int nFutureBlock = nCachedBlockHeight + 10;
 
     CheckBlockVotes(nFutureBlock - 1);
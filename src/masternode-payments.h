@@ -20,6 +20,8 @@ class CMasternodeBlockPayees;
 
 static const int MNPAYMENTS_SIGNATURES_REQUIRED         = 6;
 static const int MNPAYMENTS_SIGNATURES_TOTAL            = 10;
+//! how far ahead of the chain tip payment votes are accepted
+static const int MNPAYMENTS_FUTURE_BLOCKS               = 20;
 
 //! minimum peer version that can receive and send masternode payment messages,
 //  vote for masternode and be elected as a payment winner
@@ -30,6 +32,7 @@ static const int MIN_MASTERNODE_PAYMENT_PROTO_VERSION_2 = 70210;
 
 extern CCriticalSection cs_vecPayees;
 extern CCriticalSection cs_mapMasternodeBlocks;
+extern CCriticalSection cs_mapMasternodePaymentVotes;
 
 extern CMasternodePayments mnpayments;
 
@@ -39,73 +42,6 @@ bool IsBlockPayeeValid(const CTransaction& txNew, int nBlockHeight, CAmount bloc
 void FillBlockPayments(CMutableTransaction& txNew, int nBlockHeight, CAmount blockReward, std::vector<CTxOut>& voutMasternodePaymentsRet, std::vector<CTxOut>& voutSuperblockPaymentsRet);
 std::map<int, std::string> GetRequiredPaymentsStrings(int nStartHeight, int nEndHeight);
 
-class CMasternodePayee
-{
-private:
-    CScript scriptPubKey;
-    std::vector<uint256> vecVoteHashes;
-
-public:
-    CMasternodePayee() :
-        scriptPubKey(),
-        vecVoteHashes()
-        {}
-
-    CMasternodePayee(CScript payee, uint256 hashIn) :
-        scriptPubKey(payee),
-        vecVoteHashes()
-    {
-        vecVoteHashes.push_back(hashIn);
-    }
-
-    ADD_SERIALIZE_METHODS;
-
-    template <typename Stream, typename Operation>
-    inline void SerializationOp(Stream& s, Operation ser_action) {
-        READWRITE(*(CScriptBase*)(&scriptPubKey));
-        READWRITE(vecVoteHashes);
-    }
-
-    CScript GetPayee() const { return scriptPubKey; }
-
-    void AddVoteHash(uint256 hashIn) { vecVoteHashes.push_back(hashIn); }
-    std::vector<uint256> GetVoteHashes() const { return vecVoteHashes; }
-    int GetVoteCount() const { return vecVoteHashes.size(); }
-};
-
-// Keep track of votes for payees from masternodes
-class CMasternodeBlockPayees
-{
-public:
-    int nBlockHeight;
-    std::vector<CMasternodePayee> vecPayees;
-
-    CMasternodeBlockPayees() :
-        nBlockHeight(0),
-        vecPayees()
-        {}
-    CMasternodeBlockPayees(int nBlockHeightIn) :
-        nBlockHeight(nBlockHeightIn),
-        vecPayees()
-        {}
-
-    ADD_SERIALIZE_METHODS;
-
-    template <typename Stream, typename Operation>
-    inline void SerializationOp(Stream& s, Operation ser_action) {
-        READWRITE(nBlockHeight);
-        READWRITE(vecPayees);
-    }
-
-    void AddPayee(const CMasternodePaymentVote& vote);
-    bool GetBestPayee(CScript& payeeRet) const;
-    bool HasPayeeWithVotes(const CScript& payeeIn, int nVotesReq) const;
-
-    bool IsTransactionValid(const CTransaction& txNew) const;
-
-    std::string GetRequiredPaymentsString() const;
-};
-
 // vote for the winning payment
 class CMasternodePaymentVote
 {
@@ -157,6 +93,74 @@ public:
     std::string ToString() const;
 };
 
+class CMasternodePayee
+{
+private:
+    CScript scriptPubKey;
+    int nVotes;
+
+public:
+    CMasternodePayee() :
+        scriptPubKey(),
+        nVotes(0)
+        {}
+
+    CMasternodePayee(const CScript& payee) :
+        scriptPubKey(payee),
+        nVotes(0)
+        {}
+
+    const CScript& GetPayee() const { return scriptPubKey; }
+
+    void AddVote() { nVotes++; }
+    int GetVoteCount() const { return nVotes; }
+};
+
+// Keep track of votes for payees from masternodes, all votes for a single block height
+class CMasternodeBlockPayees
+{
+public:
+    int nBlockHeight;
+    // Verified votes tallied per payee
+    std::vector<CMasternodePayee> vecPayees;
+    // Every vote seen for this height (verified or not) along with its hash,
+    // positions are stable until the whole bucket is reset
+    std::vector<std::pair<uint256, CMasternodePaymentVote> > vecVotes;
+
+private:
+    // Index of the payee with the most votes in vecPayees, -1 if there are none
+    int nBestPayee;
+
+public:
+    CMasternodeBlockPayees() :
+        nBlockHeight(-1),
+        vecPayees(),
+        vecVotes(),
+        nBestPayee(-1)
+        {}
+    CMasternodeBlockPayees(int nBlockHeightIn) :
+        nBlockHeight(nBlockHeightIn),
+        vecPayees(),
+        vecVotes(),
+        nBestPayee(-1)
+        {}
+
+    void Reset(int nBlockHeightIn);
+
+    /// Store a vote which was not verified yet, returns its position
+    size_t AddVote(const uint256& nVoteHash, const CMasternodePaymentVote& vote);
+    /// Replace the vote at nPos by its verified version and count it for its payee
+    void AddPayee(size_t nPos, const CMasternodePaymentVote& vote);
+
+    bool HasPayees() const { return !vecPayees.empty(); }
+    bool GetBestPayee(CScript& payeeRet) const;
+    bool HasPayeeWithVotes(const CScript& payeeIn, int nVotesReq) const;
+
+    bool IsTransactionValid(const CTransaction& txNew) const;
+
+    std::string GetRequiredPaymentsString() const;
+};
+
 //
 // Masternode Payments Class
 // Keeps track of who should get paid for which blocks
@@ -164,7 +168,9 @@ public:
 
 class CMasternodePayments
 {
-private:
+protected:
+    static const std::string SERIALIZATION_VERSION_STRING;
+
     // masternode count times nStorageCoeff payments blocks should be stored ...
     const float nStorageCoeff;
     // ... but at least nMinBlocksToStore (payments blocks)
@@ -173,26 +179,80 @@ private:
     // Keep track of current block height
     int nCachedBlockHeight;
 
+    // Payment votes bucketed by block height in a ring covering the storage window.
+    // The slot of a height is reused, dropping all of its votes at once, as soon as
+    // a newer height maps to it, so pruning never has to look at individual votes.
+    std::vector<CMasternodeBlockPayees> vecBlockPayees;
+    // Block height and position in its bucket for every vote we know about
+    std::map<uint256, std::pair<int, size_t> > mapPaymentVoteIndex;
+    // Number of slots holding verified votes
+    int nBlockCount;
+
+    // all of the above are protected by cs_mapMasternodeBlocks
+
+    CMasternodeBlockPayees* GetBlockPayees(int nBlockHeight);
+    const CMasternodeBlockPayees* GetBlockPayees(int nBlockHeight) const;
+    CMasternodeBlockPayees* GetOrCreateBlockPayees(int nBlockHeight);
+    void ResetBlockPayees(CMasternodeBlockPayees& blockPayees, int nBlockHeight);
+    /// Grow the ring to hold the storage window of nStorageLimit blocks and the future blocks voted on
+    void ResizeBlockPayees(int nStorageLimit);
+    bool AddPaymentVote(const CMasternodePaymentVote& vote);
+    void ClearPaymentVotes();
+
 public:
-    std::map<uint256, CMasternodePaymentVote> mapMasternodePaymentVotes;
-    std::map<int, CMasternodeBlockPayees> mapMasternodeBlocks;
     std::map<COutPoint, int> mapMasternodesLastVote;
     std::map<COutPoint, int> mapMasternodesDidNotVote;
 
-    CMasternodePayments() : nStorageCoeff(1.25), nMinBlocksToStore(6000) {}
+    CMasternodePayments();
 
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action) {
-        READWRITE(mapMasternodePaymentVotes);
-        READWRITE(mapMasternodeBlocks);
+        // The masternode list is loaded first, the ring has to fit all of its payments
+        // before the votes go in. Its lock is taken before ours, so ask for the limit here.
+        int nStorageLimit = ser_action.ForRead() ? GetStorageLimit() : 0;
+
+        LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePaymentVotes);
+        std::string strVersion;
+        if(ser_action.ForRead()) {
+            READWRITE(strVersion);
+        }
+        else {
+            strVersion = SERIALIZATION_VERSION_STRING;
+            READWRITE(strVersion);
+        }
+
+        // Only the votes are stored, buckets and tallies are rebuilt from them
+        std::vector<CMasternodePaymentVote> vecVotes;
+        if(!ser_action.ForRead()) {
+            for (const auto& blockPayees : vecBlockPayees) {
+                for (const auto& pair : blockPayees.vecVotes) {
+                    vecVotes.push_back(pair.second);
+                }
+            }
+        }
+        READWRITE(vecVotes);
+        if(ser_action.ForRead()) {
+            ClearPaymentVotes();
+            ResizeBlockPayees(nStorageLimit);
+            if(strVersion == SERIALIZATION_VERSION_STRING) {
+                for (const auto& vote : vecVotes) {
+                    AddPaymentVote(vote);
+                }
+            }
+        }
     }
 
     void Clear();
 
     bool AddOrUpdatePaymentVote(const CMasternodePaymentVote& vote);
     bool HasVerifiedPaymentVote(const uint256& hashIn) const;
+    bool HasPaymentVote(const uint256& hashIn) const;
+    bool GetPaymentVote(const uint256& hashIn, CMasternodePaymentVote& voteRet) const;
+    bool HasPaymentBlock(int nBlockHeight) const;
+    bool GetPaymentBlockVotes(int nBlockHeight, std::vector<CMasternodePaymentVote>& vecVotesRet) const;
+    bool HasPayeeWithVotes(int nBlockHeight, const CScript& payeeIn, int nVotesReq) const;
     bool ProcessBlock(int nBlockHeight, CConnman& connman);
     void CheckBlockVotes(int nBlockHeight);
 
@@ -212,11 +272,13 @@ public:
     bool GetMasternodeTxOuts(int nBlockHeight, CAmount blockReward, std::vector<CTxOut>& voutMasternodePaymentsRet) const;
     std::string ToString() const;
 
-    int GetBlockCount() const { return mapMasternodeBlocks.size(); }
-    int GetVoteCount() const { return mapMasternodePaymentVotes.size(); }
+    int GetBlockCount() const { LOCK(cs_mapMasternodeBlocks); return nBlockCount; }
+    int GetVoteCount() const { LOCK(cs_mapMasternodeBlocks); return mapPaymentVoteIndex.size(); }
 
     bool IsEnoughData() const;
     int GetStorageLimit() const;
+    /// Make room for the payments of all masternodes, called when the list grows
+    void UpdateStorageLimit();
 
     void UpdatedBlockTip(const CBlockIndex *pindex, CConnman& connman);
 
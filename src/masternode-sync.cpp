@@ -32,6 +32,8 @@ void CMasternodeSync::Reset()
     nTimeAssetSyncStarted = GetTime();
     nTimeLastBumped = GetTime();
     nTimeLastFailure = 0;
+    nTimeSyncStarted = GetTime();
+    nTimeSyncFinished = 0;
 }
 
 void CMasternodeSync::BumpAssetLastTime(const std::string& strFuncName)
@@ -93,6 +95,7 @@ void CMasternodeSync::SwitchToNextAsset(CConnman& connman)
         case(MASTERNODE_SYNC_GOVERNANCE):
             LogPrintf("CMasternodeSync::SwitchToNextAsset -- Completed %s in %llds\n", GetAssetName(), GetTime() - nTimeAssetSyncStarted);
             nCurrentAsset = MASTERNODE_SYNC_FINISHED;
+            nTimeSyncFinished = GetTime();
             uiInterface.NotifyAdditionalDataSyncProgressChanged(1);
             //try to activate our masternode if possible
             legacyActiveMasternodeManager.ManageState(connman);
@@ -100,7 +103,7 @@ void CMasternodeSync::SwitchToNextAsset(CConnman& connman)
             connman.ForEachNode(CConnman::AllNodes, [](CNode* pnode) {
                 netfulfilledman.AddFulfilledRequest(pnode->addr, "full-sync");
             });
-            LogPrintf("CMasternodeSync::SwitchToNextAsset -- Sync has finished\n");
+            LogPrintf("CMasternodeSync::SwitchToNextAsset -- Sync has finished in %llds\n", GetSyncTime());
 
             break;
     }
@@ -428,7 +431,10 @@ void CMasternodeSync::SendGovernanceSyncRequest(CNode* pnode, CConnman& connman)
 {
     CNetMsgMaker msgMaker(pnode->GetSendVersion());
 
-    if(pnode->nVersion >= GOVERNANCE_FILTER_PROTO_VERSION) {
+    if(pnode->nVersion >= GOVERNANCE_DIGEST_PROTO_VERSION) {
+        governance.RequestGovernanceDigests(pnode, std::vector<uint256>(1, uint256()), connman);
+    }
+    else if(pnode->nVersion >= GOVERNANCE_FILTER_PROTO_VERSION) {
         CBloomFilter filter;
         filter.clear();
 
@@ -506,6 +512,7 @@ void CMasternodeSync::UpdatedBlockTip(const CBlockIndex *pindexNew, bool fInitia
         if (fLiteMode) {
             // nothing to do in lite mode, just finish the process immediately
             nCurrentAsset = MASTERNODE_SYNC_FINISHED;
+            nTimeSyncFinished = GetTime();
             return;
         }
         // Reached best header while being in initial mode.
@@ -44,6 +44,9 @@ private:
     int64_t nTimeLastBumped;
     // ... or failed
     int64_t nTimeLastFailure;
+    // Time when the whole sync started and finished
+    int64_t nTimeSyncStarted;
+    int64_t nTimeSyncFinished;
 
     void Fail();
 
@@ -63,6 +66,8 @@ public:
     int GetAttempt() { return nTriedPeerCount; }
     void BumpAssetLastTime(const std::string& strFuncName);
     int64_t GetAssetStartTime() { return nTimeAssetSyncStarted; }
+    /// Seconds the sync took, or has been running for if it's not finished yet
+    int64_t GetSyncTime() { return (IsSynced() ? nTimeSyncFinished : GetTime()) - nTimeSyncStarted; }
     std::string GetAssetName();
     std::string GetSyncStatus();
 
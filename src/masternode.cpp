@@ -6,6 +6,7 @@
 
 #include "activemasternode.h"
 #include "base58.h"
+#include "batchverifier.h"
 #include "clientversion.h"
 #include "init.h"
 #include "netbase.h"
@@ -24,6 +25,10 @@
 
 #include <string>
 
+/** Broadcasts and pings are relayed by every peer and requested again on each list sync */
+static const unsigned int MAX_MASTERNODE_SIGNATURE_CACHE_SIZE = 50000;
+static CSignatureCache mnSigCache(MAX_MASTERNODE_SIGNATURE_CACHE_SIZE);
+
 
 CMasternode::CMasternode() :
     masternode_info_t{ MASTERNODE_ENABLED, PROTOCOL_VERSION, GetAdjustedTime()}
@@ -348,11 +353,8 @@ void CMasternode::UpdateLastPaid(const CBlockIndex *pindex, int nMaxBlocksToScan
     CScript mnpayee = GetScriptForDestination(keyIDCollateralAddress);
     // LogPrint("mnpayments", "CMasternode::UpdateLastPaidBlock -- searching for block with payment to %s\n", outpoint.ToStringShort());
 
-    LOCK(cs_mapMasternodeBlocks);
-
     for (int i = 0; BlockReading && BlockReading->nHeight > nBlockLastPaid && i < nMaxBlocksToScanBack; i++) {
-        if(mnpayments.mapMasternodeBlocks.count(BlockReading->nHeight) &&
-            mnpayments.mapMasternodeBlocks[BlockReading->nHeight].HasPayeeWithVotes(mnpayee, 2))
+        if(mnpayments.HasPayeeWithVotes(BlockReading->nHeight, mnpayee, 2))
         {
             CBlock block;
             if(!ReadBlockFromDisk(block, BlockReading, Params().GetConsensus()))
@@ -689,7 +691,13 @@ bool CMasternodeBroadcast::CheckSignature(int& nDos) const
     std::string strError = "";
     nDos = 0;
 
-    if (sporkManager.IsSporkActive(SPORK_6_NEW_SIGS)) {
+    bool fNewSigs = sporkManager.IsSporkActive(SPORK_6_NEW_SIGS);
+    uint256 cacheEntry = CSignatureCache::GetEntry(GetSignatureHash(), vchSig, keyIDCollateralAddress, fNewSigs);
+    if (mnSigCache.Contains(cacheEntry)) {
+        return true;
+    }
+
+    if (fNewSigs) {
         uint256 hash = GetSignatureHash();
 
         if (!CHashSigner::VerifyHash(hash, keyIDCollateralAddress, vchSig, strError)) {
@@ -717,6 +725,7 @@ bool CMasternodeBroadcast::CheckSignature(int& nDos) const
         }
     }
 
+    mnSigCache.Add(cacheEntry);
     return true;
 }
 
@@ -809,7 +818,14 @@ bool CMasternodePing::CheckSignature(CKeyID& keyIDOperator, int &nDos) const
     std::string strError = "";
     nDos = 0;
 
-    if (sporkManager.IsSporkActive(SPORK_6_NEW_SIGS)) {
+    bool fNewSigs = sporkManager.IsSporkActive(SPORK_6_NEW_SIGS);
+    // GetHash() doesn't commit to blockHash in the old format, the serialized ping does
+    uint256 cacheEntry = CSignatureCache::GetEntry(SerializeHash(*this), vchSig, keyIDOperator, fNewSigs);
+    if (mnSigCache.Contains(cacheEntry)) {
+        return true;
+    }
+
+    if (fNewSigs) {
         uint256 hash = GetSignatureHash();
 
         if (!CHashSigner::VerifyHash(hash, keyIDOperator, vchSig, strError)) {
@@ -833,6 +849,7 @@ bool CMasternodePing::CheckSignature(CKeyID& keyIDOperator, int &nDos) const
         }
     }
 
+    mnSigCache.Add(cacheEntry);
     return true;
 }
 
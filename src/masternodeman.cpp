@@ -74,12 +74,17 @@ CMasternodeMan::CMasternodeMan():
     fMasternodesAdded(false),
     fMasternodesRemoved(false),
     vecDirtyGovernanceObjectHashes(),
+    messageVerifier("blaze-mn-verify", MASTERNODE_VERIFY_BATCH_SIZE, MASTERNODE_VERIFY_BATCH_DELAY),
     nLastSentinelPingTime(0),
     mapSeenMasternodeBroadcast(),
     mapSeenMasternodePing(),
     nDsqCount(0)
 {}
 
+CMasternodeMan::~CMasternodeMan()
+{
+}
+
 bool CMasternodeMan::Add(CMasternode &mn)
 {
     LOCK(cs);
@@ -91,10 +96,20 @@ bool CMasternodeMan::Add(CMasternode &mn)
 
     LogPrint("masternode", "CMasternodeMan::Add -- Adding new Masternode: addr=%s, %i now\n", mn.addr.ToString(), size() + 1);
     mapMasternodes[mn.outpoint] = mn;
+    ClearScoreCache();
     fMasternodesAdded = true;
+    // The payments of a longer list are stored for more blocks
+    mnpayments.UpdateStorageLimit();
     return true;
 }
 
+std::map<COutPoint, CMasternode>::iterator CMasternodeMan::Erase(std::map<COutPoint, CMasternode>::iterator it)
+{
+    AssertLockHeld(cs);
+    ClearScoreCache();
+    return mapMasternodes.erase(it);
+}
+
 void CMasternodeMan::AskForMN(CNode* pnode, const COutPoint& outpoint, CConnman& connman)
 {
     if(!pnode) return;
@@ -219,7 +234,7 @@ void CMasternodeMan::CheckAndRemove(CConnman& connman)
 
                 // and finally remove it from the list
                 it->second.FlagGovernanceItemsAsDirty();
-                mapMasternodes.erase(it++);
+                it = Erase(it);
                 fMasternodesRemoved = true;
             } else {
                 bool fAsk = (nAskForMnbRecovery > 0) &&
@@ -423,7 +438,7 @@ void CMasternodeMan::RemoveNonDeterministicMasternodes()
         auto it = mapMasternodes.begin();
         while (it != mapMasternodes.end()) {
             if (!mnSet.count(it->second.outpoint)) {
-                mapMasternodes.erase(it++);
+                it = Erase(it);
                 erased = true;
             } else {
                 ++it;
@@ -439,6 +454,7 @@ void CMasternodeMan::Clear()
 {
     LOCK(cs);
     mapMasternodes.clear();
+    ClearScoreCache();
     mAskedUsForMasternodeList.clear();
     mWeAskedForMasternodeList.clear();
     mWeAskedForMasternodeListEntry.clear();
@@ -555,6 +571,7 @@ CMasternode* CMasternodeMan::Find(const COutPoint &outpoint)
             // MN is not in mapMasternodes but in the deterministic list. Create an entry in mapMasternodes for compatibility with legacy code
             CMasternode mn(outpoint.hash, dmn);
             it = mapMasternodes.emplace(outpoint, mn).first;
+            ClearScoreCache();
             return &(it->second);
         }
     } else {
@@ -710,12 +727,13 @@ bool CMasternodeMan::GetNextMasternodeInQueueForPayment(int nBlockHeight, bool f
     //  -- This doesn't look at who is being paid in the +8-10 blocks, allowing for double payments very rarely
     //  -- 1/100 payments should be a double payment on mainnet - (1/(3000/10))*2
     //  -- (chance per block * chances before IsScheduled will fire)
+    const score_cache_entry_t& scores = GetLegacyScores(blockHash);
     int nTenthNetwork = nMnCount/10;
     int nCountTenth = 0;
     arith_uint256 nHighest = 0;
     const CMasternode *pBestMasternode = nullptr;
     for (const auto& s : vecMasternodeLastPaid) {
-        arith_uint256 nScore = s.second->CalculateScore(blockHash);
+        arith_uint256 nScore = scores.vecScores[scores.mapPositions.at(s.second)].first;
         if(nScore > nHighest){
             nHighest = nScore;
             pBestMasternode = s.second;
@@ -793,6 +811,43 @@ std::map<COutPoint, CMasternode> CMasternodeMan::GetFullMasternodeMap()
     }
 }
 
+const CMasternodeMan::score_cache_entry_t& CMasternodeMan::GetLegacyScores(const uint256& nBlockHash)
+{
+    AssertLockHeld(cs);
+
+    auto it = mapScoreCache.find(nBlockHash);
+    if (it != mapScoreCache.end()) {
+        // the same few hashes are asked for over and over again, keep them
+        listScoreCacheOrder.splice(listScoreCacheOrder.end(), listScoreCacheOrder, it->second.itOrder);
+        return it->second;
+    }
+
+    if (mapScoreCache.size() >= MAX_SCORE_CACHE_BLOCKS) {
+        mapScoreCache.erase(listScoreCacheOrder.front());
+        listScoreCacheOrder.pop_front();
+    }
+
+    score_cache_entry_t& entry = mapScoreCache[nBlockHash];
+    entry.itOrder = listScoreCacheOrder.insert(listScoreCacheOrder.end(), nBlockHash);
+
+    entry.vecScores.reserve(mapMasternodes.size());
+    for (const auto& mnpair : mapMasternodes) {
+        entry.vecScores.push_back(std::make_pair(mnpair.second.CalculateScore(nBlockHash), &mnpair.second));
+    }
+    sort(entry.vecScores.rbegin(), entry.vecScores.rend(), CompareScoreMN());
+    for (size_t i = 0; i < entry.vecScores.size(); i++) {
+        entry.mapPositions.emplace(entry.vecScores[i].second, i);
+    }
+    return entry;
+}
+
+void CMasternodeMan::ClearScoreCache()
+{
+    AssertLockHeld(cs);
+    mapScoreCache.clear();
+    listScoreCacheOrder.clear();
+}
+
 bool CMasternodeMan::GetMasternodeScores(const uint256& nBlockHash, CMasternodeMan::score_pair_vec_t& vecMasternodeScoresRet, int nMinProtocol)
 {
     AssertLockHeld(cs);
@@ -806,6 +861,7 @@ bool CMasternodeMan::GetMasternodeScores(const uint256& nBlockHash, CMasternodeM
             auto* mn = Find(p.second->collateralOutpoint);
             vecMasternodeScoresRet.emplace_back(p.first, mn);
         }
+        sort(vecMasternodeScoresRet.rbegin(), vecMasternodeScoresRet.rend(), CompareScoreMN());
     } else {
         if (!masternodeSync.IsMasternodeListSynced())
             return false;
@@ -813,14 +869,13 @@ bool CMasternodeMan::GetMasternodeScores(const uint256& nBlockHash, CMasternodeM
         if (mapMasternodes.empty())
             return false;
 
-        // calculate scores
-        for (const auto& mnpair : mapMasternodes) {
-            if (mnpair.second.nProtocolVersion >= nMinProtocol) {
-                vecMasternodeScoresRet.push_back(std::make_pair(mnpair.second.CalculateScore(nBlockHash), &mnpair.second));
+        // cached scores are already sorted, only apply the protocol filter
+        for (const auto& scorePair : GetLegacyScores(nBlockHash).vecScores) {
+            if (scorePair.second->nProtocolVersion >= nMinProtocol) {
+                vecMasternodeScoresRet.push_back(scorePair);
             }
         }
     }
-    sort(vecMasternodeScoresRet.rbegin(), vecMasternodeScoresRet.rend(), CompareScoreMN());
     return !vecMasternodeScoresRet.empty();
 }
 
@@ -846,6 +901,23 @@ bool CMasternodeMan::GetMasternodeRank(const COutPoint& outpoint, int& nRankRet,
 
     LOCK(cs);
 
+    if (!deterministicMNManager->IsDeterministicMNsSporkActive()) {
+        // count the masternodes passing the protocol filter up to our position in the cached scores
+        auto it = mapMasternodes.find(outpoint);
+        if (it == mapMasternodes.end() || it->second.nProtocolVersion < nMinProtocol)
+            return false;
+
+        const score_cache_entry_t& scores = GetLegacyScores(blockHashRet);
+        size_t nPosition = scores.mapPositions.at(&it->second);
+        int nRank = 1;
+        for (size_t i = 0; i < nPosition; i++) {
+            if (scores.vecScores[i].second->nProtocolVersion >= nMinProtocol)
+                nRank++;
+        }
+        nRankRet = nRank;
+        return true;
+    }
+
     score_pair_vec_t vecMasternodeScores;
     if (!GetMasternodeScores(blockHashRet, vecMasternodeScores, nMinProtocol))
         return false;
@@ -988,6 +1060,158 @@ void CMasternodeMan::ProcessPendingMnbRequests(CConnman& connman)
     }
 }
 
+void CMasternodeMan::StartVerification(int nThreads)
+{
+    messageVerifier.Start(nThreads);
+}
+
+void CMasternodeMan::StopVerification()
+{
+    messageVerifier.Stop();
+}
+
+void CMasternodeMan::ProcessPendingMessages(CConnman& connman)
+{
+    std::vector<CBatchVerifier<CMasternodeNetworkMessage>::Item> vecBatch;
+    if (!messageVerifier.TakeBatch(vecBatch)) {
+        return;
+    }
+
+    // Broadcasts go first, pings of masternodes we don't know are useless
+    std::vector<std::pair<CNode*, CMasternodeBroadcast> > vecMnb;
+    std::vector<std::pair<CNode*, CMasternodePing> > vecMnp;
+    for (const auto& item : vecBatch) {
+        if (const CMasternodeBroadcast* pmnb = boost::get<CMasternodeBroadcast>(&item.second)) {
+            vecMnb.emplace_back(item.first, *pmnb);
+        } else {
+            vecMnp.emplace_back(item.first, boost::get<CMasternodePing>(item.second));
+        }
+    }
+
+    // Collect the distinct, not yet seen messages which are worth verifying. Collaterals
+    // of all new masternodes are looked up here under a single cs_main lock, so that the
+    // coins are cached by the time CheckOutpoint() gets to them.
+    std::vector<CMasternodeBroadcast> vecVerifyMnb;
+    std::vector<std::pair<CMasternodePing, CKeyID> > vecVerifyMnp;
+    {
+        LOCK2(cs_main, cs);
+        std::set<uint256> setQueued;
+        for (const auto& pair : vecMnb) {
+            const CMasternodeBroadcast& mnb = pair.second;
+            uint256 nHash = mnb.GetHash();
+            if (!setQueued.insert(nHash).second || mapSeenMasternodeBroadcast.count(nHash)) {
+                continue;
+            }
+            Coin coin;
+            if (!Find(mnb.outpoint) && !GetUTXOCoin(mnb.outpoint, coin)) {
+                // going to be rejected without looking at the signature
+                continue;
+            }
+            vecVerifyMnb.push_back(mnb);
+        }
+        for (const auto& pair : vecMnp) {
+            const CMasternodePing& mnp = pair.second;
+            uint256 nHash = mnp.GetHash();
+            if (!setQueued.insert(nHash).second || mapSeenMasternodePing.count(nHash)) {
+                continue;
+            }
+            CMasternode* pmn = Find(mnp.masternodeOutpoint);
+            if (!pmn) {
+                continue;
+            }
+            vecVerifyMnp.emplace_back(mnp, pmn->legacyKeyIDOperator);
+        }
+    }
+
+    // Verify their signatures in parallel, results end up in the signature cache
+    // and the serial processing below only has to run the cheap checks.
+    std::vector<std::function<bool()> > vecChecks;
+    for (const auto& mnb : vecVerifyMnb) {
+        vecChecks.emplace_back([mnb]() {
+            int nDos;
+            CKeyID keyIDOperator = mnb.legacyKeyIDOperator;
+            // the ping is checked together with a new broadcast
+            return mnb.CheckSignature(nDos) && (!mnb.lastPing || mnb.lastPing.CheckSignature(keyIDOperator, nDos));
+        });
+    }
+    for (const auto& pair : vecVerifyMnp) {
+        vecChecks.emplace_back([pair]() {
+            int nDos;
+            CKeyID keyIDOperator = pair.second;
+            return pair.first.CheckSignature(keyIDOperator, nDos);
+        });
+    }
+
+    size_t nVerified = messageVerifier.Verify(vecChecks);
+
+    LogPrint("masternode", "CMasternodeMan::%s -- processing %d broadcasts and %d pings, %d verified in parallel\n",
+        __func__, vecMnb.size(), vecMnp.size(), nVerified);
+
+    for (auto& pair : vecMnb) {
+        ProcessNetworkMnb(pair.first, pair.second, connman);
+        pair.first->Release();
+    }
+    for (auto& pair : vecMnp) {
+        ProcessNetworkMnp(pair.first, pair.second, connman);
+        pair.first->Release();
+    }
+
+    if(fMasternodesAdded) {
+        NotifyMasternodeUpdates(connman);
+    }
+}
+
+void CMasternodeMan::ProcessNetworkMnb(CNode* pfrom, const CMasternodeBroadcast& mnb, CConnman& connman)
+{
+    int nDos = 0;
+
+    if (CheckMnbAndUpdateMasternodeList(pfrom, mnb, nDos, connman)) {
+        // use announced Masternode as a peer
+        connman.AddNewAddress(CAddress(mnb.addr, NODE_NETWORK), pfrom->addr, 2*60*60);
+    } else if(nDos > 0) {
+        LOCK(cs_main);
+        Misbehaving(pfrom->GetId(), nDos);
+    }
+}
+
+void CMasternodeMan::ProcessNetworkMnp(CNode* pfrom, const CMasternodePing& mnp, CConnman& connman)
+{
+    uint256 nHash = mnp.GetHash();
+
+    // Need LOCK2 here to ensure consistent locking order because the CheckAndUpdate call below locks cs_main
+    LOCK2(cs_main, cs);
+
+    if(mapSeenMasternodePing.count(nHash)) return; //seen
+    mapSeenMasternodePing.insert(std::make_pair(nHash, mnp));
+
+    LogPrint("masternode", "MNPING -- Masternode ping, masternode=%s new\n", mnp.masternodeOutpoint.ToStringShort());
+
+    // see if we have this Masternode
+    CMasternode* pmn = Find(mnp.masternodeOutpoint);
+
+    if(pmn && mnp.fSentinelIsCurrent)
+        UpdateLastSentinelPingTime();
+
+    // too late, new MNANNOUNCE is required
+    if(pmn && pmn->IsNewStartRequired()) return;
+
+    int nDos = 0;
+    CMasternodePing mnpCopy(mnp);
+    if(mnpCopy.CheckAndUpdate(pmn, false, nDos, connman)) return;
+
+    if(nDos > 0) {
+        // if anything significant failed, mark that node
+        Misbehaving(pfrom->GetId(), nDos);
+    } else if(pmn != nullptr) {
+        // nothing significant failed, mn is a known one too
+        return;
+    }
+
+    // something significant is broken or mn is unknown,
+    // we might have to ask for a masternode entry once
+    AskForMN(pfrom, mnp.masternodeOutpoint, connman);
+}
+
 void CMasternodeMan::ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman)
 {
     if (deterministicMNManager->IsDeterministicMNsSporkActive())
@@ -1009,16 +1233,13 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, const std::string& strCommand,
 
         LogPrint("masternode", "MNANNOUNCE -- Masternode announce, masternode=%s\n", mnb.outpoint.ToStringShort());
 
-        int nDos = 0;
-
-        if (CheckMnbAndUpdateMasternodeList(pfrom, mnb, nDos, connman)) {
-            // use announced Masternode as a peer
-            connman.AddNewAddress(CAddress(mnb.addr, NODE_NETWORK), pfrom->addr, 2*60*60);
-        } else if(nDos > 0) {
-            LOCK(cs_main);
-            Misbehaving(pfrom->GetId(), nDos);
+        if (messageVerifier.Queue(pfrom, mnb)) {
+            ProcessPendingMessages(connman);
+            return;
         }
 
+        ProcessNetworkMnb(pfrom, mnb, connman);
+
         if(fMasternodesAdded) {
             NotifyMasternodeUpdates(connman);
         }
@@ -1027,48 +1248,21 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, const std::string& strCommand,
         CMasternodePing mnp;
         vRecv >> mnp;
 
-        uint256 nHash = mnp.GetHash();
-
         {
             LOCK(cs_main);
-            connman.RemoveAskFor(nHash);
+            connman.RemoveAskFor(mnp.GetHash());
         }
 
         if(!masternodeSync.IsBlockchainSynced()) return;
 
         LogPrint("masternode", "MNPING -- Masternode ping, masternode=%s\n", mnp.masternodeOutpoint.ToStringShort());
 
-        // Need LOCK2 here to ensure consistent locking order because the CheckAndUpdate call below locks cs_main
-        LOCK2(cs_main, cs);
-
-        if(mapSeenMasternodePing.count(nHash)) return; //seen
-        mapSeenMasternodePing.insert(std::make_pair(nHash, mnp));
-
-        LogPrint("masternode", "MNPING -- Masternode ping, masternode=%s new\n", mnp.masternodeOutpoint.ToStringShort());
-
-        // see if we have this Masternode
-        CMasternode* pmn = Find(mnp.masternodeOutpoint);
-
-        if(pmn && mnp.fSentinelIsCurrent)
-            UpdateLastSentinelPingTime();
-
-        // too late, new MNANNOUNCE is required
-        if(pmn && pmn->IsNewStartRequired()) return;
-
-        int nDos = 0;
-        if(mnp.CheckAndUpdate(pmn, false, nDos, connman)) return;
-
-        if(nDos > 0) {
-            // if anything significant failed, mark that node
-            Misbehaving(pfrom->GetId(), nDos);
-        } else if(pmn != nullptr) {
-            // nothing significant failed, mn is a known one too
+        if (messageVerifier.Queue(pfrom, mnp)) {
+            ProcessPendingMessages(connman);
             return;
         }
 
-        // something significant is broken or mn is unknown,
-        // we might have to ask for a masternode entry once
-        AskForMN(pfrom, mnp.masternodeOutpoint, connman);
+        ProcessNetworkMnp(pfrom, mnp, connman);
 
     } else if (strCommand == NetMsgType::DSEG) { //Get Masternode list or specific entry
         // Ignore such requests until we are fully synced.
@@ -7,14 +7,26 @@
 #ifndef MASTERNODEMAN_H
 #define MASTERNODEMAN_H
 
+#include "batchverifier.h"
 #include "masternode.h"
 #include "sync.h"
 
+#include <boost/variant.hpp>
+
 class CMasternodeMan;
 class CConnman;
 
 extern CMasternodeMan mnodeman;
 
+static const int DEFAULT_MASTERNODE_VERIFY_THREADS = 2;
+/** Verify queued network broadcasts and pings once this many are pending, and never more at once... */
+static const size_t MASTERNODE_VERIFY_BATCH_SIZE = 256;
+/** ...or once the oldest one has been waiting this long (in milliseconds) */
+static const int64_t MASTERNODE_VERIFY_BATCH_DELAY = 100;
+
+/** A broadcast or a ping waiting for batched verification */
+typedef boost::variant<CMasternodeBroadcast, CMasternodePing> CMasternodeNetworkMessage;
+
 class CMasternodeMan
 {
 public:
@@ -23,7 +35,7 @@ public:
     typedef std::pair<int, const CMasternode> rank_pair_t;
     typedef std::vector<rank_pair_t> rank_pair_vec_t;
 
-private:
+protected:
     static const std::string SERIALIZATION_VERSION_STRING;
 
     static const int DSEG_UPDATE_SECONDS        = 3 * 60 * 60;
@@ -41,6 +53,15 @@ private:
     static const int MNB_RECOVERY_WAIT_SECONDS      = 60;
     static const int MNB_RECOVERY_RETRY_SECONDS     = 3 * 60 * 60;
 
+    static const size_t MAX_SCORE_CACHE_BLOCKS      = 32;
+
+    /// Scores of all legacy masternodes for one block hash, best first, and the position of each masternode in it
+    struct score_cache_entry_t {
+        score_pair_vec_t vecScores;
+        std::map<const CMasternode*, size_t> mapPositions;
+        /// Position of the block hash in listScoreCacheOrder
+        std::list<uint256>::iterator itOrder;
+    };
 
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
@@ -76,19 +97,38 @@ private:
 
     std::vector<uint256> vecDirtyGovernanceObjectHashes;
 
+    // broadcasts and pings received from the network, waiting to be verified as a batch
+    CBatchVerifier<CMasternodeNetworkMessage> messageVerifier;
+
     int64_t nLastSentinelPingTime;
 
+    // legacy masternode scores for recently used block hashes, shared by payments, InstantSend,
+    // PrivateSend and PoSe verification. Points into mapMasternodes, so it has to be cleared
+    // whenever masternodes are added or removed.
+    std::map<uint256, score_cache_entry_t> mapScoreCache;
+    // least recently used block hash first, evicted first once the cache is full
+    std::list<uint256> listScoreCacheOrder;
+
     friend class CMasternodeSync;
     /// Find an entry
     CMasternode* Find(const COutPoint& outpoint);
+    /// Remove an entry and the cached scores pointing to it, returns the next one
+    std::map<COutPoint, CMasternode>::iterator Erase(std::map<COutPoint, CMasternode>::iterator it);
 
     bool GetMasternodeScores(const uint256& nBlockHash, score_pair_vec_t& vecMasternodeScoresRet, int nMinProtocol = 0);
 
+    /// Get the cached legacy scores for nBlockHash, calculating them if needed
+    const score_cache_entry_t& GetLegacyScores(const uint256& nBlockHash);
+    void ClearScoreCache();
+
     void SyncSingle(CNode* pnode, const COutPoint& outpoint, CConnman& connman);
     void SyncAll(CNode* pnode, CConnman& connman);
 
     void PushDsegInvs(CNode* pnode, const CMasternode& mn);
 
+    void ProcessNetworkMnb(CNode* pfrom, const CMasternodeBroadcast& mnb, CConnman& connman);
+    void ProcessNetworkMnp(CNode* pfrom, const CMasternodePing& mnp, CConnman& connman);
+
 public:
     // Keep track of all broadcasts I've seen
     std::map<uint256, std::pair<int64_t, CMasternodeBroadcast> > mapSeenMasternodeBroadcast;
@@ -115,6 +155,9 @@ public:
         }
 
         READWRITE(mapMasternodes);
+        if(ser_action.ForRead()) {
+            ClearScoreCache();
+        }
         READWRITE(mAskedUsForMasternodeList);
         READWRITE(mWeAskedForMasternodeList);
         READWRITE(mWeAskedForMasternodeListEntry);
@@ -131,6 +174,7 @@ public:
     }
 
     CMasternodeMan();
+    ~CMasternodeMan();
 
     /// Add an entry
     bool Add(CMasternode &mn);
@@ -197,6 +241,13 @@ public:
 
     void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman);
 
+    /// Start the threads verifying batches of network broadcasts and pings, 0 processes every message on arrival
+    void StartVerification(int nThreads);
+    /// Stop the verification threads and release the nodes of the messages still queued
+    void StopVerification();
+    /// Verify and process the queued broadcasts and pings if the batch is full or old enough
+    void ProcessPendingMessages(CConnman& connman);
+
     void DoFullVerificationStep(CConnman& connman);
     void CheckSameAddr();
     bool CheckVerifyRequestAddr(const CAddress& addr, CConnman& connman);
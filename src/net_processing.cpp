@@ -942,12 +942,12 @@ bool static AlreadyHave(const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
         }
 
     case MSG_MASTERNODE_PAYMENT_VOTE:
-        return mnpayments.mapMasternodePaymentVotes.count(inv.hash);
+        return mnpayments.HasPaymentVote(inv.hash);
 
     case MSG_MASTERNODE_PAYMENT_BLOCK:
         {
             BlockMap::iterator mi = mapBlockIndex.find(inv.hash);
-            return mi != mapBlockIndex.end() && mnpayments.mapMasternodeBlocks.find(mi->second->nHeight) != mnpayments.mapMasternodeBlocks.end();
+            return mi != mapBlockIndex.end() && mnpayments.HasPaymentBlock(mi->second->nHeight);
         }
 
     case MSG_MASTERNODE_ANNOUNCE:
@@ -1191,8 +1191,9 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
 
                 if (!push && inv.type == MSG_MASTERNODE_PAYMENT_VOTE) {
                     if (!deterministicMNManager->IsDeterministicMNsSporkActive()) {
-                        if (mnpayments.HasVerifiedPaymentVote(inv.hash)) {
-                            connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::MASTERNODEPAYMENTVOTE, mnpayments.mapMasternodePaymentVotes[inv.hash]));
+                        CMasternodePaymentVote vote;
+                        if (mnpayments.GetPaymentVote(inv.hash, vote) && vote.IsVerified()) {
+                            connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::MASTERNODEPAYMENTVOTE, vote));
                             push = true;
                         }
                     }
@@ -1201,15 +1202,10 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                 if (!push && inv.type == MSG_MASTERNODE_PAYMENT_BLOCK) {
                     if (!deterministicMNManager->IsDeterministicMNsSporkActive()) {
                         BlockMap::iterator mi = mapBlockIndex.find(inv.hash);
-                        LOCK(cs_mapMasternodeBlocks);
-                        if (mi != mapBlockIndex.end() && mnpayments.mapMasternodeBlocks.count(mi->second->nHeight)) {
-                            BOOST_FOREACH(CMasternodePayee& payee, mnpayments.mapMasternodeBlocks[mi->second->nHeight].vecPayees) {
-                                std::vector<uint256> vecVoteHashes = payee.GetVoteHashes();
-                                BOOST_FOREACH(uint256& hash, vecVoteHashes) {
-                                    if(mnpayments.HasVerifiedPaymentVote(hash)) {
-                                        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::MASTERNODEPAYMENTVOTE, mnpayments.mapMasternodePaymentVotes[hash]));
-                                    }
-                                }
+                        std::vector<CMasternodePaymentVote> vecVotes;
+                        if (mi != mapBlockIndex.end() && mnpayments.GetPaymentBlockVotes(mi->second->nHeight, vecVotes)) {
+                            for (const auto& vote : vecVotes) {
+                                connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::MASTERNODEPAYMENTVOTE, vote));
                             }
                             push = true;
                         }
@@ -3164,6 +3160,12 @@ public:
 bool SendMessages(CNode* pto, CConnman& connman, const std::atomic<bool>& interruptMsgProc)
 {
     const Consensus::Params& consensusParams = Params().GetConsensus();
+
+    // Governance votes are verified in batches, process them once the batch is due
+    governance.ProcessPendingVotes(connman);
+    // Same for masternode announcements and pings
+    mnodeman.ProcessPendingMessages(connman);
+
     {
         // Don't send anything until the version handshake is complete
         if (!pto->fSuccessfullyConnected || pto->fDisconnect)
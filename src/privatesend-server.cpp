@@ -9,17 +9,67 @@
 #include "activemasternode.h"
 #include "consensus/validation.h"
 #include "core_io.h"
+#include "ctpl.h"
 #include "init.h"
 #include "masternode-sync.h"
 #include "masternodeman.h"
 #include "netmessagemaker.h"
+#include "scheduler.h"
 #include "script/interpreter.h"
+#include "script/sigcache.h"
 #include "txmempool.h"
 #include "util.h"
 #include "utilmoneystr.h"
 
+#include <boost/bind.hpp>
+
 CPrivateSendServer privateSendServer;
 
+static void PushStatusUpdate(CNode* pnode, int nSessionID, PoolState nState, int nEntriesCount, PoolStatusUpdate nStatusUpdate, PoolMessage nMessageID, CConnman& connman)
+{
+    if (!pnode) return;
+    CNetMsgMaker msgMaker(pnode->GetSendVersion());
+    connman.PushMessage(pnode, msgMaker.Make(NetMsgType::DSSTATUSUPDATE, nSessionID, (int)nState, nEntriesCount, (int)nStatusUpdate, (int)nMessageID));
+}
+
+CPrivateSendServer::CPrivateSendServer() :
+    mapSessions(),
+    mapParticipants(),
+    pscheduler(nullptr),
+    verifyPool(),
+    fUnitTest(false)
+{
+}
+
+CPrivateSendServer::~CPrivateSendServer()
+{
+}
+
+void CPrivateSendServer::Start(CScheduler& scheduler, int nVerifyThreads)
+{
+    LOCK(cs_sessions);
+    assert(!verifyPool);
+    pscheduler = &scheduler;
+    if (nVerifyThreads > 0) {
+        LogPrint("privatesend", "CPrivateSendServer::%s -- Starting %d signature verification threads\n", __func__, nVerifyThreads);
+        verifyPool.reset(new ctpl::thread_pool(nVerifyThreads));
+        RenameThreadPool(*verifyPool, "blaze-ps-verify");
+    }
+}
+
+void CPrivateSendServer::Stop()
+{
+    std::unique_ptr<ctpl::thread_pool> pool;
+    {
+        LOCK(cs_sessions);
+        pscheduler = nullptr;
+        pool.swap(verifyPool);
+    }
+    if (pool) {
+        pool->stop(true);
+    }
+}
+
 void CPrivateSendServer::ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman)
 {
     if (!fMasternodeMode) return;
@@ -30,14 +80,7 @@ void CPrivateSendServer::ProcessMessage(CNode* pfrom, const std::string& strComm
         if (pfrom->nVersion < MIN_PRIVATESEND_PEER_PROTO_VERSION) {
             LogPrint("privatesend", "DSACCEPT -- peer=%d using obsolete version %i\n", pfrom->id, pfrom->nVersion);
             connman.PushMessage(pfrom, CNetMsgMaker(pfrom->GetSendVersion()).Make(NetMsgType::REJECT, strCommand, REJECT_OBSOLETE, strprintf("Version must be %d or greater", MIN_PRIVATESEND_PEER_PROTO_VERSION)));
-            PushStatus(pfrom, STATUS_REJECTED, ERR_VERSION, connman);
-            return;
-        }
-
-        if (IsSessionReady()) {
-            // too many users in this session already, reject new ones
-            LogPrintf("DSACCEPT -- queue is already full!\n");
-            PushStatus(pfrom, STATUS_ACCEPTED, ERR_QUEUE_FULL, connman);
+            PushStatusUpdate(pfrom, 0, POOL_STATE_IDLE, 0, STATUS_REJECTED, ERR_VERSION, connman);
             return;
         }
 
@@ -48,20 +91,36 @@ void CPrivateSendServer::ProcessMessage(CNode* pfrom, const std::string& strComm
 
         masternode_info_t mnInfo;
         if (!mnodeman.GetMasternodeInfo(activeMasternodeInfo.outpoint, mnInfo)) {
-            PushStatus(pfrom, STATUS_REJECTED, ERR_MN_LIST, connman);
+            PushStatusUpdate(pfrom, 0, POOL_STATE_IDLE, 0, STATUS_REJECTED, ERR_MN_LIST, connman);
             return;
         }
 
-        if (vecSessionCollaterals.size() == 0) {
-            {
-                TRY_LOCK(cs_vecqueue, lockRecv);
-                if (!lockRecv) return;
+        LOCK(cs_sessions);
 
+        if (mapParticipants.count(pfrom->addr)) {
+            LogPrintf("DSACCEPT -- peer is already in a session, peer=%d\n", pfrom->id);
+            PushStatusUpdate(pfrom, 0, POOL_STATE_IDLE, 0, STATUS_REJECTED, ERR_MODE, connman);
+            return;
+        }
+
+        PoolMessage nMessageID = MSG_NOERR;
+
+        CPrivateSendServerSession* psession = AddUserToExistingSession(dsa, pfrom->addr, nMessageID);
+        if (!psession && nMessageID == MSG_NOERR) {
+            if ((int)mapSessions.size() >= MAX_PRIVATESEND_SERVER_SESSIONS) {
+                // too many sessions in progress already, reject new ones
+                LogPrintf("DSACCEPT -- too many sessions!\n");
+                PushStatusUpdate(pfrom, 0, POOL_STATE_IDLE, 0, STATUS_REJECTED, ERR_QUEUE_FULL, connman);
+                return;
+            }
+
+            {
+                LOCK(cs_vecqueue);
                 for (const auto& q : vecPrivateSendQueue) {
-                    if (q.masternodeOutpoint == activeMasternodeInfo.outpoint) {
+                    if (q.masternodeOutpoint == activeMasternodeInfo.outpoint && !q.IsExpired()) {
                         // refuse to create another queue this often
                         LogPrint("privatesend", "DSACCEPT -- last dsq is still in queue, refuse to mix\n");
-                        PushStatus(pfrom, STATUS_REJECTED, ERR_RECENT, connman);
+                        PushStatusUpdate(pfrom, 0, POOL_STATE_IDLE, 0, STATUS_REJECTED, ERR_RECENT, connman);
                         return;
                     }
                 }
@@ -69,23 +128,20 @@ void CPrivateSendServer::ProcessMessage(CNode* pfrom, const std::string& strComm
 
             if (mnInfo.nLastDsq != 0 && mnInfo.nLastDsq + mnodeman.CountMasternodes() / 5 > mnodeman.nDsqCount) {
                 LogPrintf("DSACCEPT -- last dsq too recent, must wait: addr=%s\n", pfrom->addr.ToString());
-                PushStatus(pfrom, STATUS_REJECTED, ERR_RECENT, connman);
+                PushStatusUpdate(pfrom, 0, POOL_STATE_IDLE, 0, STATUS_REJECTED, ERR_RECENT, connman);
                 return;
             }
-        }
 
-        PoolMessage nMessageID = MSG_NOERR;
+            psession = CreateNewSession(dsa, pfrom->addr, nMessageID, connman);
+        }
 
-        bool fResult = nSessionID == 0 ? CreateNewSession(dsa, nMessageID, connman)
-                                       : AddUserToExistingSession(dsa, nMessageID);
-        if (fResult) {
+        if (psession) {
             LogPrintf("DSACCEPT -- is compatible, please submit!\n");
-            PushStatus(pfrom, STATUS_ACCEPTED, nMessageID, connman);
-            return;
+            psession->PushStatus(pfrom, STATUS_ACCEPTED, nMessageID, connman);
+            CheckSession(psession->GetSessionID(), connman);
         } else {
             LogPrintf("DSACCEPT -- not compatible with existing transactions!\n");
-            PushStatus(pfrom, STATUS_REJECTED, nMessageID, connman);
-            return;
+            PushStatusUpdate(pfrom, 0, POOL_STATE_IDLE, 0, STATUS_REJECTED, nMessageID, connman);
         }
 
     } else if (strCommand == NetMsgType::DSQUEUE) {
@@ -124,7 +180,7 @@ void CPrivateSendServer::ProcessMessage(CNode* pfrom, const std::string& strComm
 
         if (!dsq.fReady) {
             for (const auto& q : vecPrivateSendQueue) {
-                if (q.masternodeOutpoint == dsq.masternodeOutpoint) {
+                if (q.masternodeOutpoint == dsq.masternodeOutpoint && !q.IsExpired()) {
                     // no way same mn can send another "not yet ready" dsq this soon
                     LogPrint("privatesend", "DSQUEUE -- Masternode %s is sending WAY too many dsq messages\n", mnInfo.addr.ToString());
                     return;
@@ -149,16 +205,20 @@ void CPrivateSendServer::ProcessMessage(CNode* pfrom, const std::string& strComm
         if (pfrom->nVersion < MIN_PRIVATESEND_PEER_PROTO_VERSION) {
             LogPrint("privatesend", "DSVIN -- peer=%d using obsolete version %i\n", pfrom->id, pfrom->nVersion);
             connman.PushMessage(pfrom, CNetMsgMaker(pfrom->GetSendVersion()).Make(NetMsgType::REJECT, strCommand, REJECT_OBSOLETE, strprintf("Version must be %d or greater", MIN_PRIVATESEND_PEER_PROTO_VERSION)));
-            PushStatus(pfrom, STATUS_REJECTED, ERR_VERSION, connman);
+            PushStatusUpdate(pfrom, 0, POOL_STATE_IDLE, 0, STATUS_REJECTED, ERR_VERSION, connman);
             return;
         }
 
-        //do we have enough users in the current session?
-        if (!IsSessionReady()) {
+        LOCK(cs_sessions);
+
+        //do we have enough users in the session of this peer?
+        CPrivateSendServerSession* psession = GetParticipantSession(pfrom->addr);
+        if (!psession || !psession->IsSessionReady()) {
             LogPrintf("DSVIN -- session not complete!\n");
-            PushStatus(pfrom, STATUS_REJECTED, ERR_SESSION, connman);
+            PushStatusUpdate(pfrom, 0, POOL_STATE_IDLE, 0, STATUS_REJECTED, ERR_SESSION, connman);
             return;
         }
+        int nSessionID = psession->GetSessionID();
 
         CPrivateSendEntry entry;
         vRecv >> entry;
@@ -167,20 +227,20 @@ void CPrivateSendServer::ProcessMessage(CNode* pfrom, const std::string& strComm
 
         if (entry.vecTxDSIn.size() > PRIVATESEND_ENTRY_MAX_SIZE) {
             LogPrintf("DSVIN -- ERROR: too many inputs! %d/%d\n", entry.vecTxDSIn.size(), PRIVATESEND_ENTRY_MAX_SIZE);
-            PushStatus(pfrom, STATUS_REJECTED, ERR_MAXIMUM, connman);
+            psession->PushStatus(pfrom, STATUS_REJECTED, ERR_MAXIMUM, connman);
             return;
         }
 
         if (entry.vecTxOut.size() > PRIVATESEND_ENTRY_MAX_SIZE) {
             LogPrintf("DSVIN -- ERROR: too many outputs! %d/%d\n", entry.vecTxOut.size(), PRIVATESEND_ENTRY_MAX_SIZE);
-            PushStatus(pfrom, STATUS_REJECTED, ERR_MAXIMUM, connman);
+            psession->PushStatus(pfrom, STATUS_REJECTED, ERR_MAXIMUM, connman);
             return;
         }
 
         //do we have the same denominations as the current session?
-        if (!IsOutputsCompatibleWithSessionDenom(entry.vecTxOut)) {
+        if (!psession->IsOutputsCompatibleWithSessionDenom(entry.vecTxOut)) {
             LogPrintf("DSVIN -- not compatible with existing transactions!\n");
-            PushStatus(pfrom, STATUS_REJECTED, ERR_EXISTING_TX, connman);
+            psession->PushStatus(pfrom, STATUS_REJECTED, ERR_EXISTING_TX, connman);
             return;
         }
 
@@ -197,17 +257,17 @@ void CPrivateSendServer::ProcessMessage(CNode* pfrom, const std::string& strComm
 
                 if (txout.scriptPubKey.size() != 25) {
                     LogPrintf("DSVIN -- non-standard pubkey detected! scriptPubKey=%s\n", ScriptToAsmStr(txout.scriptPubKey));
-                    PushStatus(pfrom, STATUS_REJECTED, ERR_NON_STANDARD_PUBKEY, connman);
+                    psession->PushStatus(pfrom, STATUS_REJECTED, ERR_NON_STANDARD_PUBKEY, connman);
                     return;
                 }
                 if (!txout.scriptPubKey.IsPayToPublicKeyHash()) {
                     LogPrintf("DSVIN -- invalid script! scriptPubKey=%s\n", ScriptToAsmStr(txout.scriptPubKey));
-                    PushStatus(pfrom, STATUS_REJECTED, ERR_INVALID_SCRIPT, connman);
+                    psession->PushStatus(pfrom, STATUS_REJECTED, ERR_INVALID_SCRIPT, connman);
                     return;
                 }
             }
 
-            for (const auto& txin : entry.vecTxDSIn) {
+            for (auto& txin : entry.vecTxDSIn) {
                 tx.vin.push_back(txin);
 
                 LogPrint("privatesend", "DSVIN -- txin=%s\n", txin.ToString());
@@ -215,9 +275,11 @@ void CPrivateSendServer::ProcessMessage(CNode* pfrom, const std::string& strComm
                 Coin coin;
                 if (GetUTXOCoin(txin.prevout, coin)) {
                     nValueIn += coin.out.nValue;
+                    // remember what the signature has to satisfy
+                    txin.prevPubKey = coin.out.scriptPubKey;
                 } else {
                     LogPrintf("DSVIN -- missing input! txin=%s\n", txin.ToString());
-                    PushStatus(pfrom, STATUS_REJECTED, ERR_MISSING_TX, connman);
+                    psession->PushStatus(pfrom, STATUS_REJECTED, ERR_MISSING_TX, connman);
                     return;
                 }
             }
@@ -226,7 +288,7 @@ void CPrivateSendServer::ProcessMessage(CNode* pfrom, const std::string& strComm
             CAmount nFee = nValueIn - nValueOut;
             if (nFee != 0) {
                 LogPrintf("DSVIN -- there should be no fee in mixing tx! fees: %lld, tx=%s", nFee, tx.ToString());
-                PushStatus(pfrom, STATUS_REJECTED, ERR_FEES, connman);
+                psession->PushStatus(pfrom, STATUS_REJECTED, ERR_FEES, connman);
                 return;
             }
         }
@@ -234,14 +296,14 @@ void CPrivateSendServer::ProcessMessage(CNode* pfrom, const std::string& strComm
         PoolMessage nMessageID = MSG_NOERR;
 
         entry.addr = pfrom->addr;
-        if (AddEntry(entry, nMessageID)) {
-            PushStatus(pfrom, STATUS_ACCEPTED, nMessageID, connman);
-            CheckPool(connman);
-            RelayStatus(STATUS_ACCEPTED, connman);
+        if (psession->AddEntry(entry, nMessageID)) {
+            psession->PushStatus(pfrom, STATUS_ACCEPTED, nMessageID, connman);
+            psession->RelayStatus(STATUS_ACCEPTED, connman);
         } else {
-            PushStatus(pfrom, STATUS_REJECTED, nMessageID, connman);
-            SetNull();
+            psession->PushStatus(pfrom, STATUS_REJECTED, nMessageID, connman);
+            psession->SetNull();
         }
+        CheckSession(nSessionID, connman);
 
     } else if (strCommand == NetMsgType::DSSIGNFINALTX) {
         if (pfrom->nVersion < MIN_PRIVATESEND_PEER_PROTO_VERSION) {
@@ -255,59 +317,221 @@ void CPrivateSendServer::ProcessMessage(CNode* pfrom, const std::string& strComm
 
         LogPrint("privatesend", "DSSIGNFINALTX -- vecTxIn.size() %s\n", vecTxIn.size());
 
-        int nTxInIndex = 0;
-        int nTxInsCount = (int)vecTxIn.size();
+        // The signatures are verified without holding cs_sessions, so that other
+        // sessions are not held up. Only looking up the inputs and adding the
+        // verified signatures happens under the lock.
+        int nSessionID;
+        CTransactionRef txFinal;
+        std::vector<std::pair<unsigned int, CScript> > vecChecks;
+        std::vector<std::future<bool> > vecFutures;
+        {
+            LOCK(cs_sessions);
+
+            CPrivateSendServerSession* psession = GetParticipantSession(pfrom->addr);
+            if (!psession || psession->GetState() != POOL_STATE_SIGNING) {
+                LogPrint("privatesend", "DSSIGNFINALTX -- no session is waiting for signatures from peer=%d\n", pfrom->id);
+                return;
+            }
+            nSessionID = psession->GetSessionID();
 
-        for (const auto& txin : vecTxIn) {
-            nTxInIndex++;
-            if (!AddScriptSig(txin)) {
-                LogPrint("privatesend", "DSSIGNFINALTX -- AddScriptSig() failed at %d/%d, session: %d\n", nTxInIndex, nTxInsCount, nSessionID);
-                RelayStatus(STATUS_REJECTED, connman);
+            if (!psession->PrepareScriptSigs(vecTxIn, vecChecks)) {
+                LogPrint("privatesend", "DSSIGNFINALTX -- PrepareScriptSigs() failed, session: %d\n", nSessionID);
+                psession->RelayStatus(STATUS_REJECTED, connman);
+                CheckSession(nSessionID, connman);
                 return;
             }
-            LogPrint("privatesend", "DSSIGNFINALTX -- AddScriptSig() %d/%d success\n", nTxInIndex, nTxInsCount);
+            txFinal = psession->txFinalUnsigned;
+
+            // Stop() takes the pool away under cs_sessions and runs what was pushed
+            // before, so the futures are always satisfied
+            if (verifyPool && vecTxIn.size() > 1) {
+                vecFutures.reserve(vecTxIn.size());
+                for (size_t i = 0; i < vecTxIn.size(); i++) {
+                    unsigned int nIn = vecChecks[i].first;
+                    CScript scriptSig = vecTxIn[i].scriptSig;
+                    CScript prevPubKey = vecChecks[i].second;
+                    vecFutures.emplace_back(verifyPool->push([txFinal, nIn, scriptSig, prevPubKey](int) {
+                        return CPrivateSendServerSession::VerifyScriptSig(*txFinal, nIn, scriptSig, prevPubKey);
+                    }));
+                }
+            }
+        }
+
+        bool fValid = true;
+        if (!vecFutures.empty()) {
+            for (size_t i = 0; i < vecFutures.size(); i++) {
+                if (!vecFutures[i].get() && fValid) {
+                    LogPrint("privatesend", "DSSIGNFINALTX -- VerifyScript() failed on input %d\n", vecChecks[i].first);
+                    fValid = false;
+                }
+            }
+        } else {
+            for (size_t i = 0; i < vecTxIn.size() && fValid; i++) {
+                if (!CPrivateSendServerSession::VerifyScriptSig(*txFinal, vecChecks[i].first, vecTxIn[i].scriptSig, vecChecks[i].second)) {
+                    LogPrint("privatesend", "DSSIGNFINALTX -- VerifyScript() failed on input %d\n", vecChecks[i].first);
+                    fValid = false;
+                }
+            }
+        }
+
+        LOCK(cs_sessions);
+
+        // The session may have timed out or moved on in the meantime
+        const auto it = mapSessions.find(nSessionID);
+        if (it == mapSessions.end() || it->second->GetState() != POOL_STATE_SIGNING || it->second->txFinalUnsigned != txFinal) {
+            LogPrint("privatesend", "DSSIGNFINALTX -- session %d is no longer waiting for these signatures, peer=%d\n", nSessionID, pfrom->id);
+            return;
+        }
+        CPrivateSendServerSession* psession = it->second.get();
+
+        if (!fValid || !psession->AddScriptSigs(vecTxIn, vecChecks)) {
+            LogPrint("privatesend", "DSSIGNFINALTX -- AddScriptSigs() failed, session: %d\n", nSessionID);
+            psession->RelayStatus(STATUS_REJECTED, connman);
+        }
+        CheckSession(nSessionID, connman);
+    }
+}
+
+CPrivateSendServerSession* CPrivateSendServer::GetParticipantSession(const CService& addr)
+{
+    AssertLockHeld(cs_sessions);
+    const auto it = mapParticipants.find(addr);
+    if (it == mapParticipants.end()) return nullptr;
+    const auto itSession = mapSessions.find(it->second);
+    return itSession == mapSessions.end() ? nullptr : itSession->second.get();
+}
+
+void CPrivateSendServer::RemoveSession(int nSessionID)
+{
+    AssertLockHeld(cs_sessions);
+    LogPrint("privatesend", "CPrivateSendServer::%s -- nSessionID: %d\n", __func__, nSessionID);
+    mapSessions.erase(nSessionID);
+    for (auto it = mapParticipants.begin(); it != mapParticipants.end(); ) {
+        if (it->second == nSessionID) {
+            it = mapParticipants.erase(it);
+        } else {
+            ++it;
         }
-        // all is good
-        CheckPool(connman);
     }
 }
 
 void CPrivateSendServer::SetNull()
 {
-    // MN side
-    vecSessionCollaterals.clear();
+    LOCK(cs_sessions);
+    mapSessions.clear();
+    mapParticipants.clear();
 
-    CPrivateSendBaseSession::SetNull();
     CPrivateSendBaseManager::SetNull();
 }
 
 //
-// Check the mixing progress and send client updates if a Masternode
+// Check the mixing progress of a session and send client updates if a Masternode,
+// every step is taken as soon as the message completing the previous one arrives
 //
-void CPrivateSendServer::CheckPool(CConnman& connman)
+void CPrivateSendServer::CheckSession(int nSessionID, CConnman& connman)
 {
+    AssertLockHeld(cs_sessions);
+
     if (!fMasternodeMode) return;
 
-    LogPrint("privatesend", "CPrivateSendServer::CheckPool -- entries count %lu\n", GetEntriesCount());
+    const auto it = mapSessions.find(nSessionID);
+    if (it == mapSessions.end()) return;
+    CPrivateSendServerSession& session = *it->second;
+
+    LogPrint("privatesend", "CPrivateSendServer::CheckSession -- nSessionID: %d  entries count %lu\n", nSessionID, session.GetEntriesCount());
+
+    // Check to see if we're ready for submissions from clients
+    // After receiving multiple dsa messages, the queue will switch to "accepting entries"
+    // which is the active state right before merging the transaction
+    if (session.GetState() == POOL_STATE_QUEUE && session.IsSessionReady()) {
+        session.SetState(POOL_STATE_ACCEPTING_ENTRIES);
+
+        CPrivateSendQueue dsq(session.nSessionDenom, activeMasternodeInfo.outpoint, GetAdjustedTime(), true);
+        LogPrint("privatesend", "CPrivateSendServer::CheckSession -- queue is ready, signing and relaying (%s)\n", dsq.ToString());
+        if (!fUnitTest) {
+            dsq.Sign();
+            dsq.Relay(connman);
+        }
+
+        // the queue is closed, allow another session to gather users while this one mixes
+        LOCK(cs_vecqueue);
+        vecPrivateSendQueue.erase(std::remove_if(vecPrivateSendQueue.begin(), vecPrivateSendQueue.end(), [](const CPrivateSendQueue& q) {
+            return q.masternodeOutpoint == activeMasternodeInfo.outpoint;
+        }), vecPrivateSendQueue.end());
+    }
 
     // If entries are full, create finalized transaction
-    if (nState == POOL_STATE_ACCEPTING_ENTRIES && GetEntriesCount() >= CPrivateSend::GetMaxPoolTransactions()) {
-        LogPrint("privatesend", "CPrivateSendServer::CheckPool -- FINALIZE TRANSACTIONS\n");
-        CreateFinalTransaction(connman);
-        return;
+    if (session.GetState() == POOL_STATE_ACCEPTING_ENTRIES && session.GetEntriesCount() >= CPrivateSend::GetMaxPoolTransactions()) {
+        LogPrint("privatesend", "CPrivateSendServer::CheckSession -- FINALIZE TRANSACTIONS\n");
+        session.CreateFinalTransaction(connman);
     }
 
     // If we have all of the signatures, try to compile the transaction
-    if (nState == POOL_STATE_SIGNING && IsSignaturesComplete()) {
-        LogPrint("privatesend", "CPrivateSendServer::CheckPool -- SIGNING\n");
-        CommitFinalTransaction(connman);
+    if (session.GetState() == POOL_STATE_SIGNING && session.IsSignaturesComplete()) {
+        LogPrint("privatesend", "CPrivateSendServer::CheckSession -- SIGNING\n");
+        session.CommitFinalTransaction(connman);
+    }
+
+    // The session is reset once it's done or it can't continue
+    if (session.GetState() == POOL_STATE_IDLE) {
+        RemoveSession(nSessionID);
+    }
+}
+
+void CPrivateSendServer::ScheduleTimeout(const CPrivateSendServerSession& session, CConnman& connman)
+{
+    AssertLockHeld(cs_sessions);
+    if (!pscheduler) return;
+
+    int64_t nDelay = std::max<int64_t>(1, session.nTimeLastSuccessfulStep + session.GetTimeout() - GetTime());
+    pscheduler->scheduleFromNow(boost::bind(&CPrivateSendServer::CheckSessionTimeout, this, session.GetSessionID(), boost::ref(connman)), nDelay);
+}
+
+void CPrivateSendServer::CheckSessionTimeout(int nSessionID, CConnman& connman)
+{
+    if (ShutdownRequested()) return;
+
+    LOCK(cs_sessions);
+
+    const auto it = mapSessions.find(nSessionID);
+    if (it == mapSessions.end()) return;
+
+    CPrivateSendServerSession& session = *it->second;
+    int nTimeout = session.GetTimeout();
+    if (GetTime() - session.nTimeLastSuccessfulStep < nTimeout) {
+        // the session moved on since the timer was set
+        ScheduleTimeout(session, connman);
         return;
     }
+
+    LogPrint("privatesend", "CPrivateSendServer::CheckSessionTimeout -- %s timed out (%ds) -- resetting, nSessionID: %d\n",
+        (session.GetState() == POOL_STATE_SIGNING) ? "Signing" : "Session", nTimeout, nSessionID);
+    session.ChargeFees(connman);
+    RemoveSession(nSessionID);
+}
+
+CPrivateSendServerSession::CPrivateSendServerSession(int nSessionIDIn, int nSessionDenomIn) :
+    vecSessionCollaterals(),
+    txFinalUnsigned()
+{
+    nSessionID = nSessionIDIn;
+    nSessionDenom = nSessionDenomIn;
+    nState = POOL_STATE_QUEUE;
+    nTimeLastSuccessfulStep = GetTime();
+}
+
+void CPrivateSendServerSession::SetNull()
+{
+    // MN side
+    vecSessionCollaterals.clear();
+    txFinalUnsigned.reset();
+
+    CPrivateSendBaseSession::SetNull();
 }
 
-void CPrivateSendServer::CreateFinalTransaction(CConnman& connman)
+void CPrivateSendServerSession::CreateFinalTransaction(CConnman& connman)
 {
-    LogPrint("privatesend", "CPrivateSendServer::CreateFinalTransaction -- FINALIZE TRANSACTIONS\n");
+    LogPrint("privatesend", "CPrivateSendServerSession::CreateFinalTransaction -- FINALIZE TRANSACTIONS\n");
 
     CMutableTransaction txNew;
 
@@ -324,37 +548,39 @@ void CPrivateSendServer::CreateFinalTransaction(CConnman& connman)
     sort(txNew.vout.begin(), txNew.vout.end(), CompareOutputBIP69());
 
     finalMutableTransaction = txNew;
-    LogPrint("privatesend", "CPrivateSendServer::CreateFinalTransaction -- finalMutableTransaction=%s", txNew.ToString());
+    txFinalUnsigned = MakeTransactionRef(txNew);
+    LogPrint("privatesend", "CPrivateSendServerSession::CreateFinalTransaction -- finalMutableTransaction=%s", txNew.ToString());
 
     // request signatures from clients
     RelayFinalTransaction(finalMutableTransaction, connman);
     SetState(POOL_STATE_SIGNING);
 }
 
-void CPrivateSendServer::CommitFinalTransaction(CConnman& connman)
+void CPrivateSendServerSession::CommitFinalTransaction(CConnman& connman)
 {
     if (!fMasternodeMode) return; // check and relay final tx only on masternode
 
     CTransactionRef finalTransaction = MakeTransactionRef(finalMutableTransaction);
     uint256 hashTx = finalTransaction->GetHash();
 
-    LogPrint("privatesend", "CPrivateSendServer::CommitFinalTransaction -- finalTransaction=%s", finalTransaction->ToString());
+    LogPrint("privatesend", "CPrivateSendServerSession::CommitFinalTransaction -- finalTransaction=%s", finalTransaction->ToString());
 
     {
-        // See if the transaction is valid
+        // See if the transaction is valid, the scripts were checked already
+        // and the signature cache spares checking them again here
         TRY_LOCK(cs_main, lockMain);
         CValidationState validationState;
         mempool.PrioritiseTransaction(hashTx, hashTx.ToString(), 1000, 0.1 * COIN);
         if (!lockMain || !AcceptToMemoryPool(mempool, validationState, finalTransaction, false, NULL, false, maxTxFee, true)) {
-            LogPrintf("CPrivateSendServer::CommitFinalTransaction -- AcceptToMemoryPool() error: Transaction not valid\n");
-            SetNull();
+            LogPrintf("CPrivateSendServerSession::CommitFinalTransaction -- AcceptToMemoryPool() error: Transaction not valid\n");
             // not much we can do in this case, just notify clients
             RelayCompletedTransaction(ERR_INVALID_TX, connman);
+            SetNull();
             return;
         }
     }
 
-    LogPrintf("CPrivateSendServer::CommitFinalTransaction -- CREATING DSTX\n");
+    LogPrintf("CPrivateSendServerSession::CommitFinalTransaction -- CREATING DSTX\n");
 
     // create and sign masternode dstx transaction
     if (!CPrivateSend::GetDSTX(hashTx)) {
@@ -363,7 +589,7 @@ void CPrivateSendServer::CommitFinalTransaction(CConnman& connman)
         CPrivateSend::AddDSTX(dstxNew);
     }
 
-    LogPrintf("CPrivateSendServer::CommitFinalTransaction -- TRANSMITTING DSTX\n");
+    LogPrintf("CPrivateSendServerSession::CommitFinalTransaction -- TRANSMITTING DSTX\n");
 
     CInv inv(MSG_DSTX, hashTx);
     connman.RelayInv(inv);
@@ -375,10 +601,11 @@ void CPrivateSendServer::CommitFinalTransaction(CConnman& connman)
     ChargeRandomFees(connman);
 
     // Reset
-    LogPrint("privatesend", "CPrivateSendServer::CommitFinalTransaction -- COMPLETED -- RESETTING\n");
+    LogPrint("privatesend", "CPrivateSendServerSession::CommitFinalTransaction -- COMPLETED -- RESETTING\n");
     SetNull();
 }
 
+
 //
 // Charge clients a fee if they're abusive
 //
@@ -391,7 +618,7 @@ void CPrivateSendServer::CommitFinalTransaction(CConnman& connman)
 // transaction for the client to be able to enter the pool. This transaction is kept by the Masternode
 // until the transaction is either complete or fails.
 //
-void CPrivateSendServer::ChargeFees(CConnman& connman)
+void CPrivateSendServerSession::ChargeFees(CConnman& connman)
 {
     if (!fMasternodeMode) return;
 
@@ -409,7 +636,7 @@ void CPrivateSendServer::ChargeFees(CConnman& connman)
 
             // This queue entry didn't send us the promised transaction
             if (!fFound) {
-                LogPrintf("CPrivateSendServer::ChargeFees -- found uncooperative node (didn't send transaction), found offence\n");
+                LogPrintf("CPrivateSendServerSession::ChargeFees -- found uncooperative node (didn't send transaction), found offence\n");
                 vecOffendersCollaterals.push_back(txCollateral);
             }
         }
@@ -420,7 +647,7 @@ void CPrivateSendServer::ChargeFees(CConnman& connman)
         for (const auto& entry : vecEntries) {
             for (const auto& txdsin : entry.vecTxDSIn) {
                 if (!txdsin.fHasSig) {
-                    LogPrintf("CPrivateSendServer::ChargeFees -- found uncooperative node (didn't sign), found offence\n");
+                    LogPrintf("CPrivateSendServerSession::ChargeFees -- found uncooperative node (didn't sign), found offence\n");
                     vecOffendersCollaterals.push_back(entry.txCollateral);
                 }
             }
@@ -440,7 +667,7 @@ void CPrivateSendServer::ChargeFees(CConnman& connman)
     std::random_shuffle(vecOffendersCollaterals.begin(), vecOffendersCollaterals.end());
 
     if (nState == POOL_STATE_ACCEPTING_ENTRIES || nState == POOL_STATE_SIGNING) {
-        LogPrintf("CPrivateSendServer::ChargeFees -- found uncooperative node (didn't %s transaction), charging fees: %s",
+        LogPrintf("CPrivateSendServerSession::ChargeFees -- found uncooperative node (didn't %s transaction), charging fees: %s",
             (nState == POOL_STATE_SIGNING) ? "sign" : "send", vecOffendersCollaterals[0]->ToString());
 
         LOCK(cs_main);
@@ -448,7 +675,7 @@ void CPrivateSendServer::ChargeFees(CConnman& connman)
         CValidationState state;
         if (!AcceptToMemoryPool(mempool, state, vecOffendersCollaterals[0], false, NULL, false, maxTxFee)) {
             // should never really happen
-            LogPrintf("CPrivateSendServer::ChargeFees -- ERROR: AcceptToMemoryPool failed!\n");
+            LogPrintf("CPrivateSendServerSession::ChargeFees -- ERROR: AcceptToMemoryPool failed!\n");
         } else {
             connman.RelayTransaction(*vecOffendersCollaterals[0]);
         }
@@ -467,7 +694,7 @@ void CPrivateSendServer::ChargeFees(CConnman& connman)
     stop these kinds of attacks 1 in 10 successful transactions are charged. This
     adds up to a cost of 0.001DRK per transaction on average.
 */
-void CPrivateSendServer::ChargeRandomFees(CConnman& connman)
+void CPrivateSendServerSession::ChargeRandomFees(CConnman& connman)
 {
     if (!fMasternodeMode) return;
 
@@ -475,12 +702,12 @@ void CPrivateSendServer::ChargeRandomFees(CConnman& connman)
 
     for (const auto& txCollateral : vecSessionCollaterals) {
         if (GetRandInt(100) > 10) return;
-        LogPrintf("CPrivateSendServer::ChargeRandomFees -- charging random fees, txCollateral=%s", txCollateral->ToString());
+        LogPrintf("CPrivateSendServerSession::ChargeRandomFees -- charging random fees, txCollateral=%s", txCollateral->ToString());
 
         CValidationState state;
         if (!AcceptToMemoryPool(mempool, state, txCollateral, false, NULL, false, maxTxFee)) {
             // should never really happen
-            LogPrintf("CPrivateSendServer::ChargeRandomFees -- ERROR: AcceptToMemoryPool failed!\n");
+            LogPrintf("CPrivateSendServerSession::ChargeRandomFees -- ERROR: AcceptToMemoryPool failed!\n");
         } else {
             connman.RelayTransaction(*txCollateral);
         }
@@ -496,101 +723,44 @@ void CPrivateSendServer::CheckTimeout(CConnman& connman)
 
     CheckQueue();
 
-    int nTimeout = (nState == POOL_STATE_SIGNING) ? PRIVATESEND_SIGNING_TIMEOUT : PRIVATESEND_QUEUE_TIMEOUT;
-    bool fTimeout = GetTime() - nTimeLastSuccessfulStep >= nTimeout;
-
-    if (nState != POOL_STATE_IDLE && fTimeout) {
-        LogPrint("privatesend", "CPrivateSendServer::CheckTimeout -- %s timed out (%ds) -- resetting\n",
-            (nState == POOL_STATE_SIGNING) ? "Signing" : "Session", nTimeout);
-        ChargeFees(connman);
-        SetNull();
-    }
-}
-
-/*
-    Check to see if we're ready for submissions from clients
-    After receiving multiple dsa messages, the queue will switch to "accepting entries"
-    which is the active state right before merging the transaction
-*/
-void CPrivateSendServer::CheckForCompleteQueue(CConnman& connman)
-{
-    if (!fMasternodeMode) return;
-
-    if (nState == POOL_STATE_QUEUE && IsSessionReady()) {
-        SetState(POOL_STATE_ACCEPTING_ENTRIES);
-
-        CPrivateSendQueue dsq(nSessionDenom, activeMasternodeInfo.outpoint, GetAdjustedTime(), true);
-        LogPrint("privatesend", "CPrivateSendServer::CheckForCompleteQueue -- queue is ready, signing and relaying (%s)\n", dsq.ToString());
-        dsq.Sign();
-        dsq.Relay(connman);
-    }
-}
-
-// Check to make sure a given input matches an input in the pool and its scriptSig is valid
-bool CPrivateSendServer::IsInputScriptSigValid(const CTxIn& txin)
-{
-    CMutableTransaction txNew;
-    txNew.vin.clear();
-    txNew.vout.clear();
-
-    int i = 0;
-    int nTxInIndex = -1;
-    CScript sigPubKey = CScript();
-
-    for (const auto& entry : vecEntries) {
-        for (const auto& txout : entry.vecTxOut)
-            txNew.vout.push_back(txout);
-
-        for (const auto& txdsin : entry.vecTxDSIn) {
-            txNew.vin.push_back(txdsin);
-
-            if (txdsin.prevout == txin.prevout) {
-                nTxInIndex = i;
-                sigPubKey = txdsin.prevPubKey;
-            }
-            i++;
+    std::vector<int> vecSessionIDs;
+    {
+        LOCK(cs_sessions);
+        // sessions time out on their own timers when there is a scheduler
+        if (pscheduler) return;
+        for (const auto& pair : mapSessions) {
+            vecSessionIDs.push_back(pair.first);
         }
     }
 
-    if (nTxInIndex >= 0) { //might have to do this one input at a time?
-        txNew.vin[nTxInIndex].scriptSig = txin.scriptSig;
-        LogPrint("privatesend", "CPrivateSendServer::IsInputScriptSigValid -- verifying scriptSig %s\n", ScriptToAsmStr(txin.scriptSig).substr(0, 24));
-        if (!VerifyScript(txNew.vin[nTxInIndex].scriptSig, sigPubKey, SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC, MutableTransactionSignatureChecker(&txNew, nTxInIndex))) {
-            LogPrint("privatesend", "CPrivateSendServer::IsInputScriptSigValid -- VerifyScript() failed on input %d\n", nTxInIndex);
-            return false;
-        }
-    } else {
-        LogPrint("privatesend", "CPrivateSendServer::IsInputScriptSigValid -- Failed to find matching input in pool, %s\n", txin.ToString());
-        return false;
+    for (int nSessionID : vecSessionIDs) {
+        CheckSessionTimeout(nSessionID, connman);
     }
-
-    LogPrint("privatesend", "CPrivateSendServer::IsInputScriptSigValid -- Successfully validated input and scriptSig\n");
-    return true;
 }
 
 //
 // Add a clients transaction to the pool
 //
-bool CPrivateSendServer::AddEntry(const CPrivateSendEntry& entryNew, PoolMessage& nMessageIDRet)
+bool CPrivateSendServerSession::AddEntry(const CPrivateSendEntry& entryNew, PoolMessage& nMessageIDRet)
 {
     if (!fMasternodeMode) return false;
 
     for (const auto& txin : entryNew.vecTxDSIn) {
         if (txin.prevout.IsNull()) {
-            LogPrint("privatesend", "CPrivateSendServer::AddEntry -- input not valid!\n");
+            LogPrint("privatesend", "CPrivateSendServerSession::AddEntry -- input not valid!\n");
             nMessageIDRet = ERR_INVALID_INPUT;
             return false;
         }
     }
 
     if (!CPrivateSend::IsCollateralValid(*entryNew.txCollateral)) {
-        LogPrint("privatesend", "CPrivateSendServer::AddEntry -- collateral not valid!\n");
+        LogPrint("privatesend", "CPrivateSendServerSession::AddEntry -- collateral not valid!\n");
         nMessageIDRet = ERR_INVALID_COLLATERAL;
         return false;
     }
 
     if (GetEntriesCount() >= CPrivateSend::GetMaxPoolTransactions()) {
-        LogPrint("privatesend", "CPrivateSendServer::AddEntry -- entries is full!\n");
+        LogPrint("privatesend", "CPrivateSendServerSession::AddEntry -- entries is full!\n");
         nMessageIDRet = ERR_ENTRIES_FULL;
         return false;
     }
@@ -600,7 +770,7 @@ bool CPrivateSendServer::AddEntry(const CPrivateSendEntry& entryNew, PoolMessage
         for (const auto& entry : vecEntries) {
             for (const auto& txdsin : entry.vecTxDSIn) {
                 if (txdsin.prevout == txin.prevout) {
-                    LogPrint("privatesend", "CPrivateSendServer::AddEntry -- found in txin\n");
+                    LogPrint("privatesend", "CPrivateSendServerSession::AddEntry -- found in txin\n");
                     nMessageIDRet = ERR_ALREADY_HAVE;
                     return false;
                 }
@@ -610,52 +780,90 @@ bool CPrivateSendServer::AddEntry(const CPrivateSendEntry& entryNew, PoolMessage
 
     vecEntries.push_back(entryNew);
 
-    LogPrint("privatesend", "CPrivateSendServer::AddEntry -- adding entry\n");
+    LogPrint("privatesend", "CPrivateSendServerSession::AddEntry -- adding entry\n");
     nMessageIDRet = MSG_ENTRIES_ADDED;
     nTimeLastSuccessfulStep = GetTime();
 
     return true;
 }
 
-bool CPrivateSendServer::AddScriptSig(const CTxIn& txinNew)
+bool CPrivateSendServerSession::PrepareScriptSigs(const std::vector<CTxIn>& vecTxIn, std::vector<std::pair<unsigned int, CScript> >& vecChecksRet) const
 {
-    LogPrint("privatesend", "CPrivateSendServer::AddScriptSig -- scriptSig=%s\n", ScriptToAsmStr(txinNew.scriptSig).substr(0, 24));
+    if (!txFinalUnsigned) return false;
 
-    for (const auto& entry : vecEntries) {
-        for (const auto& txdsin : entry.vecTxDSIn) {
-            if (txdsin.scriptSig == txinNew.scriptSig) {
-                LogPrint("privatesend", "CPrivateSendServer::AddScriptSig -- already exists\n");
-                return false;
+    // Find the position of every input in the final transaction and the script it spends
+    vecChecksRet.clear();
+    std::set<COutPoint> setPrevouts;
+    for (const auto& txin : vecTxIn) {
+        LogPrint("privatesend", "CPrivateSendServerSession::PrepareScriptSigs -- scriptSig=%s\n", ScriptToAsmStr(txin.scriptSig).substr(0, 24));
+
+        if (!setPrevouts.insert(txin.prevout).second) {
+            LogPrint("privatesend", "CPrivateSendServerSession::PrepareScriptSigs -- already exists\n");
+            return false;
+        }
+
+        int nTxInIndex = -1;
+        for (unsigned int i = 0; i < finalMutableTransaction.vin.size(); i++) {
+            if (finalMutableTransaction.vin[i].prevout == txin.prevout && finalMutableTransaction.vin[i].nSequence == txin.nSequence) {
+                nTxInIndex = i;
+                break;
             }
         }
-    }
 
-    if (!IsInputScriptSigValid(txinNew)) {
-        LogPrint("privatesend", "CPrivateSendServer::AddScriptSig -- Invalid scriptSig\n");
-        return false;
+        const CTxDSIn* ptxdsin = nullptr;
+        for (const auto& entry : vecEntries) {
+            for (const auto& txdsin : entry.vecTxDSIn) {
+                if (txdsin.prevout == txin.prevout) {
+                    ptxdsin = &txdsin;
+                }
+            }
+        }
+
+        if (nTxInIndex < 0 || !ptxdsin) {
+            LogPrint("privatesend", "CPrivateSendServerSession::PrepareScriptSigs -- Failed to find matching input in pool, %s\n", txin.ToString());
+            return false;
+        }
+        if (ptxdsin->fHasSig) {
+            LogPrint("privatesend", "CPrivateSendServerSession::PrepareScriptSigs -- already exists\n");
+            return false;
+        }
+        vecChecksRet.emplace_back(nTxInIndex, ptxdsin->prevPubKey);
     }
 
-    LogPrint("privatesend", "CPrivateSendServer::AddScriptSig -- scriptSig=%s new\n", ScriptToAsmStr(txinNew.scriptSig).substr(0, 24));
+    return true;
+}
 
-    for (auto& txin : finalMutableTransaction.vin) {
-        if (txin.prevout == txinNew.prevout && txin.nSequence == txinNew.nSequence) {
-            txin.scriptSig = txinNew.scriptSig;
-            LogPrint("privatesend", "CPrivateSendServer::AddScriptSig -- adding to finalMutableTransaction, scriptSig=%s\n", ScriptToAsmStr(txinNew.scriptSig).substr(0, 24));
-        }
+bool CPrivateSendServerSession::VerifyScriptSig(const CTransaction& txFinal, unsigned int nIn, const CScript& scriptSig, const CScript& prevPubKey)
+{
+    // Signature hashes don't depend on the scriptSigs of the other inputs, the cache
+    // remembers valid signatures for AcceptToMemoryPool
+    CachingTransactionSignatureChecker checker(&txFinal, nIn);
+    return VerifyScript(scriptSig, prevPubKey, SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC, checker);
+}
+
+bool CPrivateSendServerSession::AddScriptSigs(const std::vector<CTxIn>& vecTxIn, const std::vector<std::pair<unsigned int, CScript> >& vecChecks)
+{
+    // Nothing may have changed about these inputs while their signatures were verified
+    std::vector<std::pair<unsigned int, CScript> > vecChecksNow;
+    if (!PrepareScriptSigs(vecTxIn, vecChecksNow) || vecChecksNow != vecChecks) {
+        return false;
     }
-    for (int i = 0; i < GetEntriesCount(); i++) {
-        if (vecEntries[i].AddScriptSig(txinNew)) {
-            LogPrint("privatesend", "CPrivateSendServer::AddScriptSig -- adding to entries, scriptSig=%s\n", ScriptToAsmStr(txinNew.scriptSig).substr(0, 24));
-            return true;
+
+    for (size_t i = 0; i < vecTxIn.size(); i++) {
+        finalMutableTransaction.vin[vecChecks[i].first].scriptSig = vecTxIn[i].scriptSig;
+        for (auto& entry : vecEntries) {
+            if (entry.AddScriptSig(vecTxIn[i])) {
+                break;
+            }
         }
     }
 
-    LogPrintf("CPrivateSendServer::AddScriptSig -- Couldn't set sig!\n");
-    return false;
+    LogPrint("privatesend", "CPrivateSendServerSession::AddScriptSigs -- %d scriptSig(s) added, session: %d\n", vecTxIn.size(), nSessionID);
+    return true;
 }
 
 // Check to make sure everything is signed
-bool CPrivateSendServer::IsSignaturesComplete()
+bool CPrivateSendServerSession::IsSignaturesComplete() const
 {
     for (const auto& entry : vecEntries)
         for (const auto& txdsin : entry.vecTxDSIn)
@@ -664,12 +872,12 @@ bool CPrivateSendServer::IsSignaturesComplete()
     return true;
 }
 
-bool CPrivateSendServer::IsOutputsCompatibleWithSessionDenom(const std::vector<CTxOut>& vecTxOut)
+bool CPrivateSendServerSession::IsOutputsCompatibleWithSessionDenom(const std::vector<CTxOut>& vecTxOut) const
 {
     if (CPrivateSend::GetDenominations(vecTxOut) == 0) return false;
 
     for (const auto& entry : vecEntries) {
-        LogPrintf("CPrivateSendServer::IsOutputsCompatibleWithSessionDenom -- vecTxOut denom %d, entry.vecTxOut denom %d\n",
+        LogPrintf("CPrivateSendServerSession::IsOutputsCompatibleWithSessionDenom -- vecTxOut denom %d, entry.vecTxOut denom %d\n",
             CPrivateSend::GetDenominations(vecTxOut), CPrivateSend::GetDenominations(entry.vecTxOut));
         if (CPrivateSend::GetDenominations(vecTxOut) != CPrivateSend::GetDenominations(entry.vecTxOut)) return false;
     }
@@ -699,82 +907,102 @@ bool CPrivateSendServer::IsAcceptableDSA(const CPrivateSendAccept& dsa, PoolMess
     return true;
 }
 
-bool CPrivateSendServer::CreateNewSession(const CPrivateSendAccept& dsa, PoolMessage& nMessageIDRet, CConnman& connman)
+CPrivateSendServerSession* CPrivateSendServer::CreateNewSession(const CPrivateSendAccept& dsa, const CService& addr, PoolMessage& nMessageIDRet, CConnman& connman)
 {
-    if (!fMasternodeMode || nSessionID != 0) return false;
+    AssertLockHeld(cs_sessions);
 
-    // new session can only be started in idle mode
-    if (nState != POOL_STATE_IDLE) {
-        nMessageIDRet = ERR_MODE;
-        LogPrintf("CPrivateSendServer::CreateNewSession -- incompatible mode: nState=%d\n", nState);
-        return false;
-    }
+    if (!fMasternodeMode) return nullptr;
 
     if (!IsAcceptableDSA(dsa, nMessageIDRet)) {
-        return false;
+        return nullptr;
     }
 
     // start new session
-    nMessageIDRet = MSG_NOERR;
-    nSessionID = GetRandInt(999999) + 1;
-    nSessionDenom = dsa.nDenom;
+    int nSessionID;
+    do {
+        nSessionID = GetRandInt(999999) + 1;
+    } while (mapSessions.count(nSessionID));
 
-    SetState(POOL_STATE_QUEUE);
-    nTimeLastSuccessfulStep = GetTime();
+    std::unique_ptr<CPrivateSendServerSession> session(new CPrivateSendServerSession(nSessionID, dsa.nDenom));
+    CPrivateSendServerSession* psession = session.get();
+
+    nMessageIDRet = MSG_NOERR;
+    psession->AddUser(dsa, nMessageIDRet);
+    mapSessions.emplace(nSessionID, std::move(session));
+    mapParticipants.emplace(addr, nSessionID);
 
     if (!fUnitTest) {
         //broadcast that I'm accepting entries, only if it's the first entry through
-        CPrivateSendQueue dsq(nSessionDenom, activeMasternodeInfo.outpoint, GetAdjustedTime(), false);
+        CPrivateSendQueue dsq(psession->nSessionDenom, activeMasternodeInfo.outpoint, GetAdjustedTime(), false);
         LogPrint("privatesend", "CPrivateSendServer::CreateNewSession -- signing and relaying new queue: %s\n", dsq.ToString());
         dsq.Sign();
         dsq.Relay(connman);
+        LOCK(cs_vecqueue);
         vecPrivateSendQueue.push_back(dsq);
     }
 
-    vecSessionCollaterals.push_back(MakeTransactionRef(dsa.txCollateral));
-    LogPrintf("CPrivateSendServer::CreateNewSession -- new session created, nSessionID: %d  nSessionDenom: %d (%s)  vecSessionCollaterals.size(): %d\n",
-        nSessionID, nSessionDenom, CPrivateSend::GetDenominationsToString(nSessionDenom), vecSessionCollaterals.size());
+    ScheduleTimeout(*psession, connman);
 
-    return true;
+    LogPrintf("CPrivateSendServer::CreateNewSession -- new session created, nSessionID: %d  nSessionDenom: %d (%s)  sessions: %d\n",
+        nSessionID, psession->nSessionDenom, CPrivateSend::GetDenominationsToString(psession->nSessionDenom), mapSessions.size());
+
+    return psession;
 }
 
-bool CPrivateSendServer::AddUserToExistingSession(const CPrivateSendAccept& dsa, PoolMessage& nMessageIDRet)
+CPrivateSendServerSession* CPrivateSendServer::AddUserToExistingSession(const CPrivateSendAccept& dsa, const CService& addr, PoolMessage& nMessageIDRet)
 {
-    if (!fMasternodeMode || nSessionID == 0 || IsSessionReady()) return false;
+    AssertLockHeld(cs_sessions);
 
-    if (!IsAcceptableDSA(dsa, nMessageIDRet)) {
-        return false;
+    if (!fMasternodeMode) return nullptr;
+
+    // We only add new users to the session which is still in queue mode. Only one session
+    // is gathering users at any time, clients submit their entries to any session on
+    // this masternode as soon as a ready dsq shows up.
+    for (const auto& pair : mapSessions) {
+        CPrivateSendServerSession& session = *pair.second;
+        if (session.GetState() != POOL_STATE_QUEUE) continue;
+
+        if (!IsAcceptableDSA(dsa, nMessageIDRet) || !session.AddUser(dsa, nMessageIDRet)) {
+            return nullptr;
+        }
+        mapParticipants.emplace(addr, session.GetSessionID());
+        return &session;
     }
 
-    // we only add new users to an existing session when we are in queue mode
-    if (nState != POOL_STATE_QUEUE) {
-        nMessageIDRet = ERR_MODE;
-        LogPrintf("CPrivateSendServer::AddUserToExistingSession -- incompatible mode: nState=%d\n", nState);
+    return nullptr;
+}
+
+bool CPrivateSendServerSession::AddUser(const CPrivateSendAccept& dsa, PoolMessage& nMessageIDRet)
+{
+    if (IsSessionReady()) {
+        // too many users in this session already, reject new ones
+        LogPrintf("CPrivateSendServerSession::AddUser -- queue is already full!\n");
+        nMessageIDRet = ERR_QUEUE_FULL;
         return false;
     }
 
     if (dsa.nDenom != nSessionDenom) {
-        LogPrintf("CPrivateSendServer::AddUserToExistingSession -- incompatible denom %d (%s) != nSessionDenom %d (%s)\n",
+        LogPrintf("CPrivateSendServerSession::AddUser -- incompatible denom %d (%s) != nSessionDenom %d (%s)\n",
             dsa.nDenom, CPrivateSend::GetDenominationsToString(dsa.nDenom), nSessionDenom, CPrivateSend::GetDenominationsToString(nSessionDenom));
         nMessageIDRet = ERR_DENOM;
         return false;
     }
 
-    // count new user as accepted to an existing session
+    // count new user as accepted to the session
 
     nMessageIDRet = MSG_NOERR;
     nTimeLastSuccessfulStep = GetTime();
     vecSessionCollaterals.push_back(MakeTransactionRef(dsa.txCollateral));
 
-    LogPrintf("CPrivateSendServer::AddUserToExistingSession -- new user accepted, nSessionID: %d  nSessionDenom: %d (%s)  vecSessionCollaterals.size(): %d\n",
+    LogPrintf("CPrivateSendServerSession::AddUser -- new user accepted, nSessionID: %d  nSessionDenom: %d (%s)  vecSessionCollaterals.size(): %d\n",
         nSessionID, nSessionDenom, CPrivateSend::GetDenominationsToString(nSessionDenom), vecSessionCollaterals.size());
 
     return true;
 }
 
-void CPrivateSendServer::RelayFinalTransaction(const CTransaction& txFinal, CConnman& connman)
+void CPrivateSendServerSession::RelayFinalTransaction(const CTransaction& txFinal, CConnman& connman)
 {
-    LogPrint("privatesend", "CPrivateSendServer::%s -- nSessionID: %d  nSessionDenom: %d (%s)\n",
+    LogPrint("privatesend", "CPrivateSendServerSession::%s -- nSessionID: %d  nSessionDenom: %d (%s)\n",
         __func__, nSessionID, nSessionDenom, CPrivateSend::GetDenominationsToString(nSessionDenom));
 
     // final mixing tx with empty signatures should be relayed to mixing participants only
@@ -792,14 +1020,12 @@ void CPrivateSendServer::RelayFinalTransaction(const CTransaction& txFinal, CCon
     }
 }
 
-void CPrivateSendServer::PushStatus(CNode* pnode, PoolStatusUpdate nStatusUpdate, PoolMessage nMessageID, CConnman& connman)
+void CPrivateSendServerSession::PushStatus(CNode* pnode, PoolStatusUpdate nStatusUpdate, PoolMessage nMessageID, CConnman& connman) const
 {
-    if (!pnode) return;
-    CNetMsgMaker msgMaker(pnode->GetSendVersion());
-    connman.PushMessage(pnode, msgMaker.Make(NetMsgType::DSSTATUSUPDATE, nSessionID, (int)nState, (int)vecEntries.size(), (int)nStatusUpdate, (int)nMessageID));
+    PushStatusUpdate(pnode, nSessionID, nState, (int)vecEntries.size(), nStatusUpdate, nMessageID, connman);
 }
 
-void CPrivateSendServer::RelayStatus(PoolStatusUpdate nStatusUpdate, CConnman& connman, PoolMessage nMessageID)
+void CPrivateSendServerSession::RelayStatus(PoolStatusUpdate nStatusUpdate, CConnman& connman, PoolMessage nMessageID)
 {
     unsigned int nDisconnected{};
     // status updates should be relayed to mixing participants only
@@ -817,7 +1043,7 @@ void CPrivateSendServer::RelayStatus(PoolStatusUpdate nStatusUpdate, CConnman& c
     if (nDisconnected == 0) return; // all is clear
 
     // smth went wrong
-    LogPrintf("CPrivateSendServer::%s -- can't continue, %llu client(s) disconnected, nSessionID: %d  nSessionDenom: %d (%s)\n",
+    LogPrintf("CPrivateSendServerSession::%s -- can't continue, %llu client(s) disconnected, nSessionID: %d  nSessionDenom: %d (%s)\n",
         __func__, nDisconnected, nSessionID, nSessionDenom, CPrivateSend::GetDenominationsToString(nSessionDenom));
 
     // notify everyone else that this session should be terminated
@@ -835,9 +1061,9 @@ void CPrivateSendServer::RelayStatus(PoolStatusUpdate nStatusUpdate, CConnman& c
     }
 }
 
-void CPrivateSendServer::RelayCompletedTransaction(PoolMessage nMessageID, CConnman& connman)
+void CPrivateSendServerSession::RelayCompletedTransaction(PoolMessage nMessageID, CConnman& connman)
 {
-    LogPrint("privatesend", "CPrivateSendServer::%s -- nSessionID: %d  nSessionDenom: %d (%s)\n",
+    LogPrint("privatesend", "CPrivateSendServerSession::%s -- nSessionID: %d  nSessionDenom: %d (%s)\n",
         __func__, nSessionID, nSessionDenom, CPrivateSend::GetDenominationsToString(nSessionDenom));
 
     // final mixing tx with empty signatures should be relayed to mixing participants only
@@ -855,19 +1081,47 @@ void CPrivateSendServer::RelayCompletedTransaction(PoolMessage nMessageID, CConn
     }
 }
 
-void CPrivateSendServer::SetState(PoolState nStateNew)
+void CPrivateSendServerSession::SetState(PoolState nStateNew)
 {
     if (!fMasternodeMode) return;
 
     if (nStateNew == POOL_STATE_ERROR || nStateNew == POOL_STATE_SUCCESS) {
-        LogPrint("privatesend", "CPrivateSendServer::SetState -- Can't set state to ERROR or SUCCESS as a Masternode. \n");
+        LogPrint("privatesend", "CPrivateSendServerSession::SetState -- Can't set state to ERROR or SUCCESS as a Masternode. \n");
         return;
     }
 
-    LogPrintf("CPrivateSendServer::SetState -- nState: %d, nStateNew: %d\n", nState, nStateNew);
+    LogPrintf("CPrivateSendServerSession::SetState -- nSessionID: %d, nState: %d, nStateNew: %d\n", nSessionID, nState, nStateNew);
     nState = nStateNew;
 }
 
+int CPrivateSendServer::GetSessionCount() const
+{
+    LOCK(cs_sessions);
+    return mapSessions.size();
+}
+
+int CPrivateSendServer::GetEntriesCount() const
+{
+    LOCK(cs_sessions);
+    int nCount = 0;
+    for (const auto& pair : mapSessions) {
+        nCount += pair.second->GetEntriesCount();
+    }
+    return nCount;
+}
+
+std::string CPrivateSendServer::GetStateString() const
+{
+    LOCK(cs_sessions);
+    const CPrivateSendServerSession* pnewest = nullptr;
+    for (const auto& pair : mapSessions) {
+        if (!pnewest || pair.second->nTimeLastSuccessfulStep >= pnewest->nTimeLastSuccessfulStep) {
+            pnewest = pair.second.get();
+        }
+    }
+    return pnewest ? pnewest->GetStateString() : "IDLE";
+}
+
 void CPrivateSendServer::DoMaintenance(CConnman& connman)
 {
     if (fLiteMode) return;        // disable all Blaze specific functionality
@@ -877,5 +1131,4 @@ void CPrivateSendServer::DoMaintenance(CConnman& connman)
         return;
 
     privateSendServer.CheckTimeout(connman);
-    privateSendServer.CheckForCompleteQueue(connman);
 }
@@ -10,71 +10,130 @@
 #include "net.h"
 #include "privatesend.h"
 
+#include <memory>
+
 class CPrivateSendServer;
+class CScheduler;
+
+namespace ctpl {
+class thread_pool;
+}
 
 // The main object for accessing mixing
 extern CPrivateSendServer privateSendServer;
 
-/** Used to keep track of current status of mixing pool
+//! maximum number of mixing sessions a masternode serves at the same time
+static const int MAX_PRIVATESEND_SERVER_SESSIONS = 8;
+static const int DEFAULT_PRIVATESEND_VERIFY_THREADS = 2;
+
+/** A single mixing session served by this masternode
  */
-class CPrivateSendServer : public CPrivateSendBaseSession, public CPrivateSendBaseManager
+class CPrivateSendServerSession : public CPrivateSendBaseSession
 {
-private:
+    friend class CPrivateSendServer;
+
+protected:
     // Mixing uses collateral transactions to trust parties entering the pool
     // to behave honestly. If they don't it takes their money.
     std::vector<CTransactionRef> vecSessionCollaterals;
 
-    bool fUnitTest;
+    // The final transaction without any signatures, signature hashes do not
+    // depend on the scriptSigs of other inputs so all of them are checked against it
+    CTransactionRef txFinalUnsigned;
 
     /// Add a clients entry to the pool
     bool AddEntry(const CPrivateSendEntry& entryNew, PoolMessage& nMessageIDRet);
-    /// Add signature to a txin
-    bool AddScriptSig(const CTxIn& txin);
+    /// Find the unsigned inputs of the final transaction a client signed, with the scripts they spend
+    bool PrepareScriptSigs(const std::vector<CTxIn>& vecTxIn, std::vector<std::pair<unsigned int, CScript> >& vecChecksRet) const;
+    /// Add the signatures of a client once they are verified, vecChecks is what PrepareScriptSigs() found for them
+    bool AddScriptSigs(const std::vector<CTxIn>& vecTxIn, const std::vector<std::pair<unsigned int, CScript> >& vecChecks);
 
     /// Charge fees to bad actors (Charge clients a fee if they're abusive)
     void ChargeFees(CConnman& connman);
     /// Rarely charge fees to pay miners
     void ChargeRandomFees(CConnman& connman);
 
-    /// Check for process
-    void CheckPool(CConnman& connman);
-
     void CreateFinalTransaction(CConnman& connman);
     void CommitFinalTransaction(CConnman& connman);
 
-    /// Is this nDenom and txCollateral acceptable?
-    bool IsAcceptableDSA(const CPrivateSendAccept& dsa, PoolMessage& nMessageIDRet);
-    bool CreateNewSession(const CPrivateSendAccept& dsa, PoolMessage& nMessageIDRet, CConnman& connman);
-    bool AddUserToExistingSession(const CPrivateSendAccept& dsa, PoolMessage& nMessageIDRet);
+    bool AddUser(const CPrivateSendAccept& dsa, PoolMessage& nMessageIDRet);
     /// Do we have enough users to take entries?
-    bool IsSessionReady() { return (int)vecSessionCollaterals.size() >= CPrivateSend::GetMaxPoolTransactions(); }
+    bool IsSessionReady() const { return (int)vecSessionCollaterals.size() >= CPrivateSend::GetMaxPoolTransactions(); }
 
     /// Check that all inputs are signed. (Are all inputs signed?)
-    bool IsSignaturesComplete();
-    /// Check to make sure a given input matches an input in the pool and its scriptSig is valid
-    bool IsInputScriptSigValid(const CTxIn& txin);
+    bool IsSignaturesComplete() const;
     /// Are these outputs compatible with other client in the pool?
-    bool IsOutputsCompatibleWithSessionDenom(const std::vector<CTxOut>& vecTxOut);
+    bool IsOutputsCompatibleWithSessionDenom(const std::vector<CTxOut>& vecTxOut) const;
 
     // Set the 'state' value, with some logging and capturing when the state changed
     void SetState(PoolState nStateNew);
+    void SetNull();
+    int GetTimeout() const { return nState == POOL_STATE_SIGNING ? PRIVATESEND_SIGNING_TIMEOUT : PRIVATESEND_QUEUE_TIMEOUT; }
 
     /// Relay mixing Messages
     void RelayFinalTransaction(const CTransaction& txFinal, CConnman& connman);
-    void PushStatus(CNode* pnode, PoolStatusUpdate nStatusUpdate, PoolMessage nMessageID, CConnman& connman);
+    void PushStatus(CNode* pnode, PoolStatusUpdate nStatusUpdate, PoolMessage nMessageID, CConnman& connman) const;
     void RelayStatus(PoolStatusUpdate nStatusUpdate, CConnman& connman, PoolMessage nMessageID = MSG_NOERR);
     void RelayCompletedTransaction(PoolMessage nMessageID, CConnman& connman);
 
+public:
+    CPrivateSendServerSession(int nSessionIDIn, int nSessionDenomIn);
+
+    int GetSessionID() const { return nSessionID; }
+
+    /// Check the scriptSig of input nIn of the unsigned final transaction, valid ones go to the signature cache
+    static bool VerifyScriptSig(const CTransaction& txFinal, unsigned int nIn, const CScript& scriptSig, const CScript& prevPubKey);
+};
+
+/** Used to keep track of the mixing sessions served by this masternode
+ */
+class CPrivateSendServer : public CPrivateSendBaseManager
+{
+protected:
+    // Protects the sessions and the participants, taken before the lock of any session
+    mutable CCriticalSection cs_sessions;
+
+    std::map<int, std::unique_ptr<CPrivateSendServerSession> > mapSessions;
+    // Session every accepted peer belongs to
+    std::map<CService, int> mapParticipants;
+
+    // Session timeouts are scheduled here, polled by DoMaintenance if there is none
+    CScheduler* pscheduler;
+    // Checks signatures of the final transactions
+    std::unique_ptr<ctpl::thread_pool> verifyPool;
+
+    bool fUnitTest;
+
+    /// Is this nDenom and txCollateral acceptable?
+    bool IsAcceptableDSA(const CPrivateSendAccept& dsa, PoolMessage& nMessageIDRet);
+    CPrivateSendServerSession* CreateNewSession(const CPrivateSendAccept& dsa, const CService& addr, PoolMessage& nMessageIDRet, CConnman& connman);
+    CPrivateSendServerSession* AddUserToExistingSession(const CPrivateSendAccept& dsa, const CService& addr, PoolMessage& nMessageIDRet);
+    /// Find the session a peer was accepted into
+    CPrivateSendServerSession* GetParticipantSession(const CService& addr);
+
+    /// Move the session along after a successful step
+    void CheckSession(int nSessionID, CConnman& connman);
+    void RemoveSession(int nSessionID);
+    void ScheduleTimeout(const CPrivateSendServerSession& session, CConnman& connman);
+    void CheckSessionTimeout(int nSessionID, CConnman& connman);
+
     void SetNull();
 
 public:
-    CPrivateSendServer() :
-        vecSessionCollaterals(), fUnitTest(false) {}
+    CPrivateSendServer();
+    ~CPrivateSendServer();
+
+    void Start(CScheduler& scheduler, int nVerifyThreads);
+    void Stop();
 
     void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman);
 
     void CheckTimeout(CConnman& connman);
-    void CheckForCompleteQueue(CConnman& connman);
+
+    int GetSessionCount() const;
+    int GetEntriesCount() const;
+    /// State of the newest session
+    std::string GetStateString() const;
 
     void DoMaintenance(CConnman& connman);
 };
@@ -232,7 +232,7 @@ public:
     bool Relay(CConnman& connman);
 
     /// Is this queue expired?
-    bool IsExpired() { return GetAdjustedTime() - nTime > PRIVATESEND_QUEUE_TIMEOUT; }
+    bool IsExpired() const { return GetAdjustedTime() - nTime > PRIVATESEND_QUEUE_TIMEOUT; }
 
     std::string ToString() const
     {
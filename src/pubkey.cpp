@@ -9,7 +9,9 @@
 
 namespace
 {
-/* Global secp256k1_context object used for verification. */
+/* Global secp256k1_context object used for verification. It holds the
+ * precomputed multiples of G, is only read after ECC_Start and is shared by
+ * all threads verifying signatures. */
 secp256k1_context* secp256k1_context_verify = NULL;
 }
 
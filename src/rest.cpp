@@ -250,7 +250,7 @@ static bool rest_block(HTTPRequest* req,
         UniValue objBlock = blockToJSON(block, pblockindex, showTxDetails);
         std::string strJSON = objBlock.write() + "\n";
         req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
+        req->WriteReply(HTTP_OK, std::move(strJSON));
         return true;
     }
 
@@ -340,7 +340,7 @@ static bool rest_mempool_contents(HTTPRequest* req, const std::string& strURIPar
 
         std::string strJSON = mempoolObject.write() + "\n";
         req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
+        req->WriteReply(HTTP_OK, std::move(strJSON));
         return true;
     }
     default: {
@@ -605,10 +605,15 @@ static const struct {
       {"/rest/getutxos", rest_getutxos},
 };
 
+static HTTPWorkClass RESTClassifyRequest(HTTPRequest* req, const std::string&)
+{
+    return HTTP_WORK_REST;
+}
+
 bool StartREST()
 {
     for (unsigned int i = 0; i < ARRAYLEN(uri_prefixes); i++)
-        RegisterHTTPHandler(uri_prefixes[i].prefix, false, uri_prefixes[i].handler);
+        RegisterHTTPHandler(uri_prefixes[i].prefix, false, uri_prefixes[i].handler, RESTClassifyRequest);
     return true;
 }
 
@@ -8,6 +8,7 @@
 #include "base58.h"
 #include "clientversion.h"
 #include "init.h"
+#include "instantx.h"
 #include "netbase.h"
 #include "validation.h"
 #include "masternode-payments.h"
@@ -100,6 +101,9 @@ UniValue getpoolinfo(const JSONRPCRequest& request)
     obj.push_back(Pair("queue",             pprivateSendBaseManager->GetQueueSize()));
     // obj.push_back(Pair("entries",           pprivateSendBase->GetEntriesCount()));
     obj.push_back(Pair("status",            privateSendClient.GetStatuses()));
+    if (fMasternodeMode) {
+        obj.push_back(Pair("sessions",          privateSendServer.GetSessionCount()));
+    }
 
     std::vector<masternode_info_t> vecMnInfo;
     if (privateSendClient.GetMixingMasternodesInfo(vecMnInfo)) {
@@ -123,11 +127,51 @@ UniValue getpoolinfo(const JSONRPCRequest& request)
     obj.push_back(Pair("state",             privateSendServer.GetStateString()));
     obj.push_back(Pair("queue",             privateSendServer.GetQueueSize()));
     obj.push_back(Pair("entries",           privateSendServer.GetEntriesCount()));
+    obj.push_back(Pair("sessions",          privateSendServer.GetSessionCount()));
 #endif // ENABLE_WALLET
 
     return obj;
 }
 
+UniValue getinstantsendinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "getinstantsendinfo\n"
+            "Returns an object containing InstantSend related information.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"locks\": n,              (numeric) Number of locks completed since startup for requests seen by this node\n"
+            "  \"latency_avg_ms\": n,     (numeric) Average time from lock request to completed lock\n"
+            "  \"latency_max_ms\": n,     (numeric) Longest time from lock request to completed lock\n"
+            "  \"latency_histogram\": {   (object) Number of locks per latency bucket\n"
+            "    \"<=100\": n,\n"
+            "    ...\n"
+            "    \">15000\": n\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getinstantsendinfo", "")
+            + HelpExampleRpc("getinstantsendinfo", "")
+        );
+
+    CInstantSendLatencyStats stats = instantsend.GetLockLatencyStats();
+
+    UniValue histogram(UniValue::VOBJ);
+    for (size_t i = 0; i < CInstantSendLatencyStats::vecBucketBounds.size(); i++) {
+        histogram.push_back(Pair(strprintf("<=%d", CInstantSendLatencyStats::vecBucketBounds[i]), stats.vecCounts[i]));
+    }
+    histogram.push_back(Pair(strprintf(">%d", CInstantSendLatencyStats::vecBucketBounds.back()), stats.vecCounts.back()));
+
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("locks",             stats.nCount));
+    obj.push_back(Pair("latency_avg_ms",    stats.nCount ? stats.nTotalMillis / (int64_t)stats.nCount : 0));
+    obj.push_back(Pair("latency_max_ms",    stats.nMaxMillis));
+    obj.push_back(Pair("latency_histogram", histogram));
+
+    return obj;
+}
+
 void masternode_list_help()
 {
     throw std::runtime_error(
@@ -1294,6 +1338,7 @@ static const CRPCCommand commands[] =
     { "blaze",               "masternodelist",         &masternodelist,         true,  {} },
     { "blaze",               "masternodebroadcast",    &masternodebroadcast,    true,  {} },
     { "blaze",               "getpoolinfo",            &getpoolinfo,            true,  {} },
+    { "blaze",               "getinstantsendinfo",     &getinstantsendinfo,     true,  {} },
     { "blaze",               "sentinelping",           &sentinelping,           true,  {} },
 #ifdef ENABLE_WALLET
     { "blaze",               "privatesend",            &privatesend,            false, {} },
@@ -8,6 +8,7 @@
 
 #include "base58.h"
 #include "clientversion.h"
+#include "httpserver.h"
 #include "init.h"
 #include "net.h"
 #include "netbase.h"
@@ -163,6 +164,7 @@ UniValue mnsync(const JSONRPCRequest& request)
         objStatus.push_back(Pair("IsWinnersListSynced", masternodeSync.IsWinnersListSynced()));
         objStatus.push_back(Pair("IsSynced", masternodeSync.IsSynced()));
         objStatus.push_back(Pair("IsFailed", masternodeSync.IsFailed()));
+        objStatus.push_back(Pair("SyncTime", masternodeSync.GetSyncTime()));
         return objStatus;
     }
 
@@ -1120,6 +1122,54 @@ UniValue getmemoryinfo(const JSONRPCRequest& request)
     return obj;
 }
 
+UniValue getrpcinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "getrpcinfo\n"
+            "Returns an object containing information about the HTTP work queues serving RPC and REST requests.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"name\": {                (json object) Work queue, one of \"rest\", \"rpclight\" or \"rpc\"\n"
+            "    \"threads\": xxxxx,       (numeric) Number of worker threads\n"
+            "    \"depth\": xxxxx,         (numeric) Number of queued requests\n"
+            "    \"max_depth\": xxxxx,     (numeric) Maximum number of queued requests before new ones are rejected\n"
+            "    \"processed\": xxxxx,     (numeric) Number of requests processed\n"
+            "    \"rejected\": xxxxx,      (numeric) Number of requests rejected because the queue was full\n"
+            "    \"latency\": {            (json object) Enqueue-to-completion latency of recent requests in microseconds\n"
+            "      \"p50\": xxxxx,         (numeric) Median\n"
+            "      \"p90\": xxxxx,         (numeric) 90th percentile\n"
+            "      \"p99\": xxxxx,         (numeric) 99th percentile\n"
+            "      \"max\": xxxxx,         (numeric) Maximum\n"
+            "    }\n"
+            "  },\n"
+            "  ...\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getrpcinfo", "")
+            + HelpExampleRpc("getrpcinfo", "")
+        );
+
+    UniValue obj(UniValue::VOBJ);
+    for (const HTTPWorkQueueStats& stats : GetHTTPWorkQueueStats()) {
+        UniValue latency(UniValue::VOBJ);
+        latency.push_back(Pair("p50", stats.nLatencyP50));
+        latency.push_back(Pair("p90", stats.nLatencyP90));
+        latency.push_back(Pair("p99", stats.nLatencyP99));
+        latency.push_back(Pair("max", stats.nLatencyMax));
+
+        UniValue queue(UniValue::VOBJ);
+        queue.push_back(Pair("threads", stats.nThreads));
+        queue.push_back(Pair("depth", (uint64_t)stats.nDepth));
+        queue.push_back(Pair("max_depth", (uint64_t)stats.nMaxDepth));
+        queue.push_back(Pair("processed", stats.nProcessed));
+        queue.push_back(Pair("rejected", stats.nRejected));
+        queue.push_back(Pair("latency", latency));
+        obj.push_back(Pair(HTTPWorkClassName(stats.workClass), queue));
+    }
+    return obj;
+}
+
 UniValue echo(const JSONRPCRequest& request)
 {
     if (request.fHelp)
@@ -1139,6 +1189,7 @@ static const CRPCCommand commands[] =
     { "control",            "debug",                  &debug,                  true,  {} },
     { "control",            "getinfo",                &getinfo,                true,  {} }, /* uses wallet if enabled */
     { "control",            "getmemoryinfo",          &getmemoryinfo,          true,  {} },
+    { "control",            "getrpcinfo",             &getrpcinfo,             true,  {} },
     { "util",               "validateaddress",        &validateaddress,        true,  {"address"} }, /* uses wallet if enabled */
     { "util",               "createmultisig",         &createmultisig,         true,  {"nrequired","keys"} },
     { "util",               "verifymessage",          &verifymessage,          true,  {"address","signature","message"} },
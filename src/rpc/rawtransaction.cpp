@@ -898,30 +898,53 @@ UniValue signrawtransaction(const JSONRPCRequest& request)
     // Use CTransaction for the constant parts of the
     // transaction to avoid rehashing.
     const CTransaction txConst(mergedTx);
-    // Sign what we can:
+    const PrecomputedTransactionData txdata(txConst);
+
+    // Look up the spent outputs first, the inputs are signed on several
+    // threads for large transactions and those sign with a copy of the keys
+    unsigned int nThreads = GetSigningThreads(mergedTx.vin.size());
+    CBasicKeyStore keysCopy;
+    std::vector<CScript> vPrevPubKeys(mergedTx.vin.size());
+    std::vector<bool> vFound(mergedTx.vin.size(), false);
     for (unsigned int i = 0; i < mergedTx.vin.size(); i++) {
-        CTxIn& txin = mergedTx.vin[i];
-        const Coin& coin = view.AccessCoin(txin.prevout);
-        if (coin.IsSpent()) {
-            TxInErrorToJSON(txin, vErrors, "Input not found or already spent");
+        const Coin& coin = view.AccessCoin(mergedTx.vin[i].prevout);
+        if (coin.IsSpent())
             continue;
-        }
-        const CScript& prevPubKey = coin.out.scriptPubKey;
+        vFound[i] = true;
+        vPrevPubKeys[i] = coin.out.scriptPubKey;
+        if (nThreads > 1)
+            GetSigningKeys(keystore, vPrevPubKeys[i], keysCopy);
+    }
+    const CKeyStore& keysSign = nThreads > 1 ? keysCopy : keystore;
+
+    // Sign what we can:
+    std::vector<ScriptError> vScriptErrors(mergedTx.vin.size(), SCRIPT_ERR_OK);
+    ForEachInput(mergedTx.vin.size(), nThreads, [&](unsigned int i) {
+        if (!vFound[i])
+            return;
+        CTxIn& txin = mergedTx.vin[i];
+        const CScript& prevPubKey = vPrevPubKeys[i];
 
         txin.scriptSig.clear();
         // Only sign SIGHASH_SINGLE if there's a corresponding output:
         if (!fHashSingle || (i < mergedTx.vout.size()))
-            SignSignature(keystore, prevPubKey, mergedTx, i, nHashType);
+            ProduceSignature(TransactionSignatureCreator(&keysSign, &txConst, i, nHashType, &txdata), prevPubKey, txin.scriptSig);
 
         // ... and merge in other signatures:
+        TransactionSignatureChecker checker(&txConst, i, &txdata);
         BOOST_FOREACH(const CMutableTransaction& txv, txVariants) {
             if (txv.vin.size() > i) {
-                txin.scriptSig = CombineSignatures(prevPubKey, txConst, i, txin.scriptSig, txv.vin[i].scriptSig);
+                txin.scriptSig = CombineSignatures(prevPubKey, checker, txin.scriptSig, txv.vin[i].scriptSig);
             }
         }
-        ScriptError serror = SCRIPT_ERR_OK;
-        if (!VerifyScript(txin.scriptSig, prevPubKey, STANDARD_SCRIPT_VERIFY_FLAGS, TransactionSignatureChecker(&txConst, i), &serror)) {
-            TxInErrorToJSON(txin, vErrors, ScriptErrorString(serror));
+        VerifyScript(txin.scriptSig, prevPubKey, STANDARD_SCRIPT_VERIFY_FLAGS, checker, &vScriptErrors[i]);
+    });
+
+    for (unsigned int i = 0; i < mergedTx.vin.size(); i++) {
+        if (!vFound[i]) {
+            TxInErrorToJSON(mergedTx.vin[i], vErrors, "Input not found or already spent");
+        } else if (vScriptErrors[i] != SCRIPT_ERR_OK) {
+            TxInErrorToJSON(mergedTx.vin[i], vErrors, ScriptErrorString(vScriptErrors[i]));
         }
     }
     bool fComplete = vErrors.empty();
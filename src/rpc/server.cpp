@@ -9,6 +9,7 @@
 #include "rpc/server.h"
 
 #include "base58.h"
+#include "ctpl.h"
 #include "init.h"
 #include "random.h"
 #include "sync.h"
@@ -29,7 +30,8 @@
 #include <boost/algorithm/string/split.hpp>
 
 #include <algorithm>
-#include <memory> // for unique_ptr
+#include <future>
+#include <memory> // for unique_ptr, shared_ptr
 #include <unordered_map>
 
 static bool fRPCRunning = false;
@@ -40,6 +42,11 @@ static CCriticalSection cs_rpcWarmup;
 static RPCTimerInterface* timerInterface = NULL;
 /* Map of name to timer. */
 static std::map<std::string, std::unique_ptr<RPCTimerBase> > deadlineTimers;
+/* Worker pool executing the entries of batched requests. HTTP workers may
+ * still be executing a batch while StopRPC runs, so they take a reference
+ * under cs_batchPool instead of using the pointer directly. */
+static CCriticalSection cs_batchPool;
+static std::shared_ptr<ctpl::thread_pool> batchPool;
 
 static struct CRPCSignals
 {
@@ -372,6 +379,14 @@ bool CRPCTable::appendCommand(const std::string& name, const CRPCCommand* pcmd)
 bool StartRPC()
 {
     LogPrint("rpc", "Starting RPC\n");
+    int nBatchThreads = std::max((int)GetArg("-rpcbatchthreads", DEFAULT_RPC_BATCH_THREADS), 0);
+    if (nBatchThreads > 0) {
+        LogPrint("rpc", "Starting %d RPC batch worker threads\n", nBatchThreads);
+        std::shared_ptr<ctpl::thread_pool> pool = std::make_shared<ctpl::thread_pool>(nBatchThreads);
+        RenameThreadPool(*pool, "blaze-rpc-batch");
+        LOCK(cs_batchPool);
+        batchPool = pool;
+    }
     fRPCRunning = true;
     g_rpcSignals.Started();
     return true;
@@ -387,6 +402,16 @@ void InterruptRPC()
 void StopRPC()
 {
     LogPrint("rpc", "Stopping RPC\n");
+    std::shared_ptr<ctpl::thread_pool> pool;
+    {
+        LOCK(cs_batchPool);
+        pool.swap(batchPool);
+    }
+    if (pool) {
+        // Let in-flight batch entries finish, their HTTP workers are waiting on them.
+        // Batches started from now on run in the calling thread.
+        pool->stop(true);
+    }
     deadlineTimers.clear();
     DeleteAuthCookie();
     g_rpcSignals.Stopped();
@@ -474,11 +499,39 @@ static UniValue JSONRPCExecOne(const UniValue& req)
 
 std::string JSONRPCExecBatch(const UniValue& vReq)
 {
-    UniValue ret(UniValue::VARR);
-    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
-        ret.push_back(JSONRPCExecOne(vReq[reqIdx]));
+    std::vector<UniValue> vReplies(vReq.size());
+    std::shared_ptr<ctpl::thread_pool> pool;
+    if (vReq.size() > 1) {
+        LOCK(cs_batchPool);
+        pool = batchPool;
+    }
+    if (pool) {
+        std::vector<std::future<void> > vFutures;
+        vFutures.reserve(vReq.size());
+        for (size_t reqIdx = 0; reqIdx < vReq.size(); reqIdx++) {
+            vFutures.emplace_back(pool->push([&vReq, &vReplies, reqIdx](int) {
+                vReplies[reqIdx] = JSONRPCExecOne(vReq[reqIdx]);
+            }));
+        }
+        for (auto& f : vFutures)
+            f.get();
+    } else {
+        for (size_t reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
+            vReplies[reqIdx] = JSONRPCExecOne(vReq[reqIdx]);
+    }
 
-    return ret.write() + "\n";
+    // Serialize the replies straight into one buffer instead of copying
+    // them into an intermediate UniValue array first
+    std::string strReply;
+    strReply.reserve(256 * vReplies.size());
+    strReply += '[';
+    for (size_t i = 0; i < vReplies.size(); i++) {
+        if (i != 0)
+            strReply += ',';
+        vReplies[i].write(strReply);
+    }
+    strReply += "]\n";
+    return strReply;
 }
 
 /**
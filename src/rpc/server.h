@@ -19,6 +19,10 @@
 
 #include <univalue.h>
 
+/** Entries of a batch may depend on each other (e.g. walletpassphrase
+ * followed by a send), so they run in order unless -rpcbatchthreads is set. */
+static const int DEFAULT_RPC_BATCH_THREADS = 0;
+
 class CRPCCommand;
 
 namespace RPCServer
@@ -205,6 +209,10 @@ extern void EnsureWalletIsUnlocked();
 bool StartRPC();
 void InterruptRPC();
 void StopRPC();
+/** Execute a JSON-RPC batch. Entries run in order, or are spread over the
+ * batch worker pool when -rpcbatchthreads is set; replies are returned in
+ * request order either way.
+ */
 std::string JSONRPCExecBatch(const UniValue& vReq);
 void RPCNotifyBlockChange(bool ibd, const CBlockIndex *);
 
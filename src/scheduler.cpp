@@ -76,11 +76,13 @@ void CScheduler::serviceQueue()
             }
         } catch (...) {
             --nThreadsServicingQueue;
+            serviceThreadExited.notify_all();
             throw;
         }
     }
     --nThreadsServicingQueue;
     newTaskScheduled.notify_one();
+    serviceThreadExited.notify_all();
 }
 
 void CScheduler::stop(bool drain)
@@ -95,6 +97,13 @@ void CScheduler::stop(bool drain)
     newTaskScheduled.notify_all();
 }
 
+void CScheduler::waitForServiceThreads()
+{
+    boost::unique_lock<boost::mutex> lock(newTaskMutex);
+    while (nThreadsServicingQueue > 0)
+        serviceThreadExited.wait(lock);
+}
+
 void CScheduler::schedule(CScheduler::Function f, boost::chrono::system_clock::time_point t)
 {
     {
@@ -131,3 +140,85 @@ size_t CScheduler::getQueueInfo(boost::chrono::system_clock::time_point &first,
     }
     return result;
 }
+
+bool CScheduler::AreThreadsServicingQueue() const
+{
+    boost::unique_lock<boost::mutex> lock(newTaskMutex);
+    return nThreadsServicingQueue;
+}
+
+
+void SingleThreadedSchedulerClient::MaybeScheduleProcessQueue()
+{
+    {
+        LOCK(cs_callbacksPending);
+        // Try to avoid scheduling too many copies here, but if we
+        // accidentally have two ProcessQueue's scheduled at once its
+        // not a big deal.
+        if (fCallbacksRunning) return;
+        if (callbacksPending.empty()) return;
+    }
+    pscheduler->schedule(std::bind(&SingleThreadedSchedulerClient::ProcessQueue, this), boost::chrono::system_clock::now());
+}
+
+void SingleThreadedSchedulerClient::ProcessQueue()
+{
+    std::function<void (void)> callback;
+    {
+        LOCK(cs_callbacksPending);
+        if (fCallbacksRunning) return;
+
+        // the callback list is processed one entry at a time, so that
+        // callbacks added while one is running are still picked up in order
+        if (callbacksPending.empty()) return;
+        fCallbacksRunning = true;
+
+        callback = std::move(callbacksPending.front());
+        callbacksPending.pop_front();
+    }
+
+    // RAII the setting of fCallbacksRunning and calling MaybeScheduleProcessQueue
+    // to ensure both happen safely even if callback() throws.
+    struct RAIICallbacksRunning {
+        SingleThreadedSchedulerClient* instance;
+        explicit RAIICallbacksRunning(SingleThreadedSchedulerClient* _instance) : instance(_instance) {}
+        ~RAIICallbacksRunning()
+        {
+            {
+                LOCK(instance->cs_callbacksPending);
+                instance->fCallbacksRunning = false;
+            }
+            instance->MaybeScheduleProcessQueue();
+        }
+    } raiicallbacksrunning(this);
+
+    callback();
+}
+
+void SingleThreadedSchedulerClient::AddToProcessQueue(std::function<void (void)> func)
+{
+    assert(pscheduler);
+
+    {
+        LOCK(cs_callbacksPending);
+        callbacksPending.emplace_back(std::move(func));
+    }
+    MaybeScheduleProcessQueue();
+}
+
+void SingleThreadedSchedulerClient::EmptyQueue()
+{
+    assert(!pscheduler->AreThreadsServicingQueue());
+    bool fShouldContinue = true;
+    while (fShouldContinue) {
+        ProcessQueue();
+        LOCK(cs_callbacksPending);
+        fShouldContinue = !callbacksPending.empty();
+    }
+}
+
+size_t SingleThreadedSchedulerClient::CallbacksPending()
+{
+    LOCK(cs_callbacksPending);
+    return callbacksPending.size();
+}
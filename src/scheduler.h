@@ -13,8 +13,12 @@
 #include <boost/function.hpp>
 #include <boost/chrono/chrono.hpp>
 #include <boost/thread.hpp>
+#include <functional>
+#include <list>
 #include <map>
 
+#include "sync.h"
+
 //
 // Simple class for background tasks that should be run
 // periodically or once "after a while"
@@ -65,14 +69,22 @@ public:
     // or when there is no work left to be done (drain=true)
     void stop(bool drain=false);
 
+    // Wait until the threads running serviceQueue have returned, after
+    // stop() was called or they were interrupted
+    void waitForServiceThreads();
+
     // Returns number of tasks waiting to be serviced,
     // and first and last task times
     size_t getQueueInfo(boost::chrono::system_clock::time_point &first,
                         boost::chrono::system_clock::time_point &last) const;
 
+    // Returns true if there are threads actively running in serviceQueue()
+    bool AreThreadsServicingQueue() const;
+
 private:
     std::multimap<boost::chrono::system_clock::time_point, Function> taskQueue;
     boost::condition_variable newTaskScheduled;
+    boost::condition_variable serviceThreadExited;
     mutable boost::mutex newTaskMutex;
     int nThreadsServicingQueue;
     bool stopRequested;
@@ -80,4 +92,42 @@ private:
     bool shouldStop() { return stopRequested || (stopWhenEmpty && taskQueue.empty()); }
 };
 
+/**
+ * Class used by CScheduler clients which may schedule multiple jobs
+ * which are required to be run serially. Jobs may not be run on the
+ * same thread, but no two jobs will be executed at the same time and
+ * jobs are executed in the order they were added.
+ */
+class SingleThreadedSchedulerClient
+{
+private:
+    CScheduler* pscheduler;
+
+    CCriticalSection cs_callbacksPending;
+    std::list<std::function<void (void)>> callbacksPending;
+    bool fCallbacksRunning;
+
+    void MaybeScheduleProcessQueue();
+    void ProcessQueue();
+
+public:
+    explicit SingleThreadedSchedulerClient(CScheduler* pschedulerIn) : pscheduler(pschedulerIn), fCallbacksRunning(false) {}
+
+    /**
+     * Add a callback to be executed. Callbacks are executed serially
+     * and memory is release-acquire consistent between callback executions.
+     * Practically, this means that callbacks can behave as if they are executed
+     * in order by a single thread.
+     */
+    void AddToProcessQueue(std::function<void (void)> func);
+
+    /**
+     * Processes all remaining queue members on the calling thread, blocking until queue is empty.
+     * Must be called after the CScheduler has no remaining processing threads!
+     */
+    void EmptyQueue();
+
+    size_t CallbacksPending();
+};
+
 #endif
@@ -11,6 +11,7 @@
 #include "crypto/sha256.h"
 #include "pubkey.h"
 #include "script/script.h"
+#include "streams.h"
 #include "uint256.h"
 
 typedef std::vector<unsigned char> valtype;
@@ -1117,9 +1118,52 @@ public:
     }
 };
 
+/** Stream feeding a SHA-256 hasher */
+class CSHA256Writer
+{
+private:
+    CSHA256& hasher;
+
+public:
+    CSHA256Writer(CSHA256& hasherIn) : hasher(hasherIn) {}
+    void write(const char* pch, size_t size) { hasher.Write((const unsigned char*)pch, size); }
+};
+
+//! size of a serialized outpoint
+const size_t OUTPOINT_SIZE = 36;
+
 } // anon namespace
 
-uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType)
+PrecomputedTransactionData::PrecomputedTransactionData(const CTransaction& txTo)
+{
+    // What CTransactionSignatureSerializer writes for SIGHASH_ALL, except
+    // for the script of the input being signed
+    std::vector<unsigned char> vchHead;
+    CVectorWriter head(SER_GETHASH, 0, vchHead, 0);
+    head << int32_t(txTo.nVersion | (txTo.nType << 16));
+    WriteCompactSize(head, txTo.vin.size());
+
+    CVectorWriter tail(SER_GETHASH, 0, vchTail, 0);
+    vInputPos.reserve(txTo.vin.size());
+    for (const auto& txin : txTo.vin) {
+        vInputPos.push_back(vchTail.size());
+        tail << txin.prevout << CScriptBase() << txin.nSequence;
+    }
+    tail << txTo.vout << txTo.nLockTime;
+    if (txTo.nVersion == 3 && txTo.nType != TRANSACTION_NORMAL)
+        tail << txTo.vExtraPayload;
+
+    CSHA256 hasher;
+    hasher.Write(vchHead.data(), vchHead.size());
+    vHashers.reserve(txTo.vin.size());
+    for (size_t i = 0; i < txTo.vin.size(); i++) {
+        vHashers.push_back(hasher);
+        size_t nEnd = i + 1 < txTo.vin.size() ? vInputPos[i + 1] : vchTail.size();
+        hasher.Write(vchTail.data() + vInputPos[i], nEnd - vInputPos[i]);
+    }
+}
+
+uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType, const PrecomputedTransactionData* cache)
 {
     static const uint256 one(uint256S("0000000000000000000000000000000000000000000000000000000000000001"));
     if (nIn >= txTo.vin.size()) {
@@ -1138,6 +1182,26 @@ uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsig
     // Wrapper to serialize only the necessary parts of the transaction being signed
     CTransactionSignatureSerializer txTmp(txTo, scriptCode, nIn, nHashType);
 
+    bool fHashAll = !(nHashType & SIGHASH_ANYONECANPAY) && (nHashType & 0x1f) != SIGHASH_SINGLE && (nHashType & 0x1f) != SIGHASH_NONE;
+    if (cache && fHashAll && cache->vHashers.size() == txTo.vin.size()) {
+        // Continue from the state before input nIn, with the same bytes as below
+        const unsigned char* pInput = cache->vchTail.data() + cache->vInputPos[nIn];
+        const unsigned char* pEnd = cache->vchTail.data() + cache->vchTail.size();
+        const unsigned char* pNext = pInput + OUTPOINT_SIZE + 1 + sizeof(uint32_t);
+        CSHA256 hasher(cache->vHashers[nIn]);
+        CSHA256Writer writer(hasher);
+        hasher.Write(pInput, OUTPOINT_SIZE);
+        txTmp.SerializeScriptCode(writer);
+        hasher.Write(pInput + OUTPOINT_SIZE + 1, sizeof(uint32_t));
+        hasher.Write(pNext, pEnd - pNext);
+        ::Serialize(writer, nHashType);
+
+        uint256 hash;
+        hasher.Finalize(hash.begin());
+        CSHA256().Write(hash.begin(), CSHA256::OUTPUT_SIZE).Finalize(hash.begin());
+        return hash;
+    }
+
     // Serialize and hash
     CHashWriter ss(SER_GETHASH, 0);
     ss << txTmp << nHashType;
@@ -1162,7 +1226,7 @@ bool TransactionSignatureChecker::CheckSig(const std::vector<unsigned char>& vch
     int nHashType = vchSig.back();
     vchSig.pop_back();
 
-    uint256 sighash = SignatureHash(scriptCode, *txTo, nIn, nHashType);
+    uint256 sighash = SignatureHash(scriptCode, *txTo, nIn, nHashType, txdata);
 
     if (!VerifySignature(vchSig, pubkey, sighash))
         return false;
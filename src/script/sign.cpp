@@ -5,18 +5,22 @@
 
 #include "script/sign.h"
 
+#include "ctpl.h"
 #include "key.h"
 #include "keystore.h"
 #include "policy/policy.h"
 #include "primitives/transaction.h"
 #include "script/standard.h"
 #include "uint256.h"
+#include "util.h"
+
+#include <atomic>
 
 #include <boost/foreach.hpp>
 
 typedef std::vector<unsigned char> valtype;
 
-TransactionSignatureCreator::TransactionSignatureCreator(const CKeyStore* keystoreIn, const CTransaction* txToIn, unsigned int nInIn, int nHashTypeIn) : BaseSignatureCreator(keystoreIn), txTo(txToIn), nIn(nInIn), nHashType(nHashTypeIn), checker(txTo, nIn) {}
+TransactionSignatureCreator::TransactionSignatureCreator(const CKeyStore* keystoreIn, const CTransaction* txToIn, unsigned int nInIn, int nHashTypeIn, const PrecomputedTransactionData* txdataIn) : BaseSignatureCreator(keystoreIn), txTo(txToIn), nIn(nInIn), nHashType(nHashTypeIn), txdata(txdataIn), checker(txTo, nIn, txdata) {}
 
 bool TransactionSignatureCreator::CreateSig(std::vector<unsigned char>& vchSig, const CKeyID& address, const CScript& scriptCode) const
 {
@@ -24,7 +28,7 @@ bool TransactionSignatureCreator::CreateSig(std::vector<unsigned char>& vchSig,
     if (!keystore->GetKey(address, key))
         return false;
 
-    uint256 hash = SignatureHash(scriptCode, *txTo, nIn, nHashType);
+    uint256 hash = SignatureHash(scriptCode, *txTo, nIn, nHashType, txdata);
     if (!key.Sign(hash, vchSig))
         return false;
     vchSig.push_back((unsigned char)nHashType);
@@ -135,6 +139,107 @@ bool SignSignature(const CKeyStore &keystore, const CScript& fromPubKey, CMutabl
     return ProduceSignature(creator, fromPubKey, txin.scriptSig);
 }
 
+unsigned int GetSigningThreads(unsigned int nInputs)
+{
+    return std::min((unsigned int)std::max(GetNumCores(), 1), nInputs / MIN_SIGN_INPUTS_PER_THREAD);
+}
+
+void ForEachInput(unsigned int nInputs, unsigned int nThreads, const std::function<void(unsigned int)>& fn)
+{
+    auto runRange = [&fn](unsigned int nBegin, unsigned int nEnd) {
+        for (unsigned int i = nBegin; i < nEnd; i++) {
+            fn(i);
+        }
+    };
+
+    if (nThreads <= 1) {
+        runRange(0, nInputs);
+        return;
+    }
+
+    ctpl::thread_pool pool(nThreads);
+    RenameThreadPool(pool, "blaze-sign");
+    std::vector<std::future<void> > vecFutures;
+    unsigned int nPerThread = (nInputs + nThreads - 1) / nThreads;
+    for (unsigned int nBegin = 0; nBegin < nInputs; nBegin += nPerThread) {
+        unsigned int nEnd = std::min(nBegin + nPerThread, nInputs);
+        vecFutures.emplace_back(pool.push([&runRange, nBegin, nEnd](int) { runRange(nBegin, nEnd); }));
+    }
+    for (auto& f : vecFutures) {
+        f.get();
+    }
+}
+
+static void CopySigningKey(const CKeyStore& keystore, const CKeyID& keyID, CBasicKeyStore& keysRet)
+{
+    CKey key;
+    CPubKey pubkey;
+    if (keystore.GetKey(keyID, key) && keystore.GetPubKey(keyID, pubkey))
+        keysRet.AddKeyPubKey(key, pubkey);
+}
+
+void GetSigningKeys(const CKeyStore& keystore, const CScript& scriptPubKey, CBasicKeyStore& keysRet)
+{
+    // Same cases as SignStep
+    txnouttype whichType;
+    std::vector<valtype> vSolutions;
+    if (!Solver(scriptPubKey, whichType, vSolutions))
+        return;
+
+    switch (whichType)
+    {
+    case TX_NONSTANDARD:
+    case TX_NULL_DATA:
+        break;
+    case TX_PUBKEY:
+        CopySigningKey(keystore, CPubKey(vSolutions[0]).GetID(), keysRet);
+        break;
+    case TX_PUBKEYHASH:
+        CopySigningKey(keystore, CKeyID(uint160(vSolutions[0])), keysRet);
+        break;
+    case TX_SCRIPTHASH:
+    {
+        CScript subscript;
+        if (keystore.GetCScript(uint160(vSolutions[0]), subscript)) {
+            keysRet.AddCScript(subscript);
+            if (!subscript.IsPayToScriptHash())
+                GetSigningKeys(keystore, subscript, keysRet);
+        }
+        break;
+    }
+    case TX_MULTISIG:
+        for (unsigned int i = 1; i < vSolutions.size() - 1; i++)
+            CopySigningKey(keystore, CPubKey(vSolutions[i]).GetID(), keysRet);
+        break;
+    }
+}
+
+bool SignTransaction(const CKeyStore& keystore, const std::vector<CScript>& vScriptPubKeys, CMutableTransaction& txTo, int nHashType)
+{
+    assert(vScriptPubKeys.size() == txTo.vin.size());
+
+    // The signatures don't commit to input scripts, so all inputs can be signed against one copy
+    const CTransaction txToConst(txTo);
+    const PrecomputedTransactionData txdata(txToConst);
+
+    // Keystores like the wallet's are locked by the caller, the threads sign with a copy of the keys
+    unsigned int nThreads = GetSigningThreads(txTo.vin.size());
+    CBasicKeyStore keysCopy;
+    if (nThreads > 1) {
+        for (const auto& scriptPubKey : vScriptPubKeys)
+            GetSigningKeys(keystore, scriptPubKey, keysCopy);
+    }
+    const CKeyStore& keysSign = nThreads > 1 ? keysCopy : keystore;
+
+    std::atomic<bool> fSigned(true);
+    ForEachInput(txTo.vin.size(), nThreads, [&](unsigned int i) {
+        TransactionSignatureCreator creator(&keysSign, &txToConst, i, nHashType, &txdata);
+        if (!ProduceSignature(creator, vScriptPubKeys[i], txTo.vin[i].scriptSig))
+            fSigned = false;
+    });
+    return fSigned;
+}
+
 bool SignSignature(const CKeyStore &keystore, const CTransaction& txFrom, CMutableTransaction& txTo, unsigned int nIn, int nHashType)
 {
     assert(nIn < txTo.vin.size());
@@ -8,6 +8,9 @@
 
 #include "script/interpreter.h"
 
+#include <functional>
+
+class CBasicKeyStore;
 class CKeyID;
 class CKeyStore;
 class CScript;
@@ -35,10 +38,11 @@ class TransactionSignatureCreator : public BaseSignatureCreator {
     const CTransaction* txTo;
     unsigned int nIn;
     int nHashType;
+    const PrecomputedTransactionData* txdata;
     const TransactionSignatureChecker checker;
 
 public:
-    TransactionSignatureCreator(const CKeyStore* keystoreIn, const CTransaction* txToIn, unsigned int nInIn, int nHashTypeIn=SIGHASH_ALL);
+    TransactionSignatureCreator(const CKeyStore* keystoreIn, const CTransaction* txToIn, unsigned int nInIn, int nHashTypeIn=SIGHASH_ALL, const PrecomputedTransactionData* txdataIn=NULL);
     const BaseSignatureChecker& Checker() const  override{ return checker; }
     bool CreateSig(std::vector<unsigned char>& vchSig, const CKeyID& keyid, const CScript& scriptCode) const override;
 };
@@ -58,6 +62,28 @@ bool ProduceSignature(const BaseSignatureCreator& creator, const CScript& script
 bool SignSignature(const CKeyStore& keystore, const CScript& fromPubKey, CMutableTransaction& txTo, unsigned int nIn, int nHashType=SIGHASH_ALL);
 bool SignSignature(const CKeyStore& keystore, const CTransaction& txFrom, CMutableTransaction& txTo, unsigned int nIn, int nHashType=SIGHASH_ALL);
 
+/** Don't bother with threads for less inputs than this per thread */
+static const unsigned int MIN_SIGN_INPUTS_PER_THREAD = 16;
+
+/** Number of threads to sign a transaction with nInputs inputs on */
+unsigned int GetSigningThreads(unsigned int nInputs);
+
+/** Call fn for every input index below nInputs, spread over nThreads threads */
+void ForEachInput(unsigned int nInputs, unsigned int nThreads, const std::function<void(unsigned int)>& fn);
+
+/**
+ * Copy the keys and scripts needed to sign scriptPubKey from keystore to keysRet,
+ * so other threads can sign without locking a wallet.
+ */
+void GetSigningKeys(const CKeyStore& keystore, const CScript& scriptPubKey, CBasicKeyStore& keysRet);
+
+/**
+ * Sign every input of txTo, the one spending vScriptPubKeys[i] being txTo.vin[i].
+ * Large transactions are signed on several threads sharing one precomputed
+ * signature hash context. Returns false if any input couldn't be signed.
+ */
+bool SignTransaction(const CKeyStore& keystore, const std::vector<CScript>& vScriptPubKeys, CMutableTransaction& txTo, int nHashType=SIGHASH_ALL);
+
 /** Combine two script signatures using a generic signature checker, intelligently, possibly with OP_0 placeholders. */
 CScript CombineSignatures(const CScript& scriptPubKey, const BaseSignatureChecker& checker, const CScript& scriptSig1, const CScript& scriptSig2);
 
@@ -0,0 +1,124 @@
+// Copyright (c) 2024 The blazegeek developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "batchverifier.h"
+#include "chainparams.h"
+#include "key.h"
+#include "random.h"
+#include "utilstrencodings.h"
+
+#include "test/test_blaze.h"
+
+#include <atomic>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(batchverifier_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(signature_cache)
+{
+    CSignatureCache cache(2);
+    uint256 nHash = GetRandHash();
+    std::vector<unsigned char> vchSig(65, 1);
+    CKeyID keyID(uint160(ParseHex("0102030405060708090a0b0c0d0e0f1011121314")));
+
+    // every part of the message goes into the entry
+    uint256 entry = CSignatureCache::GetEntry(nHash, vchSig, keyID, true);
+    BOOST_CHECK(entry == CSignatureCache::GetEntry(nHash, vchSig, keyID, true));
+    BOOST_CHECK(entry != CSignatureCache::GetEntry(GetRandHash(), vchSig, keyID, true));
+    BOOST_CHECK(entry != CSignatureCache::GetEntry(nHash, std::vector<unsigned char>(65, 2), keyID, true));
+    BOOST_CHECK(entry != CSignatureCache::GetEntry(nHash, vchSig, CKeyID(), true));
+    BOOST_CHECK(entry != CSignatureCache::GetEntry(nHash, vchSig, keyID, false));
+
+    BOOST_CHECK(!cache.Contains(entry));
+    cache.Add(entry);
+    BOOST_CHECK(cache.Contains(entry));
+
+    // the oldest entries go once the cache is full
+    cache.Add(GetRandHash());
+    cache.Add(GetRandHash());
+    BOOST_CHECK(!cache.Contains(entry));
+}
+
+BOOST_AUTO_TEST_CASE(batch_verifier)
+{
+    CAddress addr(CService(CNetAddr(), Params().GetDefaultPort()), NODE_NONE);
+    CNode dummyNode(0, NODE_NETWORK, 0, INVALID_SOCKET, addr, 0, 0, "", true);
+
+    // a batch is due once it is full, the delay is long enough to never pass here
+    CBatchVerifier<int> verifier("blaze-test-verify", 3, 60 * 60 * 1000);
+    std::vector<CBatchVerifier<int>::Item> vecBatch;
+
+    // without threads the messages are processed on arrival
+    BOOST_CHECK(!verifier.IsRunning());
+    BOOST_CHECK(!verifier.Queue(&dummyNode, 0));
+    BOOST_CHECK_EQUAL(dummyNode.GetRefCount(), 0);
+
+    verifier.Start(2);
+    BOOST_CHECK(verifier.IsRunning());
+    for (int i = 0; i < 7; i++) {
+        BOOST_CHECK(verifier.Queue(&dummyNode, i));
+    }
+    BOOST_CHECK_EQUAL(verifier.GetQueuedCount(), 7U);
+    BOOST_CHECK_EQUAL(dummyNode.GetRefCount(), 7);
+
+    // full batches are taken in order, the rest waits for the delay
+    BOOST_CHECK(verifier.TakeBatch(vecBatch));
+    BOOST_CHECK_EQUAL(vecBatch.size(), 3U);
+    BOOST_CHECK_EQUAL(vecBatch.front().second, 0);
+    BOOST_CHECK(verifier.TakeBatch(vecBatch));
+    BOOST_CHECK_EQUAL(vecBatch.front().second, 3);
+    BOOST_CHECK(!verifier.TakeBatch(vecBatch));
+    BOOST_CHECK(verifier.TakeBatch(vecBatch, true));
+    BOOST_CHECK_EQUAL(vecBatch.size(), 1U);
+    BOOST_CHECK_EQUAL(vecBatch.front().second, 6);
+    BOOST_CHECK(!verifier.TakeBatch(vecBatch, true));
+
+    // the references pass to whoever took the messages
+    BOOST_CHECK_EQUAL(dummyNode.GetRefCount(), 7);
+    for (int i = 0; i < 7; i++) {
+        dummyNode.Release();
+    }
+
+    // all checks run before Verify returns
+    std::atomic<int> nChecked(0);
+    std::vector<std::function<bool()> > vecChecks(100, [&nChecked]() { nChecked++; return true; });
+    BOOST_CHECK_EQUAL(verifier.Verify(vecChecks), 100U);
+    BOOST_CHECK_EQUAL(nChecked.load(), 100);
+
+    // stopping releases the nodes of the messages still queued
+    BOOST_CHECK(verifier.Queue(&dummyNode, 7));
+    BOOST_CHECK(verifier.Queue(&dummyNode, 8));
+    BOOST_CHECK_EQUAL(dummyNode.GetRefCount(), 2);
+    verifier.Stop();
+    BOOST_CHECK_EQUAL(dummyNode.GetRefCount(), 0);
+    BOOST_CHECK_EQUAL(verifier.GetQueuedCount(), 0U);
+
+    // and nothing is queued or checked afterwards
+    BOOST_CHECK(!verifier.IsRunning());
+    BOOST_CHECK(!verifier.Queue(&dummyNode, 9));
+    BOOST_CHECK_EQUAL(dummyNode.GetRefCount(), 0);
+    BOOST_CHECK_EQUAL(verifier.Verify(vecChecks), 0U);
+    BOOST_CHECK_EQUAL(nChecked.load(), 100);
+}
+
+BOOST_AUTO_TEST_CASE(batch_verifier_delay)
+{
+    CAddress addr(CService(CNetAddr(), Params().GetDefaultPort()), NODE_NONE);
+    CNode dummyNode(0, NODE_NETWORK, 0, INVALID_SOCKET, addr, 0, 0, "", true);
+
+    // without a delay a single message is due right away
+    CBatchVerifier<int> verifier("blaze-test-verify", 100, 0);
+    std::vector<CBatchVerifier<int>::Item> vecBatch;
+    verifier.Start(1);
+    BOOST_CHECK(!verifier.TakeBatch(vecBatch));
+    BOOST_CHECK(verifier.Queue(&dummyNode, 1));
+    BOOST_CHECK(verifier.TakeBatch(vecBatch));
+    BOOST_CHECK_EQUAL(vecBatch.size(), 1U);
+    vecBatch.front().first->Release();
+    verifier.Stop();
+    BOOST_CHECK_EQUAL(dummyNode.GetRefCount(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -9,6 +9,7 @@
 #include "crypto/sha512.h"
 #include "crypto/hmac_sha256.h"
 #include "crypto/hmac_sha512.h"
+#include "hash.h"
 #include "utilstrencodings.h"
 #include "test/test_blaze.h"
 #include "test/test_random.h"
@@ -292,6 +293,55 @@ BOOST_AUTO_TEST_CASE(sha512_testvectors) {
                "37de8c3ef5459d76a52cedc02dc499a3c9ed9dedbfb3281afd9653b8a112fafc");
 }
 
+BOOST_AUTO_TEST_CASE(sha512_iterate) {
+    std::vector<unsigned char> vchIn(4 * CSHA512::OUTPUT_SIZE);
+    for (size_t i = 0; i < vchIn.size(); i++)
+        vchIn[i] = insecure_rand();
+
+    for (uint64_t nCount : {0, 1, 2, 1000}) {
+        // hash chains computed with the streaming hasher
+        std::vector<unsigned char> vchExpected(vchIn);
+        for (int nChain = 0; nChain < 4; nChain++) {
+            unsigned char* hash = &vchExpected[nChain * CSHA512::OUTPUT_SIZE];
+            for (uint64_t i = 0; i < nCount; i++)
+                CSHA512().Write(hash, CSHA512::OUTPUT_SIZE).Finalize(hash);
+        }
+
+        std::vector<unsigned char> vchOut(vchIn);
+        for (int nChain = 0; nChain < 4; nChain++)
+            SHA512Iterate(&vchOut[nChain * CSHA512::OUTPUT_SIZE], nCount);
+        BOOST_CHECK(vchOut == vchExpected);
+
+        std::vector<unsigned char> vchOut4(vchIn);
+        SHA512Iterate4(vchOut4.data(), nCount);
+        BOOST_CHECK(vchOut4 == vchExpected);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(sha256d64) {
+    // enough inputs for every multi-way transform and the remainders after it
+    std::vector<unsigned char> vchIn(64 * 32);
+    for (size_t i = 0; i < vchIn.size(); i++)
+        vchIn[i] = insecure_rand();
+
+    for (size_t nBlocks = 0; nBlocks <= 32; nBlocks++) {
+        std::vector<unsigned char> vchExpected(32 * nBlocks);
+        for (size_t i = 0; i < nBlocks; i++)
+            CHash256().Write(&vchIn[64 * i], 64).Finalize(&vchExpected[32 * i]);
+
+        std::vector<unsigned char> vchOut(32 * nBlocks);
+        SHA256D64(vchOut.data(), vchIn.data(), nBlocks);
+        BOOST_CHECK(vchOut == vchExpected);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(sha256_implementations) {
+    // the selection stops at the first one the CPU has, check the others too
+    std::string strTested;
+    BOOST_CHECK_MESSAGE(SHA256SelfTestAll(strTested), "SHA256 self-test failed, tested: " + strTested);
+    BOOST_TEST_MESSAGE("SHA256 implementations tested: " + strTested);
+}
+
 BOOST_AUTO_TEST_CASE(hmac_sha256_testvectors) {
     // test cases 1, 2, 3, 4, 6 and 7 of RFC 4231
     TestHMACSHA256("0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b",
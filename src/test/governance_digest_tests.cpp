@@ -0,0 +1,107 @@
+// Copyright (c) 2024 The blazegeek developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "governance-digest.h"
+#include "random.h"
+#include "streams.h"
+#include "version.h"
+
+#include "test/test_blaze.h"
+
+#include <set>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(governance_digest_tests, BasicTestingSetup)
+
+// Hashes of theirs which the peer with the digest of ours has to announce
+static std::set<uint256> Reconcile(const std::vector<uint256>& vecOurs, const std::vector<uint256>& vecTheirs)
+{
+    CGovernanceSetDigest digestOurs(uint256(), vecOurs.size());
+    for (const auto& hash : vecOurs) {
+        digestOurs.Insert(hash);
+    }
+
+    // send it over the wire like the peer would receive it
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << digestOurs;
+    CGovernanceSetDigest digestReceived;
+    ss >> digestReceived;
+    BOOST_CHECK(digestReceived.IsValid());
+
+    CGovernanceSetDigest digestTheirs = CGovernanceSetDigest::WithLayoutOf(digestReceived);
+    for (const auto& hash : vecTheirs) {
+        digestTheirs.Insert(hash);
+    }
+
+    std::set<uint256> setAnnounce;
+    for (const auto& hash : vecTheirs) {
+        if (digestTheirs.Differs(digestReceived, hash)) {
+            setAnnounce.insert(hash);
+        }
+    }
+    return setAnnounce;
+}
+
+BOOST_AUTO_TEST_CASE(digest_layout)
+{
+    BOOST_CHECK_EQUAL(CGovernanceSetDigest().GetBucketCount(), 1);
+    BOOST_CHECK_EQUAL(CGovernanceSetDigest(uint256(), 0).GetBucketCount(), 1);
+    BOOST_CHECK_EQUAL(CGovernanceSetDigest(uint256(), 5).GetBucketCount(), 2);
+    BOOST_CHECK_EQUAL(CGovernanceSetDigest(uint256(), 1000).GetBucketCount(), 256);
+    BOOST_CHECK_EQUAL(CGovernanceSetDigest(uint256(), 100000000).GetBucketCount(), MAX_GOVERNANCE_DIGEST_BUCKETS);
+    BOOST_CHECK(CGovernanceSetDigest(uint256(), 100000000).IsValid());
+}
+
+BOOST_AUTO_TEST_CASE(digest_reconcile)
+{
+    std::vector<uint256> vecCommon;
+    for (int i = 0; i < 5000; i++) {
+        vecCommon.push_back(GetRandHash());
+    }
+
+    // identical sets, nothing to announce
+    BOOST_CHECK(Reconcile(vecCommon, vecCommon).empty());
+
+    // empty requester gets everything
+    BOOST_CHECK_EQUAL(Reconcile(std::vector<uint256>(), vecCommon).size(), vecCommon.size());
+
+    // a few missing hashes are all announced, along with a small number of known ones
+    std::vector<uint256> vecTheirs = vecCommon;
+    std::set<uint256> setMissing;
+    for (int i = 0; i < 10; i++) {
+        uint256 hash = GetRandHash();
+        vecTheirs.push_back(hash);
+        setMissing.insert(hash);
+    }
+    std::set<uint256> setAnnounce = Reconcile(vecCommon, vecTheirs);
+    for (const auto& hash : setMissing) {
+        BOOST_CHECK(setAnnounce.count(hash));
+    }
+    BOOST_CHECK(setAnnounce.size() < 10 * 10);
+
+    // hashes only the requester has make it announce the buckets they fall into, nothing else
+    std::vector<uint256> vecOurs = vecCommon;
+    vecOurs.push_back(GetRandHash());
+    BOOST_CHECK(Reconcile(vecOurs, vecCommon).size() < 20);
+}
+
+BOOST_AUTO_TEST_CASE(digest_invalid_sizes)
+{
+    CGovernanceSetDigest digest(uint256(), 100);
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << uint256() << std::vector<uint64_t>(3, 0);
+    ss >> digest;
+    BOOST_CHECK(!digest.IsValid());
+
+    ss << uint256() << std::vector<uint64_t>();
+    ss >> digest;
+    BOOST_CHECK(!digest.IsValid());
+
+    ss << uint256() << std::vector<uint64_t>(MAX_GOVERNANCE_DIGEST_BUCKETS * 2, 0);
+    ss >> digest;
+    BOOST_CHECK(!digest.IsValid());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,147 @@
+// Copyright (c) 2024 The blazegeek developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "governance-object.h"
+#include "governance-votedb.h"
+#include "masternodeman.h"
+#include "random.h"
+#include "timedata.h"
+
+#include "test/test_blaze.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(governance_votedb_tests, BasicTestingSetup)
+
+static CGovernanceVote CreateVote(const COutPoint& outpoint, const uint256& nParentHash, vote_signal_enum_t eSignal, int64_t nTime)
+{
+    CGovernanceVote vote(outpoint, nParentHash, eSignal, VOTE_OUTCOME_YES);
+    vote.SetTime(nTime);
+    return vote;
+}
+
+BOOST_AUTO_TEST_CASE(votefile_remove_by_masternode)
+{
+    uint256 nParentHash = GetRandHash();
+    COutPoint mn1(GetRandHash(), 0);
+    COutPoint mn2(GetRandHash(), 1);
+
+    CGovernanceObjectVoteFile fileVotes;
+    std::vector<CGovernanceVote> vecVotes1, vecVotes2;
+    for (int i = 0; i < 3; i++) {
+        vecVotes1.push_back(CreateVote(mn1, nParentHash, VOTE_SIGNAL_FUNDING, 1000 + i));
+        vecVotes2.push_back(CreateVote(mn2, nParentHash, VOTE_SIGNAL_FUNDING, 1000 + i));
+        fileVotes.AddVote(vecVotes1.back());
+        fileVotes.AddVote(vecVotes2.back());
+    }
+    // known votes are never added twice
+    fileVotes.AddVote(vecVotes1[0]);
+    BOOST_CHECK_EQUAL(fileVotes.GetVoteCount(), 6);
+
+    fileVotes.RemoveVotesFromMasternode(mn1);
+    BOOST_CHECK_EQUAL(fileVotes.GetVoteCount(), 3);
+    BOOST_CHECK_EQUAL(fileVotes.GetVotes().size(), 3U);
+    for (int i = 0; i < 3; i++) {
+        BOOST_CHECK(!fileVotes.HasVote(vecVotes1[i].GetHash()));
+        BOOST_CHECK(fileVotes.HasVote(vecVotes2[i].GetHash()));
+    }
+
+    // removing old votes keeps the masternode index consistent
+    std::vector<uint256> vecRemoved = fileVotes.RemoveOldVotes(1001);
+    BOOST_CHECK_EQUAL(vecRemoved.size(), 1U);
+    BOOST_CHECK(vecRemoved[0] == vecVotes2[0].GetHash());
+    fileVotes.RemoveVotesFromMasternode(mn2);
+    BOOST_CHECK_EQUAL(fileVotes.GetVoteCount(), 0);
+    BOOST_CHECK(fileVotes.GetVotes().empty());
+
+    // a copy rebuilds its own indexes
+    fileVotes.AddVote(vecVotes1[0]);
+    CGovernanceObjectVoteFile fileVotesCopy(fileVotes);
+    fileVotesCopy.RemoveVotesFromMasternode(mn1);
+    BOOST_CHECK_EQUAL(fileVotesCopy.GetVoteCount(), 0);
+    BOOST_CHECK_EQUAL(fileVotes.GetVoteCount(), 1);
+}
+
+class CGovernanceObjectTest : public CGovernanceObject
+{
+public:
+    using CGovernanceObject::ProcessVote;
+    using CGovernanceObject::ClearMasternodeVotes;
+    using CGovernanceObject::RebuildVoteTally;
+};
+
+static std::vector<int> GetVoteTally(const CGovernanceObject& govobj)
+{
+    std::vector<int> vecTally;
+    for (int nSignal = VOTE_SIGNAL_FUNDING; nSignal <= MAX_SUPPORTED_VOTE_SIGNAL; nSignal++) {
+        for (int nOutcome = VOTE_OUTCOME_YES; nOutcome <= VOTE_OUTCOME_ABSTAIN; nOutcome++) {
+            vecTally.push_back(govobj.CountMatchingVotes((vote_signal_enum_t)nSignal, (vote_outcome_enum_t)nOutcome));
+        }
+    }
+    return vecTally;
+}
+
+// The incremental tally must match one counted from scratch
+static void CheckVoteTally(CGovernanceObjectTest& govobj)
+{
+    std::vector<int> vecTally = GetVoteTally(govobj);
+    govobj.RebuildVoteTally();
+    BOOST_CHECK(GetVoteTally(govobj) == vecTally);
+}
+
+static bool ProcessSignedVote(CGovernanceObjectTest& govobj, const CKey& key, const COutPoint& outpoint, vote_signal_enum_t eSignal, vote_outcome_enum_t eOutcome, int64_t nTime, CConnman& connman)
+{
+    CGovernanceVote vote(outpoint, govobj.GetHash(), eSignal, eOutcome);
+    vote.SetTime(nTime);
+    BOOST_CHECK(vote.Sign(key, key.GetPubKey().GetID()));
+    CGovernanceException exception;
+    return govobj.ProcessVote(nullptr, vote, exception, connman);
+}
+
+BOOST_FIXTURE_TEST_CASE(vote_tally_incremental, TestingSetup)
+{
+    std::vector<CKey> vecKeys(3);
+    std::vector<CMasternode> vecMasternodes;
+    for (auto& key : vecKeys) {
+        key.MakeNewKey(true);
+        CKey keyCollateral;
+        keyCollateral.MakeNewKey(true);
+        vecMasternodes.emplace_back(CService(), COutPoint(GetRandHash(), 0), keyCollateral.GetPubKey(), key.GetPubKey(), PROTOCOL_VERSION);
+        BOOST_CHECK(mnodeman.Add(vecMasternodes.back()));
+    }
+
+    CGovernanceObjectTest govobj;
+    int64_t nTime = GetAdjustedTime();
+
+    // new votes
+    BOOST_CHECK(ProcessSignedVote(govobj, vecKeys[0], vecMasternodes[0].outpoint, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES, nTime, *connman));
+    BOOST_CHECK(ProcessSignedVote(govobj, vecKeys[1], vecMasternodes[1].outpoint, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES, nTime, *connman));
+    BOOST_CHECK(ProcessSignedVote(govobj, vecKeys[2], vecMasternodes[2].outpoint, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_NO, nTime, *connman));
+    BOOST_CHECK(ProcessSignedVote(govobj, vecKeys[2], vecMasternodes[2].outpoint, VOTE_SIGNAL_DELETE, VOTE_OUTCOME_ABSTAIN, nTime, *connman));
+    BOOST_CHECK_EQUAL(govobj.GetYesCount(VOTE_SIGNAL_FUNDING), 2);
+    BOOST_CHECK_EQUAL(govobj.GetNoCount(VOTE_SIGNAL_FUNDING), 1);
+    BOOST_CHECK_EQUAL(govobj.GetAbstainCount(VOTE_SIGNAL_DELETE), 1);
+    CheckVoteTally(govobj);
+
+    // a changed outcome moves the vote, an obsolete one changes nothing
+    BOOST_CHECK(ProcessSignedVote(govobj, vecKeys[1], vecMasternodes[1].outpoint, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_NO, nTime + 1, *connman));
+    BOOST_CHECK(!ProcessSignedVote(govobj, vecKeys[0], vecMasternodes[0].outpoint, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_NO, nTime - 1, *connman));
+    BOOST_CHECK_EQUAL(govobj.GetYesCount(VOTE_SIGNAL_FUNDING), 1);
+    BOOST_CHECK_EQUAL(govobj.GetNoCount(VOTE_SIGNAL_FUNDING), 2);
+    CheckVoteTally(govobj);
+
+    // the votes of a removed masternode are dropped
+    mnodeman.Clear();
+    BOOST_CHECK(mnodeman.Add(vecMasternodes[0]));
+    BOOST_CHECK(mnodeman.Add(vecMasternodes[1]));
+    govobj.ClearMasternodeVotes();
+    BOOST_CHECK_EQUAL(govobj.GetYesCount(VOTE_SIGNAL_FUNDING), 1);
+    BOOST_CHECK_EQUAL(govobj.GetNoCount(VOTE_SIGNAL_FUNDING), 1);
+    BOOST_CHECK_EQUAL(govobj.GetAbstainCount(VOTE_SIGNAL_DELETE), 0);
+    CheckVoteTally(govobj);
+
+    mnodeman.Clear();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,58 @@
+// Copyright (c) 2024 The blazegeek developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chainparams.h"
+#include "instantx.h"
+#include "net.h"
+#include "random.h"
+
+#include "test/test_blaze.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(instantsend_tests, TestingSetup)
+
+static CTxLockVote RandomVote()
+{
+    return CTxLockVote(GetRandHash(), COutPoint(GetRandHash(), 0), COutPoint(GetRandHash(), 0), uint256(), uint256());
+}
+
+BOOST_AUTO_TEST_CASE(vote_queue)
+{
+    CAddress addr(CService(CNetAddr(), Params().GetDefaultPort()), NODE_NONE);
+    CNode dummyNode(0, NODE_NETWORK, 0, INVALID_SOCKET, addr, 0, 0, "", true);
+    dummyNode.SetSendVersion(PROTOCOL_VERSION);
+    dummyNode.nVersion = PROTOCOL_VERSION;
+
+    // without threads the message handler processes the votes itself
+    BOOST_CHECK(!instantsend.QueueTxLockVote(&dummyNode, RandomVote(), *connman));
+    BOOST_CHECK_EQUAL(dummyNode.GetRefCount(), 0);
+
+    // queued votes hold a reference to their node until they are processed,
+    // the votes of unknown masternodes are just rejected by the workers
+    instantsend.StartVoteProcessing(2, 100);
+    for (int i = 0; i < 10; i++) {
+        BOOST_CHECK(instantsend.QueueTxLockVote(&dummyNode, RandomVote(), *connman));
+    }
+    BOOST_CHECK(instantsend.GetQueuedVoteCount() <= 10);
+    instantsend.StopVoteProcessing();
+    BOOST_CHECK_EQUAL(instantsend.GetQueuedVoteCount(), 0U);
+    BOOST_CHECK_EQUAL(dummyNode.GetRefCount(), 0);
+
+    // a full queue turns votes away without taking a reference
+    instantsend.StartVoteProcessing(1, 0);
+    BOOST_CHECK(!instantsend.QueueTxLockVote(&dummyNode, RandomVote(), *connman));
+    BOOST_CHECK_EQUAL(instantsend.GetQueuedVoteCount(), 0U);
+    BOOST_CHECK_EQUAL(dummyNode.GetRefCount(), 0);
+    instantsend.StopVoteProcessing();
+
+    // a queue with room takes the vote
+    instantsend.StartVoteProcessing(1, 1);
+    BOOST_CHECK(instantsend.QueueTxLockVote(&dummyNode, RandomVote(), *connman));
+    instantsend.StopVoteProcessing();
+    BOOST_CHECK_EQUAL(instantsend.GetQueuedVoteCount(), 0U);
+    BOOST_CHECK_EQUAL(dummyNode.GetRefCount(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
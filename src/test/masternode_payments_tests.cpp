@@ -0,0 +1,213 @@
+// Copyright (c) 2024 The blazegeek developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "clientversion.h"
+#include "masternode-payments.h"
+#include "streams.h"
+
+#include "test/test_blaze.h"
+
+#include <boost/test/unit_test.hpp>
+
+class CMasternodePaymentsTest : public CMasternodePayments
+{
+public:
+    using CMasternodePayments::vecBlockPayees;
+    using CMasternodePayments::GetBlockPayees;
+    using CMasternodePayments::GetOrCreateBlockPayees;
+    using CMasternodePayments::ResizeBlockPayees;
+    using CMasternodePayments::AddPaymentVote;
+
+    /// Is every stored vote indexed at its position, and nothing else?
+    bool CheckVoteIndex() const
+    {
+        LOCK(cs_mapMasternodeBlocks);
+        size_t nVotes = 0;
+        for (const auto& blockPayees : vecBlockPayees) {
+            for (size_t i = 0; i < blockPayees.vecVotes.size(); i++) {
+                const auto it = mapPaymentVoteIndex.find(blockPayees.vecVotes[i].first);
+                if (it == mapPaymentVoteIndex.end() || it->second != std::make_pair(blockPayees.nBlockHeight, i)) {
+                    return false;
+                }
+                nVotes++;
+            }
+        }
+        return nVotes == mapPaymentVoteIndex.size();
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(masternode_payments_tests, BasicTestingSetup)
+
+static CMasternodePaymentVote MakeVote(uint32_t n, int nBlockHeight, const CScript& payee, bool fVerified)
+{
+    CMasternodePaymentVote vote(COutPoint(uint256S("01"), n), nBlockHeight, payee);
+    if (fVerified) {
+        vote.vchSig.push_back(1);
+    }
+    return vote;
+}
+
+BOOST_AUTO_TEST_CASE(block_payees_tally)
+{
+    const int nHeight = 1000;
+    CScript payee1 = CScript() << OP_1;
+    CScript payee2 = CScript() << OP_2;
+    CScript payeeRet;
+
+    CMasternodeBlockPayees blockPayees(nHeight);
+    BOOST_CHECK(!blockPayees.HasPayees());
+    BOOST_CHECK(!blockPayees.GetBestPayee(payeeRet));
+
+    // seen but not verified votes are not counted
+    std::vector<CMasternodePaymentVote> vecVotes;
+    for (uint32_t i = 0; i < 5; i++) {
+        vecVotes.push_back(MakeVote(i, nHeight, i < 2 ? payee1 : payee2, true));
+        CMasternodePaymentVote voteSeen = vecVotes.back();
+        voteSeen.MarkAsNotVerified();
+        BOOST_CHECK_EQUAL(blockPayees.AddVote(voteSeen.GetHash(), voteSeen), i);
+    }
+    BOOST_CHECK(!blockPayees.HasPayees());
+    BOOST_CHECK_EQUAL(blockPayees.vecVotes.size(), 5);
+
+    // 1:1
+    blockPayees.AddPayee(0, vecVotes[0]);
+    blockPayees.AddPayee(2, vecVotes[2]);
+    BOOST_CHECK(blockPayees.GetBestPayee(payeeRet));
+    BOOST_CHECK(payeeRet == payee1);
+
+    // 1:2
+    blockPayees.AddPayee(3, vecVotes[3]);
+    BOOST_CHECK(blockPayees.GetBestPayee(payeeRet));
+    BOOST_CHECK(payeeRet == payee2);
+    BOOST_CHECK(blockPayees.HasPayeeWithVotes(payee2, 2));
+    BOOST_CHECK(!blockPayees.HasPayeeWithVotes(payee1, 2));
+
+    // 2:2, ties go to the payee seen first
+    blockPayees.AddPayee(1, vecVotes[1]);
+    BOOST_CHECK(blockPayees.GetBestPayee(payeeRet));
+    BOOST_CHECK(payeeRet == payee1);
+    BOOST_CHECK(blockPayees.vecVotes[1].second.IsVerified());
+    BOOST_CHECK(!blockPayees.vecVotes[4].second.IsVerified());
+
+    blockPayees.Reset(nHeight + 1);
+    BOOST_CHECK_EQUAL(blockPayees.nBlockHeight, nHeight + 1);
+    BOOST_CHECK(!blockPayees.HasPayees());
+    BOOST_CHECK(blockPayees.vecVotes.empty());
+    BOOST_CHECK(!blockPayees.GetBestPayee(payeeRet));
+}
+
+BOOST_AUTO_TEST_CASE(payments_ring_wraparound)
+{
+    CMasternodePaymentsTest payments;
+    CScript payee = CScript() << OP_1;
+    const int nHeight = 1000;
+
+    LOCK(cs_mapMasternodeBlocks);
+    const int nSize = payments.vecBlockPayees.size();
+    BOOST_CHECK(!payments.GetOrCreateBlockPayees(-1));
+
+    // a vote seen first and verified later is stored once
+    CMasternodePaymentVote vote = MakeVote(0, nHeight, payee, true);
+    CMasternodePaymentVote voteSeen = vote;
+    voteSeen.MarkAsNotVerified();
+    BOOST_CHECK(payments.AddPaymentVote(voteSeen));
+    BOOST_CHECK(!payments.HasPaymentBlock(nHeight));
+    BOOST_CHECK(payments.AddPaymentVote(vote));
+    BOOST_CHECK(!payments.AddPaymentVote(vote));
+    BOOST_CHECK(payments.HasPaymentBlock(nHeight));
+    BOOST_CHECK(payments.AddPaymentVote(MakeVote(1, nHeight, payee, false)));
+    BOOST_CHECK(payments.AddPaymentVote(MakeVote(2, nHeight + 1, payee, true)));
+    BOOST_CHECK_EQUAL(payments.GetVoteCount(), 3);
+    BOOST_CHECK_EQUAL(payments.GetBlockCount(), 2);
+    BOOST_CHECK(payments.CheckVoteIndex());
+
+    // a full ring later the slot is reused, dropping the votes of the old height
+    CMasternodeBlockPayees* pblockPayees = payments.GetOrCreateBlockPayees(nHeight + nSize);
+    BOOST_CHECK(pblockPayees && pblockPayees->nBlockHeight == nHeight + nSize);
+    BOOST_CHECK(pblockPayees->vecVotes.empty());
+    BOOST_CHECK(!payments.GetBlockPayees(nHeight));
+    BOOST_CHECK(!payments.HasPaymentVote(vote.GetHash()));
+    BOOST_CHECK_EQUAL(payments.GetVoteCount(), 1);
+    BOOST_CHECK_EQUAL(payments.GetBlockCount(), 1);
+    BOOST_CHECK(payments.CheckVoteIndex());
+
+    // and the old height doesn't get it back
+    BOOST_CHECK(!payments.GetOrCreateBlockPayees(nHeight));
+    BOOST_CHECK(!payments.AddPaymentVote(MakeVote(3, nHeight, payee, true)));
+    BOOST_CHECK(payments.GetBlockPayees(nHeight + nSize) == pblockPayees);
+
+    // the neighbouring height keeps its slot
+    BOOST_CHECK(payments.HasPaymentBlock(nHeight + 1));
+    BOOST_CHECK(payments.AddPaymentVote(MakeVote(4, nHeight + nSize, payee, true)));
+    BOOST_CHECK_EQUAL(payments.GetVoteCount(), 2);
+    BOOST_CHECK_EQUAL(payments.GetBlockCount(), 2);
+    BOOST_CHECK(payments.CheckVoteIndex());
+}
+
+BOOST_AUTO_TEST_CASE(payments_ring_resize)
+{
+    CMasternodePaymentsTest payments;
+    CScript payee = CScript() << OP_1;
+    const int nLimit = payments.GetStorageLimit() + 100;
+    const int nSize = nLimit + MNPAYMENTS_FUTURE_BLOCKS + 1;
+
+    LOCK(cs_mapMasternodeBlocks);
+    const size_t nSizeOld = payments.vecBlockPayees.size();
+    BOOST_CHECK(nSizeOld < (size_t)nSize);
+
+    // these land in different slots now, but all in the first one of the bigger ring
+    BOOST_CHECK(payments.AddPaymentVote(MakeVote(0, nSize, payee, true)));
+    BOOST_CHECK(payments.AddPaymentVote(MakeVote(1, 2 * nSize, payee, true)));
+    BOOST_CHECK(payments.AddPaymentVote(MakeVote(2, 2 * nSize, payee, false)));
+    BOOST_CHECK(payments.AddPaymentVote(MakeVote(3, 2 * nSize + 1, payee, true)));
+    BOOST_CHECK_EQUAL(payments.GetBlockCount(), 3);
+
+    // the ring never shrinks
+    payments.ResizeBlockPayees(0);
+    BOOST_CHECK_EQUAL(payments.vecBlockPayees.size(), nSizeOld);
+
+    // moved blocks keep their votes, the older one of a collision is dropped
+    payments.ResizeBlockPayees(nLimit);
+    BOOST_CHECK_EQUAL(payments.vecBlockPayees.size(), (size_t)nSize);
+    BOOST_CHECK(!payments.GetBlockPayees(nSize));
+    BOOST_CHECK(payments.GetBlockPayees(2 * nSize) && payments.GetBlockPayees(2 * nSize)->vecVotes.size() == 2);
+    BOOST_CHECK(payments.HasPaymentBlock(2 * nSize + 1));
+    BOOST_CHECK(payments.HasPaymentVote(MakeVote(2, 2 * nSize, payee, false).GetHash()));
+    BOOST_CHECK(!payments.HasPaymentVote(MakeVote(0, nSize, payee, false).GetHash()));
+    BOOST_CHECK_EQUAL(payments.GetVoteCount(), 3);
+    BOOST_CHECK_EQUAL(payments.GetBlockCount(), 2);
+    BOOST_CHECK(payments.CheckVoteIndex());
+
+    // a height which took the slot of another one in the old ring gets its own now
+    BOOST_CHECK(payments.AddPaymentVote(MakeVote(4, 2 * nSize + 1 + nSizeOld, payee, true)));
+    BOOST_CHECK(payments.HasPaymentBlock(2 * nSize + 1));
+    BOOST_CHECK(payments.CheckVoteIndex());
+}
+
+BOOST_AUTO_TEST_CASE(payments_serialization)
+{
+    CMasternodePaymentsTest payments;
+    CScript payee = CScript() << OP_1;
+    {
+        LOCK(cs_mapMasternodeBlocks);
+        for (uint32_t i = 0; i < 10; i++) {
+            BOOST_CHECK(payments.AddPaymentVote(MakeVote(i, 1000 + i / 2, payee, i % 3 != 0)));
+        }
+    }
+
+    // the buckets, the index and the tallies are rebuilt from the votes
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << payments;
+    CMasternodePaymentsTest paymentsLoaded;
+    ss >> paymentsLoaded;
+    BOOST_CHECK_EQUAL(paymentsLoaded.vecBlockPayees.size(), payments.vecBlockPayees.size());
+    BOOST_CHECK_EQUAL(paymentsLoaded.GetVoteCount(), 10);
+    BOOST_CHECK_EQUAL(paymentsLoaded.GetBlockCount(), payments.GetBlockCount());
+    BOOST_CHECK(paymentsLoaded.CheckVoteIndex());
+    for (uint32_t i = 0; i < 10; i++) {
+        BOOST_CHECK_EQUAL(paymentsLoaded.HasVerifiedPaymentVote(MakeVote(i, 1000 + i / 2, payee, false).GetHash()), i % 3 != 0);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
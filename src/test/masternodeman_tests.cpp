@@ -0,0 +1,115 @@
+// Copyright (c) 2024 The blazegeek developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "masternodeman.h"
+#include "random.h"
+
+#include "test/test_blaze.h"
+
+#include <boost/test/unit_test.hpp>
+
+class CMasternodeManTest : public CMasternodeMan
+{
+public:
+    using CMasternodeMan::MAX_SCORE_CACHE_BLOCKS;
+    using CMasternodeMan::cs;
+    using CMasternodeMan::mapMasternodes;
+    using CMasternodeMan::mapScoreCache;
+    using CMasternodeMan::listScoreCacheOrder;
+    using CMasternodeMan::GetLegacyScores;
+    using CMasternodeMan::Erase;
+
+    /// Number of scores for nBlockHash and whether every one of them points into mapMasternodes
+    size_t GetScoreCount(const uint256& nBlockHash, bool& fValid)
+    {
+        LOCK(cs);
+        const auto& vecScores = GetLegacyScores(nBlockHash).vecScores;
+        fValid = true;
+        for (const auto& scorePair : vecScores) {
+            auto it = mapMasternodes.find(scorePair.second->outpoint);
+            fValid = fValid && it != mapMasternodes.end() && &it->second == scorePair.second;
+        }
+        return vecScores.size();
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(masternodeman_tests, TestingSetup)
+
+static CMasternode MakeMasternode()
+{
+    CKey key;
+    key.MakeNewKey(true);
+    return CMasternode(CService(), COutPoint(GetRandHash(), 0), key.GetPubKey(), key.GetPubKey(), PROTOCOL_VERSION);
+}
+
+BOOST_AUTO_TEST_CASE(score_cache_lru)
+{
+    CMasternodeManTest mnman;
+    for (int i = 0; i < 3; i++) {
+        CMasternode mn = MakeMasternode();
+        BOOST_CHECK(mnman.Add(mn));
+    }
+
+    const size_t nMaxBlocks = CMasternodeManTest::MAX_SCORE_CACHE_BLOCKS;
+    std::vector<uint256> vecHashes;
+    for (size_t i = 0; i <= nMaxBlocks; i++) {
+        vecHashes.push_back(GetRandHash());
+    }
+
+    LOCK(mnman.cs);
+    for (size_t i = 0; i < nMaxBlocks; i++) {
+        BOOST_CHECK_EQUAL(mnman.GetLegacyScores(vecHashes[i]).vecScores.size(), 3U);
+    }
+    BOOST_CHECK_EQUAL(mnman.mapScoreCache.size(), nMaxBlocks);
+
+    // using the oldest entry again makes the next one the least recently used
+    mnman.GetLegacyScores(vecHashes[0]);
+    BOOST_CHECK(mnman.listScoreCacheOrder.front() == vecHashes[1]);
+    BOOST_CHECK(mnman.listScoreCacheOrder.back() == vecHashes[0]);
+
+    mnman.GetLegacyScores(vecHashes.back());
+    BOOST_CHECK_EQUAL(mnman.mapScoreCache.size(), nMaxBlocks);
+    BOOST_CHECK_EQUAL(mnman.listScoreCacheOrder.size(), nMaxBlocks);
+    BOOST_CHECK(!mnman.mapScoreCache.count(vecHashes[1]));
+    BOOST_CHECK(mnman.mapScoreCache.count(vecHashes[0]));
+    BOOST_CHECK(mnman.mapScoreCache.count(vecHashes.back()));
+    BOOST_CHECK(mnman.listScoreCacheOrder.front() == vecHashes[2]);
+    BOOST_CHECK(mnman.listScoreCacheOrder.back() == vecHashes.back());
+}
+
+BOOST_AUTO_TEST_CASE(score_cache_list_changes)
+{
+    CMasternodeManTest mnman;
+    for (int i = 0; i < 3; i++) {
+        CMasternode mn = MakeMasternode();
+        BOOST_CHECK(mnman.Add(mn));
+    }
+
+    uint256 nBlockHash = GetRandHash();
+    bool fValid;
+    BOOST_CHECK_EQUAL(mnman.GetScoreCount(nBlockHash, fValid), 3U);
+    BOOST_CHECK(fValid);
+
+    // a new masternode is scored
+    CMasternode mn = MakeMasternode();
+    BOOST_CHECK(mnman.Add(mn));
+    BOOST_CHECK(mnman.mapScoreCache.empty());
+    BOOST_CHECK_EQUAL(mnman.GetScoreCount(nBlockHash, fValid), 4U);
+    BOOST_CHECK(fValid);
+
+    // an erased one is not
+    {
+        LOCK(mnman.cs);
+        mnman.Erase(mnman.mapMasternodes.find(mn.outpoint));
+        BOOST_CHECK(mnman.mapScoreCache.empty());
+    }
+    BOOST_CHECK_EQUAL(mnman.GetScoreCount(nBlockHash, fValid), 3U);
+    BOOST_CHECK(fValid);
+
+    mnman.Clear();
+    BOOST_CHECK(mnman.mapScoreCache.empty());
+    BOOST_CHECK_EQUAL(mnman.GetScoreCount(nBlockHash, fValid), 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
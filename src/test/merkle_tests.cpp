@@ -133,4 +133,46 @@ BOOST_AUTO_TEST_CASE(merkle_test)
     }
 }
 
+BOOST_AUTO_TEST_CASE(merkle_threads)
+{
+    // Sizes around the chunk boundaries, where the last chunk is partial or a single leaf.
+    for (size_t ntx : {2 * MIN_MERKLE_LEAVES_PER_THREAD, 2 * MIN_MERKLE_LEAVES_PER_THREAD + 1, 3 * MIN_MERKLE_LEAVES_PER_THREAD - 1,
+                       5 * MIN_MERKLE_LEAVES_PER_THREAD + 3, 8 * MIN_MERKLE_LEAVES_PER_THREAD + 1}) {
+        CBlock block;
+        block.vtx.resize(ntx);
+        for (size_t j = 0; j < ntx; j++) {
+            CMutableTransaction mtx;
+            mtx.nLockTime = j;
+            block.vtx[j] = MakeTransactionRef(std::move(mtx));
+        }
+        bool fMutated = true;
+        uint256 root = BlockMerkleRoot(block, &fMutated);
+        BOOST_CHECK(!fMutated);
+        for (int nThreads : {2, 3, 4, 16}) {
+            bool fMutatedThreads = true;
+            BOOST_CHECK(BlockMerkleRoot(block, &fMutatedThreads, nThreads) == root);
+            BOOST_CHECK(!fMutatedThreads);
+        }
+
+        // Duplicate a subtree inside one of the chunks, and the last transactions of the block.
+        CBlock blockMutated(block);
+        blockMutated.vtx[MIN_MERKLE_LEAVES_PER_THREAD + 3] = blockMutated.vtx[MIN_MERKLE_LEAVES_PER_THREAD + 2];
+        for (int nThreads : {1, 4}) {
+            bool fMutatedThreads = false;
+            BlockMerkleRoot(blockMutated, &fMutatedThreads, nThreads);
+            BOOST_CHECK(fMutatedThreads);
+        }
+        int nDuplicate = 1 << ctz(ntx);
+        if (nDuplicate < (int)ntx) {
+            blockMutated = block;
+            for (int j = 0; j < nDuplicate; j++) {
+                blockMutated.vtx.push_back(blockMutated.vtx[ntx + j - nDuplicate]);
+            }
+            bool fMutatedThreads = false;
+            BOOST_CHECK(BlockMerkleRoot(blockMutated, &fMutatedThreads, 4) == root);
+            BOOST_CHECK(fMutatedThreads);
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
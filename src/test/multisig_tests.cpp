@@ -10,6 +10,7 @@
 #include "script/interpreter.h"
 #include "script/sign.h"
 #include "script/ismine.h"
+#include "script/standard.h"
 #include "uint256.h"
 #include "test/test_blaze.h"
 
@@ -304,5 +305,68 @@ BOOST_AUTO_TEST_CASE(multisig_Sign)
     }
 }
 
+BOOST_AUTO_TEST_CASE(multisig_SignTransaction)
+{
+    // SignTransaction() must produce the same signatures as signing input by input
+    CBasicKeyStore keystore;
+    CKey key[3];
+    std::vector<CPubKey> pubkeys;
+    for (int i = 0; i < 3; i++)
+    {
+        key[i].MakeNewKey(true);
+        keystore.AddKey(key[i]);
+        pubkeys.push_back(key[i].GetPubKey());
+    }
+    CScript escrow = GetScriptForMultisig(2, pubkeys);
+    keystore.AddCScript(escrow);
+
+    CKey keyUnknown;
+    keyUnknown.MakeNewKey(true);
+
+    std::vector<CScript> scriptPubKeys;
+    scriptPubKeys.push_back(GetScriptForDestination(key[0].GetPubKey().GetID()));
+    scriptPubKeys.push_back(CScript() << ToByteVector(key[1].GetPubKey()) << OP_CHECKSIG);
+    scriptPubKeys.push_back(escrow);
+    scriptPubKeys.push_back(GetScriptForDestination(CScriptID(escrow)));
+
+    CMutableTransaction txTo;
+    std::vector<CScript> vScriptPubKeys;
+    for (unsigned int i = 0; i < 200; i++)
+    {
+        txTo.vin.push_back(CTxIn(COutPoint(GetRandHash(), i)));
+        vScriptPubKeys.push_back(scriptPubKeys[i % scriptPubKeys.size()]);
+    }
+    txTo.vout.resize(2);
+    txTo.vout[0].nValue = 1;
+    txTo.vout[1].nValue = 2;
+
+    CMutableTransaction txSerial(txTo);
+    for (unsigned int i = 0; i < txSerial.vin.size(); i++)
+    {
+        BOOST_CHECK(SignSignature(keystore, vScriptPubKeys[i], txSerial, i));
+    }
+
+    BOOST_CHECK(SignTransaction(keystore, vScriptPubKeys, txTo));
+    BOOST_CHECK(txTo.GetHash() == txSerial.GetHash());
+
+    // an input that can't be signed fails the transaction, the others are still signed
+    vScriptPubKeys[5] = GetScriptForDestination(keyUnknown.GetPubKey().GetID());
+    CMutableTransaction txMissing(txSerial);
+    BOOST_CHECK(!SignTransaction(keystore, vScriptPubKeys, txMissing));
+    BOOST_CHECK(txMissing.vin[5].scriptSig.empty());
+    BOOST_CHECK(txMissing.vin[6].scriptSig == txSerial.vin[6].scriptSig);
+
+    // the keys are copied for the signing threads
+    CBasicKeyStore keysCopy;
+    GetSigningKeys(keystore, scriptPubKeys[3], keysCopy);
+    for (int i = 0; i < 3; i++)
+        BOOST_CHECK(keysCopy.HaveKey(key[i].GetPubKey().GetID()));
+    BOOST_CHECK(keysCopy.HaveCScript(CScriptID(escrow)));
+
+    std::vector<int> vCalls(1000, 0);
+    ForEachInput(vCalls.size(), 4, [&vCalls](unsigned int i) { vCalls[i]++; });
+    BOOST_CHECK(std::count(vCalls.begin(), vCalls.end(), 1) == (int)vCalls.size());
+}
+
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,266 @@
+// Copyright (c) 2024 The blazegeek developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "netbase.h"
+#include "privatesend-server.h"
+#include "script/sign.h"
+#include "script/standard.h"
+#include "util.h"
+#include "utiltime.h"
+
+#include "test/test_blaze.h"
+
+#include <boost/test/unit_test.hpp>
+
+class CPrivateSendServerTest : public CPrivateSendServer
+{
+public:
+    CPrivateSendServerTest() { fUnitTest = true; }
+
+    using CPrivateSendServer::cs_sessions;
+    using CPrivateSendServer::CreateNewSession;
+    using CPrivateSendServer::AddUserToExistingSession;
+    using CPrivateSendServer::GetParticipantSession;
+    using CPrivateSendServer::CheckSession;
+    using CPrivateSendServer::RemoveSession;
+};
+
+class CPrivateSendServerSessionTest : public CPrivateSendServerSession
+{
+public:
+    CPrivateSendServerSessionTest(int nSessionIDIn, int nSessionDenomIn) : CPrivateSendServerSession(nSessionIDIn, nSessionDenomIn) {}
+
+    using CPrivateSendServerSession::finalMutableTransaction;
+    using CPrivateSendServerSession::txFinalUnsigned;
+    using CPrivateSendServerSession::AddUser;
+    using CPrivateSendServerSession::AddEntry;
+    using CPrivateSendServerSession::PrepareScriptSigs;
+    using CPrivateSendServerSession::AddScriptSigs;
+    using CPrivateSendServerSession::IsSignaturesComplete;
+    using CPrivateSendServerSession::SetState;
+};
+
+struct PrivateSendServerTestingSetup : public TestChain100Setup {
+    PrivateSendServerTestingSetup()
+    {
+        fMasternodeMode = true;
+        CPrivateSend::InitStandardDenominations();
+    }
+    ~PrivateSendServerTestingSetup()
+    {
+        fMasternodeMode = false;
+    }
+
+    CScript GetCoinbaseScript() const
+    {
+        return CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    }
+
+    std::vector<unsigned char> SignInput(const CMutableTransaction& tx, unsigned int nIn) const
+    {
+        std::vector<unsigned char> vchSig;
+        uint256 hash = SignatureHash(GetCoinbaseScript(), tx, nIn, SIGHASH_ALL);
+        BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+        vchSig.push_back((unsigned char)SIGHASH_ALL);
+        return vchSig;
+    }
+
+    /// Collateral spending a mature coinbase output, paying the collateral fee
+    CMutableTransaction CreateCollateral(const CTransaction& txFrom) const
+    {
+        CMutableTransaction tx;
+        tx.vin.emplace_back(COutPoint(txFrom.GetHash(), 0));
+        tx.vout.emplace_back(txFrom.vout[0].nValue - CPrivateSend::GetCollateralAmount(), GetScriptForDestination(coinbaseKey.GetPubKey().GetID()));
+        tx.vin[0].scriptSig << SignInput(tx, 0);
+        return tx;
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(privatesend_server_tests, PrivateSendServerTestingSetup)
+
+BOOST_AUTO_TEST_CASE(session_routing)
+{
+    CPrivateSendServerTest server;
+    PoolMessage nMessageID;
+    std::vector<CService> vecAddr;
+    for (int i = 0; i < 5; i++) {
+        vecAddr.push_back(LookupNumeric(strprintf("1.2.3.%d", i + 1).c_str(), Params().GetDefaultPort()));
+    }
+    CPrivateSendAccept dsa(1, CMutableTransaction());
+
+    LOCK(server.cs_sessions);
+
+    // denominations which don't exist are refused
+    BOOST_CHECK(!server.CreateNewSession(CPrivateSendAccept(1 << 10, CMutableTransaction()), vecAddr[0], nMessageID, *connman));
+    BOOST_CHECK_EQUAL(nMessageID, ERR_DENOM);
+    BOOST_CHECK_EQUAL(server.GetSessionCount(), 0);
+
+    // nobody is gathering users until the first session is created
+    BOOST_CHECK(!server.AddUserToExistingSession(dsa, vecAddr[0], nMessageID));
+    CPrivateSendServerSession* psession1 = server.CreateNewSession(dsa, vecAddr[0], nMessageID, *connman);
+    BOOST_CHECK(psession1);
+    BOOST_CHECK_EQUAL(nMessageID, MSG_NOERR);
+    BOOST_CHECK_EQUAL(psession1->GetState(), POOL_STATE_QUEUE);
+    BOOST_CHECK(server.GetParticipantSession(vecAddr[0]) == psession1);
+    BOOST_CHECK(!server.GetParticipantSession(vecAddr[1]));
+
+    // users with another denomination are not added to the queue
+    BOOST_CHECK(!server.AddUserToExistingSession(CPrivateSendAccept(2, CMutableTransaction()), vecAddr[1], nMessageID));
+    BOOST_CHECK_EQUAL(nMessageID, ERR_DENOM);
+    BOOST_CHECK(!server.GetParticipantSession(vecAddr[1]));
+
+    // the others join the session in queue mode until it is full
+    for (int i = 1; i < CPrivateSend::GetMaxPoolTransactions(); i++) {
+        BOOST_CHECK(server.AddUserToExistingSession(dsa, vecAddr[i], nMessageID) == psession1);
+        BOOST_CHECK(server.GetParticipantSession(vecAddr[i]) == psession1);
+    }
+    int nSessionID1 = psession1->GetSessionID();
+    server.CheckSession(nSessionID1, *connman);
+    BOOST_CHECK_EQUAL(psession1->GetState(), POOL_STATE_ACCEPTING_ENTRIES);
+
+    // and the next user starts another session
+    int nNext = CPrivateSend::GetMaxPoolTransactions();
+    BOOST_CHECK(!server.AddUserToExistingSession(dsa, vecAddr[nNext], nMessageID));
+    CPrivateSendServerSession* psession2 = server.CreateNewSession(dsa, vecAddr[nNext], nMessageID, *connman);
+    BOOST_CHECK(psession2 && psession2 != psession1);
+    BOOST_CHECK_EQUAL(server.GetSessionCount(), 2);
+
+    // removing a session forgets its participants only
+    server.RemoveSession(nSessionID1);
+    BOOST_CHECK_EQUAL(server.GetSessionCount(), 1);
+    for (int i = 0; i < nNext; i++) {
+        BOOST_CHECK(!server.GetParticipantSession(vecAddr[i]));
+    }
+    BOOST_CHECK(server.GetParticipantSession(vecAddr[nNext]) == psession2);
+}
+
+BOOST_AUTO_TEST_CASE(session_add_user_entry)
+{
+    CPrivateSendServerSessionTest session(1, 1);
+    PoolMessage nMessageID;
+
+    // users are taken until the session is ready
+    BOOST_CHECK(!session.AddUser(CPrivateSendAccept(2, CMutableTransaction()), nMessageID));
+    BOOST_CHECK_EQUAL(nMessageID, ERR_DENOM);
+    for (int i = 0; i < CPrivateSend::GetMaxPoolTransactions(); i++) {
+        BOOST_CHECK(session.AddUser(CPrivateSendAccept(1, CMutableTransaction()), nMessageID));
+        BOOST_CHECK_EQUAL(nMessageID, MSG_NOERR);
+    }
+    BOOST_CHECK(!session.AddUser(CPrivateSendAccept(1, CMutableTransaction()), nMessageID));
+    BOOST_CHECK_EQUAL(nMessageID, ERR_QUEUE_FULL);
+
+    CTransaction txCollateral(CreateCollateral(coinbaseTxns[0]));
+    std::vector<CTxOut> vecTxOut;
+
+    // entries need real inputs and a valid collateral
+    std::vector<CTxDSIn> vecTxDSIn{CTxDSIn(CTxIn(), CScript())};
+    BOOST_CHECK(!session.AddEntry(CPrivateSendEntry(vecTxDSIn, vecTxOut, txCollateral), nMessageID));
+    BOOST_CHECK_EQUAL(nMessageID, ERR_INVALID_INPUT);
+
+    vecTxDSIn = {CTxDSIn(CTxIn(COutPoint(GetRandHash(), 0)), CScript())};
+    CMutableTransaction txBadCollateral(txCollateral);
+    txBadCollateral.vout[0].nValue = coinbaseTxns[0].vout[0].nValue;
+    BOOST_CHECK(!session.AddEntry(CPrivateSendEntry(vecTxDSIn, vecTxOut, txBadCollateral), nMessageID));
+    BOOST_CHECK_EQUAL(nMessageID, ERR_INVALID_COLLATERAL);
+
+    BOOST_CHECK(session.AddEntry(CPrivateSendEntry(vecTxDSIn, vecTxOut, txCollateral), nMessageID));
+    BOOST_CHECK_EQUAL(nMessageID, MSG_ENTRIES_ADDED);
+    BOOST_CHECK_EQUAL(session.GetEntriesCount(), 1);
+
+    // an input can only be mixed once
+    BOOST_CHECK(!session.AddEntry(CPrivateSendEntry(vecTxDSIn, vecTxOut, txCollateral), nMessageID));
+    BOOST_CHECK_EQUAL(nMessageID, ERR_ALREADY_HAVE);
+
+    // every user gets one entry
+    while (session.GetEntriesCount() < CPrivateSend::GetMaxPoolTransactions()) {
+        vecTxDSIn = {CTxDSIn(CTxIn(COutPoint(GetRandHash(), 0)), CScript())};
+        BOOST_CHECK(session.AddEntry(CPrivateSendEntry(vecTxDSIn, vecTxOut, txCollateral), nMessageID));
+    }
+    vecTxDSIn = {CTxDSIn(CTxIn(COutPoint(GetRandHash(), 0)), CScript())};
+    BOOST_CHECK(!session.AddEntry(CPrivateSendEntry(vecTxDSIn, vecTxOut, txCollateral), nMessageID));
+    BOOST_CHECK_EQUAL(nMessageID, ERR_ENTRIES_FULL);
+}
+
+BOOST_AUTO_TEST_CASE(session_script_sigs)
+{
+    CPrivateSendServerSessionTest session(1, 1);
+    PoolMessage nMessageID;
+
+    CTxIn txin(COutPoint(coinbaseTxns[1].GetHash(), 0));
+    std::vector<CTxDSIn> vecTxDSIn{CTxDSIn(txin, GetCoinbaseScript())};
+    BOOST_CHECK(session.AddEntry(CPrivateSendEntry(vecTxDSIn, std::vector<CTxOut>(), CreateCollateral(coinbaseTxns[0])), nMessageID));
+
+    session.finalMutableTransaction.vin.emplace_back(COutPoint(GetRandHash(), 0));
+    session.finalMutableTransaction.vin.push_back(txin);
+    session.finalMutableTransaction.vout.emplace_back(coinbaseTxns[1].vout[0].nValue, GetScriptForDestination(coinbaseKey.GetPubKey().GetID()));
+    session.txFinalUnsigned = MakeTransactionRef(session.finalMutableTransaction);
+    session.SetState(POOL_STATE_SIGNING);
+
+    std::vector<CTxIn> vecTxIn{txin};
+    vecTxIn[0].scriptSig << SignInput(session.finalMutableTransaction, 1);
+
+    // inputs are matched to their position in the final transaction
+    std::vector<std::pair<unsigned int, CScript> > vecChecks;
+    BOOST_CHECK(!session.PrepareScriptSigs(std::vector<CTxIn>{CTxIn(COutPoint(GetRandHash(), 0))}, vecChecks));
+    BOOST_CHECK(!session.PrepareScriptSigs(std::vector<CTxIn>{vecTxIn[0], vecTxIn[0]}, vecChecks));
+    BOOST_CHECK(session.PrepareScriptSigs(vecTxIn, vecChecks));
+    BOOST_CHECK_EQUAL(vecChecks.size(), 1U);
+    BOOST_CHECK_EQUAL(vecChecks[0].first, 1U);
+    BOOST_CHECK(vecChecks[0].second == GetCoinbaseScript());
+
+    // the signature commits to the input it was made for
+    const CTransaction& txFinal = *session.txFinalUnsigned;
+    BOOST_CHECK(CPrivateSendServerSession::VerifyScriptSig(txFinal, 1, vecTxIn[0].scriptSig, vecChecks[0].second));
+    BOOST_CHECK(!CPrivateSendServerSession::VerifyScriptSig(txFinal, 0, vecTxIn[0].scriptSig, vecChecks[0].second));
+
+    // signatures are only added for the inputs they were verified for
+    std::vector<std::pair<unsigned int, CScript> > vecChecksWrong{std::make_pair(0U, vecChecks[0].second)};
+    BOOST_CHECK(!session.AddScriptSigs(vecTxIn, vecChecksWrong));
+    BOOST_CHECK(!session.IsSignaturesComplete());
+    BOOST_CHECK(session.AddScriptSigs(vecTxIn, vecChecks));
+    BOOST_CHECK(session.IsSignaturesComplete());
+    BOOST_CHECK(session.finalMutableTransaction.vin[1].scriptSig == vecTxIn[0].scriptSig);
+
+    // and only once
+    BOOST_CHECK(!session.PrepareScriptSigs(vecTxIn, vecChecks));
+    BOOST_CHECK(!session.AddScriptSigs(vecTxIn, vecChecks));
+}
+
+BOOST_AUTO_TEST_CASE(session_timeout)
+{
+    CPrivateSendServerTest server;
+    PoolMessage nMessageID;
+    CService addr = LookupNumeric("1.2.3.4", Params().GetDefaultPort());
+    int64_t nTime = GetTime();
+    SetMockTime(nTime);
+
+    int nSessionID;
+    {
+        LOCK(server.cs_sessions);
+        CPrivateSendServerSession* psession = server.CreateNewSession(CPrivateSendAccept(1, CMutableTransaction()), addr, nMessageID, *connman);
+        BOOST_CHECK(psession);
+        nSessionID = psession->GetSessionID();
+    }
+
+    // without a scheduler the sessions are polled
+    SetMockTime(nTime + PRIVATESEND_QUEUE_TIMEOUT - 1);
+    server.CheckTimeout(*connman);
+    BOOST_CHECK_EQUAL(server.GetSessionCount(), 1);
+    {
+        LOCK(server.cs_sessions);
+        BOOST_CHECK(server.GetParticipantSession(addr) && server.GetParticipantSession(addr)->GetSessionID() == nSessionID);
+    }
+
+    SetMockTime(nTime + PRIVATESEND_QUEUE_TIMEOUT);
+    server.CheckTimeout(*connman);
+    BOOST_CHECK_EQUAL(server.GetSessionCount(), 0);
+    {
+        LOCK(server.cs_sessions);
+        BOOST_CHECK(!server.GetParticipantSession(addr));
+    }
+
+    SetMockTime(0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
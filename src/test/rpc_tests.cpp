@@ -6,6 +6,7 @@
 #include "rpc/client.h"
 
 #include "base58.h"
+#include "httprpc.h"
 #include "netbase.h"
 
 #include "test/test_blaze.h"
@@ -350,4 +351,30 @@ BOOST_AUTO_TEST_CASE(rpc_sentinel_ping)
     BOOST_CHECK_THROW(CallRPC("sentinelping 2"), std::bad_cast);
 }
 
+BOOST_AUTO_TEST_CASE(rpc_classify_light)
+{
+    // cheap calls go to the light queue, wherever the method is in the request
+    BOOST_CHECK_EQUAL(ClassifyJSONRPCRequest("{\"method\":\"getblockcount\"}"), HTTP_WORK_RPC_LIGHT);
+    BOOST_CHECK_EQUAL(ClassifyJSONRPCRequest(" {\"jsonrpc\": \"1.0\", \"id\": \"curltest\", \"method\": \"getblockcount\", \"params\": [] }\n"), HTTP_WORK_RPC_LIGHT);
+    BOOST_CHECK_EQUAL(ClassifyJSONRPCRequest("{\"params\":[1,{\"a\":\"}\\\"\"},[2]],\"id\":null,\"method\":\"getblockhash\"}"), HTTP_WORK_RPC_LIGHT);
+    BOOST_CHECK_EQUAL(ClassifyJSONRPCRequest("{\"method\":\"getbestblock\"}"), HTTP_WORK_RPC_HEAVY);
+    BOOST_CHECK_EQUAL(ClassifyJSONRPCRequest("{\"method\":\"mnsync\",\"params\":[\"status\"]}"), HTTP_WORK_RPC_HEAVY);
+
+    // a method name anywhere but at the top level is not the method called
+    BOOST_CHECK_EQUAL(ClassifyJSONRPCRequest("{\"params\":{\"method\":\"ping\"},\"method\":\"gobject\"}"), HTTP_WORK_RPC_HEAVY);
+    BOOST_CHECK_EQUAL(ClassifyJSONRPCRequest("{\"params\":[\"\\\"method\\\":\\\"ping\\\"\"],\"method\":\"gobject\"}"), HTTP_WORK_RPC_HEAVY);
+    BOOST_CHECK_EQUAL(ClassifyJSONRPCRequest("{\"params\":[\"ping\"],\"id\":\"method\"}"), HTTP_WORK_RPC_HEAVY);
+
+    // anything the parser could read differently is heavy
+    BOOST_CHECK_EQUAL(ClassifyJSONRPCRequest("{\"method\":\"ping\",\"method\":\"gobject\"}"), HTTP_WORK_RPC_HEAVY);
+    BOOST_CHECK_EQUAL(ClassifyJSONRPCRequest("{\"meth\\u006fd\":\"gobject\",\"method\":\"ping\"}"), HTTP_WORK_RPC_HEAVY);
+    BOOST_CHECK_EQUAL(ClassifyJSONRPCRequest("{\"method\":\"pin\\u0067\"}"), HTTP_WORK_RPC_HEAVY);
+    BOOST_CHECK_EQUAL(ClassifyJSONRPCRequest("[{\"method\":\"ping\"}]"), HTTP_WORK_RPC_HEAVY);
+    BOOST_CHECK_EQUAL(ClassifyJSONRPCRequest("{\"method\":\"ping\""), HTTP_WORK_RPC_HEAVY);
+    BOOST_CHECK_EQUAL(ClassifyJSONRPCRequest("{\"method\":\"ping\",\"params\":[\"" + std::string(600, 'x')), HTTP_WORK_RPC_HEAVY);
+    BOOST_CHECK_EQUAL(ClassifyJSONRPCRequest("{\"method\":[\"ping\"]}"), HTTP_WORK_RPC_HEAVY);
+    BOOST_CHECK_EQUAL(ClassifyJSONRPCRequest("{}"), HTTP_WORK_RPC_HEAVY);
+    BOOST_CHECK_EQUAL(ClassifyJSONRPCRequest(""), HTTP_WORK_RPC_HEAVY);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
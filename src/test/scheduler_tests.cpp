@@ -4,6 +4,7 @@
 
 #include "random.h"
 #include "scheduler.h"
+#include "utiltime.h"
 
 #include "test/test_blaze.h"
 
@@ -114,4 +115,78 @@ BOOST_AUTO_TEST_CASE(manythreads)
     BOOST_CHECK_EQUAL(counterSum, 200);
 }
 
+BOOST_AUTO_TEST_CASE(singlethreadedscheduler_ordered)
+{
+    CScheduler scheduler;
+
+    // each queue should be well ordered with respect to itself but not other queues
+    SingleThreadedSchedulerClient queue1(&scheduler);
+    SingleThreadedSchedulerClient queue2(&scheduler);
+
+    // create more threads than queues
+    // if the queues only permit execution of one task at once then
+    // the extra threads should effectively be doing nothing
+    // if they don't we'll get out of order behaviour
+    boost::thread_group threads;
+    for (int i = 0; i < 5; ++i) {
+        threads.create_thread(boost::bind(&CScheduler::serviceQueue, &scheduler));
+    }
+
+    // these are not atomic, if SingleThreadedSchedulerClient prevents
+    // parallel execution at the queue level no synchronization should be required here
+    int counter1 = 0;
+    int counter2 = 0;
+
+    // just simply count up on each queue - if execution is properly ordered then
+    // the callbacks should run in exactly the order in which they were enqueued
+    for (int i = 0; i < 100; ++i) {
+        queue1.AddToProcessQueue([i, &counter1]() {
+            assert(i == counter1++);
+        });
+
+        queue2.AddToProcessQueue([i, &counter2]() {
+            assert(i == counter2++);
+        });
+    }
+
+    // finish up
+    scheduler.stop(true);
+    threads.join_all();
+
+    BOOST_CHECK_EQUAL(counter1, 100);
+    BOOST_CHECK_EQUAL(counter2, 100);
+    BOOST_CHECK_EQUAL(queue1.CallbacksPending(), 0);
+    BOOST_CHECK_EQUAL(queue2.CallbacksPending(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(singlethreadedscheduler_emptyqueue_after_stop)
+{
+    // A failed startup doesn't join its threads, it stops the scheduler and
+    // waits for it before the callbacks still pending are flushed
+    CScheduler scheduler;
+    SingleThreadedSchedulerClient queue(&scheduler);
+    boost::thread_group threads;
+    for (int i = 0; i < 2; ++i) {
+        threads.create_thread(boost::bind(&CScheduler::serviceQueue, &scheduler));
+    }
+    scheduler.scheduleFromNow([] {}, 3600);
+    while (!scheduler.AreThreadsServicingQueue()) {
+        MilliSleep(1);
+    }
+
+    threads.interrupt_all();
+    scheduler.stop();
+    scheduler.waitForServiceThreads();
+    BOOST_CHECK(!scheduler.AreThreadsServicingQueue());
+
+    int counter = 0;
+    for (int i = 0; i < 10; ++i) {
+        queue.AddToProcessQueue([&counter]() { counter++; });
+    }
+    queue.EmptyQueue();
+    BOOST_CHECK_EQUAL(counter, 10);
+    BOOST_CHECK_EQUAL(queue.CallbacksPending(), 0);
+    threads.join_all();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -167,6 +167,34 @@ BOOST_AUTO_TEST_CASE(sighash_test)
 }
 
 // Goal: check that SignatureHash generates correct hash
+BOOST_AUTO_TEST_CASE(sighash_precomputed)
+{
+    seed_insecure_rand(false);
+
+    for (int i=0; i<10000; i++) {
+        int nHashType = insecure_rand();
+        // half of them with the hash types that use the precomputed data
+        if (i % 2)
+            nHashType = (nHashType & ~0xff) | SIGHASH_ALL;
+        CMutableTransaction txTo;
+        RandomTransaction(txTo, (nHashType & 0x1f) == SIGHASH_SINGLE);
+        if (i % 3 == 0) {
+            // special transactions commit to their extra payload
+            txTo.nVersion = 3;
+            txTo.nType = insecure_rand() % 2;
+            txTo.vExtraPayload.resize(insecure_rand() % 100);
+        }
+        CScript scriptCode;
+        RandomScript(scriptCode);
+        const CTransaction tx(txTo);
+        const PrecomputedTransactionData txdata(tx);
+
+        for (unsigned int nIn = 0; nIn < tx.vin.size(); nIn++) {
+            BOOST_CHECK(SignatureHash(scriptCode, tx, nIn, nHashType, &txdata) == SignatureHash(scriptCode, tx, nIn, nHashType));
+        }
+    }
+}
+
 BOOST_AUTO_TEST_CASE(sighash_from_data)
 {
     UniValue tests = read_json(std::string(json_tests::sighash, json_tests::sighash + sizeof(json_tests::sighash)));
@@ -323,6 +323,14 @@ BOOST_AUTO_TEST_CASE(univalue_readwrite)
 
     BOOST_CHECK_EQUAL(strJson1, v.write());
 
+    // Writing into a caller-provided buffer appends to it
+    std::string strAppended("prefix");
+    v.write(strAppended);
+    BOOST_CHECK_EQUAL(strAppended, "prefix" + strJson1);
+    std::string strPretty;
+    v.write(strPretty, 4);
+    BOOST_CHECK_EQUAL(strPretty, v.write(4));
+
     /* Check for (correctly reporting) a parsing error if the initial
        JSON construct is followed by more stuff.  Note that whitespace
        is, of course, exempt.  */
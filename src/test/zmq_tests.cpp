@@ -0,0 +1,82 @@
+// Copyright (c) 2024 The blazegeek developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "zmq/zmqpublishnotifier.h"
+
+#include "test/test_blaze.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(zmq_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(zmq_payload_size)
+{
+    CZMQPayload payload;
+    payload.ss << std::vector<unsigned char>(100);
+    BOOST_CHECK_EQUAL(payload.GetQueuedSize(), payload.ss.size());
+
+    // a lazy payload counts its estimate before and after it is loaded
+    CZMQPayload lazy([](CDataStream& ss) { ss << std::vector<unsigned char>(10); return true; }, 1000);
+    BOOST_CHECK_EQUAL(lazy.GetQueuedSize(), 1000U);
+    lazy.fValid = lazy.loader(lazy.ss);
+    lazy.fLoaded = true;
+    BOOST_CHECK_EQUAL(lazy.GetQueuedSize(), 1000U);
+    BOOST_CHECK(lazy.fSized);
+
+    // one with a sizer waits for the publisher thread to run it
+    CZMQPayload block([](CDataStream& ss) { return false; }, 2000000, []() { return (size_t)1500; });
+    BOOST_CHECK(!block.fSized);
+    BOOST_CHECK_EQUAL(block.GetQueuedSize(), 2000000U);
+}
+
+BOOST_AUTO_TEST_CASE(zmq_queue_budget)
+{
+    CZMQQueueBudget budget(3, 1000);
+
+    // the byte limit turns away messages that do not fit any more
+    BOOST_CHECK(budget.Reserve(600));
+    BOOST_CHECK(!budget.Reserve(401));
+    BOOST_CHECK(budget.Reserve(400));
+    BOOST_CHECK_EQUAL(budget.GetBytes(), 1000U);
+    BOOST_CHECK(!budget.Reserve(1));
+    BOOST_CHECK_EQUAL(budget.GetMessages(), 2U);
+
+    // lazy payloads are counted with their estimate, a block can not slip through
+    CZMQPayload block([](CDataStream& ss) { return false; }, 2000000);
+    budget.Release(400);
+    BOOST_CHECK(!budget.Reserve(block.GetQueuedSize()));
+    BOOST_CHECK(!CZMQQueueBudget(3, 1000).Reserve(block.GetQueuedSize()));
+    BOOST_CHECK(CZMQQueueBudget(3, 2000000).Reserve(block.GetQueuedSize()));
+
+    // the message limit applies to empty payloads as well
+    BOOST_CHECK(budget.Reserve(0));
+    BOOST_CHECK(budget.Reserve(0));
+    BOOST_CHECK(!budget.Reserve(0));
+    BOOST_CHECK_EQUAL(budget.GetMessages(), 3U);
+
+    budget.Release(0);
+    budget.Release(0);
+    budget.Release(600);
+    BOOST_CHECK_EQUAL(budget.GetMessages(), 0U);
+    BOOST_CHECK_EQUAL(budget.GetBytes(), 0U);
+
+    // a message can be accounted with its actual size once it is known
+    BOOST_CHECK(budget.Reserve(1000));
+    budget.Resize(1000, 100);
+    BOOST_CHECK_EQUAL(budget.GetBytes(), 100U);
+    BOOST_CHECK(budget.Reserve(900));
+    budget.Resize(100, 200);
+    BOOST_CHECK_EQUAL(budget.GetBytes(), 1100U);
+    BOOST_CHECK(!budget.Reserve(0));
+    budget.Release(200);
+    budget.Release(900);
+    BOOST_CHECK_EQUAL(budget.GetBytes(), 0U);
+
+    budget.Reserve(10);
+    budget.Clear();
+    BOOST_CHECK_EQUAL(budget.GetMessages(), 0U);
+    BOOST_CHECK_EQUAL(budget.GetBytes(), 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
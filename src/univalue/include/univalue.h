@@ -123,6 +123,10 @@ public:
 
     std::string write(unsigned int prettyIndent = 0,
                       unsigned int indentLevel = 0) const;
+    // Append the serialization to s, so callers can reserve (or reuse) a
+    // single output buffer for large documents.
+    void write(std::string& s, unsigned int prettyIndent = 0,
+               unsigned int indentLevel = 0) const;
 
     bool read(const char *raw);
     bool read(const std::string& rawStr) {
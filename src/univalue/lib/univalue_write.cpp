@@ -10,22 +10,22 @@
 
 using namespace std;
 
-static string json_escape(const string& inS)
+static void json_escape(const string& inS, string& outS)
 {
-    string outS;
-    outS.reserve(inS.size() * 2);
-
-    for (unsigned int i = 0; i < inS.size(); i++) {
-        unsigned char ch = inS[i];
-        const char *escStr = escapes[ch];
-
-        if (escStr)
+    // Copy runs of characters that need no escaping in one go instead of
+    // appending them one by one.
+    const char *start = inS.data();
+    const char *end = start + inS.size();
+    const char *run = start;
+    for (const char *p = start; p != end; ++p) {
+        const char *escStr = escapes[(unsigned char)*p];
+        if (escStr) {
+            outS.append(run, p - run);
             outS += escStr;
-        else
-            outS += ch;
+            run = p + 1;
+        }
     }
-
-    return outS;
+    outS.append(run, end - run);
 }
 
 string UniValue::write(unsigned int prettyIndent,
@@ -33,7 +33,13 @@ string UniValue::write(unsigned int prettyIndent,
 {
     string s;
     s.reserve(1024);
+    write(s, prettyIndent, indentLevel);
+    return s;
+}
 
+void UniValue::write(string& s, unsigned int prettyIndent,
+                     unsigned int indentLevel) const
+{
     unsigned int modIndent = indentLevel;
     if (modIndent == 0)
         modIndent = 1;
@@ -49,7 +55,9 @@ string UniValue::write(unsigned int prettyIndent,
         writeArray(prettyIndent, modIndent, s);
         break;
     case VSTR:
-        s += "\"" + json_escape(val) + "\"";
+        s += '"';
+        json_escape(val, s);
+        s += '"';
         break;
     case VNUM:
         s += val;
@@ -58,8 +66,6 @@ string UniValue::write(unsigned int prettyIndent,
         s += (val == "1" ? "true" : "false");
         break;
     }
-
-    return s;
 }
 
 static void indentStr(unsigned int prettyIndent, unsigned int indentLevel, string& s)
@@ -76,7 +82,7 @@ void UniValue::writeArray(unsigned int prettyIndent, unsigned int indentLevel, s
     for (unsigned int i = 0; i < values.size(); i++) {
         if (prettyIndent)
             indentStr(prettyIndent, indentLevel, s);
-        s += values[i].write(prettyIndent, indentLevel + 1);
+        values[i].write(s, prettyIndent, indentLevel + 1);
         if (i != (values.size() - 1)) {
             s += ",";
             if (prettyIndent)
@@ -100,10 +106,12 @@ void UniValue::writeObject(unsigned int prettyIndent, unsigned int indentLevel,
     for (unsigned int i = 0; i < keys.size(); i++) {
         if (prettyIndent)
             indentStr(prettyIndent, indentLevel, s);
-        s += "\"" + json_escape(keys[i]) + "\":";
+        s += '"';
+        json_escape(keys[i], s);
+        s += "\":";
         if (prettyIndent)
             s += " ";
-        s += values.at(i).write(prettyIndent, indentLevel + 1);
+        values.at(i).write(s, prettyIndent, indentLevel + 1);
         if (i != (values.size() - 1))
             s += ",";
         if (prettyIndent)
@@ -114,4 +122,3 @@ void UniValue::writeObject(unsigned int prettyIndent, unsigned int indentLevel,
         indentStr(prettyIndent, indentLevel - 1, s);
     s += "}";
 }
-
@@ -5,52 +5,259 @@
 
 #include "validationinterface.h"
 
+#include "governance-object.h"
+#include "governance-vote.h"
+#include "primitives/transaction.h"
+#include "scheduler.h"
+#include "sync.h"
+#include "util.h"
+#include "utiltime.h"
+
+#include <atomic>
+#include <future>
+#include <map>
+#include <typeinfo>
+#include <vector>
+
+#if defined(__GNUC__)
+#include <cxxabi.h>
+#endif
+
+/** Cumulative time spent inside one registered listener, reported under -debug=bench */
+struct CValidationListenerTimer {
+    std::string strName;
+    std::atomic<int64_t> nTimeTotal;
+
+    explicit CValidationListenerTimer(const std::string& strNameIn) : strName(strNameIn), nTimeTotal(0) {}
+
+    template<typename Callable>
+    void Run(const char* pszSignal, Callable&& func)
+    {
+        int64_t nTimeStart = GetTimeMicros();
+        func();
+        int64_t nTime = GetTimeMicros() - nTimeStart;
+        int64_t nTotal = (nTimeTotal += nTime);
+        LogPrint("bench", "    - %s::%s: %.2fms [%.2fs]\n", strName, pszSignal, nTime * 0.001, nTotal * 0.000001);
+    }
+};
+
+typedef std::shared_ptr<CValidationListenerTimer> CValidationListenerTimerRef;
+
+struct CMainSignalsInstance {
+    CCriticalSection cs;
+    // All listeners registered through RegisterValidationInterface, so that
+    // their slots can be disconnected again.
+    std::map<CValidationInterface*, std::vector<boost::signals2::connection> > mapListeners;
+    // We are not allowed to assume the scheduler only runs in one thread,
+    // but must ensure all callbacks happen in-order, so we end up creating
+    // our own queue here :(
+    std::unique_ptr<SingleThreadedSchedulerClient> backgroundQueue;
+};
+
 static CMainSignals g_signals;
+static CMainSignalsInstance g_signalsInstance;
 
 CMainSignals& GetMainSignals()
 {
     return g_signals;
 }
 
-void RegisterValidationInterface(CValidationInterface* pwalletIn) {
-    g_signals.AcceptedBlockHeader.connect(boost::bind(&CValidationInterface::AcceptedBlockHeader, pwalletIn, _1));
-    g_signals.NotifyHeaderTip.connect(boost::bind(&CValidationInterface::NotifyHeaderTip, pwalletIn, _1, _2));
-    g_signals.UpdatedBlockTip.connect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2, _3));
-    g_signals.SyncTransaction.connect(boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2, _3));
-    g_signals.NotifyTransactionLock.connect(boost::bind(&CValidationInterface::NotifyTransactionLock, pwalletIn, _1));
-    g_signals.UpdatedTransaction.connect(boost::bind(&CValidationInterface::UpdatedTransaction, pwalletIn, _1));
-    g_signals.SetBestChain.connect(boost::bind(&CValidationInterface::SetBestChain, pwalletIn, _1));
-    g_signals.Inventory.connect(boost::bind(&CValidationInterface::Inventory, pwalletIn, _1));
-    g_signals.Broadcast.connect(boost::bind(&CValidationInterface::ResendWalletTransactions, pwalletIn, _1, _2));
-    g_signals.BlockChecked.connect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
-    g_signals.ScriptForMining.connect(boost::bind(&CValidationInterface::GetScriptForMining, pwalletIn, _1));
-    g_signals.BlockFound.connect(boost::bind(&CValidationInterface::ResetRequestCount, pwalletIn, _1));
-    g_signals.NewPoWValidBlock.connect(boost::bind(&CValidationInterface::NewPoWValidBlock, pwalletIn, _1, _2));
-    g_signals.NotifyGovernanceObject.connect(boost::bind(&CValidationInterface::NotifyGovernanceObject, pwalletIn, _1));
-    g_signals.NotifyGovernanceVote.connect(boost::bind(&CValidationInterface::NotifyGovernanceVote, pwalletIn, _1));
-    g_signals.NotifyInstantSendDoubleSpendAttempt.connect(boost::bind(&CValidationInterface::NotifyInstantSendDoubleSpendAttempt, pwalletIn, _1, _2));
+void CMainSignals::RegisterBackgroundSignalScheduler(CScheduler& scheduler)
+{
+    LOCK(g_signalsInstance.cs);
+    assert(!g_signalsInstance.backgroundQueue);
+    g_signalsInstance.backgroundQueue.reset(new SingleThreadedSchedulerClient(&scheduler));
+}
+
+void CMainSignals::UnregisterBackgroundSignalScheduler()
+{
+    LOCK(g_signalsInstance.cs);
+    g_signalsInstance.backgroundQueue.reset();
+}
+
+void CMainSignals::FlushBackgroundCallbacks()
+{
+    SingleThreadedSchedulerClient* queue;
+    {
+        LOCK(g_signalsInstance.cs);
+        queue = g_signalsInstance.backgroundQueue.get();
+    }
+    if (queue)
+        queue->EmptyQueue();
+}
+
+size_t CMainSignals::CallbacksPending()
+{
+    LOCK(g_signalsInstance.cs);
+    if (!g_signalsInstance.backgroundQueue) return 0;
+    return g_signalsInstance.backgroundQueue->CallbacksPending();
+}
+
+static void EnqueueValidationCallback(std::function<void ()> func)
+{
+    SingleThreadedSchedulerClient* queue;
+    {
+        LOCK(g_signalsInstance.cs);
+        queue = g_signalsInstance.backgroundQueue.get();
+    }
+    if (queue)
+        queue->AddToProcessQueue(std::move(func));
+    else
+        func();
+}
+
+void CallFunctionInValidationInterfaceQueue(std::function<void ()> func)
+{
+    EnqueueValidationCallback(std::move(func));
+}
+
+void SyncWithValidationInterfaceQueue()
+{
+    // Block until the validation queue drains
+    std::promise<void> promise;
+    CallFunctionInValidationInterfaceQueue([&promise] {
+        promise.set_value();
+    });
+    promise.get_future().wait();
+}
+
+static std::string GetListenerName(CValidationInterface* pwalletIn)
+{
+    const char* pszName = typeid(*pwalletIn).name();
+#if defined(__GNUC__)
+    int status = 0;
+    char* pszDemangled = abi::__cxa_demangle(pszName, NULL, NULL, &status);
+    if (pszDemangled) {
+        std::string strName(status == 0 ? pszDemangled : pszName);
+        free(pszDemangled);
+        return strName;
+    }
+#endif
+    return pszName;
+}
+
+void RegisterValidationInterface(CValidationInterface* pwalletIn, bool fBackground) {
+    CValidationListenerTimerRef t = std::make_shared<CValidationListenerTimer>(GetListenerName(pwalletIn));
+    CValidationInterface* p = pwalletIn;
+    std::vector<boost::signals2::connection> c;
+
+    c.push_back(g_signals.AcceptedBlockHeader.connect([p, t](const CBlockIndex* pindexNew) {
+        t->Run("AcceptedBlockHeader", [&] { p->AcceptedBlockHeader(pindexNew); });
+    }));
+    c.push_back(g_signals.NotifyHeaderTip.connect([p, t](const CBlockIndex* pindexNew, bool fInitialDownload) {
+        t->Run("NotifyHeaderTip", [&] { p->NotifyHeaderTip(pindexNew, fInitialDownload); });
+    }));
+    c.push_back(g_signals.UpdatedTransaction.connect([p, t](const uint256& hash) {
+        bool fRet = false;
+        t->Run("UpdatedTransaction", [&] { fRet = p->UpdatedTransaction(hash); });
+        return fRet;
+    }));
+    c.push_back(g_signals.SetBestChain.connect([p, t](const CBlockLocator& locator) {
+        t->Run("SetBestChain", [&] { p->SetBestChain(locator); });
+    }));
+    c.push_back(g_signals.Inventory.connect([p, t](const uint256& hash) {
+        t->Run("Inventory", [&] { p->Inventory(hash); });
+    }));
+    c.push_back(g_signals.Broadcast.connect([p, t](int64_t nBestBlockTime, CConnman* connman) {
+        t->Run("ResendWalletTransactions", [&] { p->ResendWalletTransactions(nBestBlockTime, connman); });
+    }));
+    c.push_back(g_signals.BlockChecked.connect([p, t](const CBlock& block, const CValidationState& state) {
+        t->Run("BlockChecked", [&] { p->BlockChecked(block, state); });
+    }));
+    c.push_back(g_signals.ScriptForMining.connect([p, t](boost::shared_ptr<CReserveScript>& script) {
+        t->Run("GetScriptForMining", [&] { p->GetScriptForMining(script); });
+    }));
+    c.push_back(g_signals.BlockFound.connect([p, t](const uint256& hash) {
+        t->Run("ResetRequestCount", [&] { p->ResetRequestCount(hash); });
+    }));
+    c.push_back(g_signals.NewPoWValidBlock.connect([p, t](const CBlockIndex* pindex, const std::shared_ptr<const CBlock>& block) {
+        t->Run("NewPoWValidBlock", [&] { p->NewPoWValidBlock(pindex, block); });
+    }));
+
+    if (!fBackground) {
+        c.push_back(g_signals.UpdatedBlockTip.connect([p, t](const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload) {
+            t->Run("UpdatedBlockTip", [&] { p->UpdatedBlockTip(pindexNew, pindexFork, fInitialDownload); });
+        }));
+        c.push_back(g_signals.SyncTransaction.connect([p, t](const CTransaction& tx, const CBlockIndex* pindex, int posInBlock) {
+            t->Run("SyncTransaction", [&] { p->SyncTransaction(tx, pindex, posInBlock); });
+        }));
+        c.push_back(g_signals.NotifyTransactionLock.connect([p, t](const CTransaction& tx) {
+            t->Run("NotifyTransactionLock", [&] { p->NotifyTransactionLock(tx); });
+        }));
+        c.push_back(g_signals.NotifyGovernanceObject.connect([p, t](const CGovernanceObject& object) {
+            t->Run("NotifyGovernanceObject", [&] { p->NotifyGovernanceObject(object); });
+        }));
+        c.push_back(g_signals.NotifyGovernanceVote.connect([p, t](const CGovernanceVote& vote) {
+            t->Run("NotifyGovernanceVote", [&] { p->NotifyGovernanceVote(vote); });
+        }));
+        c.push_back(g_signals.NotifyInstantSendDoubleSpendAttempt.connect([p, t](const CTransaction& currentTx, const CTransaction& previousTx) {
+            t->Run("NotifyInstantSendDoubleSpendAttempt", [&] { p->NotifyInstantSendDoubleSpendAttempt(currentTx, previousTx); });
+        }));
+    } else {
+        // Block indexes are never freed while the node runs, everything else
+        // is copied so the notifying thread can move on right away.
+        c.push_back(g_signals.UpdatedBlockTip.connect([p, t](const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload) {
+            EnqueueValidationCallback([p, t, pindexNew, pindexFork, fInitialDownload] {
+                t->Run("UpdatedBlockTip", [&] { p->UpdatedBlockTip(pindexNew, pindexFork, fInitialDownload); });
+            });
+        }));
+        c.push_back(g_signals.SyncTransaction.connect([p, t](const CTransaction& tx, const CBlockIndex* pindex, int posInBlock) {
+            std::shared_ptr<const CTransaction> ptx = std::make_shared<const CTransaction>(tx);
+            EnqueueValidationCallback([p, t, ptx, pindex, posInBlock] {
+                t->Run("SyncTransaction", [&] { p->SyncTransaction(*ptx, pindex, posInBlock); });
+            });
+        }));
+        c.push_back(g_signals.NotifyTransactionLock.connect([p, t](const CTransaction& tx) {
+            std::shared_ptr<const CTransaction> ptx = std::make_shared<const CTransaction>(tx);
+            EnqueueValidationCallback([p, t, ptx] {
+                t->Run("NotifyTransactionLock", [&] { p->NotifyTransactionLock(*ptx); });
+            });
+        }));
+        c.push_back(g_signals.NotifyGovernanceObject.connect([p, t](const CGovernanceObject& object) {
+            std::shared_ptr<const CGovernanceObject> pobj = std::make_shared<const CGovernanceObject>(object);
+            EnqueueValidationCallback([p, t, pobj] {
+                t->Run("NotifyGovernanceObject", [&] { p->NotifyGovernanceObject(*pobj); });
+            });
+        }));
+        c.push_back(g_signals.NotifyGovernanceVote.connect([p, t](const CGovernanceVote& vote) {
+            std::shared_ptr<const CGovernanceVote> pvote = std::make_shared<const CGovernanceVote>(vote);
+            EnqueueValidationCallback([p, t, pvote] {
+                t->Run("NotifyGovernanceVote", [&] { p->NotifyGovernanceVote(*pvote); });
+            });
+        }));
+        c.push_back(g_signals.NotifyInstantSendDoubleSpendAttempt.connect([p, t](const CTransaction& currentTx, const CTransaction& previousTx) {
+            std::shared_ptr<const CTransaction> pcurrentTx = std::make_shared<const CTransaction>(currentTx);
+            std::shared_ptr<const CTransaction> ppreviousTx = std::make_shared<const CTransaction>(previousTx);
+            EnqueueValidationCallback([p, t, pcurrentTx, ppreviousTx] {
+                t->Run("NotifyInstantSendDoubleSpendAttempt", [&] { p->NotifyInstantSendDoubleSpendAttempt(*pcurrentTx, *ppreviousTx); });
+            });
+        }));
+    }
+
+    LOCK(g_signalsInstance.cs);
+    std::vector<boost::signals2::connection>& vConnections = g_signalsInstance.mapListeners[pwalletIn];
+    vConnections.insert(vConnections.end(), c.begin(), c.end());
 }
 
 void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
-    g_signals.BlockFound.disconnect(boost::bind(&CValidationInterface::ResetRequestCount, pwalletIn, _1));
-    g_signals.ScriptForMining.disconnect(boost::bind(&CValidationInterface::GetScriptForMining, pwalletIn, _1));
-    g_signals.BlockChecked.disconnect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
-    g_signals.Broadcast.disconnect(boost::bind(&CValidationInterface::ResendWalletTransactions, pwalletIn, _1, _2));
-    g_signals.Inventory.disconnect(boost::bind(&CValidationInterface::Inventory, pwalletIn, _1));
-    g_signals.SetBestChain.disconnect(boost::bind(&CValidationInterface::SetBestChain, pwalletIn, _1));
-    g_signals.UpdatedTransaction.disconnect(boost::bind(&CValidationInterface::UpdatedTransaction, pwalletIn, _1));
-    g_signals.NotifyTransactionLock.disconnect(boost::bind(&CValidationInterface::NotifyTransactionLock, pwalletIn, _1));
-    g_signals.SyncTransaction.disconnect(boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2, _3));
-    g_signals.UpdatedBlockTip.disconnect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2, _3));
-    g_signals.NewPoWValidBlock.disconnect(boost::bind(&CValidationInterface::NewPoWValidBlock, pwalletIn, _1, _2));
-    g_signals.NotifyHeaderTip.disconnect(boost::bind(&CValidationInterface::NotifyHeaderTip, pwalletIn, _1, _2));
-    g_signals.AcceptedBlockHeader.disconnect(boost::bind(&CValidationInterface::AcceptedBlockHeader, pwalletIn, _1));
-    g_signals.NotifyGovernanceObject.disconnect(boost::bind(&CValidationInterface::NotifyGovernanceObject, pwalletIn, _1));
-    g_signals.NotifyGovernanceVote.disconnect(boost::bind(&CValidationInterface::NotifyGovernanceVote, pwalletIn, _1));
-    g_signals.NotifyInstantSendDoubleSpendAttempt.disconnect(boost::bind(&CValidationInterface::NotifyInstantSendDoubleSpendAttempt, pwalletIn, _1, _2));
+    std::vector<boost::signals2::connection> vConnections;
+    {
+        LOCK(g_signalsInstance.cs);
+        auto it = g_signalsInstance.mapListeners.find(pwalletIn);
+        if (it == g_signalsInstance.mapListeners.end())
+            return;
+        vConnections.swap(it->second);
+        g_signalsInstance.mapListeners.erase(it);
+    }
+    for (boost::signals2::connection& c : vConnections)
+        c.disconnect();
 }
 
 void UnregisterAllValidationInterfaces() {
+    {
+        LOCK(g_signalsInstance.cs);
+        g_signalsInstance.mapListeners.clear();
+    }
     g_signals.BlockFound.disconnect_all_slots();
     g_signals.ScriptForMining.disconnect_all_slots();
     g_signals.BlockChecked.disconnect_all_slots();
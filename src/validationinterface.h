@@ -8,6 +8,7 @@
 
 #include <boost/signals2/signal.hpp>
 #include <boost/shared_ptr.hpp>
+#include <functional>
 #include <memory>
 
 class CBlock;
@@ -15,6 +16,7 @@ class CBlockIndex;
 struct CBlockLocator;
 class CConnman;
 class CReserveScript;
+class CScheduler;
 class CTransaction;
 class CValidationInterface;
 class CValidationState;
@@ -24,12 +26,29 @@ class uint256;
 
 // These functions dispatch to one or all registered wallets
 
-/** Register a wallet to receive updates from core */
-void RegisterValidationInterface(CValidationInterface* pwalletIn);
+/**
+ * Register a wallet to receive updates from core. With fBackground set,
+ * notification-only callbacks (UpdatedBlockTip, SyncTransaction,
+ * NotifyTransactionLock, governance and InstantSend notifications) are
+ * delivered on the background queue instead of the notifying thread.
+ * Such a listener must not be destroyed before the queue is drained.
+ */
+void RegisterValidationInterface(CValidationInterface* pwalletIn, bool fBackground = false);
 /** Unregister a wallet from core */
 void UnregisterValidationInterface(CValidationInterface* pwalletIn);
 /** Unregister all wallets from core */
 void UnregisterAllValidationInterfaces();
+/**
+ * Pushes a function to the callback queue, guaranteeing any callbacks
+ * queued before it have been executed first. Runs the function
+ * synchronously if no background scheduler is registered.
+ */
+void CallFunctionInValidationInterfaceQueue(std::function<void ()> func);
+/**
+ * Wait until all callbacks queued before this call have been executed.
+ * Must not be called while holding cs_main or from a queued callback.
+ */
+void SyncWithValidationInterfaceQueue();
 
 class CValidationInterface {
 protected:
@@ -49,7 +68,7 @@ protected:
     virtual void GetScriptForMining(boost::shared_ptr<CReserveScript>&) {}
     virtual void ResetRequestCount(const uint256 &hash) {}
     virtual void NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& block) {}
-    friend void ::RegisterValidationInterface(CValidationInterface*);
+    friend void ::RegisterValidationInterface(CValidationInterface*, bool);
     friend void ::UnregisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterAllValidationInterfaces();
 };
@@ -98,6 +117,15 @@ struct CMainSignals {
      * Notifies listeners that a block which builds directly on our current tip
      * has been received and connected to the headers tree, though not validated yet */
     boost::signals2::signal<void (const CBlockIndex *, const std::shared_ptr<const CBlock>&)> NewPoWValidBlock;
+
+    /** Register a CScheduler to give callbacks which should run in the background (may only be called once) */
+    void RegisterBackgroundSignalScheduler(CScheduler& scheduler);
+    /** Unregister a CScheduler to give callbacks which should run in the background - these callbacks will now be dropped! */
+    void UnregisterBackgroundSignalScheduler();
+    /** Call any remaining callbacks on the calling thread */
+    void FlushBackgroundCallbacks();
+
+    size_t CallbacksPending();
 };
 
 CMainSignals& GetMainSignals();
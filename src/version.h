@@ -13,7 +13,7 @@
  */
 
 
-static const int PROTOCOL_VERSION = 70213;
+static const int PROTOCOL_VERSION = 70214;
 
 //! initial proto version, to be increased after version/verack negotiation
 static const int INIT_PROTO_VERSION = 209;
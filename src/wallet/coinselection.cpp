@@ -0,0 +1,140 @@
+// Copyright (c) 2024 The blazegeek developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "wallet/coinselection.h"
+
+#include "random.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+void SortInputCoins(std::vector<CInputCoin>& vCoins)
+{
+    // The randomness only needs to be fast, see ApproximateBestSubset
+    FastRandomContext insecure_rand;
+    std::random_shuffle(vCoins.begin(), vCoins.end(), insecure_rand);
+    std::sort(vCoins.begin(), vCoins.end(), [](const CInputCoin& a, const CInputCoin& b) { return a.nValue > b.nValue; });
+}
+
+bool SelectCoinsBnB(const std::vector<CAmount>& vValue, const CAmount& nTargetValue, const CAmount& nCostOfChange, const CAmount& nMaxValue,
+                    std::vector<char>& vfBest, CAmount& nBest)
+{
+    const CAmount nUpperBound = std::min(nTargetValue + nCostOfChange, nMaxValue);
+    if (nUpperBound < nTargetValue)
+        return false;
+
+    // Value of the coins from each position on
+    std::vector<CAmount> vRemaining(vValue.size() + 1, 0);
+    for (size_t i = vValue.size(); i > 0; i--)
+        vRemaining[i - 1] = vRemaining[i] + vValue[i - 1];
+
+    // Every coin is either included or left out when the search reaches it,
+    // only the included ones are kept to backtrack to
+    std::vector<size_t> vIncluded;
+    std::vector<size_t> vBestIncluded;
+    bool fFound = false;
+    CAmount nCurrent = 0;
+    CAmount nBestExcess = std::numeric_limits<CAmount>::max();
+    size_t i = 0;
+    for (size_t nTries = 0; nTries < BNB_MAX_TRIES; nTries++)
+    {
+        bool fBacktrack = false;
+        if (nCurrent + vRemaining[i] < nTargetValue) {
+            // the target can't be reached from here
+            fBacktrack = true;
+        } else if (nCurrent >= nTargetValue) {
+            // more coins only add excess
+            if (nCurrent - nTargetValue < nBestExcess) {
+                fFound = true;
+                nBestExcess = nCurrent - nTargetValue;
+                vBestIncluded = vIncluded;
+                if (nBestExcess == 0)
+                    break;
+            }
+            fBacktrack = true;
+        }
+
+        if (fBacktrack) {
+            // leave out the last coin included and continue after it
+            if (vIncluded.empty())
+                break;
+            i = vIncluded.back();
+            vIncluded.pop_back();
+            nCurrent -= vValue[i];
+            i++;
+        } else if (nCurrent + vValue[i] > nUpperBound) {
+            // leave out all coins too large to fit at once
+            i = std::lower_bound(vValue.begin() + i, vValue.end(), nUpperBound - nCurrent, std::greater<CAmount>()) - vValue.begin();
+        } else if (i > 0 && vValue[i] == vValue[i - 1] && (vIncluded.empty() || vIncluded.back() != i - 1)) {
+            // including a coin of the same value as the one left out just
+            // before it gives the totals that were already searched
+            i = std::upper_bound(vValue.begin() + i, vValue.end(), vValue[i], std::greater<CAmount>()) - vValue.begin();
+        } else {
+            vIncluded.push_back(i);
+            nCurrent += vValue[i];
+            i++;
+        }
+    }
+
+    if (!fFound)
+        return false;
+
+    vfBest.assign(vValue.size(), false);
+    nBest = 0;
+    for (size_t nIndex : vBestIncluded) {
+        vfBest[nIndex] = true;
+        nBest += vValue[nIndex];
+    }
+    return true;
+}
+
+void ApproximateBestSubset(const std::vector<CAmount>& vValue, const CAmount& nTotalLower, const CAmount& nTargetValue, const CAmount& nMaxValue,
+                           std::vector<char>& vfBest, CAmount& nBest, int iterations)
+{
+    std::vector<char> vfIncluded;
+
+    vfBest.assign(vValue.size(), true);
+    nBest = nTotalLower;
+
+    FastRandomContext insecure_rand;
+
+    for (int nRep = 0; nRep < iterations && nBest != nTargetValue; nRep++)
+    {
+        vfIncluded.assign(vValue.size(), false);
+        CAmount nTotal = 0;
+        bool fReachedTarget = false;
+        for (int nPass = 0; nPass < 2 && !fReachedTarget; nPass++)
+        {
+            for (unsigned int i = 0; i < vValue.size(); i++)
+            {
+                if (nTotal + vValue[i] > nMaxValue) {
+                    continue;
+                }
+                //The solver here uses a randomized algorithm,
+                //the randomness serves no real security purpose but is just
+                //needed to prevent degenerate behavior and it is important
+                //that the rng is fast. We do not use a constant random sequence,
+                //because there may be some privacy improvement by making
+                //the selection random.
+                if (nPass == 0 ? insecure_rand.rand32()&1 : !vfIncluded[i])
+                {
+                    nTotal += vValue[i];
+                    vfIncluded[i] = true;
+                    if (nTotal >= nTargetValue)
+                    {
+                        fReachedTarget = true;
+                        if (nTotal < nBest)
+                        {
+                            nBest = nTotal;
+                            vfBest = vfIncluded;
+                        }
+                        nTotal -= vValue[i];
+                        vfIncluded[i] = false;
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,57 @@
+// Copyright (c) 2024 The blazegeek developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_WALLET_COINSELECTION_H
+#define BITCOIN_WALLET_COINSELECTION_H
+
+#include "amount.h"
+
+#include <utility>
+#include <vector>
+
+class CWalletTx;
+
+//! nodes the branch and bound search visits before it gives up
+static const size_t BNB_MAX_TRIES = 100000;
+
+//! iterations of the stochastic approximation of the best subset
+static const int KNAPSACK_ITERATIONS = 1000;
+
+/** A coin the wallet could spend, with everything coin selection filters it by */
+struct CInputCoin
+{
+    CAmount nValue;
+    std::pair<const CWalletTx*, unsigned int> outpoint;
+    int nDepth;
+    bool fFromMe;
+    bool fDenominated;
+    //! mixed through enough PrivateSend rounds, only looked up when selecting denominated coins
+    bool fAnonymized;
+};
+
+/**
+ * Shuffle vCoins and sort them by descending value, so coins of the same
+ * value are selected at random. Selection keeps this order when it filters
+ * coins, so a wallet's coins are only sorted once per selection.
+ */
+void SortInputCoins(std::vector<CInputCoin>& vCoins);
+
+/**
+ * Depth first branch and bound search for the subset of vValue, sorted by
+ * descending value, worth between nTargetValue and nTargetValue + nCostOfChange
+ * (and no more than nMaxValue) with the least excess. Such a subset doesn't
+ * need change. Gives up after BNB_MAX_TRIES nodes.
+ */
+bool SelectCoinsBnB(const std::vector<CAmount>& vValue, const CAmount& nTargetValue, const CAmount& nCostOfChange, const CAmount& nMaxValue,
+                    std::vector<char>& vfBest, CAmount& nBest);
+
+/**
+ * Stochastic approximation of the subset of vValue, sorted by descending
+ * value, worth at least nTargetValue with the least excess. vfBest starts
+ * with all of them, worth nTotalLower. No subset is worth more than nMaxValue.
+ */
+void ApproximateBestSubset(const std::vector<CAmount>& vValue, const CAmount& nTotalLower, const CAmount& nTargetValue, const CAmount& nMaxValue,
+                           std::vector<char>& vfBest, CAmount& nBest, int iterations = KNAPSACK_ITERATIONS);
+
+#endif // BITCOIN_WALLET_COINSELECTION_H
@@ -32,8 +32,7 @@ int CCrypter::BytesToKeySHA512AES(const std::vector<unsigned char>& chSalt, cons
         di.Write(&chSalt[0], chSalt.size());
     di.Finalize(buf);
 
-    for(int i = 0; i != count - 1; i++)
-        di.Reset().Write(buf, sizeof(buf)).Finalize(buf);
+    SHA512Iterate(buf, count - 1);
 
     memcpy(key, buf, WALLET_CRYPTO_KEY_SIZE);
     memcpy(iv, buf + WALLET_CRYPTO_KEY_SIZE, WALLET_CRYPTO_IV_SIZE);
@@ -41,14 +40,48 @@ int CCrypter::BytesToKeySHA512AES(const std::vector<unsigned char>& chSalt, cons
     return WALLET_CRYPTO_KEY_SIZE;
 }
 
+int CCrypter::BytesToKeySHA512x4AES(const std::vector<unsigned char>& chSalt, const SecureString& strKeyData, int count, unsigned char *key, unsigned char *iv) const
+{
+    // Four chains of count SHA-512 iterations, seeded with the passphrase,
+    // the salt and the chain number. They are computed together, so with
+    // SIMD they take about as long as the single chain of method 0 while an
+    // attacker has to compute all of them for every guess.
+
+    if(!count || !key || !iv)
+        return 0;
+
+    unsigned char buf[4 * CSHA512::OUTPUT_SIZE];
+    for (unsigned char nChain = 0; nChain < 4; nChain++) {
+        CSHA512 di;
+        di.Write((const unsigned char*)strKeyData.c_str(), strKeyData.size());
+        if(chSalt.size())
+            di.Write(&chSalt[0], chSalt.size());
+        di.Write(&nChain, 1);
+        di.Finalize(buf + nChain * CSHA512::OUTPUT_SIZE);
+    }
+
+    SHA512Iterate4(buf, count - 1);
+
+    unsigned char out[CSHA512::OUTPUT_SIZE];
+    CSHA512().Write(buf, sizeof(buf)).Finalize(out);
+
+    memcpy(key, out, WALLET_CRYPTO_KEY_SIZE);
+    memcpy(iv, out + WALLET_CRYPTO_KEY_SIZE, WALLET_CRYPTO_IV_SIZE);
+    memory_cleanse(buf, sizeof(buf));
+    memory_cleanse(out, sizeof(out));
+    return WALLET_CRYPTO_KEY_SIZE;
+}
+
 bool CCrypter::SetKeyFromPassphrase(const SecureString& strKeyData, const std::vector<unsigned char>& chSalt, const unsigned int nRounds, const unsigned int nDerivationMethod)
 {
     if (nRounds < 1 || chSalt.size() != WALLET_CRYPTO_SALT_SIZE)
         return false;
 
     int i = 0;
-    if (nDerivationMethod == 0)
+    if (nDerivationMethod == WALLET_CRYPTO_DERIVATION_SHA512)
         i = BytesToKeySHA512AES(chSalt, strKeyData, nRounds, vchKey.data(), vchIV.data());
+    else if (nDerivationMethod == WALLET_CRYPTO_DERIVATION_SHA512X4)
+        i = BytesToKeySHA512x4AES(chSalt, strKeyData, nRounds, vchKey.data(), vchIV.data());
 
     if (i != (int)WALLET_CRYPTO_KEY_SIZE)
     {
@@ -208,6 +241,7 @@ bool CCryptoKeyStore::Lock(bool fAllowMixing)
     if(!fAllowMixing) {
         LOCK(cs_KeyStore);
         vMasterKey.clear();
+        ClearKeyCache();
     }
 
     fOnlyMixingAllowed = fAllowMixing;
@@ -247,6 +281,7 @@ bool CCryptoKeyStore::Unlock(const CKeyingMaterial& vMasterKeyIn, bool fForMixin
         if (keyFail || (!keyPass && cryptedHDChain.IsNull()))
             return false;
 
+        ClearKeyCache();
         vMasterKey = vMasterKeyIn;
 
         if(!cryptedHDChain.IsNull()) {
@@ -313,14 +348,55 @@ bool CCryptoKeyStore::GetKey(const CKeyID &address, CKey& keyOut) const
         CryptedKeyMap::const_iterator mi = mapCryptedKeys.find(address);
         if (mi != mapCryptedKeys.end())
         {
+            if (GetCachedKey(address, keyOut))
+                return true;
             const CPubKey &vchPubKey = (*mi).second.first;
             const std::vector<unsigned char> &vchCryptedSecret = (*mi).second.second;
-            return DecryptKey(vMasterKey, vchCryptedSecret, vchPubKey, keyOut);
+            if (!DecryptKey(vMasterKey, vchCryptedSecret, vchPubKey, keyOut))
+                return false;
+            CacheKey(address, keyOut);
+            return true;
         }
     }
     return false;
 }
 
+bool CCryptoKeyStore::GetCachedKey(const CKeyID &address, CKey& keyOut) const
+{
+    LOCK(cs_KeyStore);
+    if (IsCrypted() && vMasterKey.empty())
+        return false;
+
+    std::map<CKeyID, KeyCacheList::iterator>::const_iterator mi = mapKeyCache.find(address);
+    if (mi == mapKeyCache.end())
+        return false;
+    // move it to the front, the least recently used key is evicted first
+    listKeyCache.splice(listKeyCache.begin(), listKeyCache, mi->second);
+    keyOut = mi->second->second;
+    return true;
+}
+
+void CCryptoKeyStore::CacheKey(const CKeyID &address, const CKey& key) const
+{
+    LOCK(cs_KeyStore);
+    if ((IsCrypted() && vMasterKey.empty()) || mapKeyCache.count(address))
+        return;
+
+    listKeyCache.push_front(std::make_pair(address, key));
+    mapKeyCache[address] = listKeyCache.begin();
+    if (listKeyCache.size() > WALLET_CRYPTO_KEY_CACHE_SIZE) {
+        mapKeyCache.erase(listKeyCache.back().first);
+        listKeyCache.pop_back();
+    }
+}
+
+void CCryptoKeyStore::ClearKeyCache()
+{
+    LOCK(cs_KeyStore);
+    mapKeyCache.clear();
+    listKeyCache.clear();
+}
+
 bool CCryptoKeyStore::GetPubKey(const CKeyID &address, CPubKey& vchPubKeyOut) const
 {
     {
@@ -348,6 +424,7 @@ bool CCryptoKeyStore::EncryptKeys(CKeyingMaterial& vMasterKeyIn)
             return false;
 
         fUseCrypto = true;
+        ClearKeyCache();
         BOOST_FOREACH(KeyMap::value_type& mKey, mapKeys)
         {
             const CKey &key = mKey.second;
@@ -9,19 +9,28 @@
 #include "serialize.h"
 #include "support/allocators/secure.h"
 
+#include <list>
+
 class uint256;
 
 const unsigned int WALLET_CRYPTO_KEY_SIZE = 32;
 const unsigned int WALLET_CRYPTO_SALT_SIZE = 8;
 const unsigned int WALLET_CRYPTO_IV_SIZE = 16;
 
+const unsigned int WALLET_CRYPTO_DERIVATION_SHA512 = 0;
+const unsigned int WALLET_CRYPTO_DERIVATION_SHA512X4 = 2;
+
+//! number of decrypted keys an unlocked CCryptoKeyStore keeps
+const unsigned int WALLET_CRYPTO_KEY_CACHE_SIZE = 2048;
+
 /**
  * Private key encryption is done based on a CMasterKey,
  * which holds a salt and random encryption key.
  * 
  * CMasterKeys are encrypted using AES-256-CBC using a key
  * derived using derivation method nDerivationMethod
- * (0 == EVP_sha512()) and derivation iterations nDeriveIterations.
+ * (0 == EVP_sha512(), 2 == four EVP_sha512() chains) and derivation
+ * iterations nDeriveIterations.
  * vchOtherDerivationParameters is provided for alternative algorithms
  * which may require more parameters (such as scrypt).
  * 
@@ -38,6 +47,7 @@ public:
     std::vector<unsigned char> vchSalt;
     //! 0 = EVP_sha512()
     //! 1 = scrypt()
+    //! 2 = four EVP_sha512() chains, nDeriveIterations each, whose results are hashed together
     unsigned int nDerivationMethod;
     unsigned int nDeriveIterations;
     //! Use this for more parameters to key derivation,
@@ -60,7 +70,7 @@ public:
         // 25000 rounds is just under 0.1 seconds on a 1.86 GHz Pentium M
         // ie slightly lower than the lowest hardware we need bother supporting
         nDeriveIterations = 25000;
-        nDerivationMethod = 0;
+        nDerivationMethod = WALLET_CRYPTO_DERIVATION_SHA512;
         vchOtherDerivationParameters = std::vector<unsigned char>(0);
     }
 };
@@ -82,6 +92,7 @@ private:
     bool fKeySet;
 
     int BytesToKeySHA512AES(const std::vector<unsigned char>& chSalt, const SecureString& strKeyData, int count, unsigned char *key,unsigned char *iv) const;
+    int BytesToKeySHA512x4AES(const std::vector<unsigned char>& chSalt, const SecureString& strKeyData, int count, unsigned char *key, unsigned char *iv) const;
 
 public:
     bool SetKeyFromPassphrase(const SecureString &strKeyData, const std::vector<unsigned char>& chSalt, const unsigned int nRounds, const unsigned int nDerivationMethod);
@@ -134,9 +145,20 @@ private:
     //! if fOnlyMixingAllowed is true, only mixing should be allowed in unlocked wallet
     bool fOnlyMixingAllowed;
 
+    //! recently used keys, so signing doesn't decrypt or derive them again,
+    //! only filled while vMasterKey is set. CKey keeps its secret in locked
+    //! memory, and so does the cache.
+    typedef std::list<std::pair<CKeyID, CKey> > KeyCacheList;
+    mutable KeyCacheList listKeyCache;
+    mutable std::map<CKeyID, KeyCacheList::iterator> mapKeyCache;
+
 protected:
     bool SetCrypted();
 
+    bool GetCachedKey(const CKeyID &address, CKey& keyOut) const;
+    void CacheKey(const CKeyID &address, const CKey& key) const;
+    void ClearKeyCache();
+
     //! will encrypt previously unencrypted keys
     bool EncryptKeys(CKeyingMaterial& vMasterKeyIn);
 
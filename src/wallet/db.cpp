@@ -10,6 +10,7 @@
 #include "protocol.h"
 #include "util.h"
 #include "utilstrencodings.h"
+#include "wallet/ldb.h"
 
 #include <stdint.h>
 
@@ -234,7 +235,178 @@ void CDBEnv::CheckpointLSN(const std::string& strFile)
 }
 
 
-CDB::CDB(const std::string& strFilename, const char* pszMode, bool fFlushOnCloseIn) : pdb(NULL), activeTxn(NULL)
+WalletDBBackend nWalletDBBackendNew = WALLETDB_BDB;
+
+bool ParseWalletDBBackend(const std::string& strName, WalletDBBackend& backendRet)
+{
+    if (strName == "bdb") {
+        backendRet = WALLETDB_BDB;
+        return true;
+    }
+    if (strName == "leveldb") {
+        backendRet = WALLETDB_LEVELDB;
+        return true;
+    }
+    return false;
+}
+
+std::string GetWalletDBBackendName(WalletDBBackend backend)
+{
+    return backend == WALLETDB_LEVELDB ? "leveldb" : "bdb";
+}
+
+WalletDBBackend GetWalletDBBackend(const std::string& strFile)
+{
+    if (walletldb.IsOpen(strFile))
+        return WALLETDB_LEVELDB;
+    boost::filesystem::path path = GetDataDir() / strFile;
+    if (boost::filesystem::is_directory(path))
+        return WALLETDB_LEVELDB;
+    {
+        LOCK(bitdb.cs_db);
+        if (bitdb.mapDb.count(strFile))
+            return WALLETDB_BDB;
+    }
+    if (boost::filesystem::exists(path))
+        return WALLETDB_BDB;
+    return nWalletDBBackendNew;
+}
+
+class CBerkeleyDBCursor : public CWalletDBCursor
+{
+private:
+    Dbc* pcursor;
+
+public:
+    explicit CBerkeleyDBCursor(Dbc* pcursorIn) : pcursor(pcursorIn) {}
+    ~CBerkeleyDBCursor() { pcursor->close(); }
+
+    int Read(CDataStream& ssKey, CDataStream& ssValue, bool setRange) override
+    {
+        // Read at cursor
+        Dbt datKey;
+        unsigned int fFlags = DB_NEXT;
+        if (setRange) {
+            datKey.set_data(ssKey.data());
+            datKey.set_size(ssKey.size());
+            fFlags = DB_SET_RANGE;
+        }
+        Dbt datValue;
+        datKey.set_flags(DB_DBT_MALLOC);
+        datValue.set_flags(DB_DBT_MALLOC);
+        int ret = pcursor->get(&datKey, &datValue, fFlags);
+        if (ret != 0)
+            return ret;
+        else if (datKey.get_data() == NULL || datValue.get_data() == NULL)
+            return 99999;
+
+        // Convert to streams
+        ssKey.SetType(SER_DISK);
+        ssKey.clear();
+        ssKey.write((char*)datKey.get_data(), datKey.get_size());
+        ssValue.SetType(SER_DISK);
+        ssValue.clear();
+        ssValue.write((char*)datValue.get_data(), datValue.get_size());
+
+        // Clear and free memory
+        memory_cleanse(datKey.get_data(), datKey.get_size());
+        memory_cleanse(datValue.get_data(), datValue.get_size());
+        free(datKey.get_data());
+        free(datValue.get_data());
+        return 0;
+    }
+};
+
+/** Access to a Berkeley DB wallet file through a Db handle shared in bitdb */
+class CBerkeleyDBStore : public CWalletDBStore
+{
+private:
+    Db* pdb;
+    DbTxn* activeTxn;
+
+public:
+    explicit CBerkeleyDBStore(Db* pdbIn) : pdb(pdbIn), activeTxn(NULL) {}
+
+    bool Read(const CDataStream& ssKey, CDataStream& ssValue) override
+    {
+        Dbt datKey((void*)ssKey.data(), ssKey.size());
+        Dbt datValue;
+        datValue.set_flags(DB_DBT_MALLOC);
+        int ret = pdb->get(activeTxn, &datKey, &datValue, 0);
+        if (datValue.get_data() == NULL)
+            return false;
+        ssValue.write((char*)datValue.get_data(), datValue.get_size());
+
+        // Clear and free memory
+        memory_cleanse(datValue.get_data(), datValue.get_size());
+        free(datValue.get_data());
+        return ret == 0;
+    }
+
+    bool Write(const CDataStream& ssKey, const CDataStream& ssValue, bool fOverwrite) override
+    {
+        Dbt datKey((void*)ssKey.data(), ssKey.size());
+        Dbt datValue((void*)ssValue.data(), ssValue.size());
+        int ret = pdb->put(activeTxn, &datKey, &datValue, (fOverwrite ? 0 : DB_NOOVERWRITE));
+        return (ret == 0);
+    }
+
+    bool Erase(const CDataStream& ssKey) override
+    {
+        Dbt datKey((void*)ssKey.data(), ssKey.size());
+        int ret = pdb->del(activeTxn, &datKey, 0);
+        return (ret == 0 || ret == DB_NOTFOUND);
+    }
+
+    bool Exists(const CDataStream& ssKey) override
+    {
+        Dbt datKey((void*)ssKey.data(), ssKey.size());
+        int ret = pdb->exists(activeTxn, &datKey, 0);
+        return (ret == 0);
+    }
+
+    CWalletDBCursor* GetCursor() override
+    {
+        Dbc* pcursor = NULL;
+        int ret = pdb->cursor(NULL, &pcursor, 0);
+        if (ret != 0)
+            return NULL;
+        return new CBerkeleyDBCursor(pcursor);
+    }
+
+    bool TxnBegin() override
+    {
+        if (activeTxn)
+            return false;
+        DbTxn* ptxn = bitdb.TxnBegin();
+        if (!ptxn)
+            return false;
+        activeTxn = ptxn;
+        return true;
+    }
+
+    bool TxnCommit() override
+    {
+        if (!activeTxn)
+            return false;
+        int ret = activeTxn->commit(0);
+        activeTxn = NULL;
+        return (ret == 0);
+    }
+
+    bool TxnAbort() override
+    {
+        if (!activeTxn)
+            return false;
+        int ret = activeTxn->abort();
+        activeTxn = NULL;
+        return (ret == 0);
+    }
+
+    bool IsTxnActive() const override { return activeTxn != NULL; }
+};
+
+CDB::CDB(const std::string& strFilename, const char* pszMode, bool fFlushOnCloseIn) : backend(WALLETDB_BDB)
 {
     int ret;
     fReadOnly = (!strchr(pszMode, '+') && !strchr(pszMode, 'w'));
@@ -243,6 +415,19 @@ CDB::CDB(const std::string& strFilename, const char* pszMode, bool fFlushOnClose
         return;
 
     bool fCreate = strchr(pszMode, 'c') != NULL;
+    backend = GetWalletDBBackend(strFilename);
+    if (backend == WALLETDB_LEVELDB) {
+        pstore.reset(walletldb.OpenStore(strFilename, fCreate));
+        strFile = strFilename;
+        if (fCreate && !Exists(std::string("version"))) {
+            bool fTmp = fReadOnly;
+            fReadOnly = false;
+            WriteVersion(CLIENT_VERSION);
+            fReadOnly = fTmp;
+        }
+        return;
+    }
+
     unsigned int nFlags = DB_THREAD;
     if (fCreate)
         nFlags |= DB_CREATE;
@@ -254,7 +439,7 @@ CDB::CDB(const std::string& strFilename, const char* pszMode, bool fFlushOnClose
 
         strFile = strFilename;
         ++bitdb.mapFileUseCount[strFile];
-        pdb = bitdb.mapDb[strFile];
+        Db* pdb = bitdb.mapDb[strFile];
         if (pdb == NULL) {
             pdb = new Db(bitdb.dbenv, 0);
 
@@ -275,12 +460,12 @@ CDB::CDB(const std::string& strFilename, const char* pszMode, bool fFlushOnClose
 
             if (ret != 0) {
                 delete pdb;
-                pdb = NULL;
                 --bitdb.mapFileUseCount[strFile];
                 strFile = "";
                 throw std::runtime_error(strprintf("CDB: Error %d, can't open database %s", ret, strFilename));
             }
 
+            pstore.reset(new CBerkeleyDBStore(pdb));
             if (fCreate && !Exists(std::string("version"))) {
                 bool fTmp = fReadOnly;
                 fReadOnly = false;
@@ -289,13 +474,18 @@ CDB::CDB(const std::string& strFilename, const char* pszMode, bool fFlushOnClose
             }
 
             bitdb.mapDb[strFile] = pdb;
+        } else {
+            pstore.reset(new CBerkeleyDBStore(pdb));
         }
     }
 }
 
 void CDB::Flush()
 {
-    if (activeTxn)
+    if (pstore && pstore->IsTxnActive())
+        return;
+    // Writes to leveldb are synced in groups by walletldb
+    if (backend == WALLETDB_LEVELDB)
         return;
 
     // Flush database activity from memory pool to disk log
@@ -308,17 +498,16 @@ void CDB::Flush()
 
 void CDB::Close()
 {
-    if (!pdb)
+    if (!pstore)
         return;
-    if (activeTxn)
-        activeTxn->abort();
-    activeTxn = NULL;
-    pdb = NULL;
+    if (pstore->IsTxnActive())
+        pstore->TxnAbort();
+    pstore.reset();
 
     if (fFlushOnClose)
         Flush();
 
-    {
+    if (backend == WALLETDB_BDB) {
         LOCK(bitdb.cs_db);
         --bitdb.mapFileUseCount[strFile];
     }
@@ -349,6 +538,9 @@ bool CDBEnv::RemoveDb(const std::string& strFile)
 
 bool CDB::Rewrite(const std::string& strFile, const char* pszSkip)
 {
+    if (GetWalletDBBackend(strFile) == WALLETDB_LEVELDB)
+        return walletldb.Rewrite(strFile, pszSkip);
+
     while (true) {
         {
             LOCK(bitdb.cs_db);
@@ -376,17 +568,15 @@ bool CDB::Rewrite(const std::string& strFile, const char* pszSkip)
                         fSuccess = false;
                     }
 
-                    Dbc* pcursor = db.GetCursor();
+                    std::unique_ptr<CWalletDBCursor> pcursor(db.GetCursor());
                     if (pcursor)
                         while (fSuccess) {
                             CDataStream ssKey(SER_DISK, CLIENT_VERSION);
                             CDataStream ssValue(SER_DISK, CLIENT_VERSION);
-                            int ret1 = db.ReadAtCursor(pcursor, ssKey, ssValue);
+                            int ret1 = db.ReadAtCursor(pcursor.get(), ssKey, ssValue);
                             if (ret1 == DB_NOTFOUND) {
-                                pcursor->close();
                                 break;
                             } else if (ret1 != 0) {
-                                pcursor->close();
                                 fSuccess = false;
                                 break;
                             }
@@ -404,6 +594,7 @@ bool CDB::Rewrite(const std::string& strFile, const char* pszSkip)
                             if (ret2 > 0)
                                 fSuccess = false;
                         }
+                    pcursor.reset();
                     if (fSuccess) {
                         db.Close();
                         bitdb.CloseDb(strFile);
@@ -431,6 +622,80 @@ bool CDB::Rewrite(const std::string& strFile, const char* pszSkip)
 }
 
 
+bool CDB::Convert(const std::string& strFile)
+{
+    WalletDBBackend backendFrom = GetWalletDBBackend(strFile);
+    if (backendFrom == nWalletDBBackendNew)
+        return true;
+
+    // Make the file self contained before moving it out of the way
+    if (backendFrom == WALLETDB_BDB) {
+        LOCK(bitdb.cs_db);
+        if (bitdb.mapFileUseCount.count(strFile) && bitdb.mapFileUseCount[strFile] != 0)
+            return error("CDB::Convert: %s is in use", strFile);
+        bitdb.CloseDb(strFile);
+        bitdb.CheckpointLSN(strFile);
+        bitdb.mapFileUseCount.erase(strFile);
+        bitdb.mapDb.erase(strFile);
+    } else if (!walletldb.CloseDb(strFile)) {
+        return error("CDB::Convert: %s is in use", strFile);
+    }
+
+    std::string strFileBak = strprintf("%s.%d.bak", strFile, GetTime());
+    boost::filesystem::path pathFile = GetDataDir() / strFile;
+    boost::filesystem::path pathFileBak = GetDataDir() / strFileBak;
+    try {
+        boost::filesystem::rename(pathFile, pathFileBak);
+    } catch (const boost::filesystem::filesystem_error& e) {
+        return error("CDB::Convert: Failed to rename %s to %s: %s", strFile, strFileBak, e.what());
+    }
+    LogPrintf("CDB::Convert: Converting %s from %s to %s, original saved as %s...\n", strFile,
+        GetWalletDBBackendName(backendFrom), GetWalletDBBackendName(nWalletDBBackendNew), strFileBak);
+
+    int64_t nStart = GetTimeMillis();
+    unsigned int nRecords = 0;
+    bool fSuccess = false;
+    try {
+        CDB dbFrom(strFileBak, "r");
+        CDB dbTo(strFile, "cr+");
+        std::unique_ptr<CWalletDBCursor> pcursor(dbFrom.GetCursor());
+        // A single transaction, so a failed conversion leaves no partial wallet
+        fSuccess = pcursor && dbTo.TxnBegin();
+        while (fSuccess) {
+            CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+            CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+            int ret = dbFrom.ReadAtCursor(pcursor.get(), ssKey, ssValue);
+            if (ret == DB_NOTFOUND)
+                break;
+            fSuccess = ret == 0 && dbTo.pstore->Write(ssKey, ssValue, true);
+            nRecords++;
+        }
+        fSuccess = fSuccess && dbTo.TxnCommit();
+    } catch (const std::runtime_error& e) {
+        LogPrintf("CDB::Convert: %s\n", e.what());
+        fSuccess = false;
+    }
+
+    if (!fSuccess) {
+        try {
+            if (nWalletDBBackendNew == WALLETDB_LEVELDB) {
+                walletldb.CloseDb(strFile);
+                boost::filesystem::remove_all(pathFile);
+            } else {
+                bitdb.RemoveDb(strFile);
+            }
+            boost::filesystem::rename(pathFileBak, pathFile);
+        } catch (const boost::filesystem::filesystem_error& e) {
+            return error("CDB::Convert: Failed to convert %s and to restore it, the original is saved as %s: %s", strFile, strFileBak, e.what());
+        }
+        return error("CDB::Convert: Failed to convert %s", strFile);
+    }
+
+    LogPrintf("CDB::Convert: Converted %u records in %dms\n", nRecords, GetTimeMillis() - nStart);
+    return true;
+}
+
+
 void CDBEnv::Flush(bool fShutdown)
 {
     int64_t nStart = GetTimeMillis();
@@ -13,6 +13,7 @@
 #include "version.h"
 
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -88,13 +89,61 @@ public:
 extern CDBEnv bitdb;
 
 
-/** RAII class that provides access to a Berkeley database */
+/** Storage backends a wallet file can be kept in */
+enum WalletDBBackend
+{
+    WALLETDB_BDB,
+    WALLETDB_LEVELDB,
+};
+
+//! Backend new wallet files are created with
+extern WalletDBBackend nWalletDBBackendNew;
+
+bool ParseWalletDBBackend(const std::string& strName, WalletDBBackend& backendRet);
+std::string GetWalletDBBackendName(WalletDBBackend backend);
+/** Backend the wallet file strFile is kept in, nWalletDBBackendNew if it doesn't exist yet */
+WalletDBBackend GetWalletDBBackend(const std::string& strFile);
+
+/** Cursor over the serialized records of a wallet database */
+class CWalletDBCursor
+{
+public:
+    virtual ~CWalletDBCursor() {}
+
+    /**
+     * Read the next record, or the first one not below ssKey if setRange is set.
+     * Returns 0 on success, DB_NOTFOUND after the last record and any other value on errors.
+     */
+    virtual int Read(CDataStream& ssKey, CDataStream& ssValue, bool setRange) = 0;
+};
+
+/** Access to the serialized records of an open wallet file, implemented by every backend */
+class CWalletDBStore
+{
+public:
+    virtual ~CWalletDBStore() {}
+
+    virtual bool Read(const CDataStream& ssKey, CDataStream& ssValue) = 0;
+    virtual bool Write(const CDataStream& ssKey, const CDataStream& ssValue, bool fOverwrite) = 0;
+    virtual bool Erase(const CDataStream& ssKey) = 0;
+    virtual bool Exists(const CDataStream& ssKey) = 0;
+    /** Cursor over the committed records, owned by the caller */
+    virtual CWalletDBCursor* GetCursor() = 0;
+
+    virtual bool TxnBegin() = 0;
+    virtual bool TxnCommit() = 0;
+    virtual bool TxnAbort() = 0;
+    virtual bool IsTxnActive() const = 0;
+};
+
+
+/** RAII class that provides access to a wallet database */
 class CDB
 {
 protected:
-    Db* pdb;
+    std::unique_ptr<CWalletDBStore> pstore;
+    WalletDBBackend backend;
     std::string strFile;
-    DbTxn* activeTxn;
     bool fReadOnly;
     bool fFlushOnClose;
 
@@ -113,42 +162,36 @@ protected:
     template <typename K, typename T>
     bool Read(const K& key, T& value)
     {
-        if (!pdb)
+        if (!pstore)
             return false;
 
         // Key
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
-        Dbt datKey(ssKey.data(), ssKey.size());
 
         // Read
-        Dbt datValue;
-        datValue.set_flags(DB_DBT_MALLOC);
-        int ret = pdb->get(activeTxn, &datKey, &datValue, 0);
-        memory_cleanse(datKey.get_data(), datKey.get_size());
+        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
         bool success = false;
-        if (datValue.get_data() != NULL) {
+        if (pstore->Read(ssKey, ssValue)) {
             // Unserialize value
             try {
-                CDataStream ssValue((char*)datValue.get_data(), (char*)datValue.get_data() + datValue.get_size(), SER_DISK, CLIENT_VERSION);
                 ssValue >> value;
                 success = true;
             } catch (const std::exception&) {
                 // In this case success remains 'false'
             }
-
-            // Clear and free memory
-            memory_cleanse(datValue.get_data(), datValue.get_size());
-            free(datValue.get_data());
         }
-        return ret == 0 && success;
+
+        // Clear memory, the value stream is cleared when it is freed
+        memory_cleanse(ssKey.data(), ssKey.size());
+        return success;
     }
 
     template <typename K, typename T>
     bool Write(const K& key, const T& value, bool fOverwrite = true)
     {
-        if (!pdb)
+        if (!pstore)
             return false;
         if (fReadOnly)
             assert(!"Write called on database in read-only mode");
@@ -157,27 +200,25 @@ protected:
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
-        Dbt datKey(ssKey.data(), ssKey.size());
 
         // Value
         CDataStream ssValue(SER_DISK, CLIENT_VERSION);
         ssValue.reserve(10000);
         ssValue << value;
-        Dbt datValue(ssValue.data(), ssValue.size());
 
         // Write
-        int ret = pdb->put(activeTxn, &datKey, &datValue, (fOverwrite ? 0 : DB_NOOVERWRITE));
+        bool ret = pstore->Write(ssKey, ssValue, fOverwrite);
 
         // Clear memory in case it was a private key
-        memory_cleanse(datKey.get_data(), datKey.get_size());
-        memory_cleanse(datValue.get_data(), datValue.get_size());
-        return (ret == 0);
+        memory_cleanse(ssKey.data(), ssKey.size());
+        memory_cleanse(ssValue.data(), ssValue.size());
+        return ret;
     }
 
     template <typename K>
     bool Erase(const K& key)
     {
-        if (!pdb)
+        if (!pstore)
             return false;
         if (fReadOnly)
             assert(!"Erase called on database in read-only mode");
@@ -186,110 +227,66 @@ protected:
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
-        Dbt datKey(ssKey.data(), ssKey.size());
 
         // Erase
-        int ret = pdb->del(activeTxn, &datKey, 0);
+        bool ret = pstore->Erase(ssKey);
 
         // Clear memory
-        memory_cleanse(datKey.get_data(), datKey.get_size());
-        return (ret == 0 || ret == DB_NOTFOUND);
+        memory_cleanse(ssKey.data(), ssKey.size());
+        return ret;
     }
 
     template <typename K>
     bool Exists(const K& key)
     {
-        if (!pdb)
+        if (!pstore)
             return false;
 
         // Key
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
-        Dbt datKey(ssKey.data(), ssKey.size());
 
         // Exists
-        int ret = pdb->exists(activeTxn, &datKey, 0);
+        bool ret = pstore->Exists(ssKey);
 
         // Clear memory
-        memory_cleanse(datKey.get_data(), datKey.get_size());
-        return (ret == 0);
+        memory_cleanse(ssKey.data(), ssKey.size());
+        return ret;
     }
 
-    Dbc* GetCursor()
+    CWalletDBCursor* GetCursor()
     {
-        if (!pdb)
-            return NULL;
-        Dbc* pcursor = NULL;
-        int ret = pdb->cursor(NULL, &pcursor, 0);
-        if (ret != 0)
+        if (!pstore)
             return NULL;
-        return pcursor;
+        return pstore->GetCursor();
     }
 
-    int ReadAtCursor(Dbc* pcursor, CDataStream& ssKey, CDataStream& ssValue, bool setRange = false)
+    int ReadAtCursor(CWalletDBCursor* pcursor, CDataStream& ssKey, CDataStream& ssValue, bool setRange = false)
     {
-        // Read at cursor
-        Dbt datKey;
-        unsigned int fFlags = DB_NEXT;
-        if (setRange) {
-            datKey.set_data(ssKey.data());
-            datKey.set_size(ssKey.size());
-            fFlags = DB_SET_RANGE;
-        }
-        Dbt datValue;
-        datKey.set_flags(DB_DBT_MALLOC);
-        datValue.set_flags(DB_DBT_MALLOC);
-        int ret = pcursor->get(&datKey, &datValue, fFlags);
-        if (ret != 0)
-            return ret;
-        else if (datKey.get_data() == NULL || datValue.get_data() == NULL)
-            return 99999;
-
-        // Convert to streams
-        ssKey.SetType(SER_DISK);
-        ssKey.clear();
-        ssKey.write((char*)datKey.get_data(), datKey.get_size());
-        ssValue.SetType(SER_DISK);
-        ssValue.clear();
-        ssValue.write((char*)datValue.get_data(), datValue.get_size());
-
-        // Clear and free memory
-        memory_cleanse(datKey.get_data(), datKey.get_size());
-        memory_cleanse(datValue.get_data(), datValue.get_size());
-        free(datKey.get_data());
-        free(datValue.get_data());
-        return 0;
+        return pcursor->Read(ssKey, ssValue, setRange);
     }
 
 public:
     bool TxnBegin()
     {
-        if (!pdb || activeTxn)
+        if (!pstore)
             return false;
-        DbTxn* ptxn = bitdb.TxnBegin();
-        if (!ptxn)
-            return false;
-        activeTxn = ptxn;
-        return true;
+        return pstore->TxnBegin();
     }
 
     bool TxnCommit()
     {
-        if (!pdb || !activeTxn)
+        if (!pstore)
             return false;
-        int ret = activeTxn->commit(0);
-        activeTxn = NULL;
-        return (ret == 0);
+        return pstore->TxnCommit();
     }
 
     bool TxnAbort()
     {
-        if (!pdb || !activeTxn)
+        if (!pstore)
             return false;
-        int ret = activeTxn->abort();
-        activeTxn = NULL;
-        return (ret == 0);
+        return pstore->TxnAbort();
     }
 
     bool ReadVersion(int& nVersion)
@@ -304,6 +301,11 @@ public:
     }
 
     bool static Rewrite(const std::string& strFile, const char* pszSkip = NULL);
+    /**
+     * Move the wallet file strFile to the backend new wallet files are created with.
+     * The original is kept as strFile.<timestamp>.bak, must be called before strFile is opened.
+     */
+    bool static Convert(const std::string& strFile);
 };
 
 #endif // BITCOIN_WALLET_DB_H
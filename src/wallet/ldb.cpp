@@ -0,0 +1,399 @@
+// Copyright (c) 2024 The blazegeek developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "wallet/ldb.h"
+
+#include "dbwrapper.h"
+#include "util.h"
+
+#include <atomic>
+
+#include <boost/filesystem.hpp>
+
+CWalletLevelDBEnv walletldb;
+
+/** Serialized record data passed to leveldb as it is, without a length prefix */
+class CRawRecord
+{
+private:
+    const char* pbegin;
+    const char* pend;
+
+public:
+    CRawRecord(const char* pbeginIn, const char* pendIn) : pbegin(pbeginIn), pend(pendIn) {}
+    explicit CRawRecord(const CDataStream& ss) : pbegin(ss.data()), pend(ss.data() + ss.size()) {}
+    explicit CRawRecord(const CSerializeData& vch) : pbegin(vch.data()), pend(vch.data() + vch.size()) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        if (pend != pbegin)
+            s.write(pbegin, pend - pbegin);
+    }
+};
+
+/** Receives the serialized record data read from leveldb */
+class CRawRecordStream
+{
+private:
+    CDataStream& ss;
+
+public:
+    explicit CRawRecordStream(CDataStream& ssIn) : ss(ssIn) {}
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        ss.clear();
+        ss.write(s.data(), s.size());
+        s.ignore(s.size());
+    }
+};
+
+/** A wallet file open in leveldb, shared by all stores accessing it */
+class CWalletLevelDB
+{
+public:
+    CDBWrapper db;
+    //! written to since the last sync
+    std::atomic<bool> fDirty;
+    //! number of open stores, protected by walletldb.cs_ldb
+    int nUseCount;
+
+    CWalletLevelDB(const boost::filesystem::path& path, bool fMemory) :
+        db(path, WALLET_LEVELDB_CACHE, fMemory, false, false),
+        fDirty(false),
+        nUseCount(0)
+    {
+    }
+};
+
+class CWalletLevelDBCursor : public CWalletDBCursor
+{
+private:
+    std::unique_ptr<CDBIterator> piter;
+    bool fStarted;
+
+public:
+    explicit CWalletLevelDBCursor(CDBIterator* piterIn) : piter(piterIn), fStarted(false) {}
+
+    int Read(CDataStream& ssKey, CDataStream& ssValue, bool setRange) override
+    {
+        if (setRange)
+            piter->Seek(CRawRecord(ssKey));
+        else if (!fStarted)
+            piter->SeekToFirst();
+        else
+            piter->Next();
+        fStarted = true;
+
+        if (!piter->Valid())
+            return DB_NOTFOUND;
+
+        ssKey.SetType(SER_DISK);
+        ssValue.SetType(SER_DISK);
+        CRawRecordStream key(ssKey);
+        CRawRecordStream value(ssValue);
+        if (!piter->GetKey(key) || !piter->GetValue(value))
+            return 99999;
+        return 0;
+    }
+};
+
+/**
+ * Access to a leveldb wallet file. Writes of a transaction are kept here
+ * and written in a single batch when it is committed.
+ */
+class CWalletLevelDBStore : public CWalletDBStore
+{
+private:
+    CWalletLevelDB* pdb;
+    bool fTxn;
+    //! key -> (erased, value) of the writes in the active transaction
+    std::map<CSerializeData, std::pair<bool, CSerializeData> > mapTxn;
+
+    static CSerializeData ToData(const CDataStream& ss) { return CSerializeData(ss.data(), ss.data() + ss.size()); }
+
+public:
+    explicit CWalletLevelDBStore(CWalletLevelDB* pdbIn) : pdb(pdbIn), fTxn(false) {}
+
+    CWalletLevelDB* GetDB() const { return pdb; }
+
+    ~CWalletLevelDBStore()
+    {
+        LOCK(walletldb.cs_ldb);
+        --pdb->nUseCount;
+    }
+
+    bool Read(const CDataStream& ssKey, CDataStream& ssValue) override
+    {
+        if (fTxn) {
+            auto it = mapTxn.find(ToData(ssKey));
+            if (it != mapTxn.end()) {
+                if (it->second.first)
+                    return false;
+                ssValue.write(it->second.second.data(), it->second.second.size());
+                return true;
+            }
+        }
+        try {
+            CRawRecordStream value(ssValue);
+            return pdb->db.Read(CRawRecord(ssKey), value);
+        } catch (const dbwrapper_error& e) {
+            LogPrintf("CWalletLevelDBStore::%s -- %s\n", __func__, e.what());
+            return false;
+        }
+    }
+
+    bool Write(const CDataStream& ssKey, const CDataStream& ssValue, bool fOverwrite) override
+    {
+        if (!fOverwrite && Exists(ssKey))
+            return false;
+        if (fTxn) {
+            mapTxn[ToData(ssKey)] = std::make_pair(false, ToData(ssValue));
+            return true;
+        }
+        try {
+            pdb->db.Write(CRawRecord(ssKey), CRawRecord(ssValue));
+        } catch (const dbwrapper_error& e) {
+            LogPrintf("CWalletLevelDBStore::%s -- %s\n", __func__, e.what());
+            return false;
+        }
+        pdb->fDirty = true;
+        return true;
+    }
+
+    bool Erase(const CDataStream& ssKey) override
+    {
+        if (fTxn) {
+            mapTxn[ToData(ssKey)] = std::make_pair(true, CSerializeData());
+            return true;
+        }
+        try {
+            pdb->db.Erase(CRawRecord(ssKey));
+        } catch (const dbwrapper_error& e) {
+            LogPrintf("CWalletLevelDBStore::%s -- %s\n", __func__, e.what());
+            return false;
+        }
+        pdb->fDirty = true;
+        return true;
+    }
+
+    bool Exists(const CDataStream& ssKey) override
+    {
+        if (fTxn) {
+            auto it = mapTxn.find(ToData(ssKey));
+            if (it != mapTxn.end())
+                return !it->second.first;
+        }
+        try {
+            return pdb->db.Exists(CRawRecord(ssKey));
+        } catch (const dbwrapper_error& e) {
+            LogPrintf("CWalletLevelDBStore::%s -- %s\n", __func__, e.what());
+            return false;
+        }
+    }
+
+    CWalletDBCursor* GetCursor() override
+    {
+        return new CWalletLevelDBCursor(pdb->db.NewIterator());
+    }
+
+    bool TxnBegin() override
+    {
+        if (fTxn)
+            return false;
+        fTxn = true;
+        return true;
+    }
+
+    bool TxnCommit() override
+    {
+        if (!fTxn)
+            return false;
+        CDBBatch batch(pdb->db);
+        for (const auto& item : mapTxn) {
+            if (item.second.first)
+                batch.Erase(CRawRecord(item.first));
+            else
+                batch.Write(CRawRecord(item.first), CRawRecord(item.second.second));
+        }
+        mapTxn.clear();
+        fTxn = false;
+        try {
+            pdb->db.WriteBatch(batch);
+        } catch (const dbwrapper_error& e) {
+            LogPrintf("CWalletLevelDBStore::%s -- %s\n", __func__, e.what());
+            return false;
+        }
+        pdb->fDirty = true;
+        return true;
+    }
+
+    bool TxnAbort() override
+    {
+        if (!fTxn)
+            return false;
+        mapTxn.clear();
+        fTxn = false;
+        return true;
+    }
+
+    bool IsTxnActive() const override { return fTxn; }
+};
+
+CWalletLevelDBEnv::CWalletLevelDBEnv() : fMockDb(false)
+{
+}
+
+CWalletLevelDBEnv::~CWalletLevelDBEnv()
+{
+}
+
+void CWalletLevelDBEnv::Reset()
+{
+    LOCK(cs_ldb);
+    mapDb.clear();
+    fMockDb = false;
+}
+
+void CWalletLevelDBEnv::MakeMock()
+{
+    LOCK(cs_ldb);
+    if (!mapDb.empty())
+        throw std::runtime_error("CWalletLevelDBEnv::MakeMock: Already in use");
+
+    LogPrint("db", "CWalletLevelDBEnv::MakeMock\n");
+    fMockDb = true;
+}
+
+bool CWalletLevelDBEnv::IsOpen(const std::string& strFile) const
+{
+    LOCK(cs_ldb);
+    return mapDb.count(strFile) != 0;
+}
+
+CWalletDBStore* CWalletLevelDBEnv::OpenStore(const std::string& strFile, bool fCreate)
+{
+    LOCK(cs_ldb);
+    auto it = mapDb.find(strFile);
+    if (it == mapDb.end()) {
+        boost::filesystem::path path = GetDataDir() / strFile;
+        if (!fCreate && (fMockDb || !boost::filesystem::is_directory(path)))
+            throw std::runtime_error(strprintf("CWalletLevelDBEnv: Database %s does not exist", strFile));
+        LogPrint("db", "CWalletLevelDBEnv::OpenStore: Opening %s\n", strFile);
+        it = mapDb.emplace(strFile, std::unique_ptr<CWalletLevelDB>(new CWalletLevelDB(path, fMockDb))).first;
+    }
+    ++it->second->nUseCount;
+    return new CWalletLevelDBStore(it->second.get());
+}
+
+void CWalletLevelDBEnv::Sync()
+{
+    LOCK(cs_ldb);
+    for (auto& item : mapDb) {
+        if (!item.second->fDirty.exchange(false))
+            continue;
+        try {
+            item.second->db.Sync();
+        } catch (const dbwrapper_error& e) {
+            item.second->fDirty = true;
+            LogPrintf("CWalletLevelDBEnv::Sync: Error syncing %s: %s\n", item.first, e.what());
+        }
+    }
+}
+
+void CWalletLevelDBEnv::Flush(bool fShutdown)
+{
+    int64_t nStart = GetTimeMillis();
+    Sync();
+    if (!fShutdown || fMockDb)
+        return;
+
+    LOCK(cs_ldb);
+    auto it = mapDb.begin();
+    while (it != mapDb.end()) {
+        if (it->second->nUseCount == 0) {
+            LogPrint("db", "CWalletLevelDBEnv::Flush: %s closed\n", it->first);
+            it = mapDb.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    LogPrint("db", "CWalletLevelDBEnv::Flush: Flush(%s) took %15dms\n", fShutdown ? "true" : "false", GetTimeMillis() - nStart);
+}
+
+bool CWalletLevelDBEnv::CloseDb(const std::string& strFile)
+{
+    LOCK(cs_ldb);
+    auto it = mapDb.find(strFile);
+    if (it == mapDb.end())
+        return true;
+    if (it->second->nUseCount != 0)
+        return false;
+    mapDb.erase(it);
+    return true;
+}
+
+bool CWalletLevelDBEnv::Rewrite(const std::string& strFile, const char* pszSkip)
+{
+    LogPrintf("CWalletLevelDBEnv::Rewrite: Rewriting %s...\n", strFile);
+    try {
+        std::unique_ptr<CWalletLevelDBStore> pstore(static_cast<CWalletLevelDBStore*>(OpenStore(strFile, false)));
+        CWalletLevelDB* pdb = pstore->GetDB();
+
+        if (pszSkip) {
+            size_t nSkip = strlen(pszSkip);
+            CDBBatch batch(pdb->db);
+            std::unique_ptr<CDBIterator> piter(pdb->db.NewIterator());
+            CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+            CRawRecordStream key(ssKey);
+            for (piter->Seek(CRawRecord(pszSkip, pszSkip + nSkip)); piter->Valid(); piter->Next()) {
+                if (!piter->GetKey(key) || ssKey.size() < nSkip || memcmp(ssKey.data(), pszSkip, nSkip) != 0)
+                    break;
+                batch.Erase(CRawRecord(ssKey));
+            }
+            pdb->db.WriteBatch(batch, true);
+        }
+
+        // Erased and overwritten values stay in the log and in older tables
+        // until they are compacted, which also starts a new log
+        static const char pchEnd[] = {'\xff'};
+        pdb->db.CompactRange(CRawRecord(pchEnd, pchEnd), CRawRecord(pchEnd, pchEnd + sizeof(pchEnd)));
+    } catch (const std::runtime_error& e) {
+        LogPrintf("CWalletLevelDBEnv::Rewrite: Failed to rewrite database %s: %s\n", strFile, e.what());
+        return false;
+    }
+    return true;
+}
+
+bool CWalletLevelDBEnv::Backup(const std::string& strFile, const boost::filesystem::path& pathDest)
+{
+    try {
+        std::unique_ptr<CWalletDBStore> pstore(OpenStore(strFile, false));
+        std::unique_ptr<CWalletDBCursor> pcursor(pstore->GetCursor());
+        CDBWrapper dbDest(pathDest, WALLET_LEVELDB_CACHE, fMockDb, true, false);
+        CDBBatch batch(dbDest);
+        while (true) {
+            CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+            CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+            int ret = pcursor->Read(ssKey, ssValue, false);
+            if (ret == DB_NOTFOUND)
+                break;
+            if (ret != 0)
+                throw std::runtime_error("error reading database");
+            batch.Write(CRawRecord(ssKey), CRawRecord(ssValue));
+            if (batch.SizeEstimate() > WALLET_LEVELDB_CACHE) {
+                dbDest.WriteBatch(batch);
+                batch.Clear();
+            }
+        }
+        dbDest.WriteBatch(batch, true);
+    } catch (const std::runtime_error& e) {
+        LogPrintf("error copying %s to %s - %s\n", strFile, pathDest.string(), e.what());
+        return false;
+    }
+    LogPrintf("copied %s to %s\n", strFile, pathDest.string());
+    return true;
+}
@@ -0,0 +1,65 @@
+// Copyright (c) 2024 The blazegeek developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_WALLET_LDB_H
+#define BITCOIN_WALLET_LDB_H
+
+#include "sync.h"
+#include "wallet/db.h"
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include <boost/filesystem/path.hpp>
+
+class CWalletLevelDB;
+
+//! cache of a leveldb wallet, the wallet keeps all records in memory anyway
+static const size_t WALLET_LEVELDB_CACHE = 1 << 20;
+
+/**
+ * Wallet files kept in leveldb, a directory in place of the Berkeley DB file.
+ *
+ * Writes are appended to the leveldb log without waiting for the disk, a
+ * transaction is a single atomic batch. Sync() makes everything written so
+ * far durable with one fsync per file and is called by the wallet flushing
+ * thread and on shutdown, so bursts of writes are committed as a group.
+ */
+class CWalletLevelDBEnv
+{
+private:
+    bool fMockDb;
+    std::map<std::string, std::unique_ptr<CWalletLevelDB> > mapDb;
+
+public:
+    mutable CCriticalSection cs_ldb;
+
+    CWalletLevelDBEnv();
+    ~CWalletLevelDBEnv();
+    void Reset();
+
+    /** Keep wallet files in memory, for the tests */
+    void MakeMock();
+    bool IsMock() const { return fMockDb; }
+
+    bool IsOpen(const std::string& strFile) const;
+    /** Store accessing strFile, throws if it doesn't exist and fCreate isn't set */
+    CWalletDBStore* OpenStore(const std::string& strFile, bool fCreate);
+
+    /** Make all writes so far durable */
+    void Sync();
+    void Flush(bool fShutdown);
+    /** Close strFile, returns false if it is in use */
+    bool CloseDb(const std::string& strFile);
+
+    /** Erase the records starting with pszSkip and compact strFile so erased values are gone from disk */
+    bool Rewrite(const std::string& strFile, const char* pszSkip);
+    /** Copy the records of strFile into a new leveldb wallet at pathDest */
+    bool Backup(const std::string& strFile, const boost::filesystem::path& pathDest);
+};
+
+extern CWalletLevelDBEnv walletldb;
+
+#endif // BITCOIN_WALLET_LDB_H
@@ -6,6 +6,7 @@
 #include "utilstrencodings.h"
 #include "test/test_blaze.h"
 #include "wallet/crypter.h"
+#include "crypto/sha512.h"
 
 #include <vector>
 
@@ -218,6 +219,32 @@ static void TestPassphrase(const std::vector<unsigned char>& vchSalt, const Secu
 }
 
 
+static void TestPassphraseSHA512x4(const std::vector<unsigned char>& vchSalt, const SecureString& passphrase, uint32_t rounds)
+{
+    // four plain SHA-512 chains, each seeded with the chain number
+    unsigned char buf[4 * CSHA512::OUTPUT_SIZE];
+    for (unsigned char nChain = 0; nChain < 4; nChain++) {
+        unsigned char* hash = buf + nChain * CSHA512::OUTPUT_SIZE;
+        CSHA512().Write((const unsigned char*)&passphrase[0], passphrase.size()).Write(&vchSalt[0], vchSalt.size()).Write(&nChain, 1).Finalize(hash);
+        for (uint32_t i = 1; i < rounds; i++)
+            CSHA512().Write(hash, CSHA512::OUTPUT_SIZE).Finalize(hash);
+    }
+    unsigned char out[CSHA512::OUTPUT_SIZE];
+    CSHA512().Write(buf, sizeof(buf)).Finalize(out);
+
+    CCrypter crypt;
+    BOOST_CHECK(crypt.SetKeyFromPassphrase(passphrase, vchSalt, rounds, WALLET_CRYPTO_DERIVATION_SHA512X4));
+    BOOST_CHECK_MESSAGE(memcmp(out, crypt.vchKey.data(), crypt.vchKey.size()) == 0, \
+        HexStr(out, out + WALLET_CRYPTO_KEY_SIZE) + std::string(" != ") + HexStr(crypt.vchKey));
+    BOOST_CHECK_MESSAGE(memcmp(out + WALLET_CRYPTO_KEY_SIZE, crypt.vchIV.data(), crypt.vchIV.size()) == 0, \
+        HexStr(out + WALLET_CRYPTO_KEY_SIZE, out + WALLET_CRYPTO_KEY_SIZE + WALLET_CRYPTO_IV_SIZE) + std::string(" != ") + HexStr(crypt.vchIV));
+
+    // it must not be mistaken for the single chain
+    CCrypter crypt0;
+    BOOST_CHECK(crypt0.SetKeyFromPassphrase(passphrase, vchSalt, rounds, WALLET_CRYPTO_DERIVATION_SHA512));
+    BOOST_CHECK(crypt0.vchKey != crypt.vchKey);
+}
+
 static void TestDecrypt(const CCrypter& crypt, const std::vector<unsigned char>& vchCiphertext, \
                         const std::vector<unsigned char>& vchPlaintext = std::vector<unsigned char>())
 {
@@ -289,6 +316,69 @@ BOOST_AUTO_TEST_CASE(passphrase) {
     TestCrypter::TestPassphrase(vchSalt, SecureString(hash.begin(), hash.end()), rounds);
 }
 
+BOOST_AUTO_TEST_CASE(passphrase_sha512x4) {
+    TestCrypter::TestPassphraseSHA512x4(ParseHex("0000deadbeef0000"), "test", 25000);
+    TestCrypter::TestPassphraseSHA512x4(ParseHex("0000deadbeef0000"), "test", 1);
+
+    std::string hash(GetRandHash().ToString());
+    std::vector<unsigned char> vchSalt(8);
+    GetRandBytes(&vchSalt[0], vchSalt.size());
+    TestCrypter::TestPassphraseSHA512x4(vchSalt, SecureString(hash.begin(), hash.end()), 1 + insecure_rand() % 30000);
+
+    // unknown derivation methods are refused
+    CCrypter crypt;
+    BOOST_CHECK(!crypt.SetKeyFromPassphrase("test", vchSalt, 25000, 1));
+}
+
+class TestCryptoKeyStore : public CCryptoKeyStore
+{
+public:
+    bool EncryptKeys(CKeyingMaterial& vMasterKeyIn) { return CCryptoKeyStore::EncryptKeys(vMasterKeyIn); }
+    bool Unlock(const CKeyingMaterial& vMasterKeyIn) { return CCryptoKeyStore::Unlock(vMasterKeyIn); }
+};
+
+BOOST_AUTO_TEST_CASE(key_cache) {
+    TestCryptoKeyStore keystore;
+    std::vector<CKey> vKeys(10);
+    for (CKey& key : vKeys) {
+        key.MakeNewKey(true);
+        BOOST_CHECK(keystore.AddKey(key));
+    }
+
+    CKeyingMaterial vMasterKey(WALLET_CRYPTO_KEY_SIZE);
+    GetRandBytes(&vMasterKey[0], WALLET_CRYPTO_KEY_SIZE);
+    BOOST_CHECK(keystore.EncryptKeys(vMasterKey));
+    BOOST_CHECK(keystore.IsLocked());
+
+    CKey keyOut;
+    BOOST_CHECK(!keystore.GetKey(vKeys[0].GetPubKey().GetID(), keyOut));
+
+    // decrypted keys are returned again from the cache while unlocked
+    BOOST_CHECK(keystore.Unlock(vMasterKey));
+    for (int i = 0; i < 2; i++) {
+        for (const CKey& key : vKeys) {
+            BOOST_CHECK(keystore.GetKey(key.GetPubKey().GetID(), keyOut));
+            BOOST_CHECK(keyOut == key);
+        }
+    }
+
+    // and are gone once it is locked
+    BOOST_CHECK(keystore.Lock());
+    BOOST_CHECK(!keystore.GetKey(vKeys[0].GetPubKey().GetID(), keyOut));
+
+    // a wrong master key doesn't unlock them
+    CKeyingMaterial vWrongKey(WALLET_CRYPTO_KEY_SIZE);
+    GetRandBytes(&vWrongKey[0], WALLET_CRYPTO_KEY_SIZE);
+    BOOST_CHECK(!keystore.Unlock(vWrongKey));
+    BOOST_CHECK(!keystore.GetKey(vKeys[0].GetPubKey().GetID(), keyOut));
+
+    // locking for mixing only keeps the master key, and the cache with it
+    BOOST_CHECK(keystore.Unlock(vMasterKey));
+    BOOST_CHECK(keystore.Lock(true));
+    BOOST_CHECK(keystore.GetKey(vKeys[1].GetPubKey().GetID(), keyOut));
+    BOOST_CHECK(keyOut == vKeys[1]);
+}
+
 BOOST_AUTO_TEST_CASE(encrypt) {
     std::vector<unsigned char> vchSalt = ParseHex("0000deadbeef0000");
     BOOST_CHECK(vchSalt.size() == WALLET_CRYPTO_SALT_SIZE);
@@ -6,12 +6,14 @@
 
 #include "rpc/server.h"
 #include "wallet/db.h"
+#include "wallet/ldb.h"
 #include "wallet/wallet.h"
 
 WalletTestingSetup::WalletTestingSetup(const std::string& chainName):
     TestingSetup(chainName)
 {
     bitdb.MakeMock();
+    walletldb.MakeMock();
 
     bool fFirstRun;
     pwalletMain = new CWallet("wallet_test.dat");
@@ -29,4 +31,6 @@ WalletTestingSetup::~WalletTestingSetup()
 
     bitdb.Flush(true);
     bitdb.Reset();
+    walletldb.Reset();
+    nWalletDBBackendNew = WALLETDB_BDB;
 }
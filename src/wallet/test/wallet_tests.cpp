@@ -9,6 +9,7 @@
 #include <utility>
 #include <vector>
 
+#include "privatesend-client.h"
 #include "rpc/server.h"
 #include "test/test_blaze.h"
 #include "validation.h"
@@ -297,8 +298,8 @@ BOOST_AUTO_TEST_CASE(coin_selection_tests)
             for (int i2 = 0; i2 < 100; i2++)
                 add_coin(COIN);
 
-            // picking 50 from 100 coins doesn't depend on the shuffle,
-            // but does depend on randomness in the stochastic approximation code
+            // picking 50 from 100 coins depends on the shuffle, the
+            // branch and bound search takes the first 50 it finds
             BOOST_CHECK(wallet.SelectCoinsMinConf(50 * COIN, 1, 6, 0, vCoins, setCoinsRet , nValueRet));
             BOOST_CHECK(wallet.SelectCoinsMinConf(50 * COIN, 1, 6, 0, vCoins, setCoinsRet2, nValueRet));
             BOOST_CHECK(!equal_sets(setCoinsRet, setCoinsRet2));
@@ -361,6 +362,80 @@ BOOST_AUTO_TEST_CASE(ApproximateBestSubset)
     empty_wallet();
 }
 
+BOOST_AUTO_TEST_CASE(branch_and_bound)
+{
+    std::vector<CAmount> vValue;
+    std::vector<char> vfBest;
+    CAmount nBest;
+    CAmount nMaxValue = std::numeric_limits<CAmount>::max();
+
+    // sorted by descending value
+    vValue.push_back(8 * CENT);
+    vValue.push_back(7 * CENT);
+    vValue.push_back(5 * CENT);
+    vValue.push_back(2 * CENT);
+    vValue.push_back(1 * CENT);
+
+    // exact matches
+    BOOST_CHECK(SelectCoinsBnB(vValue, 10 * CENT, 0, nMaxValue, vfBest, nBest));
+    BOOST_CHECK_EQUAL(nBest, 10 * CENT);
+    BOOST_CHECK(SelectCoinsBnB(vValue, 23 * CENT, 0, nMaxValue, vfBest, nBest));
+    BOOST_CHECK_EQUAL(nBest, 23 * CENT);
+    BOOST_CHECK(std::count(vfBest.begin(), vfBest.end(), true) == 5);
+    BOOST_CHECK(!SelectCoinsBnB(vValue, 24 * CENT, 0, nMaxValue, vfBest, nBest));
+
+    // the least excess within the cost of change
+    vValue.clear();
+    vValue.push_back(10 * CENT + 500);
+    vValue.push_back(10 * CENT + 200);
+    vValue.push_back(5 * CENT + 300);
+    vValue.push_back(5 * CENT);
+    BOOST_CHECK(!SelectCoinsBnB(vValue, 15 * CENT, 100, nMaxValue, vfBest, nBest));
+    BOOST_CHECK(SelectCoinsBnB(vValue, 15 * CENT, 1000, nMaxValue, vfBest, nBest));
+    BOOST_CHECK_EQUAL(nBest, 15 * CENT + 200);
+    BOOST_CHECK(vfBest[1] && vfBest[3] && !vfBest[0] && !vfBest[2]);
+
+    // and no more than the maximum value
+    BOOST_CHECK(!SelectCoinsBnB(vValue, 15 * CENT, 1000, 15 * CENT + 100, vfBest, nBest));
+
+    // identical coins don't make the search exponential
+    vValue.assign(100000, 2 * CENT);
+    vValue.push_back(1 * CENT);
+    BOOST_CHECK(SelectCoinsBnB(vValue, 2001 * CENT, 0, nMaxValue, vfBest, nBest));
+    BOOST_CHECK_EQUAL(nBest, 2001 * CENT);
+    BOOST_CHECK(!SelectCoinsBnB(vValue, 5 * COIN + 1, 0, nMaxValue, vfBest, nBest));
+}
+
+BOOST_AUTO_TEST_CASE(select_coins_no_change)
+{
+    CoinSet setCoinsRet;
+    CAmount nValueRet;
+
+    LOCK(wallet.cs_wallet);
+
+    empty_wallet();
+    add_coin(3 * CENT);
+    add_coin(5 * CENT + 300);
+    add_coin(6 * CENT);
+    add_coin(50 * CENT);
+
+    // a subset within the cost of change is preferred over the smallest bigger coin
+    BOOST_CHECK(wallet.SelectCoinsMinConf(8 * CENT, 1, 6, 0, vCoins, setCoinsRet, nValueRet, ALL_COINS, false, 546));
+    BOOST_CHECK_EQUAL(nValueRet, 8 * CENT + 300);
+    BOOST_CHECK_EQUAL(setCoinsRet.size(), 2U);
+
+    // the coins are prepared once for several attempts
+    std::vector<CInputCoin> vInputCoins;
+    wallet.GetInputCoins(vCoins, ALL_COINS, vInputCoins);
+    BOOST_CHECK_EQUAL(vInputCoins.size(), 4U);
+    BOOST_CHECK_EQUAL(vInputCoins.front().nValue, 50 * CENT);
+    BOOST_CHECK(wallet.SelectCoinsMinConf(9 * CENT, 1, 6, 0, vInputCoins, setCoinsRet, nValueRet));
+    BOOST_CHECK_EQUAL(nValueRet, 9 * CENT);
+    BOOST_CHECK(!wallet.SelectCoinsMinConf(9 * CENT, 7 * 24, 7 * 24, 0, vInputCoins, setCoinsRet, nValueRet));
+
+    empty_wallet();
+}
+
 BOOST_FIXTURE_TEST_CASE(rescan, TestChain100Setup)
 {
     LOCK(cs_main);
@@ -377,7 +452,9 @@ BOOST_FIXTURE_TEST_CASE(rescan, TestChain100Setup)
         CWallet wallet;
         LOCK(wallet.cs_wallet);
         wallet.AddKeyPubKey(coinbaseKey, coinbaseKey.GetPubKey());
-        BOOST_CHECK_EQUAL(oldTip, wallet.ScanForWalletTransactions(oldTip));
+        CWalletRescanReserver reserver(&wallet);
+        BOOST_CHECK(reserver.Reserve());
+        BOOST_CHECK_EQUAL(oldTip, wallet.ScanForWalletTransactions(oldTip, reserver));
         BOOST_CHECK_EQUAL(wallet.GetImmatureBalance(), 1000 * COIN);
     }
 
@@ -391,7 +468,9 @@ BOOST_FIXTURE_TEST_CASE(rescan, TestChain100Setup)
         CWallet wallet;
         LOCK(wallet.cs_wallet);
         wallet.AddKeyPubKey(coinbaseKey, coinbaseKey.GetPubKey());
-        BOOST_CHECK_EQUAL(newTip, wallet.ScanForWalletTransactions(oldTip));
+        CWalletRescanReserver reserver(&wallet);
+        BOOST_CHECK(reserver.Reserve());
+        BOOST_CHECK_EQUAL(newTip, wallet.ScanForWalletTransactions(oldTip, reserver));
         BOOST_CHECK_EQUAL(wallet.GetImmatureBalance(), 500 * COIN);
     }
 
@@ -428,6 +507,170 @@ BOOST_FIXTURE_TEST_CASE(rescan, TestChain100Setup)
     }
 }
 
+BOOST_FIXTURE_TEST_CASE(rescan_reorg, TestChain100Setup)
+{
+    LOCK(cs_main);
+
+    CKey staleKey, newKey;
+    staleKey.MakeNewKey(true);
+    newKey.MakeNewKey(true);
+
+    // Replace the tip by a block paying to another key, as if the scan had
+    // queued the old tip just before a reorg.
+    CBlock staleBlock = CreateAndProcessBlock({}, GetScriptForRawPubKey(staleKey.GetPubKey()));
+    CBlockIndex* staleTip = chainActive.Tip();
+    BOOST_CHECK(staleTip->GetBlockHash() == staleBlock.GetHash());
+    CValidationState state;
+    BOOST_CHECK(InvalidateBlock(state, Params(), staleTip));
+    CBlock newBlock = CreateAndProcessBlock({}, GetScriptForRawPubKey(newKey.GetPubKey()));
+    CBlockIndex* newTip = chainActive.Tip();
+    BOOST_CHECK(newTip->GetBlockHash() == newBlock.GetHash());
+    BOOST_CHECK(!chainActive.Contains(staleTip));
+
+    // The scan skips the disconnected block and carries on after the fork
+    CWallet wallet;
+    LOCK(wallet.cs_wallet);
+    wallet.AddKeyPubKey(staleKey, staleKey.GetPubKey());
+    wallet.AddKeyPubKey(newKey, newKey.GetPubKey());
+    ScanResult result;
+    CWalletRescanReserver reserver(&wallet);
+    BOOST_CHECK(reserver.Reserve());
+    BOOST_CHECK_EQUAL(newTip, wallet.ScanForWalletTransactions(staleTip, reserver, false, &result));
+    BOOST_CHECK_EQUAL(result, SCAN_SUCCESS);
+    BOOST_CHECK_EQUAL(wallet.mapWallet.count(staleBlock.vtx[0]->GetHash()), 0U);
+    BOOST_CHECK_EQUAL(wallet.mapWallet.count(newBlock.vtx[0]->GetHash()), 1U);
+}
+
+BOOST_FIXTURE_TEST_CASE(rescan_reserver, TestChain100Setup)
+{
+    CWallet wallet;
+    wallet.AddKeyPubKey(coinbaseKey, coinbaseKey.GetPubKey());
+
+    // an abort of an earlier rescan doesn't carry over
+    wallet.AbortRescan();
+    {
+        CWalletRescanReserver reserver(&wallet);
+        BOOST_CHECK(reserver.Reserve());
+        BOOST_CHECK(wallet.IsScanning());
+        BOOST_CHECK(!wallet.IsAbortingRescan());
+
+        // a second rescan fails right away
+        CWalletRescanReserver reserver2(&wallet);
+        BOOST_CHECK(!reserver2.Reserve());
+        BOOST_CHECK(!reserver2.IsReserved());
+
+        // an abort between the reservation and the scan stops the scan
+        wallet.AbortRescan();
+        ScanResult result;
+        wallet.ScanForWalletTransactions(chainActive.Genesis(), reserver, false, &result);
+        BOOST_CHECK_EQUAL(result, SCAN_ABORTED);
+        BOOST_CHECK(wallet.IsScanning());
+    }
+    BOOST_CHECK(!wallet.IsScanning());
+
+    // the wallet can be rescanned again once the reservation is gone
+    CWalletRescanReserver reserver(&wallet);
+    BOOST_CHECK(reserver.Reserve());
+    ScanResult result;
+    wallet.ScanForWalletTransactions(chainActive.Genesis(), reserver, false, &result);
+    BOOST_CHECK_EQUAL(result, SCAN_SUCCESS);
+    BOOST_CHECK(wallet.GetImmatureBalance() > 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(cached_balances, TestChain100Setup)
+{
+    LOCK(cs_main);
+
+    CWallet wallet;
+    LOCK(wallet.cs_wallet);
+    wallet.AddKeyPubKey(coinbaseKey, coinbaseKey.GetPubKey());
+    {
+        CWalletRescanReserver reserver(&wallet);
+        BOOST_CHECK(reserver.Reserve());
+        wallet.ScanForWalletTransactions(chainActive.Genesis(), reserver);
+    }
+
+    // none of the coinbases are mature yet
+    CAmount nImmature = wallet.GetImmatureBalance();
+    BOOST_CHECK(nImmature > 0);
+    BOOST_CHECK_EQUAL(wallet.GetBalance(), 0);
+    BOOST_CHECK_EQUAL(wallet.GetUnconfirmedBalance(), 0);
+
+    // a new tip matures the first coinbase without the wallet hearing about it
+    CreateAndProcessBlock({}, CScript() << OP_TRUE);
+    CAmount nBalance = wallet.GetBalance();
+    BOOST_CHECK(nBalance > 0);
+    BOOST_CHECK_EQUAL(wallet.GetImmatureBalance() + nBalance, nImmature);
+
+    // only unspent outputs are available
+    std::vector<COutput> vAvailable;
+    wallet.AvailableCoins(vAvailable);
+    BOOST_CHECK_EQUAL(vAvailable.size(), 1);
+    BOOST_CHECK_EQUAL(vAvailable[0].tx->tx->vout[vAvailable[0].i].nValue, nBalance);
+}
+
+BOOST_AUTO_TEST_CASE(hd_keypool_topup)
+{
+    LOCK(pwalletMain->cs_wallet);
+
+    std::vector<unsigned char> vchSeed = ParseHex("000102030405060708090a0b0c0d0e0f");
+    CHDChain hdChain;
+    BOOST_CHECK(hdChain.SetSeed(SecureVector(vchSeed.begin(), vchSeed.end()), true));
+    BOOST_CHECK(pwalletMain->SetHDChain(hdChain, false));
+    BOOST_CHECK(pwalletMain->IsHDEnabled());
+
+    // enough keys for the derivation to be spread over several threads
+    BOOST_CHECK(pwalletMain->TopUpKeyPool(500));
+    BOOST_CHECK_EQUAL(pwalletMain->KeypoolCountExternalKeys(), 500);
+    BOOST_CHECK_EQUAL(pwalletMain->GetKeyPoolSize(), 1000);
+
+    // keys derived from the public chain keys are the ones derived from the seed
+    for (bool fInternal : {false, true}) {
+        for (uint32_t i = 0; i < 500; i++) {
+            CExtKey extKey;
+            hdChain.DeriveChildExtKey(0, fInternal, i, extKey);
+            BOOST_CHECK(pwalletMain->HaveKey(extKey.key.GetPubKey().GetID()));
+        }
+    }
+    CExtKey extKey;
+    hdChain.DeriveChildExtKey(0, true, 499, extKey);
+    CKey key;
+    BOOST_CHECK(pwalletMain->GetKey(extKey.key.GetPubKey().GetID(), key));
+    BOOST_CHECK(key == extKey.key);
+
+    // the chain counters moved past the whole batch
+    CHDChain hdChainStored;
+    CHDAccount acc;
+    BOOST_CHECK(pwalletMain->GetHDChain(hdChainStored));
+    BOOST_CHECK(hdChainStored.GetAccount(0, acc));
+    BOOST_CHECK_EQUAL(acc.nExternalChainCounter, 500);
+    BOOST_CHECK_EQUAL(acc.nInternalChainCounter, 500);
+}
+
+BOOST_AUTO_TEST_CASE(rescan_filter)
+{
+    CKey key, otherKey;
+    key.MakeNewKey(true);
+    otherKey.MakeNewKey(true);
+    CScript redeemScript = GetScriptForMultisig(1, {otherKey.GetPubKey(), key.GetPubKey()});
+    CScript watchScript = CScript() << OP_RETURN << ParseHex("00112233");
+
+    CWalletScanFilter filter;
+    filter.AddId(key.GetPubKey().GetID());
+    filter.AddId(CScriptID(redeemScript));
+    filter.AddWatchOnly(watchScript);
+
+    BOOST_CHECK(filter.IsRelevant(CTxOut(COIN, GetScriptForRawPubKey(key.GetPubKey()))));
+    BOOST_CHECK(filter.IsRelevant(CTxOut(COIN, GetScriptForDestination(key.GetPubKey().GetID()))));
+    BOOST_CHECK(filter.IsRelevant(CTxOut(COIN, GetScriptForDestination(CScriptID(redeemScript)))));
+    BOOST_CHECK(filter.IsRelevant(CTxOut(COIN, redeemScript)));
+    BOOST_CHECK(filter.IsRelevant(CTxOut(0, watchScript)));
+
+    BOOST_CHECK(!filter.IsRelevant(CTxOut(COIN, GetScriptForRawPubKey(otherKey.GetPubKey()))));
+    BOOST_CHECK(!filter.IsRelevant(CTxOut(COIN, GetScriptForDestination(otherKey.GetPubKey().GetID()))));
+    BOOST_CHECK(!filter.IsRelevant(CTxOut(COIN, GetScriptForDestination(CScriptID(watchScript)))));
+}
+
 // Verify importwallet RPC starts rescan at earliest block with timestamp
 // greater or equal than key birthday. Previously there was a bug where
 // importwallet RPC would start the scan at the latest block with timestamp less
@@ -488,4 +731,45 @@ BOOST_FIXTURE_TEST_CASE(importwallet_rescan, TestChain100Setup)
     ::pwalletMain = pwalletMainBackup;
 }
 
+BOOST_AUTO_TEST_CASE(privatesend_rounds)
+{
+    CPrivateSend::InitStandardDenominations();
+    std::vector<CAmount> vecDenominations = CPrivateSend::GetStandardDenominations();
+    CAmount nDenomLarge = vecDenominations[vecDenominations.size() - 3];
+    CAmount nDenomSmall = vecDenominations[vecDenominations.size() - 2];
+
+    CKey key;
+    key.MakeNewKey(true);
+    BOOST_CHECK(pwalletMain->AddKeyPubKey(key, key.GetPubKey()));
+    CScript scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
+
+    // denominate a foreign input, the outputs have no rounds yet
+    CMutableTransaction txDenominate;
+    txDenominate.vin.emplace_back(GetRandHash(), 0);
+    txDenominate.vout.emplace_back(nDenomLarge, scriptPubKey);
+    txDenominate.vout.emplace_back(nDenomSmall, scriptPubKey);
+    txDenominate.vout.emplace_back(CPrivateSend::GetCollateralAmount(), scriptPubKey);
+    BOOST_CHECK(pwalletMain->AddToWallet(CWalletTx(pwalletMain, MakeTransactionRef(txDenominate))));
+
+    COutPoint outpointLarge(txDenominate.GetHash(), 0);
+    BOOST_CHECK_EQUAL(pwalletMain->GetRealOutpointPrivateSendRounds(outpointLarge), 0);
+    BOOST_CHECK_EQUAL(pwalletMain->GetRealOutpointPrivateSendRounds(COutPoint(txDenominate.GetHash(), 1)), 0);
+    BOOST_CHECK_EQUAL(pwalletMain->GetRealOutpointPrivateSendRounds(COutPoint(txDenominate.GetHash(), 2)), -3);
+    BOOST_CHECK_EQUAL(pwalletMain->GetAverageAnonymizedRounds(), 0);
+
+    // mix the large output into smaller ones
+    CMutableTransaction txMix;
+    txMix.vin.emplace_back(outpointLarge);
+    for (int i = 0; i < 10; i++) {
+        txMix.vout.emplace_back(nDenomSmall, scriptPubKey);
+    }
+    BOOST_CHECK(pwalletMain->AddToWallet(CWalletTx(pwalletMain, MakeTransactionRef(txMix))));
+
+    for (int i = 0; i < 10; i++) {
+        BOOST_CHECK_EQUAL(pwalletMain->GetRealOutpointPrivateSendRounds(COutPoint(txMix.GetHash(), i)), 1);
+    }
+    // the spent output is gone from the index, ten outputs mixed once and one not yet mixed are left
+    BOOST_CHECK_CLOSE(pwalletMain->GetAverageAnonymizedRounds(), 10.0 / 11, 0.001);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
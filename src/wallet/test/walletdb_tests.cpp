@@ -0,0 +1,204 @@
+// Copyright (c) 2024 The blazegeek developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "wallet/db.h"
+#include "wallet/ldb.h"
+#include "wallet/wallet.h"
+#include "wallet/walletdb.h"
+
+#include "utiltime.h"
+#include "validation.h"
+#include "wallet/test/wallet_test_fixture.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(walletdb_tests, WalletTestingSetup)
+
+static CKeyPool MakeKeyPoolEntry()
+{
+    CKey key;
+    key.MakeNewKey(true);
+    return CKeyPool(key.GetPubKey(), false);
+}
+
+static void WriteAccountingEntry(CWalletDB& walletdb, uint64_t nEntryNo, const std::string& strAccount, CAmount nCreditDebit)
+{
+    CAccountingEntry acentry;
+    acentry.strAccount = strAccount;
+    acentry.nCreditDebit = nCreditDebit;
+    BOOST_CHECK(walletdb.WriteAccountingEntry(nEntryNo, acentry));
+}
+
+BOOST_AUTO_TEST_CASE(leveldb_records)
+{
+    nWalletDBBackendNew = WALLETDB_LEVELDB;
+    BOOST_CHECK(GetWalletDBBackend("wallet_test.dat") == WALLETDB_BDB);
+    BOOST_CHECK(GetWalletDBBackend("wallet_ldb.dat") == WALLETDB_LEVELDB);
+
+    {
+        CWalletDB walletdb("wallet_ldb.dat", "cr+");
+        int nVersion;
+        BOOST_CHECK(walletdb.ReadVersion(nVersion));
+        BOOST_CHECK_EQUAL(nVersion, CLIENT_VERSION);
+
+        CKeyPool keypool;
+        BOOST_CHECK(walletdb.WritePool(1, MakeKeyPoolEntry()));
+        BOOST_CHECK(walletdb.ReadPool(1, keypool));
+        BOOST_CHECK(walletdb.ErasePool(1));
+        BOOST_CHECK(!walletdb.ReadPool(1, keypool));
+
+        // writes of a transaction are visible to it but only stored when it is committed
+        BOOST_CHECK(walletdb.TxnBegin());
+        BOOST_CHECK(walletdb.WritePool(2, MakeKeyPoolEntry()));
+        BOOST_CHECK(walletdb.ReadPool(2, keypool));
+        BOOST_CHECK(walletdb.TxnAbort());
+        BOOST_CHECK(!walletdb.ReadPool(2, keypool));
+
+        BOOST_CHECK(walletdb.TxnBegin());
+        for (int64_t i = 2; i < 10; i++) {
+            BOOST_CHECK(walletdb.WritePool(i, MakeKeyPoolEntry()));
+        }
+        BOOST_CHECK(walletdb.ErasePool(2));
+        BOOST_CHECK(walletdb.TxnCommit());
+        BOOST_CHECK(!walletdb.ReadPool(2, keypool));
+        for (int64_t i = 3; i < 10; i++) {
+            BOOST_CHECK(walletdb.ReadPool(i, keypool));
+        }
+
+        // accounting entries are found with a range cursor
+        WriteAccountingEntry(walletdb, 1, "a", 5 * COIN);
+        WriteAccountingEntry(walletdb, 2, "b", -3 * COIN);
+        WriteAccountingEntry(walletdb, 3, "a", 2 * COIN);
+        BOOST_CHECK_EQUAL(walletdb.GetAccountCreditDebit("a"), 7 * COIN);
+        BOOST_CHECK_EQUAL(walletdb.GetAccountCreditDebit("b"), -3 * COIN);
+        BOOST_CHECK_EQUAL(walletdb.GetAccountCreditDebit("*"), 4 * COIN);
+    }
+
+    // a rewrite drops the skipped records only
+    BOOST_CHECK(CDB::Rewrite("wallet_ldb.dat", "\x04pool"));
+    CWalletDB walletdb("wallet_ldb.dat");
+    CKeyPool keypool;
+    for (int64_t i = 3; i < 10; i++) {
+        BOOST_CHECK(!walletdb.ReadPool(i, keypool));
+    }
+    BOOST_CHECK_EQUAL(walletdb.GetAccountCreditDebit("*"), 4 * COIN);
+}
+
+BOOST_AUTO_TEST_CASE(leveldb_wallet_load)
+{
+    nWalletDBBackendNew = WALLETDB_LEVELDB;
+
+    std::set<CKeyID> setKeys;
+    std::vector<uint256> vHashes;
+    unsigned int nKeyPoolSize;
+    {
+        CWallet wallet("wallet_ldb.dat");
+        bool fFirstRun;
+        BOOST_CHECK_EQUAL(wallet.LoadWallet(fFirstRun), DB_LOAD_OK);
+        BOOST_CHECK(fFirstRun);
+
+        LOCK2(cs_main, wallet.cs_wallet);
+        BOOST_CHECK(wallet.TopUpKeyPool(10));
+        wallet.GetKeys(setKeys);
+        nKeyPoolSize = wallet.GetKeyPoolSize();
+        for (int i = 0; i < 10; i++) {
+            CMutableTransaction tx;
+            tx.nLockTime = i;
+            tx.vout.resize(1);
+            tx.vout[0].nValue = COIN;
+            CWalletTx wtx(&wallet, MakeTransactionRef(std::move(tx)));
+            BOOST_CHECK(wallet.AddToWallet(wtx));
+            vHashes.push_back(wtx.GetHash());
+        }
+    }
+
+    CWallet wallet("wallet_ldb.dat");
+    bool fFirstRun;
+    BOOST_CHECK_EQUAL(wallet.LoadWallet(fFirstRun), DB_LOAD_OK);
+
+    LOCK(wallet.cs_wallet);
+    std::set<CKeyID> setKeysLoaded;
+    wallet.GetKeys(setKeysLoaded);
+    BOOST_CHECK(setKeysLoaded == setKeys);
+    BOOST_CHECK_EQUAL(wallet.GetKeyPoolSize(), nKeyPoolSize);
+    BOOST_CHECK_EQUAL(wallet.mapWallet.size(), vHashes.size());
+    for (const auto& hash : vHashes) {
+        BOOST_CHECK(wallet.mapWallet.count(hash));
+    }
+}
+
+// Conversions move files in the data directory, so they need real databases
+struct ConvertTestingSetup : public TestingSetup {
+    ~ConvertTestingSetup()
+    {
+        bitdb.Flush(true);
+        bitdb.Reset();
+        walletldb.Flush(true);
+        walletldb.Reset();
+        nWalletDBBackendNew = WALLETDB_BDB;
+        SetMockTime(0);
+    }
+};
+
+static void CheckWalletLoad(const std::string& strFile, const std::set<CKeyID>& setKeys, const std::vector<uint256>& vHashes)
+{
+    CWallet wallet(strFile);
+    bool fFirstRun;
+    BOOST_CHECK_EQUAL(wallet.LoadWallet(fFirstRun), DB_LOAD_OK);
+    BOOST_CHECK(!fFirstRun);
+
+    LOCK(wallet.cs_wallet);
+    std::set<CKeyID> setKeysLoaded;
+    wallet.GetKeys(setKeysLoaded);
+    BOOST_CHECK(setKeysLoaded == setKeys);
+    BOOST_CHECK_EQUAL(wallet.mapWallet.size(), vHashes.size());
+    for (const auto& hash : vHashes) {
+        BOOST_CHECK(wallet.mapWallet.count(hash));
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(convert_wallet, ConvertTestingSetup)
+{
+    const std::string strFile = "wallet_convert.dat";
+    std::set<CKeyID> setKeys;
+    std::vector<uint256> vHashes;
+    {
+        CWallet wallet(strFile);
+        bool fFirstRun;
+        BOOST_CHECK_EQUAL(wallet.LoadWallet(fFirstRun), DB_LOAD_OK);
+
+        LOCK2(cs_main, wallet.cs_wallet);
+        BOOST_CHECK(wallet.TopUpKeyPool(10));
+        wallet.GetKeys(setKeys);
+        for (int i = 0; i < 10; i++) {
+            CMutableTransaction tx;
+            tx.nLockTime = i;
+            tx.vout.resize(1);
+            tx.vout[0].nValue = COIN;
+            CWalletTx wtx(&wallet, MakeTransactionRef(std::move(tx)));
+            BOOST_CHECK(wallet.AddToWallet(wtx));
+            vHashes.push_back(wtx.GetHash());
+        }
+    }
+    BOOST_CHECK(GetWalletDBBackend(strFile) == WALLETDB_BDB);
+
+    // the backups are named after the time, keep them apart
+    SetMockTime(GetTime());
+    nWalletDBBackendNew = WALLETDB_LEVELDB;
+    BOOST_CHECK(CDB::Convert(strFile));
+    BOOST_CHECK(GetWalletDBBackend(strFile) == WALLETDB_LEVELDB);
+    CheckWalletLoad(strFile, setKeys, vHashes);
+
+    SetMockTime(GetTime() + 1);
+    nWalletDBBackendNew = WALLETDB_BDB;
+    BOOST_CHECK(CDB::Convert(strFile));
+    BOOST_CHECK(GetWalletDBBackend(strFile) == WALLETDB_BDB);
+    CheckWalletLoad(strFile, setKeys, vHashes);
+
+    // converting to the backend a wallet already uses does nothing
+    BOOST_CHECK(CDB::Convert(strFile));
+    CheckWalletLoad(strFile, setKeys, vHashes);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -12,8 +12,11 @@
 #include "checkpoints.h"
 #include "chain.h"
 #include "wallet/coincontrol.h"
+#include "wallet/coinselection.h"
+#include "wallet/ldb.h"
 #include "consensus/consensus.h"
 #include "consensus/validation.h"
+#include "ctpl.h"
 #include "key.h"
 #include "keystore.h"
 #include "validation.h"
@@ -23,6 +26,7 @@
 #include "primitives/transaction.h"
 #include "script/script.h"
 #include "script/sign.h"
+#include "script/standard.h"
 #include "timedata.h"
 #include "txmempool.h"
 #include "util.h"
@@ -38,6 +42,8 @@
 #include "evo/providertx.h"
 
 #include <assert.h>
+#include <deque>
+#include <future>
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/filesystem.hpp>
@@ -50,6 +56,7 @@ unsigned int nTxConfirmTarget = DEFAULT_TX_CONFIRM_TARGET;
 bool bSpendZeroConfChange = DEFAULT_SPEND_ZEROCONF_CHANGE;
 bool fSendFreeTransactions = DEFAULT_SEND_FREE_TRANSACTIONS;
 bool bBIP69Enabled = true;
+unsigned int nWalletDerivationMethod = WALLET_CRYPTO_DERIVATION_SHA512;
 
 const char * DEFAULT_WALLET_DAT = "wallet.dat";
 
@@ -72,15 +79,6 @@ const uint256 CMerkleTx::ABANDON_HASH(uint256S("00000000000000000000000000000000
  * @{
  */
 
-struct CompareValueOnly
-{
-    bool operator()(const std::pair<CAmount, std::pair<const CWalletTx*, unsigned int> >& t1,
-                    const std::pair<CAmount, std::pair<const CWalletTx*, unsigned int> >& t2) const
-    {
-        return t1.first < t2.first;
-    }
-};
-
 std::string COutput::ToString() const
 {
     return strprintf("COutput(%s, %d, %d) [%s]", tx->GetHash().ToString(), i, nDepth, FormatMoney(tx->tx->vout[i].nValue));
@@ -121,8 +119,10 @@ CPubKey CWallet::GenerateNewKey(uint32_t nAccountIndex, bool fInternal)
     CPubKey pubkey;
     // use HD key derivation if HD was enabled during wallet creation
     if (IsHDEnabled()) {
-        DeriveNewChildKey(metadata, secret, nAccountIndex, fInternal);
-        pubkey = secret.GetPubKey();
+        CWalletDB walletdb(strWalletFile);
+        std::vector<CPubKey> vecPubKeys;
+        DeriveNewChildKeys(walletdb, metadata, nAccountIndex, fInternal, 1, vecPubKeys);
+        pubkey = vecPubKeys[0];
     } else {
         secret.MakeNewKey(fCompressed);
 
@@ -143,44 +143,122 @@ CPubKey CWallet::GenerateNewKey(uint32_t nAccountIndex, bool fInternal)
     return pubkey;
 }
 
-void CWallet::DeriveNewChildKey(const CKeyMetadata& metadata, CKey& secretRet, uint32_t nAccountIndex, bool fInternal)
+void CWallet::GenerateNewKeys(CWalletDB& walletdb, uint32_t nAccountIndex, bool fInternal, size_t nCount, std::vector<CPubKey>& vecPubKeysRet)
 {
-    CHDChain hdChainTmp;
-    if (!GetHDChain(hdChainTmp)) {
-        throw std::runtime_error(std::string(__func__) + ": GetHDChain failed");
+    AssertLockHeld(cs_wallet);
+
+    vecPubKeysRet.clear();
+    if (nCount == 0)
+        return;
+
+    if (IsHDEnabled()) {
+        DeriveNewChildKeys(walletdb, CKeyMetadata(GetTime()), nAccountIndex, fInternal, nCount, vecPubKeysRet);
+    } else {
+        // random keys are cheap to generate, the cost is in writing them
+        while (vecPubKeysRet.size() < nCount)
+            vecPubKeysRet.push_back(GenerateNewKey(nAccountIndex, fInternal));
     }
+}
+
+CExtPubKey CWallet::GetHDChainExtPubKey(const CHDChain& hdChain, uint32_t nAccountIndex, bool fInternal)
+{
+    AssertLockHeld(cs_wallet);
 
+    if (hdChain.GetID() != hdChainIDCached) {
+        mapHdChainExtPubKeys.clear();
+        hdChainIDCached = hdChain.GetID();
+    }
+
+    std::pair<uint32_t, bool> key = std::make_pair(nAccountIndex, fInternal);
+    std::map<std::pair<uint32_t, bool>, CExtPubKey>::const_iterator it = mapHdChainExtPubKeys.find(key);
+    if (it != mapHdChainExtPubKeys.end())
+        return it->second;
+
+    CHDChain hdChainTmp(hdChain);
     if (!DecryptHDChain(hdChainTmp))
         throw std::runtime_error(std::string(__func__) + ": DecryptHDChainSeed failed");
     // make sure seed matches this chain
     if (hdChainTmp.GetID() != hdChainTmp.GetSeedHash())
         throw std::runtime_error(std::string(__func__) + ": Wrong HD chain!");
 
+    // keys of the chain itself are derived without hardening, their public
+    // parts follow from the public part of the chain key
+    CExtKey chainKey;
+    hdChainTmp.DeriveChainExtKey(nAccountIndex, fInternal, chainKey);
+    CExtPubKey chainPubKey = chainKey.Neuter();
+    mapHdChainExtPubKeys.emplace(key, chainPubKey);
+    return chainPubKey;
+}
+
+/** Don't bother with threads for less keys than this per thread */
+static const size_t MIN_HD_KEYS_PER_THREAD = 64;
+
+// Derive the children of chainPubKey from index nChildIndex on, one for every element of vecChildKeysRet
+static void DeriveChildExtPubKeys(const CExtPubKey& chainPubKey, uint32_t nChildIndex, std::vector<CExtPubKey>& vecChildKeysRet)
+{
+    auto deriveRange = [&chainPubKey, nChildIndex, &vecChildKeysRet](size_t nBegin, size_t nEnd) {
+        for (size_t i = nBegin; i < nEnd; i++) {
+            if (!chainPubKey.Derive(vecChildKeysRet[i], nChildIndex + i))
+                throw std::runtime_error("DeriveChildExtPubKeys: Derive failed");
+        }
+    };
+
+    size_t nThreads = std::min((size_t)std::max(GetNumCores(), 1), vecChildKeysRet.size() / MIN_HD_KEYS_PER_THREAD);
+    if (nThreads <= 1) {
+        deriveRange(0, vecChildKeysRet.size());
+        return;
+    }
+
+    ctpl::thread_pool pool(nThreads);
+    RenameThreadPool(pool, "blaze-hdderive");
+    std::vector<std::future<void> > vecFutures;
+    size_t nPerThread = (vecChildKeysRet.size() + nThreads - 1) / nThreads;
+    for (size_t nBegin = 0; nBegin < vecChildKeysRet.size(); nBegin += nPerThread) {
+        size_t nEnd = std::min(nBegin + nPerThread, vecChildKeysRet.size());
+        vecFutures.emplace_back(pool.push([&deriveRange, nBegin, nEnd](int) { deriveRange(nBegin, nEnd); }));
+    }
+    for (auto& f : vecFutures) {
+        f.get();
+    }
+}
+
+void CWallet::DeriveNewChildKeys(CWalletDB& walletdb, const CKeyMetadata& metadata, uint32_t nAccountIndex, bool fInternal, size_t nCount, std::vector<CPubKey>& vecPubKeysRet)
+{
+    AssertLockHeld(cs_wallet);
+
+    CHDChain hdChainCurrent;
+    if (!GetHDChain(hdChainCurrent))
+        throw std::runtime_error(std::string(__func__) + ": GetHDChain failed");
+
     CHDAccount acc;
-    if (!hdChainTmp.GetAccount(nAccountIndex, acc))
+    if (!hdChainCurrent.GetAccount(nAccountIndex, acc))
         throw std::runtime_error(std::string(__func__) + ": Wrong HD account!");
 
-    // derive child key at next index, skip keys already known to the wallet
-    CExtKey childKey;
+    CExtPubKey chainPubKey = GetHDChainExtPubKey(hdChainCurrent, nAccountIndex, fInternal);
+
+    // derive child keys at the next indexes, skip keys already known to the wallet
     uint32_t nChildIndex = fInternal ? acc.nInternalChainCounter : acc.nExternalChainCounter;
-    do {
-        hdChainTmp.DeriveChildExtKey(nAccountIndex, fInternal, nChildIndex, childKey);
-        // increment childkey index
-        nChildIndex++;
-    } while (HaveKey(childKey.key.GetPubKey().GetID()));
-    secretRet = childKey.key;
-
-    CPubKey pubkey = secretRet.GetPubKey();
-    assert(secretRet.VerifyPubKey(pubkey));
-
-    // store metadata
-    mapKeyMetadata[pubkey.GetID()] = metadata;
-    UpdateTimeFirstKey(metadata.nCreateTime);
+    vecPubKeysRet.clear();
+    while (vecPubKeysRet.size() < nCount) {
+        std::vector<CExtPubKey> vecChildKeys(nCount - vecPubKeysRet.size());
+        DeriveChildExtPubKeys(chainPubKey, nChildIndex, vecChildKeys);
+        nChildIndex += vecChildKeys.size();
+
+        for (const auto& childKey : vecChildKeys) {
+            CKeyID keyID = childKey.pubkey.GetID();
+            if (HaveKey(keyID))
+                continue;
 
-    // update the chain model in the database
-    CHDChain hdChainCurrent;
-    GetHDChain(hdChainCurrent);
+            // store metadata
+            mapKeyMetadata[keyID] = metadata;
+            if (!AddHDPubKeyWithDB(walletdb, childKey, fInternal))
+                throw std::runtime_error(std::string(__func__) + ": AddHDPubKey failed");
+            vecPubKeysRet.push_back(childKey.pubkey);
+        }
+    }
+    UpdateTimeFirstKey(metadata.nCreateTime);
 
+    // update the chain model in the database, once for all of the keys
     if (fInternal) {
         acc.nInternalChainCounter = nChildIndex;
     }
@@ -192,16 +270,13 @@ void CWallet::DeriveNewChildKey(const CKeyMetadata& metadata, CKey& secretRet, u
         throw std::runtime_error(std::string(__func__) + ": SetAccount failed");
 
     if (IsCrypted()) {
-        if (!SetCryptedHDChain(hdChainCurrent, false))
+        if (!SetCryptedHDChain(hdChainCurrent, true) || (fFileBacked && !walletdb.WriteCryptedHDChain(hdChainCurrent)))
             throw std::runtime_error(std::string(__func__) + ": SetCryptedHDChain failed");
     }
     else {
-        if (!SetHDChain(hdChainCurrent, false))
+        if (!SetHDChain(hdChainCurrent, true) || (fFileBacked && !walletdb.WriteHDChain(hdChainCurrent)))
             throw std::runtime_error(std::string(__func__) + ": SetHDChain failed");
     }
-
-    if (!AddHDPubKey(childKey.Neuter(), fInternal))
-        throw std::runtime_error(std::string(__func__) + ": AddHDPubKey failed");
 }
 
 bool CWallet::GetPubKey(const CKeyID &address, CPubKey& vchPubKeyOut) const
@@ -224,6 +299,9 @@ bool CWallet::GetKey(const CKeyID &address, CKey& keyOut) const
     std::map<CKeyID, CHDPubKey>::const_iterator mi = mapHdPubKeys.find(address);
     if (mi != mapHdPubKeys.end())
     {
+        if (GetCachedKey(address, keyOut))
+            return true;
+
         // if the key has been found in mapHdPubKeys, derive it on the fly
         const CHDPubKey &hdPubKey = (*mi).second;
         CHDChain hdChainCurrent;
@@ -238,6 +316,7 @@ bool CWallet::GetKey(const CKeyID &address, CKey& keyOut) const
         CExtKey extkey;
         hdChainCurrent.DeriveChildExtKey(hdPubKey.nAccountIndex, hdPubKey.nChangeIndex != 0, hdPubKey.extPubKey.nChild, extkey);
         keyOut = extkey.key;
+        CacheKey(address, keyOut);
 
         return true;
     }
@@ -263,6 +342,12 @@ bool CWallet::LoadHDPubKey(const CHDPubKey &hdPubKey)
 }
 
 bool CWallet::AddHDPubKey(const CExtPubKey &extPubKey, bool fInternal)
+{
+    CWalletDB walletdb(strWalletFile);
+    return AddHDPubKeyWithDB(walletdb, extPubKey, fInternal);
+}
+
+bool CWallet::AddHDPubKeyWithDB(CWalletDB& walletdb, const CExtPubKey& extPubKey, bool fInternal)
 {
     AssertLockHeld(cs_wallet);
 
@@ -279,15 +364,15 @@ bool CWallet::AddHDPubKey(const CExtPubKey &extPubKey, bool fInternal)
     CScript script;
     script = GetScriptForDestination(extPubKey.pubkey.GetID());
     if (HaveWatchOnly(script))
-        RemoveWatchOnly(script);
+        RemoveWatchOnlyWithDB(walletdb, script);
     script = GetScriptForRawPubKey(extPubKey.pubkey);
     if (HaveWatchOnly(script))
-        RemoveWatchOnly(script);
+        RemoveWatchOnlyWithDB(walletdb, script);
 
     if (!fFileBacked)
         return true;
 
-    return CWalletDB(strWalletFile).WriteHDPubKey(hdPubKey, mapKeyMetadata[extPubKey.pubkey.GetID()]);
+    return walletdb.WriteHDPubKey(hdPubKey, mapKeyMetadata[extPubKey.pubkey.GetID()]);
 }
 
 bool CWallet::AddKeyPubKey(const CKey& secret, const CPubKey &pubkey)
@@ -405,6 +490,12 @@ bool CWallet::AddWatchOnly(const CScript& dest, int64_t nCreateTime)
 }
 
 bool CWallet::RemoveWatchOnly(const CScript &dest)
+{
+    CWalletDB walletdb(strWalletFile);
+    return RemoveWatchOnlyWithDB(walletdb, dest);
+}
+
+bool CWallet::RemoveWatchOnlyWithDB(CWalletDB& walletdb, const CScript& dest)
 {
     AssertLockHeld(cs_wallet);
     if (!CCryptoKeyStore::RemoveWatchOnly(dest))
@@ -412,7 +503,7 @@ bool CWallet::RemoveWatchOnly(const CScript &dest)
     if (!HaveWatchOnly())
         NotifyWatchonlyChanged(false);
     if (fFileBacked)
-        if (!CWalletDB(strWalletFile).EraseWatchOnly(dest))
+        if (!walletdb.EraseWatchOnly(dest))
             return false;
 
     return true;
@@ -500,6 +591,9 @@ bool CWallet::ChangeWalletPassphrase(const SecureString& strOldWalletPassphrase,
                 return false;
             if (CCryptoKeyStore::Unlock(vMasterKey))
             {
+                // the new passphrase uses the configured key derivation
+                pMasterKey.second.nDerivationMethod = nWalletDerivationMethod;
+
                 int64_t nStartTime = GetTimeMillis();
                 crypter.SetKeyFromPassphrase(strNewWalletPassphrase, pMasterKey.second.vchSalt, pMasterKey.second.nDeriveIterations, pMasterKey.second.nDerivationMethod);
                 pMasterKey.second.nDeriveIterations = pMasterKey.second.nDeriveIterations * (100 / ((double)(GetTimeMillis() - nStartTime)));
@@ -511,7 +605,7 @@ bool CWallet::ChangeWalletPassphrase(const SecureString& strOldWalletPassphrase,
                 if (pMasterKey.second.nDeriveIterations < 25000)
                     pMasterKey.second.nDeriveIterations = 25000;
 
-                LogPrintf("Wallet passphrase changed to an nDeriveIterations of %i\n", pMasterKey.second.nDeriveIterations);
+                LogPrintf("Wallet passphrase changed to an nDeriveIterations of %i, nDerivationMethod %u\n", pMasterKey.second.nDeriveIterations, pMasterKey.second.nDerivationMethod);
 
                 if (!crypter.SetKeyFromPassphrase(strNewWalletPassphrase, pMasterKey.second.vchSalt, pMasterKey.second.nDeriveIterations, pMasterKey.second.nDerivationMethod))
                     return false;
@@ -611,6 +705,7 @@ std::set<uint256> CWallet::GetConflicts(const uint256& txid) const
 void CWallet::Flush(bool shutdown)
 {
     bitdb.Flush(shutdown);
+    walletldb.Flush(shutdown);
 }
 
 bool CWallet::Verify()
@@ -647,6 +742,22 @@ bool CWallet::Verify()
         }
     }
     
+    if (IsArgSet("-walletbackend"))
+    {
+        if (!ParseWalletDBBackend(GetArg("-walletbackend", ""), nWalletDBBackendNew))
+            return InitError(strprintf(_("Unknown wallet backend requested: %s"), GetArg("-walletbackend", "")));
+        if (boost::filesystem::exists(GetDataDir() / walletFile) && !CDB::Convert(walletFile))
+            return InitError(strprintf(_("Error converting %s to the %s backend"), walletFile, GetArg("-walletbackend", "")));
+    }
+
+    if (GetWalletDBBackend(walletFile) == WALLETDB_LEVELDB)
+    {
+        if (GetBoolArg("-salvagewallet", false))
+            return InitError(_("-salvagewallet is only supported for Berkeley DB wallets"));
+        LogPrintf("Using leveldb wallet backend\n");
+        return true;
+    }
+
     if (GetBoolArg("-salvagewallet", false))
     {
         // Recover readable keypairs:
@@ -735,13 +846,65 @@ bool CWallet::IsSpent(const uint256& hash, unsigned int n) const
 void CWallet::AddToSpends(const COutPoint& outpoint, const uint256& wtxid)
 {
     mapTxSpends.insert(std::make_pair(outpoint, wtxid));
-    setWalletUTXO.erase(outpoint);
+    EraseWalletUTXO(outpoint);
 
     std::pair<TxSpends::iterator, TxSpends::iterator> range;
     range = mapTxSpends.equal_range(outpoint);
     SyncMetaData(range);
 }
 
+// Index of the standard denomination nAmount is equal to, -1 if there is none
+static int GetDenominationIndex(CAmount nAmount)
+{
+    std::vector<CAmount> vecDenominations = CPrivateSend::GetStandardDenominations();
+    for (size_t i = 0; i < vecDenominations.size(); i++) {
+        if (nAmount == vecDenominations[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void CWallet::AddWalletUTXO(const COutPoint& outpoint, const CTxOut& txout)
+{
+    AssertLockHeld(cs_wallet);
+
+    if (!setWalletUTXO.insert(outpoint).second) return;
+
+    int nRounds = GetRealOutpointPrivateSendRounds(outpoint);
+    mapWalletUTXOBuckets[std::make_pair(GetDenominationIndex(txout.nValue), nRounds)].insert(outpoint);
+}
+
+void CWallet::EraseWalletUTXO(const COutPoint& outpoint)
+{
+    if (!setWalletUTXO.erase(outpoint)) return;
+
+    const CWalletTx* wtx = GetWalletTx(outpoint.hash);
+    if (wtx == NULL || outpoint.n >= wtx->tx->vout.size()) return;
+
+    // rounds were cached when the output was added, this finds the same bucket
+    auto it = mapWalletUTXOBuckets.find(std::make_pair(GetDenominationIndex(wtx->tx->vout[outpoint.n].nValue), GetRealOutpointPrivateSendRounds(outpoint)));
+    if (it == mapWalletUTXOBuckets.end()) return;
+
+    it->second.erase(outpoint);
+    if (it->second.empty()) {
+        mapWalletUTXOBuckets.erase(it);
+    }
+}
+
+void CWallet::UpdateWalletUTXO(const COutPoint& outpoint)
+{
+    AssertLockHeld(cs_wallet);
+
+    const CWalletTx* wtx = GetWalletTx(outpoint.hash);
+    if (wtx == NULL || outpoint.n >= wtx->tx->vout.size()) return;
+
+    if (IsMine(wtx->tx->vout[outpoint.n]) && !IsSpent(outpoint.hash, outpoint.n)) {
+        AddWalletUTXO(outpoint, wtx->tx->vout[outpoint.n]);
+    } else {
+        EraseWalletUTXO(outpoint);
+    }
+}
 
 void CWallet::AddToSpends(const uint256& wtxid)
 {
@@ -765,6 +928,7 @@ bool CWallet::EncryptWallet(const SecureString& strWalletPassphrase)
     GetStrongRandBytes(&vMasterKey[0], WALLET_CRYPTO_KEY_SIZE);
 
     CMasterKey kMasterKey;
+    kMasterKey.nDerivationMethod = nWalletDerivationMethod;
 
     kMasterKey.vchSalt.resize(WALLET_CRYPTO_SALT_SIZE);
     GetStrongRandBytes(&kMasterKey.vchSalt[0], WALLET_CRYPTO_SALT_SIZE);
@@ -781,7 +945,7 @@ bool CWallet::EncryptWallet(const SecureString& strWalletPassphrase)
     if (kMasterKey.nDeriveIterations < 25000)
         kMasterKey.nDeriveIterations = 25000;
 
-    LogPrintf("Encrypting Wallet with an nDeriveIterations of %i\n", kMasterKey.nDeriveIterations);
+    LogPrintf("Encrypting Wallet with an nDeriveIterations of %i, nDerivationMethod %u\n", kMasterKey.nDeriveIterations, kMasterKey.nDerivationMethod);
 
     if (!crypter.SetKeyFromPassphrase(strWalletPassphrase, kMasterKey.vchSalt, kMasterKey.nDeriveIterations, kMasterKey.nDerivationMethod))
         return false;
@@ -1056,6 +1220,7 @@ void CWallet::MarkDirty()
 
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
+    fBalancesCached = false;
 }
 
 bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
@@ -1125,7 +1290,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
 
         for(unsigned int i = 0; i < wtx.tx->vout.size(); ++i) {
             if (IsMine(wtx.tx->vout[i]) && !IsSpent(hash, i)) {
-                setWalletUTXO.insert(COutPoint(hash, i));
+                AddWalletUTXO(COutPoint(hash, i), wtx.tx->vout[i]);
                 if (deterministicMNManager->IsProTxWithCollateral(wtx.tx, i) || deterministicMNManager->HasMNCollateralAtChainTip(COutPoint(hash, i))) {
                     LockCoin(COutPoint(hash, i));
                 }
@@ -1158,6 +1323,13 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
             wtx.fFromMe = wtxIn.fFromMe;
             fUpdated = true;
         }
+
+        // The transaction might spend again what it didn't while abandoned or
+        // conflicted, and keys might have been imported since it was added
+        for (const auto& txin : wtx.tx->vin)
+            UpdateWalletUTXO(txin.prevout);
+        for (unsigned int i = 0; i < wtx.tx->vout.size(); ++i)
+            UpdateWalletUTXO(COutPoint(hash, i));
     }
 
     //// debug print
@@ -1185,6 +1357,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
 
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
+    fBalancesCached = false;
 
     return true;
 }
@@ -1307,12 +1480,14 @@ bool CWallet::AbandonTransaction(const uint256& hashTx)
             {
                 if (mapWallet.count(txin.prevout.hash))
                     mapWallet[txin.prevout.hash].MarkDirty();
+                UpdateWalletUTXO(txin.prevout);
             }
         }
     }
 
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
+    fBalancesCached = false;
 
     return true;
 }
@@ -1371,12 +1546,14 @@ void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
             {
                 if (mapWallet.count(txin.prevout.hash))
                     mapWallet[txin.prevout.hash].MarkDirty();
+                UpdateWalletUTXO(txin.prevout);
             }
         }
     }
 
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
+    fBalancesCached = false;
 }
 
 void CWallet::SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex, int posInBlock)
@@ -1397,6 +1574,7 @@ void CWallet::SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex,
 
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
+    fBalancesCached = false;
 }
 
 
@@ -1436,83 +1614,71 @@ CAmount CWallet::GetDebit(const CTxIn &txin, const isminefilter& filter) const
 // Recursively determine the rounds of a given input (How deep is the PrivateSend chain for a given input)
 int CWallet::GetRealOutpointPrivateSendRounds(const COutPoint& outpoint, int nRounds) const
 {
-    static std::map<uint256, CMutableTransaction> mDenomWtxes;
+    LOCK(cs_wallet);
 
     if(nRounds >= MAX_PRIVATESEND_ROUNDS) {
         // there can only be MAX_PRIVATESEND_ROUNDS rounds max
         return MAX_PRIVATESEND_ROUNDS - 1;
     }
 
-    uint256 hash = outpoint.hash;
-    unsigned int nout = outpoint.n;
-
-    const CWalletTx* wtx = GetWalletTx(hash);
-    if(wtx != NULL)
-    {
-        std::map<uint256, CMutableTransaction>::const_iterator mdwi = mDenomWtxes.find(hash);
-        if (mdwi == mDenomWtxes.end()) {
-            // not known yet, let's add it
-            LogPrint("privatesend", "GetRealOutpointPrivateSendRounds INSERTING %s\n", hash.ToString());
-            mDenomWtxes[hash] = CMutableTransaction(*wtx);
-        } else if(mDenomWtxes[hash].vout[nout].nRounds != -10) {
-            // found and it's not an initial value, just return it
-            return mDenomWtxes[hash].vout[nout].nRounds;
-        }
+    std::map<COutPoint, int>::const_iterator mri = mapOutpointRounds.find(outpoint);
+    if (mri != mapOutpointRounds.end()) {
+        // found, just return it
+        return mri->second;
+    }
 
+    const CWalletTx* wtx = GetWalletTx(outpoint.hash);
+    if (wtx == NULL) {
+        return nRounds - 1;
+    }
 
-        // bounds check
-        if (nout >= wtx->tx->vout.size()) {
-            // should never actually hit this
-            LogPrint("privatesend", "GetRealOutpointPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, -4);
-            return -4;
-        }
+    unsigned int nout = outpoint.n;
 
-        if (CPrivateSend::IsCollateralAmount(wtx->tx->vout[nout].nValue)) {
-            mDenomWtxes[hash].vout[nout].nRounds = -3;
-            LogPrint("privatesend", "GetRealOutpointPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-            return mDenomWtxes[hash].vout[nout].nRounds;
-        }
+    // bounds check
+    if (nout >= wtx->tx->vout.size()) {
+        // should never actually hit this
+        LogPrint("privatesend", "GetRealOutpointPrivateSendRounds UPDATED   %s %3d %3d\n", outpoint.hash.ToString(), nout, -4);
+        return -4;
+    }
 
+    int nRoundsRet;
+    if (CPrivateSend::IsCollateralAmount(wtx->tx->vout[nout].nValue)) {
+        nRoundsRet = -3;
+    } else if (!CPrivateSend::IsDenominatedAmount(wtx->tx->vout[nout].nValue)) {
         //make sure the final output is non-denominate
-        if (!CPrivateSend::IsDenominatedAmount(wtx->tx->vout[nout].nValue)) { //NOT DENOM
-            mDenomWtxes[hash].vout[nout].nRounds = -2;
-            LogPrint("privatesend", "GetRealOutpointPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-            return mDenomWtxes[hash].vout[nout].nRounds;
-        }
-
+        nRoundsRet = -2;
+    } else {
         bool fAllDenoms = true;
         for (const auto& out : wtx->tx->vout) {
             fAllDenoms = fAllDenoms && CPrivateSend::IsDenominatedAmount(out.nValue);
         }
 
-        // this one is denominated but there is another non-denominated output found in the same tx
         if (!fAllDenoms) {
-            mDenomWtxes[hash].vout[nout].nRounds = 0;
-            LogPrint("privatesend", "GetRealOutpointPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-            return mDenomWtxes[hash].vout[nout].nRounds;
-        }
-
-        int nShortest = -10; // an initial value, should be no way to get this by calculations
-        bool fDenomFound = false;
-        // only denoms here so let's look up
-        for (const auto& txinNext : wtx->tx->vin) {
-            if (IsMine(txinNext)) {
-                int n = GetRealOutpointPrivateSendRounds(txinNext.prevout, nRounds + 1);
-                // denom found, find the shortest chain or initially assign nShortest with the first found value
-                if(n >= 0 && (n < nShortest || nShortest == -10)) {
-                    nShortest = n;
-                    fDenomFound = true;
+            // this one is denominated but there is another non-denominated output found in the same tx
+            nRoundsRet = 0;
+        } else {
+            int nShortest = -10; // an initial value, should be no way to get this by calculations
+            bool fDenomFound = false;
+            // only denoms here so let's look up
+            for (const auto& txinNext : wtx->tx->vin) {
+                if (IsMine(txinNext)) {
+                    int n = GetRealOutpointPrivateSendRounds(txinNext.prevout, nRounds + 1);
+                    // denom found, find the shortest chain or initially assign nShortest with the first found value
+                    if(n >= 0 && (n < nShortest || nShortest == -10)) {
+                        nShortest = n;
+                        fDenomFound = true;
+                    }
                 }
             }
+            nRoundsRet = fDenomFound
+                    ? (nShortest >= MAX_PRIVATESEND_ROUNDS - 1 ? MAX_PRIVATESEND_ROUNDS : nShortest + 1) // good, we a +1 to the shortest one but only MAX_PRIVATESEND_ROUNDS rounds max allowed
+                    : 0;            // too bad, we are the fist one in that chain
         }
-        mDenomWtxes[hash].vout[nout].nRounds = fDenomFound
-                ? (nShortest >= MAX_PRIVATESEND_ROUNDS - 1 ? MAX_PRIVATESEND_ROUNDS : nShortest + 1) // good, we a +1 to the shortest one but only MAX_PRIVATESEND_ROUNDS rounds max allowed
-                : 0;            // too bad, we are the fist one in that chain
-        LogPrint("privatesend", "GetRealOutpointPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-        return mDenomWtxes[hash].vout[nout].nRounds;
     }
 
-    return nRounds - 1;
+    mapOutpointRounds.emplace(outpoint, nRoundsRet);
+    LogPrint("privatesend", "GetRealOutpointPrivateSendRounds UPDATED   %s %3d %3d\n", outpoint.hash.ToString(), nout, nRoundsRet);
+    return nRoundsRet;
 }
 
 // respect current settings
@@ -1884,60 +2050,260 @@ void CWalletTx::GetAccountAmounts(const std::string& strAccount, CAmount& nRecei
     }
 }
 
+bool CWalletScanFilter::IsRelevant(const CTxOut& txout) const
+{
+    std::vector<std::vector<unsigned char> > vSolutions;
+    txnouttype whichType;
+    if (Solver(txout.scriptPubKey, whichType, vSolutions)) {
+        switch (whichType) {
+        case TX_PUBKEY:
+            if (setIds.count(CPubKey(vSolutions[0]).GetID()))
+                return true;
+            break;
+        case TX_PUBKEYHASH:
+        case TX_SCRIPTHASH:
+            if (setIds.count(uint160(vSolutions[0])))
+                return true;
+            break;
+        case TX_MULTISIG:
+            // bare multisig needs all of the keys, any one of them is reason enough to take a closer look
+            for (size_t i = 1; i + 1 < vSolutions.size(); i++) {
+                if (setIds.count(CPubKey(vSolutions[i]).GetID()))
+                    return true;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    return setWatchOnly.count(txout.scriptPubKey) != 0;
+}
+
+void CWallet::GetScanFilter(CWalletScanFilter& filter) const
+{
+    AssertLockHeld(cs_wallet);
+
+    std::set<CKeyID> setKeys;
+    GetKeys(setKeys);
+    for (const auto& keyid : setKeys)
+        filter.AddId(keyid);
+    for (const auto& pair : mapHdPubKeys)
+        filter.AddId(pair.first);
+
+    LOCK(cs_KeyStore);
+    for (const auto& pair : mapWatchKeys)
+        filter.AddId(pair.first);
+    for (const auto& pair : mapScripts)
+        filter.AddId(pair.first);
+    for (const auto& script : setWatchOnly)
+        filter.AddWatchOnly(script);
+}
+
+/** A block read by one of the rescan threads */
+struct CRescanBlock
+{
+    bool fRead;
+    CBlock block;
+    //! Which of the transactions have outputs the wallet might own
+    std::vector<bool> vRelevant;
+};
+
+/**
+ * The block a rescan continues with when pindex was disconnected while the
+ * scan was at it: the first one of the active chain after the fork.
+ */
+static CBlockIndex* RescanNextAfterFork(const CBlockIndex* pindex)
+{
+    AssertLockHeld(cs_main);
+    const CBlockIndex* pindexFork = chainActive.FindFork(pindex);
+    return pindexFork ? chainActive.Next(pindexFork) : chainActive.Genesis();
+}
+
+static CRescanBlock ReadRescanBlock(const CBlockIndex* pindex, const CWalletScanFilter& filter)
+{
+    CRescanBlock rescanBlock;
+    rescanBlock.fRead = ReadBlockFromDisk(rescanBlock.block, pindex, Params().GetConsensus());
+    if (rescanBlock.fRead) {
+        rescanBlock.vRelevant.reserve(rescanBlock.block.vtx.size());
+        for (const auto& tx : rescanBlock.block.vtx) {
+            bool fRelevant = false;
+            for (const auto& txout : tx->vout) {
+                if (filter.IsRelevant(txout)) {
+                    fRelevant = true;
+                    break;
+                }
+            }
+            rescanBlock.vRelevant.push_back(fRelevant);
+        }
+    }
+    return rescanBlock;
+}
+
 /**
  * Scan the block chain (starting in pindexStart) for transactions
  * from or to us. If fUpdate is true, found transactions that already
  * exist in the wallet will be updated.
  *
+ * Blocks are read and matched against the keys of the wallet on
+ * -rescanthreads threads without holding any locks, only the transactions
+ * which might involve the wallet are added under cs_wallet, in chain order.
+ * Blocks which a reorg takes out of the active chain meanwhile are skipped,
+ * the scan goes on with the new chain from the fork.
+ * The scan can be stopped with AbortRescan(), the caller has to reserve it
+ * with a CWalletRescanReserver first.
+ *
  * Returns pointer to the first block in the last contiguous range that was
- * successfully scanned.
+ * successfully scanned. If pResult is given it is set to whether the scan
+ * reached the tip, stopped at blocks it couldn't read or was aborted.
  *
  */
-CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
+CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, const CWalletRescanReserver& reserver, bool fUpdate, ScanResult* pResult)
 {
     CBlockIndex* ret = nullptr;
+    ScanResult result = SCAN_SUCCESS;
     int64_t nNow = GetTime();
     const CChainParams& chainParams = Params();
 
+    assert(reserver.IsReserved());
+
+    // Outputs are matched against a snapshot of the keys, keys added while
+    // scanning were either in the keypool already or come with a rescan of
+    // their own. Inputs are matched against the transactions and spends of
+    // the wallet, which grow with every transaction the scan adds.
+    CWalletScanFilter filter;
+    std::unordered_set<uint256> setTxids;
+    std::unordered_set<COutPoint, SaltedOutpointHasher> setSpent;
+
     CBlockIndex* pindex = pindexStart;
+    double dProgressStart;
+    double dProgressTip;
     {
         LOCK2(cs_main, cs_wallet);
 
         // no need to read and scan block, if block was created before
         // our wallet birthday (as adjusted for block time variability)
         while (pindex && nTimeFirstKey && (pindex->GetBlockTime() < (nTimeFirstKey - 7200)))
-            pindex = chainActive.Next(pindex);
+            pindex = chainActive.Contains(pindex) ? chainActive.Next(pindex) : RescanNextAfterFork(pindex);
+
+        GetScanFilter(filter);
+        for (const auto& pair : mapWallet)
+            setTxids.insert(pair.first);
+        for (const auto& pair : mapTxSpends)
+            setSpent.insert(pair.first);
+
+        dProgressStart = GuessVerificationProgress(chainParams.TxData(), pindex);
+        dProgressTip = GuessVerificationProgress(chainParams.TxData(), chainActive.Tip());
+    }
+
+    ShowProgress(_("Rescanning..."), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
+
+    int nThreads = std::max(1, std::min((int)GetArg("-rescanthreads", DEFAULT_RESCAN_THREADS), MAX_RESCAN_THREADS));
+    ctpl::thread_pool pool(nThreads);
+    RenameThreadPool(pool, "blaze-rescan");
 
-        ShowProgress(_("Rescanning..."), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
-        double dProgressStart = GuessVerificationProgress(chainParams.TxData(), pindex);
-        double dProgressTip = GuessVerificationProgress(chainParams.TxData(), chainActive.Tip());
-        while (pindex)
+    // a few blocks per thread are read ahead of the one being added to the wallet
+    const size_t nMaxReadAhead = nThreads * 4;
+    std::deque<std::pair<CBlockIndex*, std::future<CRescanBlock> > > dequeReading;
+
+    while (pindex || !dequeReading.empty())
+    {
+        if (fAbortRescan) {
+            LogPrintf("Rescan aborted at block %d.\n", dequeReading.empty() ? pindex->nHeight : dequeReading.front().first->nHeight);
+            result = SCAN_ABORTED;
+            break;
+        }
+
+        while (pindex && dequeReading.size() < nMaxReadAhead) {
+            const CBlockIndex* pindexRead = pindex;
+            dequeReading.emplace_back(pindex, pool.push([pindexRead, &filter](int) {
+                return ReadRescanBlock(pindexRead, filter);
+            }));
+            LOCK(cs_main);
+            pindex = chainActive.Contains(pindex) ? chainActive.Next(pindex) : RescanNextAfterFork(pindex);
+        }
+
+        CBlockIndex* pindexScan = dequeReading.front().first;
+        CRescanBlock rescanBlock = dequeReading.front().second.get();
+        dequeReading.pop_front();
+
+        if (pindexScan->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
+            ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((GuessVerificationProgress(chainParams.TxData(), pindexScan) - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
+        if (GetTime() >= nNow + 60) {
+            nNow = GetTime();
+            LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindexScan->nHeight, GuessVerificationProgress(chainParams.TxData(), pindexScan));
+        }
+
+        if (!rescanBlock.fRead) {
+            ret = nullptr;
+            result = SCAN_FAILURE;
+            continue;
+        }
+
+        bool fDisconnected;
         {
-            if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
-                ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((GuessVerificationProgress(chainParams.TxData(), pindex) - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
-            if (GetTime() >= nNow + 60) {
-                nNow = GetTime();
-                LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight, GuessVerificationProgress(chainParams.TxData(), pindex));
+            LOCK(cs_main);
+            fDisconnected = !chainActive.Contains(pindexScan);
+        }
+        for (size_t posInBlock = 0; posInBlock < rescanBlock.block.vtx.size() && !fDisconnected; ++posInBlock) {
+            const CTransaction& tx = *rescanBlock.block.vtx[posInBlock];
+            bool fRelevant = rescanBlock.vRelevant[posInBlock] || setTxids.count(tx.GetHash());
+            for (size_t i = 0; i < tx.vin.size() && !fRelevant; i++) {
+                fRelevant = setTxids.count(tx.vin[i].prevout.hash) || setSpent.count(tx.vin[i].prevout);
             }
+            if (!fRelevant)
+                continue;
 
-            CBlock block;
-            if (ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
-                for (size_t posInBlock = 0; posInBlock < block.vtx.size(); ++posInBlock) {
-                    AddToWalletIfInvolvingMe(*block.vtx[posInBlock], pindex, posInBlock, fUpdate);
-                }
-                if (!ret) {
-                    ret = pindex;
-                }
-            } else {
-                ret = nullptr;
+            LOCK2(cs_main, cs_wallet);
+            // don't mark the transaction as coming from a block that was just disconnected
+            if (!chainActive.Contains(pindexScan)) {
+                fDisconnected = true;
+                break;
+            }
+            if (AddToWalletIfInvolvingMe(tx, pindexScan, posInBlock, fUpdate)) {
+                setTxids.insert(tx.GetHash());
+                for (const auto& txin : tx.vin)
+                    setSpent.insert(txin.prevout);
             }
-            pindex = chainActive.Next(pindex);
         }
-        ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
+        if (fDisconnected) {
+            // The blocks read after this one are on the same stale branch or
+            // were queued after a fork further down, read them again from the
+            // fork. Transactions added from the stale branch so far are like
+            // those of any other disconnected block.
+            LOCK(cs_main);
+            LogPrintf("Rescan: block %s at height %d left the active chain, continuing after the fork\n", pindexScan->GetBlockHash().ToString(), pindexScan->nHeight);
+            dequeReading.clear();
+            pindex = RescanNextAfterFork(pindexScan);
+            if (ret && !chainActive.Contains(ret))
+                ret = nullptr;
+            continue;
+        }
+        if (!ret) {
+            ret = pindexScan;
+        }
     }
+
+    // let the threads finish the blocks they are on before the filter goes away
+    pool.stop(true);
+    ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
+    if (pResult)
+        *pResult = result;
     return ret;
 }
 
+bool CWalletRescanReserver::Reserve()
+{
+    assert(!fReserved);
+    bool fScanning = false;
+    if (!pwallet->fScanningWallet.compare_exchange_strong(fScanning, true))
+        return false;
+    // an abort of the previous rescan must not stop this one, one for this
+    // rescan is kept from now on even if it comes before the scan starts
+    pwallet->fAbortRescan = false;
+    fReserved = true;
+    return true;
+}
+
 void CWallet::ReacceptWalletTransactions()
 {
     // If transactions aren't being broadcasted, don't let them into local mempool either
@@ -2359,20 +2725,65 @@ void CWallet::ResendWalletTransactions(int64_t nBestBlockTime, CConnman* connman
  */
 
 
-CAmount CWallet::GetBalance() const
+const CWallet::CWalletBalances& CWallet::GetBalances() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableCredit();
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+
+    // Depths, maturity and mempool presence of all transactions may change with
+    // the tip and the mempool, everything else resets fBalancesCached
+    uint256 hashTip = chainActive.Tip() ? chainActive.Tip()->GetBlockHash() : uint256();
+    unsigned int nMempoolUpdated = mempool.GetTransactionsUpdated();
+    if (fBalancesCached && hashBalancesTip == hashTip && nBalancesMempoolUpdated == nMempoolUpdated &&
+            nBalancesPrivateSendRounds == privateSendClient.nPrivateSendRounds)
+        return cachedBalances;
+
+    CWalletBalances balances;
+
+    // Transactions without unspent outputs have nothing to add, and the outputs
+    // of a transaction are next to each other in setWalletUTXO
+    const CWalletTx* pcoinLast = NULL;
+    for (const auto& outpoint : setWalletUTXO) {
+        if (pcoinLast && pcoinLast->GetHash() == outpoint.hash)
+            continue;
+
+        std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash);
+        if (it == mapWallet.end())
+            continue;
+        const CWalletTx* pcoin = &it->second;
+        pcoinLast = pcoin;
+
+        bool fTrusted = pcoin->IsTrusted();
+        if (fTrusted) {
+            balances.nTrusted += pcoin->GetAvailableCredit();
+            balances.nWatchOnlyTrusted += pcoin->GetAvailableWatchOnlyCredit();
+        } else if (pcoin->GetDepthInMainChain() == 0 && !pcoin->IsLockedByInstantSend() && pcoin->InMempool()) {
+            balances.nUntrustedPending += pcoin->GetAvailableCredit();
+            balances.nWatchOnlyUntrustedPending += pcoin->GetAvailableWatchOnlyCredit();
+        }
+        balances.nImmature += pcoin->GetImmatureCredit();
+        balances.nWatchOnlyImmature += pcoin->GetImmatureWatchOnlyCredit();
+
+        if (!fLiteMode) {
+            if (fTrusted)
+                balances.nAnonymized += pcoin->GetAnonymizedCredit();
+            balances.nDenominatedConfirmed += pcoin->GetDenominatedCredit(false);
+            balances.nDenominatedUnconfirmed += pcoin->GetDenominatedCredit(true);
         }
     }
 
-    return nTotal;
+    cachedBalances = balances;
+    hashBalancesTip = hashTip;
+    nBalancesMempoolUpdated = nMempoolUpdated;
+    nBalancesPrivateSendRounds = privateSendClient.nPrivateSendRounds;
+    fBalancesCached = true;
+    return cachedBalances;
+}
+
+CAmount CWallet::GetBalance() const
+{
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nTrusted;
 }
 
 CAmount CWallet::GetAnonymizableBalance(bool fSkipDenominated, bool fSkipUnconfirmed) const
@@ -2401,23 +2812,8 @@ CAmount CWallet::GetAnonymizedBalance() const
 {
     if(fLiteMode) return 0;
 
-    CAmount nTotal = 0;
-
     LOCK2(cs_main, cs_wallet);
-
-    std::set<uint256> setWalletTxesCounted;
-    for (const auto& outpoint : setWalletUTXO) {
-
-        if (setWalletTxesCounted.find(outpoint.hash) != setWalletTxesCounted.end()) continue;
-        setWalletTxesCounted.insert(outpoint.hash);
-
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash); it != mapWallet.end() && it->first == outpoint.hash; ++it) {
-            if (it->second.IsTrusted())
-                nTotal += it->second.GetAnonymizedCredit();
-        }
-    }
-
-    return nTotal;
+    return GetBalances().nAnonymized;
 }
 
 // Note: calculated including unconfirmed,
@@ -2430,11 +2826,11 @@ float CWallet::GetAverageAnonymizedRounds() const
     int nCount = 0;
 
     LOCK2(cs_main, cs_wallet);
-    for (const auto& outpoint : setWalletUTXO) {
-        if(!IsDenominated(outpoint)) continue;
+    for (const auto& bucket : mapWalletUTXOBuckets) {
+        if (bucket.first.first == -1) continue; // not denominated
 
-        nTotal += GetCappedOutpointPrivateSendRounds(outpoint);
-        nCount++;
+        nTotal += std::min(bucket.first.second, privateSendClient.nPrivateSendRounds) * (int)bucket.second.size();
+        nCount += bucket.second.size();
     }
 
     if(nCount == 0) return 0;
@@ -2451,14 +2847,17 @@ CAmount CWallet::GetNormalizedAnonymizedBalance() const
     CAmount nTotal = 0;
 
     LOCK2(cs_main, cs_wallet);
-    for (const auto& outpoint : setWalletUTXO) {
-        std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash);
-        if (it == mapWallet.end()) continue;
-        if (!IsDenominated(outpoint)) continue;
-        if (it->second.GetDepthInMainChain() < 0) continue;
+    for (const auto& bucket : mapWalletUTXOBuckets) {
+        if (bucket.first.first == -1) continue; // not denominated
+
+        int nRounds = std::min(bucket.first.second, privateSendClient.nPrivateSendRounds);
+        for (const auto& outpoint : bucket.second) {
+            std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash);
+            if (it == mapWallet.end()) continue;
+            if (it->second.GetDepthInMainChain() < 0) continue;
 
-        int nRounds = GetCappedOutpointPrivateSendRounds(outpoint);
-        nTotal += it->second.tx->vout[outpoint.n].nValue * nRounds / privateSendClient.nPrivateSendRounds;
+            nTotal += it->second.tx->vout[outpoint.n].nValue * nRounds / privateSendClient.nPrivateSendRounds;
+        }
     }
 
     return nTotal;
@@ -2492,201 +2891,115 @@ CAmount CWallet::GetDenominatedBalance(bool unconfirmed) const
 {
     if(fLiteMode) return 0;
 
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-
-            nTotal += pcoin->GetDenominatedCredit(unconfirmed);
-        }
-    }
-
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return unconfirmed ? GetBalances().nDenominatedUnconfirmed : GetBalances().nDenominatedConfirmed;
 }
 
 CAmount CWallet::GetUnconfirmedBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && !pcoin->IsLockedByInstantSend() && pcoin->InMempool())
-                nTotal += pcoin->GetAvailableCredit();
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nUntrustedPending;
 }
 
 CAmount CWallet::GetImmatureBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureCredit();
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nImmature;
 }
 
 CAmount CWallet::GetWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nWatchOnlyTrusted;
 }
 
 CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && !pcoin->IsLockedByInstantSend() && pcoin->InMempool())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nWatchOnlyUntrustedPending;
 }
 
 CAmount CWallet::GetImmatureWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nWatchOnlyImmature;
 }
 
-void CWallet::AvailableCoins(std::vector<COutput>& vCoins, bool fOnlyConfirmed, const CCoinControl *coinControl, bool fIncludeZeroValue, AvailableCoinsType nCoinType, bool fUseInstantSend) const
+// Checks AvailableCoins applies to a wallet transaction before looking at its outputs
+static bool IsAvailableWalletTx(const CWalletTx& wtx, bool fOnlyConfirmed, int& nDepthRet)
 {
-    vCoins.clear();
-
-    {
-        LOCK2(cs_main, cs_wallet);
-        int nInstantSendConfirmationsRequired = Params().GetConsensus().nInstantSendConfirmationsRequired;
-
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const uint256& wtxid = it->first;
-            const CWalletTx* pcoin = &(*it).second;
-
-            if (!CheckFinalTx(*pcoin))
-                continue;
+    if (!CheckFinalTx(wtx))
+        return false;
 
-            if (fOnlyConfirmed && !pcoin->IsTrusted())
-                continue;
+    if (fOnlyConfirmed && !wtx.IsTrusted())
+        return false;
 
-            if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0)
-                continue;
+    if (wtx.IsCoinBase() && wtx.GetBlocksToMaturity() > 0)
+        return false;
 
-            int nDepth = pcoin->GetDepthInMainChain();
-            // do not use IX for inputs that have less then nInstantSendConfirmationsRequired blockchain confirmations
-            if (fUseInstantSend && nDepth < nInstantSendConfirmationsRequired)
-                continue;
+    nDepthRet = wtx.GetDepthInMainChain();
 
-            // We should not consider coins which aren't at least in our mempool
-            // It's possible for these to be conflicted via ancestors which we may never be able to detect
-            if (nDepth == 0 && !pcoin->InMempool())
-                continue;
+    // We should not consider coins which aren't at least in our mempool
+    // It's possible for these to be conflicted via ancestors which we may never be able to detect
+    if (nDepthRet == 0 && !wtx.InMempool())
+        return false;
 
-            for (unsigned int i = 0; i < pcoin->tx->vout.size(); i++) {
-                bool found = false;
-                if(nCoinType == ONLY_DENOMINATED) {
-                    found = CPrivateSend::IsDenominatedAmount(pcoin->tx->vout[i].nValue);
-                } else if(nCoinType == ONLY_NONDENOMINATED) {
-                    if (CPrivateSend::IsCollateralAmount(pcoin->tx->vout[i].nValue)) continue; // do not use collateral amounts
-                    found = !CPrivateSend::IsDenominatedAmount(pcoin->tx->vout[i].nValue);
-                } else if(nCoinType == ONLY_MASTERNODE) {
-                    found = pcoin->tx->vout[i].nValue == MASTERNODE_COLLATERAL * COIN;
-                } else if(nCoinType == ONLY_PRIVATESEND_COLLATERAL) {
-                    found = CPrivateSend::IsCollateralAmount(pcoin->tx->vout[i].nValue);
-                } else {
-                    found = true;
-                }
-                if(!found) continue;
-
-                isminetype mine = IsMine(pcoin->tx->vout[i]);
-                if (!(IsSpent(wtxid, i)) && mine != ISMINE_NO &&
-                    (!IsLockedCoin((*it).first, i) || nCoinType == ONLY_MASTERNODE) &&
-                    (pcoin->tx->vout[i].nValue > 0 || fIncludeZeroValue) &&
-                    (!coinControl || !coinControl->HasSelected() || coinControl->fAllowOtherInputs || coinControl->IsSelected(COutPoint((*it).first, i))))
-                        vCoins.push_back(COutput(pcoin, i, nDepth,
-                                                 ((mine & ISMINE_SPENDABLE) != ISMINE_NO) ||
-                                                  (coinControl && coinControl->fAllowWatchOnly && (mine & ISMINE_WATCH_SOLVABLE) != ISMINE_NO),
-                                                 (mine & (ISMINE_SPENDABLE | ISMINE_WATCH_SOLVABLE)) != ISMINE_NO));
-            }
-        }
-    }
+    return true;
 }
 
-static void ApproximateBestSubset(std::vector<std::pair<CAmount, std::pair<const CWalletTx*,unsigned int> > >vValue, const CAmount& nTotalLower, const CAmount& nTargetValue,
-                                  std::vector<char>& vfBest, CAmount& nBest, bool fUseInstantSend = false, int iterations = 1000)
+void CWallet::AvailableCoins(std::vector<COutput>& vCoins, bool fOnlyConfirmed, const CCoinControl *coinControl, bool fIncludeZeroValue, AvailableCoinsType nCoinType, bool fUseInstantSend) const
 {
-    std::vector<char> vfIncluded;
-
-    vfBest.assign(vValue.size(), true);
-    nBest = nTotalLower;
-
-    FastRandomContext insecure_rand;
+    vCoins.clear();
 
-    for (int nRep = 0; nRep < iterations && nBest != nTargetValue; nRep++)
     {
-        vfIncluded.assign(vValue.size(), false);
-        CAmount nTotal = 0;
-        bool fReachedTarget = false;
-        for (int nPass = 0; nPass < 2 && !fReachedTarget; nPass++)
+        LOCK2(cs_main, cs_wallet);
+        int nInstantSendConfirmationsRequired = Params().GetConsensus().nInstantSendConfirmationsRequired;
+
+        // Only unspent outputs can be available, setWalletUTXO has them in the
+        // order of mapWallet with the outputs of a transaction next to each other
+        const CWalletTx* pcoin = NULL;
+        bool fAvailable = false;
+        int nDepth = 0;
+        for (const auto& outpoint : setWalletUTXO)
         {
-            for (unsigned int i = 0; i < vValue.size(); i++)
-            {
-                if (fUseInstantSend && nTotal + vValue[i].first > sporkManager.GetSporkValue(SPORK_5_INSTANTSEND_MAX_VALUE)*COIN) {
+            const uint256& wtxid = outpoint.hash;
+            if (!pcoin || pcoin->GetHash() != wtxid) {
+                std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(wtxid);
+                if (it == mapWallet.end())
                     continue;
-                }
-                //The solver here uses a randomized algorithm,
-                //the randomness serves no real security purpose but is just
-                //needed to prevent degenerate behavior and it is important
-                //that the rng is fast. We do not use a constant random sequence,
-                //because there may be some privacy improvement by making
-                //the selection random.
-                if (nPass == 0 ? insecure_rand.rand32()&1 : !vfIncluded[i])
-                {
-                    nTotal += vValue[i].first;
-                    vfIncluded[i] = true;
-                    if (nTotal >= nTargetValue)
-                    {
-                        fReachedTarget = true;
-                        if (nTotal < nBest)
-                        {
-                            nBest = nTotal;
-                            vfBest = vfIncluded;
-                        }
-                        nTotal -= vValue[i].first;
-                        vfIncluded[i] = false;
-                    }
-                }
+                pcoin = &it->second;
+
+                // do not use IX for inputs that have less then nInstantSendConfirmationsRequired blockchain confirmations
+                fAvailable = IsAvailableWalletTx(*pcoin, fOnlyConfirmed, nDepth) && !(fUseInstantSend && nDepth < nInstantSendConfirmationsRequired);
             }
+            if (!fAvailable)
+                continue;
+
+            unsigned int i = outpoint.n;
+            bool found = false;
+            if(nCoinType == ONLY_DENOMINATED) {
+                found = CPrivateSend::IsDenominatedAmount(pcoin->tx->vout[i].nValue);
+            } else if(nCoinType == ONLY_NONDENOMINATED) {
+                if (CPrivateSend::IsCollateralAmount(pcoin->tx->vout[i].nValue)) continue; // do not use collateral amounts
+                found = !CPrivateSend::IsDenominatedAmount(pcoin->tx->vout[i].nValue);
+            } else if(nCoinType == ONLY_MASTERNODE) {
+                found = pcoin->tx->vout[i].nValue == MASTERNODE_COLLATERAL * COIN;
+            } else if(nCoinType == ONLY_PRIVATESEND_COLLATERAL) {
+                found = CPrivateSend::IsCollateralAmount(pcoin->tx->vout[i].nValue);
+            } else {
+                found = true;
+            }
+            if(!found) continue;
+
+            isminetype mine = IsMine(pcoin->tx->vout[i]);
+            if (!(IsSpent(wtxid, i)) && mine != ISMINE_NO &&
+                (!IsLockedCoin(wtxid, i) || nCoinType == ONLY_MASTERNODE) &&
+                (pcoin->tx->vout[i].nValue > 0 || fIncludeZeroValue) &&
+                (!coinControl || !coinControl->HasSelected() || coinControl->fAllowOtherInputs || coinControl->IsSelected(COutPoint(wtxid, i))))
+                    vCoins.push_back(COutput(pcoin, i, nDepth,
+                                             ((mine & ISMINE_SPENDABLE) != ISMINE_NO) ||
+                                              (coinControl && coinControl->fAllowWatchOnly && (mine & ISMINE_WATCH_SOLVABLE) != ISMINE_NO),
+                                             (mine & (ISMINE_SPENDABLE | ISMINE_WATCH_SOLVABLE)) != ISMINE_NO));
         }
     }
 }
@@ -2700,53 +3013,66 @@ struct CompareByPriority
     }
 };
 
-// move denoms down
-bool less_then_denom (const COutput& out1, const COutput& out2)
+void CWallet::GetInputCoins(const std::vector<COutput>& vCoins, AvailableCoinsType nCoinType, std::vector<CInputCoin>& vInputCoinsRet) const
 {
-    const CWalletTx *pcoin1 = out1.tx;
-    const CWalletTx *pcoin2 = out2.tx;
-
-    bool found1 = false;
-    bool found2 = false;
-    for (const auto& d : CPrivateSend::GetStandardDenominations()) // loop through predefined denoms
+    vInputCoinsRet.clear();
+    vInputCoinsRet.reserve(vCoins.size());
+    for (const COutput& output : vCoins)
     {
-        if(pcoin1->tx->vout[out1.i].nValue == d) found1 = true;
-        if(pcoin2->tx->vout[out2.i].nValue == d) found2 = true;
+        if (!output.fSpendable)
+            continue;
+
+        const CWalletTx *pcoin = output.tx;
+        CInputCoin coin;
+        coin.nValue = pcoin->tx->vout[output.i].nValue;
+        coin.outpoint = std::make_pair(pcoin, output.i);
+        coin.nDepth = output.nDepth;
+        coin.fFromMe = pcoin->IsFromMe(ISMINE_ALL);
+        coin.fDenominated = CPrivateSend::IsDenominatedAmount(coin.nValue);
+        coin.fAnonymized = true;
+        if (nCoinType == ONLY_DENOMINATED) {
+            // Make sure it's actually anonymized
+            COutPoint outpoint = COutPoint(pcoin->GetHash(), output.i);
+            coin.fAnonymized = GetRealOutpointPrivateSendRounds(outpoint) >= privateSendClient.nPrivateSendRounds;
+        }
+        vInputCoinsRet.push_back(coin);
     }
-    return (!found1 && found2);
+    SortInputCoins(vInputCoinsRet);
 }
 
-bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const int nConfMine, const int nConfTheirs, const uint64_t nMaxAncestors, std::vector<COutput> vCoins,
-                                 std::set<std::pair<const CWalletTx*,unsigned int> >& setCoinsRet, CAmount& nValueRet, AvailableCoinsType nCoinType, bool fUseInstantSend) const
+bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const int nConfMine, const int nConfTheirs, const uint64_t nMaxAncestors, const std::vector<COutput>& vCoins,
+                                 std::set<std::pair<const CWalletTx*,unsigned int> >& setCoinsRet, CAmount& nValueRet, AvailableCoinsType nCoinType, bool fUseInstantSend, const CAmount& nCostOfChange) const
+{
+    std::vector<CInputCoin> vInputCoins;
+    GetInputCoins(vCoins, nCoinType, vInputCoins);
+    return SelectCoinsMinConf(nTargetValue, nConfMine, nConfTheirs, nMaxAncestors, vInputCoins, setCoinsRet, nValueRet, nCoinType, fUseInstantSend, nCostOfChange);
+}
+
+bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const int nConfMine, const int nConfTheirs, const uint64_t nMaxAncestors, const std::vector<CInputCoin>& vCoins,
+                                 std::set<std::pair<const CWalletTx*,unsigned int> >& setCoinsRet, CAmount& nValueRet, AvailableCoinsType nCoinType, bool fUseInstantSend, const CAmount& nCostOfChange) const
 {
     setCoinsRet.clear();
     nValueRet = 0;
 
-    // List of values less than target
-    std::pair<CAmount, std::pair<const CWalletTx*,unsigned int> > coinLowestLarger;
-    coinLowestLarger.first = fUseInstantSend
+    const CAmount nMaxValue = fUseInstantSend
                                         ? sporkManager.GetSporkValue(SPORK_5_INSTANTSEND_MAX_VALUE)*COIN
                                         : std::numeric_limits<CAmount>::max();
-    coinLowestLarger.second.first = NULL;
-    std::vector<std::pair<CAmount, std::pair<const CWalletTx*,unsigned int> > > vValue;
-    CAmount nTotalLower = 0;
+    const CInputCoin* pcoinLowestLarger = NULL;
+    CAmount nLowestLarger = nMaxValue;
 
-    random_shuffle(vCoins.begin(), vCoins.end(), GetRandInt);
+    // List of values less than target, vCoins is sorted by descending value and so are they
+    std::vector<CAmount> vValue;
+    std::vector<const CInputCoin*> vpValueCoins;
+    CAmount nTotalLower = 0;
 
     int tryDenomStart = 0;
     CAmount nMinChange = MIN_CHANGE;
 
     if (nCoinType == ONLY_DENOMINATED) {
-        // larger denoms first
-        std::sort(vCoins.rbegin(), vCoins.rend(), CompareByPriority());
         // we actually want denoms only, so let's skip "non-denom only" step
         tryDenomStart = 1;
         // no change is allowed
         nMinChange = 0;
-    } else {
-        // move denoms down on the list
-        // try not to use denominated coins when not needed, save denoms for privatesend
-        std::sort(vCoins.begin(), vCoins.end(), less_then_denom);
     }
 
     // try to find nondenom first to prevent unneeded spending of mixed coins
@@ -2754,48 +3080,37 @@ bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const int nConfMin
     {
         LogPrint("selectcoins", "tryDenom: %d\n", tryDenom);
         vValue.clear();
+        vpValueCoins.clear();
         nTotalLower = 0;
-        BOOST_FOREACH(const COutput &output, vCoins)
+        for (const CInputCoin& coin : vCoins)
         {
-            if (!output.fSpendable)
+            if (coin.nDepth < (coin.fFromMe ? nConfMine : nConfTheirs))
                 continue;
 
-            const CWalletTx *pcoin = output.tx;
-
-//            if (fDebug) LogPrint("selectcoins", "value %s confirms %d\n", FormatMoney(pcoin->vout[output.i].nValue), output.nDepth);
-            if (output.nDepth < (pcoin->IsFromMe(ISMINE_ALL) ? nConfMine : nConfTheirs))
+            // only transactions in the mempool have unconfirmed ancestors or descendants
+            if (coin.nDepth == 0 && !mempool.TransactionWithinChainLimit(coin.outpoint.first->GetHash(), nMaxAncestors))
                 continue;
 
-            if (!mempool.TransactionWithinChainLimit(pcoin->GetHash(), nMaxAncestors))
-                continue;
-
-            int i = output.i;
-            CAmount n = pcoin->tx->vout[i].nValue;
-            if (tryDenom == 0 && CPrivateSend::IsDenominatedAmount(n)) continue; // we don't want denom values on first run
-
-            if (nCoinType == ONLY_DENOMINATED) {
-                // Make sure it's actually anonymized
-                COutPoint outpoint = COutPoint(pcoin->GetHash(), i);
-                int nRounds = GetRealOutpointPrivateSendRounds(outpoint);
-                if (nRounds < privateSendClient.nPrivateSendRounds) continue;
-            }
+            if (tryDenom == 0 && coin.fDenominated) continue; // we don't want denom values on first run
 
-            std::pair<CAmount, std::pair<const CWalletTx*,unsigned int> > coin = std::make_pair(n, std::make_pair(pcoin, i));
+            if (!coin.fAnonymized) continue;
 
-            if (n == nTargetValue)
+            if (coin.nValue == nTargetValue)
             {
-                setCoinsRet.insert(coin.second);
-                nValueRet += coin.first;
+                setCoinsRet.insert(coin.outpoint);
+                nValueRet += coin.nValue;
                 return true;
             }
-            else if (n < nTargetValue + nMinChange)
+            else if (coin.nValue < nTargetValue + nMinChange)
             {
-                vValue.push_back(coin);
-                nTotalLower += n;
+                vValue.push_back(coin.nValue);
+                vpValueCoins.push_back(&coin);
+                nTotalLower += coin.nValue;
             }
-            else if (n < coinLowestLarger.first)
+            else if (coin.nValue < nLowestLarger)
             {
-                coinLowestLarger = coin;
+                pcoinLowestLarger = &coin;
+                nLowestLarger = coin.nValue;
             }
         }
 
@@ -2803,15 +3118,15 @@ bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const int nConfMin
         {
             for (unsigned int i = 0; i < vValue.size(); ++i)
             {
-                setCoinsRet.insert(vValue[i].second);
-                nValueRet += vValue[i].first;
+                setCoinsRet.insert(vpValueCoins[i]->outpoint);
+                nValueRet += vValue[i];
             }
             return true;
         }
 
         if (nTotalLower < nTargetValue)
         {
-            if (coinLowestLarger.second.first == NULL) // there is no input larger than nTargetValue
+            if (pcoinLowestLarger == NULL) // there is no input larger than nTargetValue
             {
                 if (tryDenom == 0)
                     // we didn't look at denom yet, let's do it
@@ -2820,8 +3135,8 @@ bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const int nConfMin
                     // we looked at everything possible and didn't find anything, no luck
                     return false;
             }
-            setCoinsRet.insert(coinLowestLarger.second);
-            nValueRet += coinLowestLarger.first;
+            setCoinsRet.insert(pcoinLowestLarger->outpoint);
+            nValueRet += nLowestLarger;
             // There is no change in PS, so we know the fee beforehand,
             // can see if we exceeded the max fee and thus fail quickly.
             return nCoinType == ONLY_DENOMINATED ? (nValueRet - nTargetValue <= maxTxFee) : true;
@@ -2832,33 +3147,34 @@ bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const int nConfMin
 
     }
 
-    // Solve subset sum by stochastic approximation
-    std::sort(vValue.begin(), vValue.end(), CompareValueOnly());
-    std::reverse(vValue.begin(), vValue.end());
     std::vector<char> vfBest;
     CAmount nBest;
 
-    ApproximateBestSubset(vValue, nTotalLower, nTargetValue, vfBest, nBest, fUseInstantSend);
-    if (nBest != nTargetValue && nTotalLower >= nTargetValue + nMinChange)
-        ApproximateBestSubset(vValue, nTotalLower, nTargetValue + nMinChange, vfBest, nBest, fUseInstantSend);
+    // Look for a subset that doesn't need change first, then solve subset sum by stochastic approximation
+    bool fNoChange = SelectCoinsBnB(vValue, nTargetValue, nCostOfChange, nMaxValue, vfBest, nBest);
+    if (!fNoChange) {
+        ApproximateBestSubset(vValue, nTotalLower, nTargetValue, nMaxValue, vfBest, nBest);
+        if (nBest != nTargetValue && nTotalLower >= nTargetValue + nMinChange)
+            ApproximateBestSubset(vValue, nTotalLower, nTargetValue + nMinChange, nMaxValue, vfBest, nBest);
+    }
 
     // If we have a bigger coin and (either the stochastic approximation didn't find a good solution,
     //                                   or the next bigger coin is closer), return the bigger coin
-    if (coinLowestLarger.second.first &&
-        ((nBest != nTargetValue && nBest < nTargetValue + nMinChange) || coinLowestLarger.first <= nBest))
+    if (pcoinLowestLarger &&
+        ((!fNoChange && nBest != nTargetValue && nBest < nTargetValue + nMinChange) || nLowestLarger <= nBest))
     {
-        setCoinsRet.insert(coinLowestLarger.second);
-        nValueRet += coinLowestLarger.first;
+        setCoinsRet.insert(pcoinLowestLarger->outpoint);
+        nValueRet += nLowestLarger;
     }
     else {
-        std::string s = "CWallet::SelectCoinsMinConf best subset: ";
+        std::string s = fNoChange ? "CWallet::SelectCoinsMinConf branch and bound: " : "CWallet::SelectCoinsMinConf best subset: ";
         for (unsigned int i = 0; i < vValue.size(); i++)
         {
             if (vfBest[i])
             {
-                setCoinsRet.insert(vValue[i].second);
-                nValueRet += vValue[i].first;
-                s += FormatMoney(vValue[i].first) + " ";
+                setCoinsRet.insert(vpValueCoins[i]->outpoint);
+                nValueRet += vValue[i];
+                s += FormatMoney(vValue[i]) + " ";
             }
         }
         LogPrint("selectcoins", "%s - total %s\n", s, FormatMoney(nBest));
@@ -2869,16 +3185,14 @@ bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const int nConfMin
     return nCoinType == ONLY_DENOMINATED ? (nValueRet - nTargetValue <= maxTxFee) : true;
 }
 
-bool CWallet::SelectCoins(const std::vector<COutput>& vAvailableCoins, const CAmount& nTargetValue, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoinsRet, CAmount& nValueRet, const CCoinControl* coinControl, AvailableCoinsType nCoinType, bool fUseInstantSend) const
+bool CWallet::SelectCoins(const std::vector<COutput>& vAvailableCoins, const CAmount& nTargetValue, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoinsRet, CAmount& nValueRet, const CCoinControl* coinControl, AvailableCoinsType nCoinType, bool fUseInstantSend, const CAmount& nCostOfChange) const
 {
     // Note: this function should never be used for "always free" tx types like dstx
 
-    std::vector<COutput> vCoins(vAvailableCoins);
-
     // coin control -> return all selected outputs (we want all selected to go into the transaction for sure)
     if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs)
     {
-        BOOST_FOREACH(const COutput& out, vCoins)
+        BOOST_FOREACH(const COutput& out, vAvailableCoins)
         {
             if(!out.fSpendable)
                 continue;
@@ -2929,26 +3243,27 @@ bool CWallet::SelectCoins(const std::vector<COutput>& vAvailableCoins, const CAm
             return false; // TODO: Allow non-wallet inputs
     }
 
-    // remove preset inputs from vCoins
-    for (std::vector<COutput>::iterator it = vCoins.begin(); it != vCoins.end() && coinControl && coinControl->HasSelected();)
+    // Shuffle and sort the coins once for all the attempts below, without the preset inputs
+    std::vector<CInputCoin> vCoins;
+    GetInputCoins(vAvailableCoins, nCoinType, vCoins);
+    if (!setPresetCoins.empty())
     {
-        if (setPresetCoins.count(std::make_pair(it->tx, it->i)))
-            it = vCoins.erase(it);
-        else
-            ++it;
+        vCoins.erase(std::remove_if(vCoins.begin(), vCoins.end(), [&setPresetCoins](const CInputCoin& coin) {
+            return setPresetCoins.count(coin.outpoint) > 0;
+        }), vCoins.end());
     }
 
     size_t nMaxChainLength = std::min(GetArg("-limitancestorcount", DEFAULT_ANCESTOR_LIMIT), GetArg("-limitdescendantcount", DEFAULT_DESCENDANT_LIMIT));
     bool fRejectLongChains = GetBoolArg("-walletrejectlongchains", DEFAULT_WALLET_REJECT_LONG_CHAINS);
 
     bool res = nTargetValue <= nValueFromPresetInputs ||
-        SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 1, 6, 0, vCoins, setCoinsRet, nValueRet, nCoinType, fUseInstantSend) ||
-        SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 1, 1, 0, vCoins, setCoinsRet, nValueRet, nCoinType, fUseInstantSend) ||
-        (bSpendZeroConfChange && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 0, 1, 2, vCoins, setCoinsRet, nValueRet, nCoinType, fUseInstantSend)) ||
-        (bSpendZeroConfChange && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 0, 1, std::min((size_t)4, nMaxChainLength/3), vCoins, setCoinsRet, nValueRet, nCoinType, fUseInstantSend)) ||
-        (bSpendZeroConfChange && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 0, 1, nMaxChainLength/2, vCoins, setCoinsRet, nValueRet, nCoinType, fUseInstantSend)) ||
-        (bSpendZeroConfChange && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 0, 1, nMaxChainLength, vCoins, setCoinsRet, nValueRet, nCoinType, fUseInstantSend)) ||
-        (bSpendZeroConfChange && !fRejectLongChains && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 0, 1, std::numeric_limits<uint64_t>::max(), vCoins, setCoinsRet, nValueRet, nCoinType, fUseInstantSend));
+        SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 1, 6, 0, vCoins, setCoinsRet, nValueRet, nCoinType, fUseInstantSend, nCostOfChange) ||
+        SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 1, 1, 0, vCoins, setCoinsRet, nValueRet, nCoinType, fUseInstantSend, nCostOfChange) ||
+        (bSpendZeroConfChange && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 0, 1, 2, vCoins, setCoinsRet, nValueRet, nCoinType, fUseInstantSend, nCostOfChange)) ||
+        (bSpendZeroConfChange && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 0, 1, std::min((size_t)4, nMaxChainLength/3), vCoins, setCoinsRet, nValueRet, nCoinType, fUseInstantSend, nCostOfChange)) ||
+        (bSpendZeroConfChange && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 0, 1, nMaxChainLength/2, vCoins, setCoinsRet, nValueRet, nCoinType, fUseInstantSend, nCostOfChange)) ||
+        (bSpendZeroConfChange && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 0, 1, nMaxChainLength, vCoins, setCoinsRet, nValueRet, nCoinType, fUseInstantSend, nCostOfChange)) ||
+        (bSpendZeroConfChange && !fRejectLongChains && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 0, 1, std::numeric_limits<uint64_t>::max(), vCoins, setCoinsRet, nValueRet, nCoinType, fUseInstantSend, nCostOfChange));
 
     // because SelectCoinsMinConf clears the setCoinsRet, we now add the possible inputs to the coinset
     setCoinsRet.insert(setPresetCoins.begin(), setPresetCoins.end());
@@ -3025,7 +3340,8 @@ bool CWallet::SelectPSInOutPairsByDenominations(int nDenom, CAmount nValueMin, C
     int nDenomResult{0};
 
     std::set<uint256> setRecentTxIds;
-    std::vector<COutput> vCoins;
+    // outpoints along with the bucket they are in, i.e. denomination bit and rounds
+    std::vector<std::pair<COutPoint, std::pair<int, int> > > vecCoins;
 
     vecPSInOutPairsRet.clear();
 
@@ -3034,32 +3350,47 @@ bool CWallet::SelectPSInOutPairsByDenominations(int nDenom, CAmount nValueMin, C
         return false;
     }
 
-    AvailableCoins(vCoins, true, NULL, false, ONLY_DENOMINATED);
-    LogPrintf("CWallet::%s -- vCoins.size(): %d\n", __func__, vCoins.size());
+    LOCK2(cs_main, cs_wallet);
 
-    std::random_shuffle(vCoins.rbegin(), vCoins.rend(), GetRandInt);
+    // only the buckets of requested denominations which are not mixed enough yet
+    for (const auto& nBit : vecBits) {
+        auto it = mapWalletUTXOBuckets.lower_bound(std::make_pair(nBit, std::numeric_limits<int>::min()));
+        for (; it != mapWalletUTXOBuckets.end() && it->first.first == nBit && it->first.second < privateSendClient.nPrivateSendRounds; ++it) {
+            for (const auto& outpoint : it->second) {
+                vecCoins.emplace_back(outpoint, it->first);
+            }
+        }
+    }
+    LogPrintf("CWallet::%s -- vecCoins.size(): %d\n", __func__, vecCoins.size());
 
-    std::vector<CAmount> vecPrivateSendDenominations = CPrivateSend::GetStandardDenominations();
-    for (const auto& out : vCoins) {
-        uint256 txHash = out.tx->GetHash();
-        int nValue = out.tx->tx->vout[out.i].nValue;
-        if (setRecentTxIds.find(txHash) != setRecentTxIds.end()) continue; // no duplicate txids
-        if (nValueTotal + nValue > nValueMax) continue;
+    std::random_shuffle(vecCoins.rbegin(), vecCoins.rend(), GetRandInt);
 
-        CTxIn txin = CTxIn(txHash, out.i);
-        CScript scriptPubKey = out.tx->tx->vout[out.i].scriptPubKey;
-        int nRounds = GetRealOutpointPrivateSendRounds(txin.prevout);
-        if (nRounds >= privateSendClient.nPrivateSendRounds) continue;
+    for (const auto& pair : vecCoins) {
+        const COutPoint& outpoint = pair.first;
+        if (setRecentTxIds.find(outpoint.hash) != setRecentTxIds.end()) continue; // no duplicate txids
 
-        for (const auto& nBit : vecBits) {
-            if (nValue != vecPrivateSendDenominations[nBit]) continue;
-            nValueTotal += nValue;
-            vecPSInOutPairsRet.emplace_back(CTxDSIn(txin, scriptPubKey), CTxOut(nValue, scriptPubKey, nRounds));
-            setRecentTxIds.emplace(txHash);
-            nDenomResult |= 1 << nBit;
-            LogPrint("privatesend", "CWallet::%s -- hash: %s, nValue: %d.%08d, nRounds: %d\n",
-                            __func__, txHash.ToString(), nValue / COIN, nValue % COIN, nRounds);
-        }
+        std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash);
+        if (it == mapWallet.end()) continue;
+
+        // same as AvailableCoins(vCoins, true, NULL, false, ONLY_DENOMINATED) would do
+        int nDepth;
+        if (!IsAvailableWalletTx(it->second, true, nDepth)) continue;
+        if (IsSpent(outpoint.hash, outpoint.n) || IsLockedCoin(outpoint.hash, outpoint.n)) continue;
+
+        const CTxOut& txout = it->second.tx->vout[outpoint.n];
+        if (IsMine(txout) == ISMINE_NO) continue;
+
+        CAmount nValue = txout.nValue;
+        if (nValueTotal + nValue > nValueMax) continue;
+
+        int nBit = pair.second.first;
+        int nRounds = pair.second.second;
+        nValueTotal += nValue;
+        vecPSInOutPairsRet.emplace_back(CTxDSIn(CTxIn(outpoint), txout.scriptPubKey), CTxOut(nValue, txout.scriptPubKey, nRounds));
+        setRecentTxIds.emplace(outpoint.hash);
+        nDenomResult |= 1 << nBit;
+        LogPrint("privatesend", "CWallet::%s -- hash: %s, nValue: %d.%08d, nRounds: %d\n",
+                        __func__, outpoint.hash.ToString(), nValue / COIN, nValue % COIN, nRounds);
     }
 
     LogPrintf("CWallet::%s -- setRecentTxIds.size(): %d\n", __func__, setRecentTxIds.size());
@@ -3091,23 +3422,25 @@ bool CWallet::SelectCoinsGroupedByAddresses(std::vector<CompactTallyItem>& vecTa
 
     // Tally
     std::map<CTxDestination, CompactTallyItem> mapTally;
-    std::set<uint256> setWalletTxesCounted;
-    for (const auto& outpoint : setWalletUTXO) {
+    for (const auto& bucket : mapWalletUTXOBuckets) {
+        // non-denominated outputs are all in the first buckets
+        if (fSkipDenominated && bucket.first.first != -1) break;
+        // ignore anonymized
+        if (fAnonymizable && bucket.first.second >= privateSendClient.nPrivateSendRounds) continue;
 
-        if (setWalletTxesCounted.find(outpoint.hash) != setWalletTxesCounted.end()) continue;
-        setWalletTxesCounted.insert(outpoint.hash);
+        for (const auto& outpoint : bucket.second) {
+            std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash);
+            if (it == mapWallet.end()) continue;
 
-        std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash);
-        if (it == mapWallet.end()) continue;
+            const CWalletTx& wtx = (*it).second;
 
-        const CWalletTx& wtx = (*it).second;
+            if(wtx.IsCoinBase() && wtx.GetBlocksToMaturity() > 0) continue;
+            if(fSkipUnconfirmed && !wtx.IsTrusted()) continue;
 
-        if(wtx.IsCoinBase() && wtx.GetBlocksToMaturity() > 0) continue;
-        if(fSkipUnconfirmed && !wtx.IsTrusted()) continue;
+            const CTxOut& txout = wtx.tx->vout[outpoint.n];
 
-        for (unsigned int i = 0; i < wtx.tx->vout.size(); i++) {
             CTxDestination txdest;
-            if (!ExtractDestination(wtx.tx->vout[i].scriptPubKey, txdest)) continue;
+            if (!ExtractDestination(txout.scriptPubKey, txdest)) continue;
 
             isminefilter mine = ::IsMine(*this, txdest);
             if(!(mine & filter)) continue;
@@ -3115,27 +3448,23 @@ bool CWallet::SelectCoinsGroupedByAddresses(std::vector<CompactTallyItem>& vecTa
             auto itTallyItem = mapTally.find(txdest);
             if (nMaxOupointsPerAddress != -1 && itTallyItem != mapTally.end() && itTallyItem->second.vecOutPoints.size() >= nMaxOupointsPerAddress) continue;
 
-            if(IsSpent(outpoint.hash, i) || IsLockedCoin(outpoint.hash, i)) continue;
-
-            if(fSkipDenominated && CPrivateSend::IsDenominatedAmount(wtx.tx->vout[i].nValue)) continue;
+            if(IsSpent(outpoint.hash, outpoint.n) || IsLockedCoin(outpoint.hash, outpoint.n)) continue;
 
             if(fAnonymizable) {
                 // ignore collaterals
-                if(CPrivateSend::IsCollateralAmount(wtx.tx->vout[i].nValue)) continue;
-                if(fMasternodeMode && wtx.tx->vout[i].nValue == MASTERNODE_COLLATERAL * COIN) continue;
+                if(CPrivateSend::IsCollateralAmount(txout.nValue)) continue;
+                if(fMasternodeMode && txout.nValue == MASTERNODE_COLLATERAL * COIN) continue;
                 // ignore outputs that are 10 times smaller then the smallest denomination
                 // otherwise they will just lead to higher fee / lower priority
-                if(wtx.tx->vout[i].nValue <= nSmallestDenom/10) continue;
-                // ignore anonymized
-                if(GetCappedOutpointPrivateSendRounds(COutPoint(outpoint.hash, i)) >= privateSendClient.nPrivateSendRounds) continue;
+                if(txout.nValue <= nSmallestDenom/10) continue;
             }
 
             if (itTallyItem == mapTally.end()) {
                 itTallyItem = mapTally.emplace(txdest, CompactTallyItem()).first;
                 itTallyItem->second.txdest = txdest;
             }
-            itTallyItem->second.nAmount += wtx.tx->vout[i].nValue;
-            itTallyItem->second.vecOutPoints.emplace_back(outpoint.hash, i);
+            itTallyItem->second.nAmount += txout.nValue;
+            itTallyItem->second.vecOutPoints.push_back(outpoint);
         }
     }
 
@@ -3480,6 +3809,12 @@ bool CWallet::CreateTransaction(const std::vector<CRecipient>& vecSend, CWalletT
             AvailableCoins(vAvailableCoins, true, coinControl, false, nCoinType, fUseInstantSend);
             int nInstantSendConfirmationsRequired = Params().GetConsensus().nInstantSendConfirmationsRequired;
 
+            // Dust change is added to the fee, so coins worth up to that much
+            // more than needed are selected without a change output
+            CAmount nCostOfChange = 0;
+            if (nSubtractFeeFromAmount == 0)
+                nCostOfChange = CTxOut(0, GetScriptForDestination(CKeyID())).GetDustThreshold(dustRelayFee);
+
             nFeeRet = 0;
             if(nFeePay > 0) nFeeRet = nFeePay;
             // Start with no fee and loop until there is enough fee
@@ -3530,7 +3865,7 @@ bool CWallet::CreateTransaction(const std::vector<CRecipient>& vecSend, CWalletT
                 // Choose coins to use
                 CAmount nValueIn = 0;
                 setCoins.clear();
-                if (!SelectCoins(vAvailableCoins, nValueToSelect, setCoins, nValueIn, coinControl, nCoinType, fUseInstantSend))
+                if (!SelectCoins(vAvailableCoins, nValueToSelect, setCoins, nValueIn, coinControl, nCoinType, fUseInstantSend, nCostOfChange))
                 {
                     if (nCoinType == ONLY_NONDENOMINATED) {
                         strFailReason = _("Unable to locate enough PrivateSend non-denominated funds for this transaction.");
@@ -3807,20 +4142,15 @@ bool CWallet::CreateTransaction(const std::vector<CRecipient>& vecSend, CWalletT
 
         if (sign)
         {
-            CTransaction txNewConst(txNew);
-            int nIn = 0;
-            for(const auto& txdsin : vecTxDSInTmp)
-            {
-                const CScript& scriptPubKey = txdsin.prevPubKey;
-                CScript& scriptSigRes = txNew.vin[nIn].scriptSig;
+            std::vector<CScript> vecScriptPubKeys;
+            vecScriptPubKeys.reserve(vecTxDSInTmp.size());
+            for (const auto& txdsin : vecTxDSInTmp)
+                vecScriptPubKeys.push_back(txdsin.prevPubKey);
 
-                if (!ProduceSignature(TransactionSignatureCreator(this, &txNewConst, nIn, SIGHASH_ALL), scriptPubKey, scriptSigRes))
-                {
-                    strFailReason = _("Signing transaction failed");
-                    return false;
-                }
-
-                nIn++;
+            if (!SignTransaction(*this, vecScriptPubKeys, txNew, SIGHASH_ALL))
+            {
+                strFailReason = _("Signing transaction failed");
+                return false;
             }
         }
 
@@ -3972,7 +4302,7 @@ DBErrors CWallet::LoadWallet(bool& fFirstRunRet)
         for (auto& pair : mapWallet) {
             for(unsigned int i = 0; i < pair.second.tx->vout.size(); ++i) {
                 if (IsMine(pair.second.tx->vout[i]) && !IsSpent(pair.first, i)) {
-                    setWalletUTXO.insert(COutPoint(pair.first, i));
+                    AddWalletUTXO(COutPoint(pair.first, i), pair.second.tx->vout[i]);
                 }
             }
         }
@@ -4181,35 +4511,51 @@ bool CWallet::TopUpKeyPool(unsigned int kpSize)
         } else {
             nTargetSize *= 2;
         }
-        bool fInternal = false;
+        if (missingInternal + missingExternal == 0)
+            return true;
+
+        int64_t nEnd = 1;
+        if (!setInternalKeyPool.empty()) {
+            nEnd = *(--setInternalKeyPool.end()) + 1;
+        }
+        if (!setExternalKeyPool.empty()) {
+            nEnd = std::max(nEnd, *(--setExternalKeyPool.end()) + 1);
+        }
+
+        // HD keys, the chain and the pool entries of the whole top-up go into
+        // a single database transaction
         CWalletDB walletdb(strWalletFile);
-        for (int64_t i = missingInternal + missingExternal; i--;)
-        {
-            int64_t nEnd = 1;
-            if (i < missingInternal) {
-                fInternal = true;
-            }
-            if (!setInternalKeyPool.empty()) {
-                nEnd = *(--setInternalKeyPool.end()) + 1;
-            }
-            if (!setExternalKeyPool.empty()) {
-                nEnd = std::max(nEnd, *(--setExternalKeyPool.end()) + 1);
-            }
-            // TODO: implement keypools for all accounts?
-            if (!walletdb.WritePool(nEnd, CKeyPool(GenerateNewKey(0, fInternal), fInternal)))
-                throw std::runtime_error(std::string(__func__) + ": writing generated key failed");
+        bool fBatch = fFileBacked && IsHDEnabled();
+        if (fBatch && !walletdb.TxnBegin())
+            throw std::runtime_error(std::string(__func__) + ": TxnBegin failed");
+
+        // TODO: implement keypools for all accounts?
+        std::vector<CPubKey> vecExternal, vecInternal;
+        GenerateNewKeys(walletdb, 0, false, missingExternal, vecExternal);
+        GenerateNewKeys(walletdb, 0, true, missingInternal, vecInternal);
+
+        for (bool fInternal : {false, true}) {
+            for (const CPubKey& pubkey : (fInternal ? vecInternal : vecExternal)) {
+                if (!walletdb.WritePool(nEnd, CKeyPool(pubkey, fInternal)))
+                    throw std::runtime_error(std::string(__func__) + ": writing generated key failed");
+
+                if (fInternal) {
+                    setInternalKeyPool.insert(nEnd);
+                } else {
+                    setExternalKeyPool.insert(nEnd);
+                }
 
-            if (fInternal) {
-                setInternalKeyPool.insert(nEnd);
-            } else {
-                setExternalKeyPool.insert(nEnd);
+                double dProgress = 100.f * nEnd / (nTargetSize + 1);
+                std::string strMsg = strprintf(_("Loading wallet... (%3.2f %%)"), dProgress);
+                uiInterface.InitMessage(strMsg);
+                nEnd++;
             }
-            LogPrintf("keypool added key %d, size=%u, internal=%d\n", nEnd, setInternalKeyPool.size() + setExternalKeyPool.size(), fInternal);
-
-            double dProgress = 100.f * nEnd / (nTargetSize + 1);
-            std::string strMsg = strprintf(_("Loading wallet... (%3.2f %%)"), dProgress);
-            uiInterface.InitMessage(strMsg);
         }
+
+        if (fBatch && !walletdb.TxnCommit())
+            throw std::runtime_error(std::string(__func__) + ": TxnCommit failed");
+
+        LogPrintf("keypool added %d external and %d internal keys, size=%u\n", vecExternal.size(), vecInternal.size(), setInternalKeyPool.size() + setExternalKeyPool.size());
     }
     return true;
 }
@@ -4579,6 +4925,8 @@ bool CWallet::UpdatedTransaction(const uint256 &hashTx)
         // Only notify UI if this transaction is in this wallet
         std::map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(hashTx);
         if (mi != mapWallet.end()){
+            // e.g. locked by InstantSend, which makes it trusted
+            fBalancesCached = false;
             NotifyTransactionChanged(this, hashTx, CT_UPDATED);
             return true;
         }
@@ -4606,6 +4954,7 @@ void CWallet::LockCoin(const COutPoint& output)
 
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
+    fBalancesCached = false;
 }
 
 void CWallet::UnlockCoin(const COutPoint& output)
@@ -4617,6 +4966,7 @@ void CWallet::UnlockCoin(const COutPoint& output)
 
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
+    fBalancesCached = false;
 }
 
 void CWallet::UnlockAllCoins()
@@ -4798,6 +5148,7 @@ std::string CWallet::GetWalletHelpString(bool showDebug)
     strUsage += HelpMessageOpt("-paytxfee=<amt>", strprintf(_("Fee (in %s/kB) to add to transactions you send (default: %s)"),
                                                             CURRENCY_UNIT, FormatMoney(payTxFee.GetFeePerK())));
     strUsage += HelpMessageOpt("-rescan", _("Rescan the block chain for missing wallet transactions on startup"));
+    strUsage += HelpMessageOpt("-rescanthreads=<n>", strprintf(_("Set the number of threads reading blocks during a rescan (1 to %d, default: %d)"), MAX_RESCAN_THREADS, DEFAULT_RESCAN_THREADS));
     strUsage += HelpMessageOpt("-salvagewallet", _("Attempt to recover private keys from a corrupt wallet on startup"));
     if (showDebug)
         strUsage += HelpMessageOpt("-sendfreetransactions", strprintf(_("Send transactions as zero-fee transactions if possible (default: %u)"), DEFAULT_SEND_FREE_TRANSACTIONS));
@@ -4809,6 +5160,8 @@ std::string CWallet::GetWalletHelpString(bool showDebug)
     strUsage += HelpMessageOpt("-hdseed", _("User defined seed for HD wallet (should be in hex). Only has effect during wallet creation/first start (default: randomly generated)"));
     strUsage += HelpMessageOpt("-upgradewallet", _("Upgrade wallet to latest format on startup"));
     strUsage += HelpMessageOpt("-wallet=<file>", _("Specify wallet file (within data directory)") + " " + strprintf(_("(default: %s)"), DEFAULT_WALLET_DAT));
+    strUsage += HelpMessageOpt("-walletbackend=<backend>", _("Storage backend of the wallet, bdb or leveldb. An existing wallet is converted to it, the original is kept as <file>.<timestamp>.bak (default: keep the backend of an existing wallet, bdb for new ones)"));
+    strUsage += HelpMessageOpt("-walletkdf=<kdf>", strprintf(_("Key derivation of newly set wallet passphrases, sha512 or sha512x4. sha512x4 computes four SHA-512 chains at once, which allows more iterations in the same time on CPUs with AVX2, but older versions can't unlock it (default: %s)"), DEFAULT_WALLET_KDF));
     strUsage += HelpMessageOpt("-walletbroadcast", _("Make the wallet broadcast transactions") + " " + strprintf(_("(default: %u)"), DEFAULT_WALLETBROADCAST));
     strUsage += HelpMessageOpt("-walletnotify=<cmd>", _("Execute command when a wallet transaction changes (%s in cmd is replaced by TxID)"));
     strUsage += HelpMessageOpt("-zapwallettxes=<mode>", _("Delete all wallet transactions and only recover those parts of the blockchain through -rescan on startup") +
@@ -5000,7 +5353,13 @@ CWallet* CWallet::CreateWalletFromFile(const std::string walletFile)
         uiInterface.InitMessage(_("Rescanning..."));
         LogPrintf("Rescanning last %i blocks (from block %i)...\n", chainActive.Height() - pindexRescan->nHeight, pindexRescan->nHeight);
         nStart = GetTimeMillis();
-        walletInstance->ScanForWalletTransactions(pindexRescan, true);
+        {
+            // nothing else knows about this wallet yet
+            CWalletRescanReserver reserver(walletInstance);
+            bool fReserved = reserver.Reserve();
+            assert(fReserved);
+            walletInstance->ScanForWalletTransactions(pindexRescan, reserver, true);
+        }
         LogPrintf(" rescan      %15dms\n", GetTimeMillis() - nStart);
         walletInstance->SetBestChain(chainActive.GetLocator());
         CWalletDB::IncrementUpdateCounter();
@@ -5154,6 +5513,14 @@ bool CWallet::ParameterInteraction()
                                        GetArg("-maxtxfee", ""), ::minRelayTxFee.ToString()));
         }
     }
+    std::string strKDF = GetArg("-walletkdf", DEFAULT_WALLET_KDF);
+    if (strKDF == "sha512")
+        nWalletDerivationMethod = WALLET_CRYPTO_DERIVATION_SHA512;
+    else if (strKDF == "sha512x4")
+        nWalletDerivationMethod = WALLET_CRYPTO_DERIVATION_SHA512X4;
+    else
+        return InitError(strprintf(_("Unknown key derivation requested: -walletkdf=%s"), strKDF));
+
     nTxConfirmTarget = GetArg("-txconfirmtarget", DEFAULT_TX_CONFIRM_TARGET);
     bSpendZeroConfChange = GetBoolArg("-spendzeroconfchange", DEFAULT_SPEND_ZEROCONF_CHANGE);
     fSendFreeTransactions = GetBoolArg("-sendfreetransactions", DEFAULT_SEND_FREE_TRANSACTIONS);
@@ -5200,6 +5567,14 @@ bool CWallet::BackupWallet(const std::string& strDest)
 {
     if (!fFileBacked)
         return false;
+    if (GetWalletDBBackend(strWalletFile) == WALLETDB_LEVELDB)
+    {
+        // The backup is a leveldb wallet itself, a directory
+        boost::filesystem::path pathDest(strDest);
+        if (boost::filesystem::is_directory(pathDest) && !boost::filesystem::exists(pathDest / "CURRENT"))
+            pathDest /= strWalletFile;
+        return walletldb.Backup(strWalletFile, pathDest);
+    }
     while (true)
     {
         {
@@ -5307,7 +5682,14 @@ bool AutoBackupWallet(CWallet* wallet, const std::string& strWalletFile_, std::s
             LogPrintf("%s\n", strBackupWarningRet);
             return false;
         }
-        if(fs::exists(sourceFile)) {
+        if (fs::is_directory(sourceFile)) {
+            if (!walletldb.Backup(strWalletFile, backupFile)) {
+                strBackupWarningRet = strprintf(_("Failed to create backup %s!"), backupFile.string());
+                LogPrintf("%s\n", strBackupWarningRet);
+                nWalletBackups = -1;
+                return false;
+            }
+        } else if(fs::exists(sourceFile)) {
             try {
                 fs::copy_file(sourceFile, backupFile);
                 LogPrintf("Creating backup of %s -> %s\n", sourceFile.string(), backupFile.string());
@@ -5329,8 +5711,8 @@ bool AutoBackupWallet(CWallet* wallet, const std::string& strWalletFile_, std::s
     fs::path currentFile;
     for (fs::directory_iterator dir_iter(backupsDir); dir_iter != end_iter; ++dir_iter)
     {
-        // Only check regular files
-        if ( fs::is_regular_file(dir_iter->status()))
+        // Only check regular files and the directories of leveldb wallets
+        if ( fs::is_regular_file(dir_iter->status()) || fs::is_directory(dir_iter->status()))
         {
             currentFile = dir_iter->path().filename();
             // Only add the backups for the current wallet, e.g. wallet.dat.*
@@ -5350,7 +5732,7 @@ bool AutoBackupWallet(CWallet* wallet, const std::string& strWalletFile_, std::s
         {
             // More than nWalletBackups backups: delete oldest one(s)
             try {
-                fs::remove(file.second);
+                fs::remove_all(file.second);
                 LogPrintf("Old backup deleted: %s\n", file.second);
             } catch(fs::filesystem_error &error) {
                 strBackupWarningRet = strprintf(_("Failed to delete backup, error: %s"), error.what());
@@ -18,6 +18,7 @@
 #include "utilstrencodings.h"
 #include "validationinterface.h"
 #include "script/ismine.h"
+#include "wallet/coinselection.h"
 #include "wallet/crypter.h"
 #include "wallet/walletdb.h"
 #include "wallet/rpcwallet.h"
@@ -31,6 +32,7 @@
 #include <stdexcept>
 #include <stdint.h>
 #include <string>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -47,6 +49,7 @@ extern unsigned int nTxConfirmTarget;
 extern bool bSpendZeroConfChange;
 extern bool fSendFreeTransactions;
 extern bool bBIP69Enabled;
+extern unsigned int nWalletDerivationMethod;
 
 static const unsigned int DEFAULT_KEYPOOL_SIZE = 1000;
 //! -paytxfee default
@@ -72,7 +75,12 @@ static const unsigned int DEFAULT_TX_CONFIRM_TARGET = 6;
 //! Largest (in bytes) free transaction we're willing to create
 static const unsigned int MAX_FREE_TRANSACTION_CREATE_SIZE = 1000;
 static const bool DEFAULT_WALLETBROADCAST = true;
+//! -rescanthreads default
+static const int DEFAULT_RESCAN_THREADS = 4;
+static const int MAX_RESCAN_THREADS = 16;
 static const bool DEFAULT_DISABLE_WALLET = false;
+//! -walletkdf default, key derivation of new wallet passphrases
+static const char* const DEFAULT_WALLET_KDF = "sha512";
 
 extern const char * DEFAULT_WALLET_DAT;
 
@@ -87,6 +95,7 @@ class COutput;
 class CReserveKey;
 class CScript;
 class CTxMemPool;
+class CWalletRescanReserver;
 class CWalletTx;
 
 /** (client) version numbers for particular wallet features */
@@ -102,6 +111,14 @@ enum WalletFeature
     FEATURE_LATEST = 100 //61000 // v0.6.10.0
 };
 
+/** How a rescan by ScanForWalletTransactions ended */
+enum ScanResult
+{
+    SCAN_SUCCESS,   // every block up to the tip was scanned
+    SCAN_FAILURE,   // some blocks could not be read, e.g. they were pruned
+    SCAN_ABORTED    // stopped by AbortRescan() before it reached the tip
+};
+
 enum AvailableCoinsType
 {
     ALL_COINS,
@@ -625,21 +642,49 @@ private:
 };
 
 
+/**
+ * Snapshot of the key and script ids and the watch-only scripts of a wallet.
+ * Lets a rescan pick out the outputs which might belong to the wallet on
+ * several threads without locking it, IsMine() has the final say on them.
+ */
+class CWalletScanFilter
+{
+private:
+    struct IdHasher
+    {
+        size_t operator()(const uint160& id) const { return id.GetUint64(0); }
+    };
+
+    std::unordered_set<uint160, IdHasher> setIds;
+    std::set<CScript> setWatchOnly;
+
+public:
+    void AddId(const uint160& id) { setIds.insert(id); }
+    void AddWatchOnly(const CScript& script) { setWatchOnly.insert(script); }
+
+    /** Could the output belong to the wallet? Never false for one which does */
+    bool IsRelevant(const CTxOut& txout) const;
+};
+
+
 /** 
  * A CWallet is an extension of a keystore, which also maintains a set of transactions and balances,
  * and provides the ability to create new transactions.
  */
 class CWallet : public CCryptoKeyStore, public CValidationInterface
 {
+    friend class CWalletRescanReserver;
+
 private:
     static std::atomic<bool> fFlushThreadRunning;
 
     /**
      * Select a set of coins such that nValueRet >= nTargetValue and at least
      * all coins from coinControl are selected; Never select unconfirmed coins
-     * if they are not ours
+     * if they are not ours. Selecting up to nCostOfChange more than needed
+     * avoids a change output.
      */
-    bool SelectCoins(const std::vector<COutput>& vAvailableCoins, const CAmount& nTargetValue, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoinsRet, CAmount& nValueRet, const CCoinControl *coinControl = NULL, AvailableCoinsType nCoinType=ALL_COINS, bool fUseInstantSend = true) const;
+    bool SelectCoins(const std::vector<COutput>& vAvailableCoins, const CAmount& nTargetValue, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoinsRet, CAmount& nValueRet, const CCoinControl *coinControl = NULL, AvailableCoinsType nCoinType=ALL_COINS, bool fUseInstantSend = true, const CAmount& nCostOfChange = 0) const;
 
     CWalletDB *pwalletdbEncryption;
 
@@ -653,11 +698,35 @@ private:
     int64_t nLastResend;
     bool fBroadcastTransactions;
 
+    std::atomic<bool> fAbortRescan;
+    std::atomic<bool> fScanningWallet;
+
     mutable bool fAnonymizableTallyCached;
     mutable std::vector<CompactTallyItem> vecAnonymizableTallyCached;
     mutable bool fAnonymizableTallyCachedNonDenom;
     mutable std::vector<CompactTallyItem> vecAnonymizableTallyCachedNonDenom;
 
+    /** Balances by category, summed up over the transactions with unspent outputs */
+    struct CWalletBalances
+    {
+        CAmount nTrusted = 0;
+        CAmount nUntrustedPending = 0;
+        CAmount nImmature = 0;
+        CAmount nWatchOnlyTrusted = 0;
+        CAmount nWatchOnlyUntrustedPending = 0;
+        CAmount nWatchOnlyImmature = 0;
+        CAmount nAnonymized = 0;
+        CAmount nDenominatedConfirmed = 0;
+        CAmount nDenominatedUnconfirmed = 0;
+    };
+    // Reset whenever a transaction changes, also recomputed once the tip or the mempool changed
+    mutable bool fBalancesCached;
+    mutable CWalletBalances cachedBalances;
+    mutable uint256 hashBalancesTip;
+    mutable unsigned int nBalancesMempoolUpdated;
+    mutable int nBalancesPrivateSendRounds;
+    const CWalletBalances& GetBalances() const;
+
     /**
      * Used to keep track of spent outpoints, and
      * detect and report conflicts (double-spends or
@@ -669,14 +738,37 @@ private:
     void AddToSpends(const uint256& wtxid);
 
     std::set<COutPoint> setWalletUTXO;
+    /**
+     * setWalletUTXO bucketed by the index of the standard denomination of an
+     * output (-1 for other amounts) and its mixing rounds, so PrivateSend can
+     * pick the outputs it is after without going over every wallet transaction.
+     */
+    std::map<std::pair<int, int>, std::set<COutPoint> > mapWalletUTXOBuckets;
+    /** Mixing rounds of the outputs looked at so far, the chain behind an output doesn't change */
+    mutable std::map<COutPoint, int> mapOutpointRounds;
+    void AddWalletUTXO(const COutPoint& outpoint, const CTxOut& txout);
+    void EraseWalletUTXO(const COutPoint& outpoint);
+    /** Add or remove outpoint depending on whether it's ours and unspent now */
+    void UpdateWalletUTXO(const COutPoint& outpoint);
 
     /* Mark a transaction (and its in-wallet descendants) as conflicting with a particular block. */
     void MarkConflicted(const uint256& hashBlock, const uint256& hashTx);
 
     void SyncMetaData(std::pair<TxSpends::iterator, TxSpends::iterator>);
 
-    /* HD derive new child key (on internal or external chain) */
-    void DeriveNewChildKey(const CKeyMetadata& metadata, CKey& secretRet, uint32_t nAccountIndex, bool fInternal /*= false*/);
+    /* Fill filter with everything IsMine() could recognize an output by */
+    void GetScanFilter(CWalletScanFilter& filter) const;
+
+    /* Public parents of the HD keys by account and chain (external or internal), derived from the seed once */
+    std::map<std::pair<uint32_t, bool>, CExtPubKey> mapHdChainExtPubKeys;
+    uint256 hdChainIDCached;
+    CExtPubKey GetHDChainExtPubKey(const CHDChain& hdChain, uint32_t nAccountIndex, bool fInternal);
+
+    /* HD derive nCount new child keys (on internal or external chain) */
+    void DeriveNewChildKeys(CWalletDB& walletdb, const CKeyMetadata& metadata, uint32_t nAccountIndex, bool fInternal, size_t nCount, std::vector<CPubKey>& vecPubKeysRet);
+
+    bool AddHDPubKeyWithDB(CWalletDB& walletdb, const CExtPubKey& extPubKey, bool fInternal);
+    bool RemoveWatchOnlyWithDB(CWalletDB& walletdb, const CScript& dest);
 
     bool fFileBacked;
 
@@ -763,10 +855,15 @@ public:
         nLastResend = 0;
         nTimeFirstKey = 0;
         fBroadcastTransactions = false;
+        fAbortRescan = false;
+        fScanningWallet = false;
         fAnonymizableTallyCached = false;
         fAnonymizableTallyCachedNonDenom = false;
         vecAnonymizableTallyCached.clear();
         vecAnonymizableTallyCachedNonDenom.clear();
+        fBalancesCached = false;
+        nBalancesMempoolUpdated = 0;
+        nBalancesPrivateSendRounds = 0;
     }
 
     std::map<uint256, CWalletTx> mapWallet;
@@ -801,11 +898,16 @@ public:
 
     /**
      * Shuffle and select coins until nTargetValue is reached while avoiding
-     * small change; This method is stochastic for some inputs and upon
-     * completion the coin set and corresponding actual target value is
-     * assembled
+     * small change; A subset worth at most nCostOfChange more than
+     * nTargetValue is searched for first, then the selection is stochastic
+     * for some inputs. Upon completion the coin set and corresponding actual
+     * target value is assembled
      */
-    bool SelectCoinsMinConf(const CAmount& nTargetValue, int nConfMine, int nConfTheirs, uint64_t nMaxAncestors, std::vector<COutput> vCoins, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoinsRet, CAmount& nValueRet, AvailableCoinsType nCoinType=ALL_COINS, bool fUseInstantSend = false) const;
+    bool SelectCoinsMinConf(const CAmount& nTargetValue, int nConfMine, int nConfTheirs, uint64_t nMaxAncestors, const std::vector<COutput>& vCoins, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoinsRet, CAmount& nValueRet, AvailableCoinsType nCoinType=ALL_COINS, bool fUseInstantSend = false, const CAmount& nCostOfChange = 0) const;
+    /** The spendable coins of vCoins as coin selection candidates, shuffled and sorted by descending value */
+    void GetInputCoins(const std::vector<COutput>& vCoins, AvailableCoinsType nCoinType, std::vector<CInputCoin>& vInputCoinsRet) const;
+    /** Select from coins prepared by GetInputCoins, so several attempts only sort them once */
+    bool SelectCoinsMinConf(const CAmount& nTargetValue, int nConfMine, int nConfTheirs, uint64_t nMaxAncestors, const std::vector<CInputCoin>& vCoins, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoinsRet, CAmount& nValueRet, AvailableCoinsType nCoinType=ALL_COINS, bool fUseInstantSend = false, const CAmount& nCostOfChange = 0) const;
 
     // Coin selection
     bool SelectPSInOutPairsByDenominations(int nDenom, CAmount nValueMin, CAmount nValueMax, std::vector< std::pair<CTxDSIn, CTxOut> >& vecPSInOutPairsRet);
@@ -843,6 +945,11 @@ public:
      * Generate a new key
      */
     CPubKey GenerateNewKey(uint32_t nAccountIndex, bool fInternal /*= false*/);
+    /**
+     * Generate nCount new keys, derived on several threads and written with
+     * walletdb if HD is enabled, one by one like GenerateNewKey otherwise
+     */
+    void GenerateNewKeys(CWalletDB& walletdb, uint32_t nAccountIndex, bool fInternal, size_t nCount, std::vector<CPubKey>& vecPubKeysRet);
     //! HaveKey implementation that also checks the mapHdPubKeys
     bool HaveKey(const CKeyID &address) const override;
     //! GetPubKey implementation that also checks the mapHdPubKeys
@@ -906,7 +1013,10 @@ public:
     bool LoadToWallet(const CWalletTx& wtxIn);
     void SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex, int posInBlock) override;
     bool AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlockIndex* pIndex, int posInBlock, bool fUpdate);
-    CBlockIndex* ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false);
+    CBlockIndex* ScanForWalletTransactions(CBlockIndex* pindexStart, const CWalletRescanReserver& reserver, bool fUpdate = false, ScanResult* pResult = NULL);
+    void AbortRescan() { fAbortRescan = true; }
+    bool IsAbortingRescan() { return fAbortRescan; }
+    bool IsScanning() { return fScanningWallet; }
     void ReacceptWalletTransactions();
     void ResendWalletTransactions(int64_t nBestBlockTime, CConnman* connman) override;
     std::vector<uint256> ResendWalletTransactionsBefore(int64_t nTime, CConnman* connman);
@@ -1150,6 +1260,29 @@ public:
     void KeepScript() override { KeepKey(); }
 };
 
+/** Reserves the rescan of a wallet for as long as it exists, only one rescan
+ * of a wallet runs at a time so that AbortRescan() reaches the right one.
+ */
+class CWalletRescanReserver
+{
+private:
+    CWallet* pwallet;
+    bool fReserved;
+
+public:
+    CWalletRescanReserver(CWallet* pwalletIn) : pwallet(pwalletIn), fReserved(false) {}
+
+    ~CWalletRescanReserver()
+    {
+        if (fReserved)
+            pwallet->fScanningWallet = false;
+    }
+
+    /// Returns false if the wallet is being rescanned already
+    bool Reserve();
+    bool IsReserved() const { return fReserved; }
+};
+
 
 /** 
  * Account information.
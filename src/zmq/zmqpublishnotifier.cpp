@@ -3,11 +3,19 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "chainparams.h"
+#include "clientversion.h"
+#include "consensus/consensus.h"
 #include "streams.h"
 #include "zmqpublishnotifier.h"
 #include "validation.h"
 #include "util.h"
 
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
 static std::multimap<std::string, CZMQAbstractPublishNotifier*> mapPublishNotifiers;
 
 static const char *MSG_HASHBLOCK  = "hashblock";
@@ -23,6 +31,49 @@ static const char *MSG_RAWGVOTE   = "rawgovernancevote";
 static const char *MSG_RAWGOBJ    = "rawgovernanceobject";
 static const char *MSG_RAWISCON   = "rawinstantsenddoublespend";
 
+/** A message waiting for the publisher thread */
+struct CZMQQueuedMessage
+{
+    void *psocket;
+    const char *command;
+    CZMQPayloadRef payload;
+    size_t nSize; //!< accounted payload size
+    unsigned char msgseq[sizeof(uint32_t)];
+};
+
+/** Sends queued messages on a dedicated thread, so that slow subscribers and
+ * large payloads do not add latency to the validation interface callbacks.
+ */
+class CZMQPublisher
+{
+private:
+    std::mutex cs;
+    std::condition_variable cond;
+    std::deque<CZMQQueuedMessage> queue;
+    std::thread thread;
+    bool fRunning;
+    CZMQQueueBudget budget;
+    uint64_t nSent;
+    uint64_t nDropped;
+    uint64_t nFailed;
+    //! Queued messages whose payload size is still an estimate
+    size_t nUnsized;
+
+    bool Send(CZMQQueuedMessage& msg);
+    void SizePayloads(std::unique_lock<std::mutex>& lock);
+    void ThreadPublish();
+
+public:
+    CZMQPublisher() : fRunning(false), nSent(0), nDropped(0), nFailed(0), nUnsized(0) {}
+
+    void Start();
+    void Stop();
+    bool Push(CZMQQueuedMessage&& msg);
+    CZMQPublishStats GetStats();
+};
+
+static CZMQPublisher publisher;
+
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
 {
@@ -45,7 +96,7 @@ static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
 
         data = va_arg(args, const void*);
 
-        rc = zmq_msg_send(&msg, sock, data ? ZMQ_SNDMORE : 0);
+        rc = zmq_msg_send(&msg, sock, (data ? ZMQ_SNDMORE : 0) | ZMQ_DONTWAIT);
         if (rc == -1)
         {
             zmqError("Unable to send ZMQ msg");
@@ -63,6 +114,198 @@ static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
     return 0;
 }
 
+void CZMQPublisher::Start()
+{
+    std::unique_lock<std::mutex> lock(cs);
+    if (fRunning)
+        return;
+    size_t nMaxQueued = std::max((int64_t)GetArg("-zmqpubqueuesize", DEFAULT_ZMQ_PUBLISH_QUEUE_SIZE), (int64_t)1);
+    size_t nMaxQueuedBytes = std::max((int64_t)GetArg("-zmqpubqueuemaxmem", DEFAULT_ZMQ_PUBLISH_QUEUE_MAXMEM), (int64_t)1) * 1024 * 1024;
+    budget = CZMQQueueBudget(nMaxQueued, nMaxQueuedBytes);
+    fRunning = true;
+    thread = std::thread(&TraceThread<std::function<void()> >, "zmqpub", std::function<void()>(std::bind(&CZMQPublisher::ThreadPublish, this)));
+}
+
+void CZMQPublisher::Stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        if (!fRunning)
+            return;
+        fRunning = false;
+        cond.notify_all();
+    }
+    thread.join();
+    // Sockets are about to be closed, messages still queued are lost
+    std::unique_lock<std::mutex> lock(cs);
+    nDropped += queue.size();
+    queue.clear();
+    budget.Clear();
+    nUnsized = 0;
+}
+
+bool CZMQPublisher::Push(CZMQQueuedMessage&& msg)
+{
+    std::unique_lock<std::mutex> lock(cs);
+    if (!fRunning)
+        return false;
+    // Lazy payloads are not loaded yet and count with their estimated size
+    msg.nSize = msg.payload->GetQueuedSize();
+    if (!budget.Reserve(msg.nSize)) {
+        // Over budget, drop the new message. Subscribers see a gap in the sequence number.
+        if (nDropped++ % 1000 == 0)
+            LogPrint("zmq", "zmq: Publish queue full (%u messages, %u bytes), dropping %s messages\n", queue.size(), budget.GetBytes(), msg.command);
+        return true;
+    }
+    if (!msg.payload->fSized)
+        nUnsized++;
+    queue.emplace_back(std::move(msg));
+    cond.notify_one();
+    return true;
+}
+
+bool CZMQPublisher::Send(CZMQQueuedMessage& msg)
+{
+    CZMQPayload& payload = *msg.payload;
+    if (!payload.fLoaded) {
+        // Only this thread loads payloads, so no locking is needed
+        payload.fValid = payload.loader(payload.ss);
+        payload.fLoaded = true;
+    }
+    if (!payload.fValid)
+        return false;
+
+    int rc = zmq_send_multipart(msg.psocket, msg.command, strlen(msg.command), payload.ss.data(), payload.ss.size(), msg.msgseq, (size_t)sizeof(uint32_t), (void*)0);
+    return rc != -1;
+}
+
+void CZMQPublisher::SizePayloads(std::unique_lock<std::mutex>& lock)
+{
+    if (nUnsized == 0)
+        return;
+
+    std::vector<CZMQPayloadRef> vPayloads;
+    for (const auto& msg : queue) {
+        if (!msg.payload->fSized && std::find(vPayloads.begin(), vPayloads.end(), msg.payload) == vPayloads.end())
+            vPayloads.push_back(msg.payload);
+    }
+
+    // The sizers may read from disk, don't hold up Push() meanwhile
+    lock.unlock();
+    std::vector<size_t> vSizes;
+    for (const auto& payload : vPayloads)
+        vSizes.push_back(payload->sizer());
+    lock.lock();
+
+    for (size_t i = 0; i < vPayloads.size(); i++) {
+        vPayloads[i]->nSizeEstimate = vSizes[i];
+        vPayloads[i]->fSized = true;
+    }
+    // Also covers the messages pushed while the lock was released
+    for (auto& msg : queue) {
+        if (msg.nSize != msg.payload->GetQueuedSize()) {
+            budget.Resize(msg.nSize, msg.payload->GetQueuedSize());
+            msg.nSize = msg.payload->GetQueuedSize();
+        }
+    }
+    nUnsized = 0;
+}
+
+void CZMQPublisher::ThreadPublish()
+{
+    while (true) {
+        CZMQQueuedMessage msg;
+        {
+            std::unique_lock<std::mutex> lock(cs);
+            while (fRunning && queue.empty())
+                cond.wait(lock);
+            if (!fRunning)
+                break;
+            SizePayloads(lock);
+            if (!fRunning)
+                break;
+            msg = std::move(queue.front());
+            queue.pop_front();
+            budget.Release(msg.nSize);
+        }
+        bool fSent = Send(msg);
+        std::unique_lock<std::mutex> lock(cs);
+        if (fSent)
+            nSent++;
+        else
+            nFailed++;
+    }
+}
+
+CZMQPublishStats CZMQPublisher::GetStats()
+{
+    std::unique_lock<std::mutex> lock(cs);
+    CZMQPublishStats stats;
+    stats.nQueued = queue.size();
+    stats.nQueuedBytes = budget.GetBytes();
+    stats.nSent = nSent;
+    stats.nDropped = nDropped;
+    stats.nFailed = nFailed;
+    return stats;
+}
+
+CZMQPublishStats GetZMQPublishStats()
+{
+    CZMQPublishStats stats = publisher.GetStats();
+    for (const auto& pair : mapPublishNotifiers)
+        stats.vNotifiers.emplace_back(pair.second->GetType(), pair.second->GetAddress());
+    return stats;
+}
+
+void CZMQAbstractPublishNotifier::StartPublisher()
+{
+    publisher.Start();
+}
+
+void CZMQAbstractPublishNotifier::StopPublisher()
+{
+    publisher.Stop();
+}
+
+/** Most recently serialized payload of one kind of object.
+ * All notifiers are invoked back to back for a notification, so remembering
+ * the last object is enough to serialize it only once for every raw* topic.
+ */
+class CZMQPayloadCache
+{
+private:
+    std::mutex cs;
+    uint256 hash;
+    CZMQPayloadRef payload;
+
+public:
+    template <typename Serializer>
+    CZMQPayloadRef Get(const uint256& hashIn, Serializer serialize)
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        if (!payload || hash != hashIn) {
+            payload = serialize();
+            hash = hashIn;
+        }
+        return payload;
+    }
+};
+
+static CZMQPayloadCache blockPayloadCache;
+static CZMQPayloadCache txPayloadCache;
+static CZMQPayloadCache votePayloadCache;
+static CZMQPayloadCache objectPayloadCache;
+
+template <typename T>
+static CZMQPayloadRef GetSerializedPayload(CZMQPayloadCache& cache, const T& obj)
+{
+    return cache.Get(obj.GetHash(), [&obj]() {
+        CZMQPayloadRef payload = std::make_shared<CZMQPayload>();
+        payload->ss << obj;
+        return payload;
+    });
+}
+
 bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
 {
     assert(!psocket);
@@ -79,6 +322,14 @@ bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
             return false;
         }
 
+        int hwm = GetArg("-zmqpubhwm", DEFAULT_ZMQ_SNDHWM);
+        if (zmq_setsockopt(psocket, ZMQ_SNDHWM, &hwm, sizeof(hwm)) != 0)
+        {
+            zmqError("Failed to set outbound message high water mark");
+            zmq_close(psocket);
+            return false;
+        }
+
         int rc = zmq_bind(psocket, address.c_str());
         if (rc!=0)
         {
@@ -133,17 +384,26 @@ void CZMQAbstractPublishNotifier::Shutdown()
 }
 
 bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* data, size_t size)
+{
+    CZMQPayloadRef payload = std::make_shared<CZMQPayload>();
+    payload->ss.write((const char*)data, size);
+    return SendMessage(command, payload);
+}
+
+bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const CZMQPayloadRef& payload)
 {
     assert(psocket);
 
     /* send three parts, command & data & a LE 4byte sequence number */
-    unsigned char msgseq[sizeof(uint32_t)];
-    WriteLE32(&msgseq[0], nSequence);
-    int rc = zmq_send_multipart(psocket, command, strlen(command), data, size, msgseq, (size_t)sizeof(uint32_t), (void*)0);
-    if (rc == -1)
+    CZMQQueuedMessage msg;
+    msg.psocket = psocket;
+    msg.command = command;
+    msg.payload = payload;
+    WriteLE32(&msg.msgseq[0], nSequence);
+    if (!publisher.Push(std::move(msg)))
         return false;
 
-    /* increment memory only sequence number after sending */
+    /* increment memory only sequence number after queueing */
     nSequence++;
 
     return true;
@@ -213,69 +473,91 @@ bool CZMQPublishHashInstantSendDoubleSpendNotifier::NotifyInstantSendDoubleSpend
 }
 
 
-bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
+/** Serialized size of a block, read from the header in front of it in the block file */
+static size_t GetBlockSizeOnDisk(const CBlockIndex *pindex)
 {
-    LogPrint("zmq", "zmq: Publish rawblock %s\n", pindex->GetBlockHash().GetHex());
-
-    const Consensus::Params& consensusParams = Params().GetConsensus();
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    CDiskBlockPos pos;
     {
         LOCK(cs_main);
-        CBlock block;
-        if(!ReadBlockFromDisk(block, pindex, consensusParams))
-        {
-            zmqError("Can't read block from disk");
-            return false;
-        }
-
-        ss << block;
+        pos = pindex->GetBlockPos();
+    }
+    // Without it count the largest block there can be
+    size_t nSize = MAX_DIP0001_BLOCK_SIZE;
+    if (pos.IsNull() || pos.nPos < sizeof(uint32_t))
+        return nSize;
+    pos.nPos -= sizeof(uint32_t);
+    CAutoFile file(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull())
+        return nSize;
+    try {
+        uint32_t nBlockSize;
+        file >> nBlockSize;
+        if (nBlockSize <= nSize)
+            nSize = nBlockSize;
+    } catch (const std::exception&) {
     }
+    return nSize;
+}
+
+bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
+{
+    LogPrint("zmq", "zmq: Publish rawblock %s\n", pindex->GetBlockHash().GetHex());
 
-    return SendMessage(MSG_RAWBLOCK, &(*ss.begin()), ss.size());
+    // The block is read from disk by the publisher thread. Until that thread
+    // has read its size as well, it counts as the largest block there can be
+    // against -zmqpubqueuemaxmem.
+    CZMQPayloadRef payload = blockPayloadCache.Get(pindex->GetBlockHash(), [pindex]() {
+        return std::make_shared<CZMQPayload>([pindex](CDataStream& ss) {
+            const Consensus::Params& consensusParams = Params().GetConsensus();
+            LOCK(cs_main);
+            CBlock block;
+            if(!ReadBlockFromDisk(block, pindex, consensusParams))
+            {
+                zmqError("Can't read block from disk");
+                return false;
+            }
+
+            ss << block;
+            return true;
+        }, MAX_DIP0001_BLOCK_SIZE, [pindex]() {
+            return GetBlockSizeOnDisk(pindex);
+        });
+    });
+
+    return SendMessage(MSG_RAWBLOCK, payload);
 }
 
 bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &transaction)
 {
     uint256 hash = transaction.GetHash();
     LogPrint("zmq", "zmq: Publish rawtx %s\n", hash.GetHex());
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-    ss << transaction;
-    return SendMessage(MSG_RAWTX, &(*ss.begin()), ss.size());
+    return SendMessage(MSG_RAWTX, GetSerializedPayload(txPayloadCache, transaction));
 }
 
 bool CZMQPublishRawTransactionLockNotifier::NotifyTransactionLock(const CTransaction &transaction)
 {
     uint256 hash = transaction.GetHash();
     LogPrint("zmq", "zmq: Publish rawtxlock %s\n", hash.GetHex());
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-    ss << transaction;
-    return SendMessage(MSG_RAWTXLOCK, &(*ss.begin()), ss.size());
+    return SendMessage(MSG_RAWTXLOCK, GetSerializedPayload(txPayloadCache, transaction));
 }
 
 bool CZMQPublishRawGovernanceVoteNotifier::NotifyGovernanceVote(const CGovernanceVote &vote)
 {
     uint256 nHash = vote.GetHash();
     LogPrint("gobject", "gobject: Publish rawgovernanceobject: hash = %s, vote = %d\n", nHash.ToString(), vote.ToString());
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-    ss << vote;
-    return SendMessage(MSG_RAWGVOTE, &(*ss.begin()), ss.size());
+    return SendMessage(MSG_RAWGVOTE, GetSerializedPayload(votePayloadCache, vote));
 }
 
 bool CZMQPublishRawGovernanceObjectNotifier::NotifyGovernanceObject(const CGovernanceObject &govobj)
 {
     uint256 nHash = govobj.GetHash();
     LogPrint("gobject", "gobject: Publish rawgovernanceobject: hash = %s, type = %d\n", nHash.ToString(), govobj.GetObjectType());
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-    ss << govobj;
-    return SendMessage(MSG_RAWGOBJ, &(*ss.begin()), ss.size());
+    return SendMessage(MSG_RAWGOBJ, GetSerializedPayload(objectPayloadCache, govobj));
 }
 
 bool CZMQPublishRawInstantSendDoubleSpendNotifier::NotifyInstantSendDoubleSpendAttempt(const CTransaction &currentTx, const CTransaction &previousTx)
 {
     LogPrint("zmq", "zmq: Publish rawinstantsenddoublespend %s conflicts with %s\n", currentTx.GetHash().ToString(), previousTx.GetHash().ToString());
-    CDataStream ssCurrent(SER_NETWORK, PROTOCOL_VERSION), ssPrevious(SER_NETWORK, PROTOCOL_VERSION);
-    ssCurrent << currentTx;
-    ssPrevious << previousTx;
-    return SendMessage(MSG_RAWISCON, &(*ssCurrent.begin()), ssCurrent.size())
-        && SendMessage(MSG_RAWISCON, &(*ssPrevious.begin()), ssPrevious.size());
+    return SendMessage(MSG_RAWISCON, GetSerializedPayload(txPayloadCache, currentTx))
+        && SendMessage(MSG_RAWISCON, GetSerializedPayload(txPayloadCache, previousTx));
 }
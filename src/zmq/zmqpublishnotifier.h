@@ -6,11 +6,113 @@
 #define BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H
 
 #include "zmqabstractnotifier.h"
+#include "streams.h"
+
+#include <assert.h>
+#include <functional>
+#include <memory>
+#include <vector>
 
 class CBlockIndex;
 class CGovernanceVote;
 class CGovernanceObject;
 
+static const int DEFAULT_ZMQ_SNDHWM = 1000;
+static const int DEFAULT_ZMQ_PUBLISH_QUEUE_SIZE = 10000;
+static const int DEFAULT_ZMQ_PUBLISH_QUEUE_MAXMEM = 128;
+
+/** Serialized body of a zmq message.
+ * Payloads are shared between all notifiers publishing the same object (e.g.
+ * rawtx and rawtxlock, or several rawblock addresses), so every object is only
+ * serialized once. A payload with a loader is filled on the publisher thread
+ * the first time it is sent, which keeps disk reads off the validation thread.
+ * The same goes for the sizer, which replaces the estimate of a lazy payload
+ * with its actual size while it waits in the queue.
+ */
+struct CZMQPayload
+{
+    CDataStream ss;
+    std::function<bool(CDataStream&)> loader;
+    std::function<size_t()> sizer;
+    //! Set for payloads filled by a loader; their size is unknown until they are sent
+    const bool fLazy;
+    //! Expected size of a lazy payload, it is counted against the queue memory limit instead
+    size_t nSizeEstimate;
+    //! Whether the sizer has run, only accessed with the publisher lock held
+    bool fSized;
+    //! Only accessed by the publisher thread for lazy payloads
+    bool fLoaded;
+    bool fValid;
+
+    CZMQPayload() : ss(SER_NETWORK, PROTOCOL_VERSION), fLazy(false), nSizeEstimate(0), fSized(true), fLoaded(true), fValid(true) {}
+    CZMQPayload(const std::function<bool(CDataStream&)>& _loader, size_t _nSizeEstimate, const std::function<size_t()>& _sizer = nullptr) :
+        ss(SER_NETWORK, PROTOCOL_VERSION), loader(_loader), sizer(_sizer), fLazy(true), nSizeEstimate(_nSizeEstimate), fSized(!_sizer), fLoaded(false), fValid(false) {}
+
+    /** Size accounted for the payload while it is queued, called with the publisher lock held */
+    size_t GetQueuedSize() const { return fLazy ? nSizeEstimate : ss.size(); }
+};
+typedef std::shared_ptr<CZMQPayload> CZMQPayloadRef;
+
+/** Message and memory limits of the publisher queue. Not thread safe, the
+ * publisher guards it with its own lock.
+ */
+class CZMQQueueBudget
+{
+private:
+    size_t nMaxMessages;
+    size_t nMaxBytes;
+    size_t nMessages;
+    size_t nBytes;
+
+public:
+    CZMQQueueBudget(size_t _nMaxMessages = 0, size_t _nMaxBytes = 0) :
+        nMaxMessages(_nMaxMessages), nMaxBytes(_nMaxBytes), nMessages(0), nBytes(0) {}
+
+    /** Account for a message of nSize bytes, false if it does not fit */
+    bool Reserve(size_t nSize)
+    {
+        if (nMessages >= nMaxMessages || nBytes > nMaxBytes || nSize > nMaxBytes - nBytes)
+            return false;
+        nMessages++;
+        nBytes += nSize;
+        return true;
+    }
+
+    /** Give back what Reserve() took for a message leaving the queue */
+    void Release(size_t nSize)
+    {
+        assert(nMessages > 0 && nBytes >= nSize);
+        nMessages--;
+        nBytes -= nSize;
+    }
+
+    /** Account nNewSize instead of nOldSize for a message still in the queue */
+    void Resize(size_t nOldSize, size_t nNewSize)
+    {
+        assert(nBytes >= nOldSize);
+        nBytes = nBytes - nOldSize + nNewSize;
+    }
+
+    void Clear() { nMessages = 0; nBytes = 0; }
+
+    size_t GetMessages() const { return nMessages; }
+    size_t GetBytes() const { return nBytes; }
+};
+
+/** Counters of the zmq publisher thread */
+struct CZMQPublishStats
+{
+    size_t nQueued;
+    size_t nQueuedBytes;
+    uint64_t nSent;
+    uint64_t nDropped;
+    uint64_t nFailed;
+    //! Type and address of every active publish notifier
+    std::vector<std::pair<std::string, std::string> > vNotifiers;
+};
+
+CZMQPublishStats GetZMQPublishStats();
+
 class CZMQAbstractPublishNotifier : public CZMQAbstractNotifier
 {
 private:
@@ -18,16 +120,23 @@ private:
 
 public:
 
-    /* send zmq multipart message
+    /* queue zmq multipart message for the publisher thread
        parts:
           * command
           * data
           * message sequence number
+       Sequence numbers are assigned when queueing, so messages that are
+       dropped because the queue is over budget show up as gaps.
     */
     bool SendMessage(const char *command, const void* data, size_t size);
+    bool SendMessage(const char *command, const CZMQPayloadRef& payload);
 
     bool Initialize(void *pcontext) override;
     void Shutdown() override;
+
+    /** Start and stop the thread sending the queued messages of all notifiers */
+    static void StartPublisher();
+    static void StopPublisher();
 };
 
 class CZMQPublishHashBlockNotifier : public CZMQAbstractPublishNotifier
@@ -0,0 +1,68 @@
+// Copyright (c) 2024 The blazegeek developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "zmq/zmqrpc.h"
+
+#include "rpc/server.h"
+#include "zmq/zmqpublishnotifier.h"
+
+#include <univalue.h>
+
+UniValue getzmqnotifications(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "getzmqnotifications\n"
+            "\nReturns information about the active ZeroMQ notifications and the publisher queue.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"notifiers\": [\n"
+            "    {\n"
+            "      \"type\": \"pubhashtx\",         (string) Type of notification\n"
+            "      \"address\": \"...\"             (string) Address of the publisher\n"
+            "    },\n"
+            "    ...\n"
+            "  ],\n"
+            "  \"queued\": n,                     (numeric) Messages waiting for the publisher thread\n"
+            "  \"queued_bytes\": n,               (numeric) Size of the queued messages\n"
+            "  \"sent\": n,                       (numeric) Messages sent\n"
+            "  \"dropped\": n,                    (numeric) Messages dropped because the queue was over budget\n"
+            "  \"failed\": n                      (numeric) Messages that could not be loaded or sent\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getzmqnotifications", "")
+            + HelpExampleRpc("getzmqnotifications", "")
+        );
+
+    CZMQPublishStats stats = GetZMQPublishStats();
+
+    UniValue notifiers(UniValue::VARR);
+    for (const auto& notifier : stats.vNotifiers) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("type", notifier.first));
+        obj.push_back(Pair("address", notifier.second));
+        notifiers.push_back(obj);
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("notifiers", notifiers));
+    result.push_back(Pair("queued", (uint64_t)stats.nQueued));
+    result.push_back(Pair("queued_bytes", (uint64_t)stats.nQueuedBytes));
+    result.push_back(Pair("sent", stats.nSent));
+    result.push_back(Pair("dropped", stats.nDropped));
+    result.push_back(Pair("failed", stats.nFailed));
+    return result;
+}
+
+static const CRPCCommand commands[] =
+{ //  category              name                      actor (function)         okSafeMode
+  //  --------------------- ------------------------  -----------------------  ----------
+    { "zmq",                "getzmqnotifications",    &getzmqnotifications,    true,  {} },
+};
+
+void RegisterZMQRPCCommands(CRPCTable& t)
+{
+    for (unsigned int vcidx = 0; vcidx < ARRAYLEN(commands); vcidx++)
+        t.appendCommand(commands[vcidx].name, &commands[vcidx]);
+}